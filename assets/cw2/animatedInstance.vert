@@ -0,0 +1,55 @@
+#version 430
+
+// Instances animated by baked clips, lit by materialColour.frag (see
+// animationClips.glsl, which is linked in next to this). Each instance
+// evaluates its own clip from the global time, so nothing is uploaded per
+// frame.
+
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec3 iColor;
+layout( location = 2 ) in vec3 iNormal;
+layout( location = 3 ) in vec3 iSpecRef;
+layout( location = 4 ) in float iShininess;
+
+layout( location = 0 ) uniform mat4 uProjCamera;
+layout( location = 1 ) uniform float uTime;
+
+out vec3 v2fColor; // v2f = vertex to fragment
+out vec3 v2fNormal;
+out vec3 v2fPosition;
+out vec3 v2fSpecRef;
+out float v2fShininess;
+out vec3 v2fmodelTransform;
+
+void animated_transform( uint aInstance, float aTime, out vec3 aPosition, out vec3 aRotation );
+
+// Same as Transform::Matrix(): Rz * Ry * Rx
+mat3 rotation_zyx( vec3 aAngles )
+{
+	vec3 c = cos( aAngles );
+	vec3 s = sin( aAngles );
+
+	mat3 rx = mat3( 1.0, 0.0, 0.0,  0.0, c.x, s.x,  0.0, -s.x, c.x );
+	mat3 ry = mat3( c.y, 0.0, -s.y,  0.0, 1.0, 0.0,  s.y, 0.0, c.y );
+	mat3 rz = mat3( c.z, s.z, 0.0,  -s.z, c.z, 0.0,  0.0, 0.0, 1.0 );
+	return rz * ry * rx;
+}
+
+void main()
+{
+	vec3 position;
+	vec3 rotation;
+	animated_transform( uint(gl_InstanceID), uTime, position, rotation );
+
+	mat3 model = rotation_zyx( rotation );
+
+	v2fColor = iColor;
+	v2fNormal = normalize( model * iNormal );
+
+	v2fPosition = model * iPosition;
+	v2fSpecRef = iSpecRef;
+	v2fShininess = iShininess;
+	v2fmodelTransform = position;
+
+	gl_Position = uProjCamera * vec4( v2fPosition + position, 1.0 );
+}
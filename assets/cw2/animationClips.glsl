@@ -0,0 +1,149 @@
+#version 430
+
+// Baked animation clips, evaluated on the GPU. Mirrors AnimationSystem and
+// EvaluateShape(); the buffers are filled by GpuAnimationClips.
+//
+// This is not a complete shader. It is attached as a second shader object
+// to the programs that use it (of any stage), which declare
+//
+//	void animated_transform( uint aInstance, float aTime, out vec3 aPosition, out vec3 aRotation );
+//
+// A clip is six tracks: position x, y, z, then rotation x, y, z.
+
+// Must match the structs in GpuAnimation.cpp (std430)
+struct AnimationKey
+{
+	float time;  // from the start of the clip
+	float value;
+	uint kind;   // ShapeKind of the segment ending at this key
+	uint degree;
+};
+
+struct AnimationTrack
+{
+	uint firstKey;
+	uint keyCount;
+};
+
+struct AnimationClip
+{
+	uint firstTrack;
+	float duration; // negative if nothing to play
+	uint loop;
+	uint pad;
+};
+
+struct AnimatedInstance
+{
+	vec3 origin;
+	uint clip;
+	float startTime;
+	float speed;
+	float pad[2];
+};
+
+layout( std430, binding = 4 ) readonly buffer AnimationKeys
+{
+	AnimationKey animationKeys[];
+};
+layout( std430, binding = 5 ) readonly buffer AnimationTracks
+{
+	AnimationTrack animationTracks[];
+};
+layout( std430, binding = 6 ) readonly buffer AnimationClips
+{
+	AnimationClip animationClips[];
+};
+layout( std430, binding = 7 ) readonly buffer AnimatedInstances
+{
+	AnimatedInstance animatedInstances[];
+};
+
+// ShapeKind
+const uint kShapeNone = 0u;
+const uint kShapeInstant = 1u;
+const uint kShapePolynomial = 2u;
+const uint kShapePolynomialEaseOut = 3u;
+const uint kShapeSmoothstep = 4u;
+
+float power_by_squaring( float x, uint n )
+{
+	float x2 = x * x;
+	float x4 = x2 * x2;
+	float x8 = x4 * x4;
+
+	float a = (n & 1u) != 0u ? x : 1.0;
+	float b = (n & 2u) != 0u ? x2 : 1.0;
+	float c = (n & 4u) != 0u ? x4 : 1.0;
+	float d = (n & 8u) != 0u ? x8 : 1.0;
+	return a * b * c * d;
+}
+
+float evaluate_shape( uint aKind, uint aDegree, float t )
+{
+	float u = 1.0 - t;
+
+	if( kShapeInstant == aKind )
+		return 1.0;
+	if( kShapePolynomial == aKind )
+		return power_by_squaring( t, aDegree );
+	if( kShapePolynomialEaseOut == aKind )
+		return 1.0 - power_by_squaring( u, aDegree );
+	if( kShapeSmoothstep == aKind )
+		return mix( t * t, 1.0 - u * u, t );
+
+	return 0.0;
+}
+
+float evaluate_track( uint aTrack, float aTime )
+{
+	AnimationTrack track = animationTracks[aTrack];
+	if( track.keyCount < 2u )
+		return track.keyCount > 0u ? animationKeys[track.firstKey].value : 0.0;
+
+	// Same as FindSegment_(): binary search for the number of inner keys at
+	// or before the time
+	uint lo = 0u;
+	uint hi = track.keyCount - 2u;
+	while( lo < hi )
+	{
+		uint mid = (lo + hi) / 2u;
+		if( animationKeys[track.firstKey + 1u + mid].time <= aTime )
+			lo = mid + 1u;
+		else
+			hi = mid;
+	}
+
+	AnimationKey from = animationKeys[track.firstKey + lo];
+	AnimationKey to = animationKeys[track.firstKey + lo + 1u];
+
+	// Empty segments are only ever the last one, and then the time is past
+	// it
+	if( to.time <= from.time )
+		return to.value;
+
+	float progress = clamp( (aTime - from.time) * (1.0 / (to.time - from.time)), 0.0, 1.0 );
+	return mix( from.value, to.value, evaluate_shape( to.kind, to.degree, progress ) );
+}
+
+void animated_transform( uint aInstance, float aTime, out vec3 aPosition, out vec3 aRotation )
+{
+	AnimatedInstance instance = animatedInstances[aInstance];
+	AnimationClip clip = animationClips[instance.clip];
+
+	float time = max( (aTime - instance.startTime) * instance.speed, 0.0 );
+	if( clip.loop != 0u && clip.duration > 0.0 )
+		time = mod( time, clip.duration );
+
+	uint t = clip.firstTrack;
+	aPosition = instance.origin + vec3(
+		evaluate_track( t + 0u, time ),
+		evaluate_track( t + 1u, time ),
+		evaluate_track( t + 2u, time )
+	);
+	aRotation = vec3(
+		evaluate_track( t + 3u, time ),
+		evaluate_track( t + 4u, time ),
+		evaluate_track( t + 5u, time )
+	);
+}
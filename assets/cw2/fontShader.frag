@@ -7,11 +7,23 @@ layout( location = 0 ) out vec4 oColor;
 
 layout( binding = 0 ) uniform sampler2D uTexture;
 
+// Retained text comes from SdfGlyphAtlas: the texture is a distance field
+// with the glyph's edge at 0.5, rather than coverage, and the texture
+// coordinates are in texels (so that the atlas can grow under them)
+uniform bool uDistanceField;
+
 
 void main()
 {
-	float alpha = texture( uTexture, v2fTexCoord ).r;
+	vec2 texCoord = uDistanceField ? v2fTexCoord / vec2(textureSize( uTexture, 0 )) : v2fTexCoord;
+	float alpha = texture( uTexture, texCoord ).r;
+
+	if( uDistanceField )
+	{
+		// About a pixel of antialiasing, whatever size the glyph is drawn at
+		float width = 0.5 * fwidth( alpha );
+		alpha = smoothstep( 0.5 - width, 0.5 + width, alpha );
+	}
 
 	oColor = vec4( v2fColor.rgb, v2fColor.a * alpha);
 }
-
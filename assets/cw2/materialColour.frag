@@ -1,4 +1,9 @@
 #version 430
+
+// Specialized by ShaderProgram::ShaderSource::defines; these are the defaults
+#ifndef N_LIGHTS
+#define N_LIGHTS 3
+#endif
 in vec3 v2fColor;
 in vec3 v2fNormal;
 in vec3 v2fPosition;
@@ -20,9 +25,11 @@ struct PointLight {
 	vec4 lIntensity;
 };
 
+#if N_LIGHTS > 0
 layout(std140) uniform LightBlock {
-    PointLight lights[3];
+    PointLight lights[N_LIGHTS];
 };
+#endif
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 view)
 {
@@ -56,10 +63,12 @@ void main()
 	vec3 fragPos = v2fPosition + v2fmodelTransform;
 	vec3 V = normalize(-uCamPosition - fragPos);
 
-	for(int i = 0; i<3; i++)
+#if N_LIGHTS > 0
+	for(int i = 0; i<N_LIGHTS; i++)
 	{
 		result_light += CalcPointLight(lights[i], normal, fragPos, V);
 	}
+#endif
 
 	//apply simplfied blinn phong
 	oColor = (uSceneAmbient + result_light) * v2fColor;
@@ -3,10 +3,14 @@
 layout( location = 0 ) in vec3 iPosition;
 layout( location = 1 ) in vec2 iTexCoord;
 
-layout(location = 0) uniform mat4 uProjCameraWorld;
-layout(location = 1) uniform vec4 uColour;
+// Per-particle (instanced) attributes
+layout( location = 2 ) in vec3 iParticlePosition;
+layout( location = 3 ) in vec4 iParticleColour;
+layout( location = 4 ) in float iParticleSize;
 
-uniform vec3 uOffset;
+layout( location = 0 ) uniform mat4 uProjCameraWorld;
+layout( location = 1 ) uniform vec3 uCameraRight;
+layout( location = 2 ) uniform vec3 uCameraUp;
 
 out vec2 v2fTexCoord;
 out vec4 v2fColour;
@@ -14,9 +18,9 @@ out vec4 v2fColour;
 void main()
 {
 	v2fTexCoord = iTexCoord;
-	v2fColour = uColour;
+	v2fColour = iParticleColour;
 
-	float scale = 0.2;
-	//gl_Position = uProjCameraWorld * (vec4((iPosition.xyz + uOffset.xyz) * scale, 1.f));
-	gl_Position = uProjCameraWorld * (vec4((iPosition.xyz) * scale, 1.f));
-}
\ No newline at end of file
+	// Billboard: span the quad along the camera's right and up axes
+	vec3 corner = (iPosition.x * uCameraRight + iPosition.y * uCameraUp) * iParticleSize;
+	gl_Position = uProjCameraWorld * vec4( iParticlePosition + corner, 1.f );
+}
@@ -0,0 +1,51 @@
+#version 430
+
+// SkinnedModel, lit by materialColour.frag. With the CPU backend the vertices
+// arrive skinned; with the GPU backend they are skinned here (skinning.glsl,
+// which is linked in next to this).
+
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec3 iColor;
+layout( location = 2 ) in vec3 iNormal;
+layout( location = 3 ) in vec3 iSpecRef;
+layout( location = 4 ) in float iShininess;
+layout( location = 5 ) in uvec4 iJoints;
+layout( location = 6 ) in vec4 iWeights;
+
+layout( location = 0 ) uniform mat4 uProjCamera;
+layout( location = 1 ) uniform mat4 uModel; // rotation, uniform scale and translation
+layout( location = 2 ) uniform uint uSkinOnGpu;
+
+out vec3 v2fColor; // v2f = vertex to fragment
+out vec3 v2fNormal;
+out vec3 v2fPosition;
+out vec3 v2fSpecRef;
+out float v2fShininess;
+out vec3 v2fmodelTransform;
+
+mat4 skin_matrix( uvec4 aJoints, vec4 aWeights );
+
+void main()
+{
+	vec4 position = vec4( iPosition, 1.0 );
+	vec3 normal = iNormal;
+
+	if( 0u != uSkinOnGpu )
+	{
+		mat4 skin = skin_matrix( iJoints, iWeights );
+		position = skin * position;
+		normal = mat3( skin ) * normal;
+	}
+
+	vec4 world = uModel * position;
+
+	v2fColor = iColor;
+	v2fNormal = normalize( mat3( uModel ) * normal );
+
+	v2fPosition = world.xyz;
+	v2fSpecRef = iSpecRef;
+	v2fShininess = iShininess;
+	v2fmodelTransform = vec3( 0.0 );
+
+	gl_Position = uProjCamera * world;
+}
@@ -0,0 +1,23 @@
+#version 430
+
+// Linear blend skinning with the palette from Skeleton::EvaluatePose(),
+// uploaded by SkinnedModel. Same as SkinVertices().
+//
+// This is not a complete shader. It is attached as a second shader object
+// to the programs that use it (of any stage), which declare
+//
+//	mat4 skin_matrix( uvec4 aJoints, vec4 aWeights );
+
+// Mat44f is row major
+layout( std430, row_major, binding = 8 ) readonly buffer SkinPalette
+{
+	mat4 skinPalette[];
+};
+
+mat4 skin_matrix( uvec4 aJoints, vec4 aWeights )
+{
+	return aWeights.x * skinPalette[aJoints.x]
+		+ aWeights.y * skinPalette[aJoints.y]
+		+ aWeights.z * skinPalette[aJoints.z]
+		+ aWeights.w * skinPalette[aJoints.w];
+}
@@ -1,65 +1,81 @@
-#version 430
-in vec3 v2fColor;
-in vec3 v2fNormal;
-in vec2 v2fTexCoord;
-in vec3 v2fPosition;
-
-layout( location = 0 ) out vec3 oColor;
-
-layout( location = 1) uniform vec3 uLightDir;
-layout( location = 2) uniform vec3 uLightDiffuse;
-layout( location = 3) uniform vec3 uSceneAmbient;
-
-uniform vec3 uCamPosition;
-
-struct PointLight {
-    vec4 lPosition;
-    vec4 lColour;
-	vec4 lIntensity;
-};
-
-layout(std140) uniform LightBlock {
-    PointLight lights[3];
-};
-
-layout( binding = 0 ) uniform sampler2D uTexture;
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 view)
-{
-	if(light.lColour[3] == 0) //check if light off
-		return vec3(0.f, 0.f, 0.f);
-
-	vec3 LPos = vec3(light.lPosition) - fragPos;
-	float distAttenuation = 50/(LPos[0]*LPos[0] + LPos[1]*LPos[1] + LPos[2]*LPos[2]); //intensity scaling factor of 10
-
-	vec3 L = normalize(LPos);
-	vec3 sum = view + L;
-	vec3 H = normalize((sum)/sqrt(sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2]));
-	vec3 specular = distAttenuation * vec3(light.lColour) * 0.5 * pow( max(0.f, dot(H, normal)), 50); //0.5 = specular reflectiveness, 50 = shininess
-
-	vec3 diffuse = 0.2* distAttenuation * vec3(light.lColour) * max(0.f, dot(L, normal));
-
-	return (specular + diffuse) * light.lIntensity[0];
-
-}
-
-void main()
-{
-	vec3 normal = normalize(v2fNormal);
-
-	vec3 result_light;
-
-	//diffuse light
-	vec3 diffuseLight = uLightDiffuse * max(0.f, dot(normal, uLightDir));
-	result_light = diffuseLight;
-
-	vec3 V = normalize(-uCamPosition - v2fPosition);
-
-	for(int i = 0; i<3; i++)
-	{
-		result_light += CalcPointLight(lights[i], normal, v2fPosition, V);
-	}
-
-	oColor = (uSceneAmbient + result_light) * texture( uTexture, v2fTexCoord ).rgb;
-}
-
+#version 430
+
+// Specialized by ShaderProgram::ShaderSource::defines; these are the defaults
+#ifndef N_LIGHTS
+#define N_LIGHTS 3
+#endif
+
+// StaticMaterialFlags
+#define STATIC_TEXTURED 1u
+
+in vec3 v2fColor;
+in vec3 v2fNormal;
+in vec3 v2fPosition;
+in vec3 v2fSpecRef;
+in float v2fShininess;
+in vec2 v2fTexCoord;
+flat in uint v2fFlags;
+flat in float v2fPointLightScale;
+
+layout( location = 0 ) out vec3 oColor;
+
+uniform vec3 uLightDir;
+uniform vec3 uLightDiffuse;
+uniform vec3 uSceneAmbient;
+
+uniform vec3 uCamPosition;
+
+layout( binding = 0 ) uniform sampler2D uTexture;
+
+struct PointLight {
+    vec4 lPosition;
+    vec4 lColour;
+	vec4 lIntensity;
+};
+
+#if N_LIGHTS > 0
+layout(std140) uniform LightBlock {
+    PointLight lights[N_LIGHTS];
+};
+#endif
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 view)
+{
+	if(light.lColour[3] == 0) //check if light off
+		return vec3(0.f, 0.f, 0.f);
+
+	vec3 LPos = vec3(light.lPosition) - fragPos;
+	float distAttenuation = v2fPointLightScale/(LPos[0]*LPos[0] + LPos[1]*LPos[1] + LPos[2]*LPos[2]);
+
+	vec3 L = normalize(LPos);
+	vec3 sum = view + L;
+	vec3 H = normalize((sum)/sqrt(sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2]));
+	vec3 specular = distAttenuation * vec3(light.lColour) * v2fSpecRef * pow( max(0.f, dot(H, normal)), v2fShininess);
+
+	vec3 diffuse = 0.2* distAttenuation * vec3(light.lColour) * max(0.f, dot(L, normal));
+
+	return (specular + diffuse) * light.lIntensity[0];
+
+}
+
+void main()
+{
+	vec3 normal = normalize(v2fNormal);
+
+	//diffuse light
+	vec3 result_light = uLightDiffuse * max(0.f, dot(normal, uLightDir));
+
+	vec3 V = normalize(-uCamPosition - v2fPosition);
+
+#if N_LIGHTS > 0
+	for(int i = 0; i<N_LIGHTS; i++)
+	{
+		result_light += CalcPointLight(lights[i], normal, v2fPosition, V);
+	}
+#endif
+
+	vec3 albedo = 0u != (v2fFlags & STATIC_TEXTURED) ? texture( uTexture, v2fTexCoord ).rgb : v2fColor;
+
+	//apply simplfied blinn phong
+	oColor = (uSceneAmbient + result_light) * albedo;
+}
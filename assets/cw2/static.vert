@@ -0,0 +1,90 @@
+#version 430
+
+// Static geometry, drawn by StaticDrawBatch in one multi-draw. Specialized by
+// ShaderProgram::ShaderSource::defines: with DRAW_PARAMETERS, each draw is
+// found with gl_DrawID; without, through the instance (see StaticDrawBatch).
+#ifndef DRAW_PARAMETERS
+#define DRAW_PARAMETERS 0
+#endif
+
+#if DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec3 iColor;
+layout( location = 2 ) in vec3 iNormal;
+layout( location = 3 ) in vec3 iSpecRef;
+layout( location = 4 ) in float iShininess;
+layout( location = 5 ) in vec2 iTexCoord;
+
+// The base instance plus the instance, the slot in StaticVisible; not read
+// with DRAW_PARAMETERS
+layout( location = 6 ) in uint iInstance;
+
+struct StaticDraw
+{
+	uint firstInstance;
+	uint flags;
+	float pointLightScale;
+	uint pad;
+};
+
+struct StaticInstance
+{
+	mat4 world;
+	mat4 normal; // The upper 3x3
+	vec4 sphere; // Read by staticCull.comp
+	uint draw;
+};
+
+layout( std430, binding = 9 ) readonly buffer StaticDraws
+{
+	StaticDraw draws[];
+};
+
+layout( std430, row_major, binding = 10 ) readonly buffer StaticInstances
+{
+	StaticInstance instances[];
+};
+
+// The instances to draw, each draw's from its first instance on
+layout( std430, binding = 11 ) readonly buffer StaticVisible
+{
+	uint visible[];
+};
+
+uniform mat4 uProjCamera;
+
+out vec3 v2fColor; // v2f = vertex to fragment
+out vec3 v2fNormal;
+out vec3 v2fPosition;
+out vec3 v2fSpecRef;
+out float v2fShininess;
+out vec2 v2fTexCoord;
+flat out uint v2fFlags;
+flat out float v2fPointLightScale;
+
+void main()
+{
+#if DRAW_PARAMETERS
+	uint drawIndex = uint(gl_DrawIDARB);
+	uint instance = visible[draws[drawIndex].firstInstance + uint(gl_InstanceID)];
+#else
+	uint instance = visible[iInstance];
+	uint drawIndex = instances[instance].draw;
+#endif
+
+	vec4 world = instances[instance].world * vec4( iPosition, 1.0 );
+
+	v2fColor = iColor;
+	v2fNormal = normalize( mat3( instances[instance].normal ) * iNormal );
+	v2fPosition = world.xyz;
+	v2fSpecRef = iSpecRef;
+	v2fShininess = iShininess;
+	v2fTexCoord = iTexCoord;
+	v2fFlags = draws[drawIndex].flags;
+	v2fPointLightScale = draws[drawIndex].pointLightScale;
+
+	gl_Position = uProjCamera * world;
+}
@@ -1,13 +1,14 @@
 #version 430
 
 layout( location = 0 ) in vec2 iPosition;
-layout ( location = 1 ) in uint BorderFlag;
+layout( location = 1 ) in vec4 iColour;
 
-flat out uint v2fBorderFlag;
+// The element's colour, opaque on its border (UIElement::WriteVertices())
+flat out vec4 v2fColour;
 
 void main()
 {
-	v2fBorderFlag = BorderFlag;
+	v2fColour = iColour;
 
 	gl_Position = vec4(iPosition.xy, 0.f, 1.f);
-}
\ No newline at end of file
+}
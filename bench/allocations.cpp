@@ -0,0 +1,32 @@
+#include "allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<std::size_t> sAllocations_{ 0 };
+}
+
+std::size_t heap_allocations() noexcept
+{
+	return sAllocations_.load( std::memory_order_relaxed );
+}
+
+// The array and nothrow forms of new (and the sized forms of delete) defer to
+// these by default, so replacing these two covers them.
+void* operator new( std::size_t aSize )
+{
+	sAllocations_.fetch_add( 1, std::memory_order_relaxed );
+
+	if( void* ptr = std::malloc( aSize ? aSize : 1 ) )
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete( void* aPtr ) noexcept
+{
+	std::free( aPtr );
+}
@@ -0,0 +1,18 @@
+#ifndef ALLOCATIONS_HPP_DF54D0A6_30A1_4AF0_AFCC_EBC1A9903C07
+#define ALLOCATIONS_HPP_DF54D0A6_30A1_4AF0_AFCC_EBC1A9903C07
+
+#include <cstddef>
+
+// Counts heap allocations. The bench replaces the global operator new (and
+// delete) with versions that count calls before deferring to malloc(), so a
+// benchmark can check that its steady state doesn't allocate:
+//
+//   std::size_t const before = heap_allocations();
+//   frame();
+//   REQUIRE( before == heap_allocations() );
+//
+// All threads count. Over-aligned allocations (operator new with an
+// std::align_val_t) are not replaced, so not counted.
+std::size_t heap_allocations() noexcept;
+
+#endif // ALLOCATIONS_HPP_DF54D0A6_30A1_4AF0_AFCC_EBC1A9903C07
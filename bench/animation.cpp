@@ -0,0 +1,143 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+
+#include "../main/AnimationTools.hpp"
+#include "../main/AnimationSystem.hpp"
+
+namespace
+{
+	constexpr float kFrameTime_ = 1.f / 60.f;
+
+	// Roughly the ship lift-off/warp sequence from main.cpp: lift off, wait,
+	// warp, disappear.
+	KeyFramedFloat make_track_( float aStart, float aEnd )
+	{
+		FloatKeyFrameGenerator gen( aStart );
+
+		KeyFramedFloat track( gen.GenerateWithValue( aStart, 0.f, ShapingFunctions::None ) );
+		track.InsertKeyframe( gen.GenerateNext( 30.f, 7.f, ShapingFunctions::Smoothstep ) );
+		track.InsertKeyframe( gen.GenerateNext( 0.f, 0.1f, ShapingFunctions::None ) );
+		track.InsertKeyframe( gen.GenerateWithValue( aEnd, 3.f, ShapingFunctions::Polynomial<6> ) );
+		track.InsertKeyframe( gen.GenerateWithValue( aEnd * 10.f, 1.f, ShapingFunctions::PolynomialEaseOut<6> ) );
+
+		return track;
+	}
+
+	// The same sequence as a clip track
+	void add_track_( AnimationSystem& aAnimations, AnimationSystem::ClipID aClip, float aStart, float aEnd )
+	{
+		TrackKeyFrame const keys[] = {
+			{ aStart, 0.f, Shapes::None },
+			{ aStart + 30.f, 7.f, Shapes::Smoothstep },
+			{ aStart + 30.f, 0.1f, Shapes::None },
+			{ aEnd, 3.f, Shapes::Polynomial<6> },
+			{ aEnd * 10.f, 1.f, Shapes::PolynomialEaseOut<6> }
+		};
+
+		aAnimations.AddTrack( aClip, keys );
+	}
+}
+
+TEST_CASE( "KeyFramedFloat::Update", "[benchmark][animation]" )
+{
+	for( int const count : { 6, 6000 } )
+	{
+		std::vector<KeyFramedFloat> tracks;
+		for( int i = 0; i < count; ++i )
+			tracks.emplace_back( make_track_( float(i), 1000.f + float(i) ) );
+
+		for( auto& track : tracks )
+			track.Play();
+
+		BENCHMARK( "Update (" + std::to_string( count ) + " tracks, ship sequence)" )
+		{
+			float sum = 0.f;
+			for( auto& track : tracks )
+			{
+				// Loop the sequence so that we never measure a finished track
+				if( !track.IsPlaying() )
+				{
+					track.Stop();
+					track.Play();
+				}
+
+				sum += track.Update( kFrameTime_ );
+			}
+			return sum;
+		};
+	}
+}
+
+TEST_CASE( "AnimationSystem::Update", "[benchmark][animation]" )
+{
+	// Six tracks per clip, like the ship
+	for( int const count : { 6, 6000 } )
+	{
+		AnimationSystem animations;
+		for( int i = 0; i < count; ++i )
+		{
+			if( 0 == i % 6 )
+				animations.AddClip();
+
+			add_track_( animations, animations.ClipCount() - 1, float(i), 1000.f + float(i) );
+		}
+
+		// Loop the sequence so that we never measure a finished clip
+		for( AnimationSystem::ClipID clip = 0; clip < animations.ClipCount(); ++clip )
+		{
+			animations.InsertOnFinishCallback( clip, [&animations, clip] {
+				animations.Stop( clip );
+				animations.Play( clip );
+			} );
+			animations.Play( clip );
+		}
+
+		BENCHMARK( "Update (" + std::to_string( count ) + " tracks, ship sequence)" )
+		{
+			animations.Update( kFrameTime_ );
+			return animations.Value( 0 );
+		};
+	}
+}
+
+TEST_CASE( "Animation seek", "[benchmark][animation]" )
+{
+	// Jump to 10s into the ship sequence. KeyFramedFloat can only get
+	// there by replaying every frame up to it.
+	constexpr float kTime = 10.f;
+
+	std::vector<KeyFramedFloat> tracks;
+	for( int i = 0; i < 6; ++i )
+		tracks.emplace_back( make_track_( float(i), 1000.f + float(i) ) );
+
+	BENCHMARK( "KeyFramedFloat replay to 10s (6 tracks)" )
+	{
+		float sum = 0.f;
+		for( auto& track : tracks )
+		{
+			track.Stop();
+			track.Play();
+			for( float time = 0.f; time < kTime; time += kFrameTime_ )
+				track.Update( kFrameTime_ );
+
+			sum += track.GetCurrentValue();
+		}
+		return sum;
+	};
+
+	AnimationSystem animations;
+	auto const clip = animations.AddClip();
+	for( int i = 0; i < 6; ++i )
+		add_track_( animations, clip, float(i), 1000.f + float(i) );
+
+	BENCHMARK( "AnimationSystem seek to 10s (6 tracks)" )
+	{
+		animations.Seek( clip, 0.f );
+		animations.Update( 0.f );
+		animations.Seek( clip, kTime );
+		animations.Update( 0.f );
+		return animations.Value( 0 );
+	};
+}
@@ -0,0 +1,127 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+
+#include "../main/Frustum.hpp"
+#include "../main/GeometryBuffer.hpp"
+#include "../main/ModelObject.hpp"
+#include "../main/ShapeObject.hpp"
+#include "../main/StaticDrawBatch.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+#include "null_gl.hpp"
+
+namespace
+{
+	constexpr ShapeMaterial kMaterial_{
+		.mVertexColor = { 0.4f, 0.4f, 0.4f },
+		.mSpecular = { 0.846f, 0.846f, 0.846f },
+		.mShininess = 50.f
+	};
+}
+
+TEST_CASE( "Static geometry welding", "[benchmark][geometry]" )
+{
+	ModelObject const landingPad( "assets/cw2/landingpad.obj", kLoadVertexColour | kLoadVertexSpecular | kLoadVertexShininess );
+	ModelObject const cylinder = MakeCylinder( true, 32, Transform{}, kMaterial_ );
+
+	std::vector<StaticVertex> vertices;
+	std::vector<GLuint> indices;
+
+	BENCHMARK( "Weld landingpad.obj" )
+	{
+		GeometryBuffer::Weld( landingPad, vertices, indices );
+		return vertices.size();
+	};
+
+	BENCHMARK( "Weld MakeCylinder (32 subdivisions)" )
+	{
+		GeometryBuffer::Weld( cylinder, vertices, indices );
+		return vertices.size();
+	};
+}
+
+// A frame of static draws: however many objects, one multi-draw. What is
+// left on the CPU is filling in the commands and the instance records, and
+// that goes with the instances (their transforms), whether each object is
+// a draw of its own or they are instances of one.
+TEST_CASE( "Static draw batch", "[benchmark][geometry]" )
+{
+	load_null_gl();
+
+	ModelObject const cube = MakeCube( Transform{}, kMaterial_ );
+	GeometryBuffer geometry( 1024, 1024 );
+	MeshRange const mesh = geometry.Add( cube );
+
+	StaticDrawBatch batch( geometry );
+
+	for( std::size_t count : { 16, 1024 } )
+	{
+		std::vector<Transform> transforms( count );
+		for( std::size_t i = 0; i < count; ++i )
+			transforms[i].mPosition = { float(i), 0.f, -float(i) };
+
+		auto const suffix = " (" + std::to_string( count ) + " objects)";
+
+		BENCHMARK( "One draw per object" + suffix )
+		{
+			batch.Clear();
+			for( Transform const& transform : transforms )
+				batch.Add( mesh, { &transform, 1 } );
+			batch.Draw();
+			return batch.DrawCount();
+		};
+
+		BENCHMARK( "One draw, instanced" + suffix )
+		{
+			batch.Clear();
+			batch.Add( mesh, transforms );
+			batch.Draw();
+			return batch.DrawCount();
+		};
+	}
+}
+
+// Frustum culling the instances of a frame, half of them in view. On the
+// CPU, each instance is tested; with the GPU backend, the CPU only issues
+// the dispatch, whatever the count (the shader's own time isn't measured
+// here, with no GL behind it).
+TEST_CASE( "Static draw culling", "[benchmark][geometry]" )
+{
+	load_null_gl();
+
+	ModelObject const cube = MakeCube( Transform{}, kMaterial_ );
+	GeometryBuffer geometry( 1024, 1024 );
+	MeshRange const mesh = geometry.Add( cube );
+
+	StaticDrawBatch batch( geometry );
+
+	Mat44f const projCamera = make_perspective_projection( 1.5f, 1.f, 0.1f, 1000.f );
+	Frustum const frustum = MakeFrustum( projCamera );
+
+	for( std::size_t count : { 1024, 16384 } )
+	{
+		std::vector<Transform> transforms( count );
+		for( std::size_t i = 0; i < count; ++i )
+			transforms[i].mPosition = { float(i % 64) - 32.f, 0.f, i % 2 ? -float(i % 512) : float(i % 512) };
+
+		batch.Clear();
+		batch.Add( mesh, transforms );
+
+		auto const suffix = " (" + std::to_string( count ) + " instances)";
+
+		BENCHMARK( "Cull on the CPU" + suffix )
+		{
+			batch.Cull( frustum, CullingBackend::Cpu );
+			return batch.DrawCount();
+		};
+
+		BENCHMARK( "Cull on the GPU" + suffix )
+		{
+			batch.Cull( frustum, CullingBackend::Gpu );
+			return batch.DrawCount();
+		};
+	}
+}
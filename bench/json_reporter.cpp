@@ -0,0 +1,95 @@
+// Catch2's own JSON reporter does not record benchmark results (its
+// benchmark*() callbacks are empty), so we provide a small one that does.
+//
+// Usage:
+//	bench --reporter benchjson::out=bench_output.json
+//
+// Each benchmark is written with its test case, mean and standard deviation
+// (point estimate plus bootstrapped bounds, in nanoseconds), so that files
+// from different commits can be compared directly.
+
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct BenchmarkRecord_
+	{
+		std::string testCase;
+		Catch::BenchmarkStats<> stats;
+	};
+
+	class BenchJsonReporter_ final : public Catch::StreamingReporterBase
+	{
+		public:
+			explicit BenchJsonReporter_( Catch::ReporterConfig&& aConfig )
+				: StreamingReporterBase( std::move(aConfig) )
+			{
+				m_preferences.shouldReportAllAssertions = false;
+			}
+
+			static std::string getDescription()
+			{
+				return "Writes benchmark results as JSON";
+			}
+
+		public:
+			void testCaseStarting( Catch::TestCaseInfo const& aInfo ) override
+			{
+				StreamingReporterBase::testCaseStarting( aInfo );
+				mCurrentTestCase = aInfo.name;
+			}
+
+			void benchmarkEnded( Catch::BenchmarkStats<> const& aStats ) override
+			{
+				mRecords.push_back( { mCurrentTestCase, aStats } );
+			}
+
+			void testRunEnded( Catch::TestRunStats const& aStats ) override
+			{
+				StreamingReporterBase::testRunEnded( aStats );
+
+				{
+					Catch::JsonObjectWriter root( m_stream );
+					root.write( "version" ).write( 1 );
+					root.write( "rng-seed" ).write( m_config->rngSeed() );
+
+					auto benchmarks = root.write( "benchmarks" ).writeArray();
+					for( auto const& record : mRecords )
+					{
+						auto const& stats = record.stats;
+
+						auto entry = benchmarks.writeObject();
+						entry.write( "test-case" ).write( record.testCase );
+						entry.write( "name" ).write( stats.info.name );
+						entry.write( "samples" ).write( stats.info.samples );
+						entry.write( "iterations" ).write( stats.info.iterations );
+
+						write_estimate_( entry, "mean", stats.mean );
+						write_estimate_( entry, "std-dev", stats.standardDeviation );
+
+						entry.write( "outlier-variance" ).write( stats.outlierVariance );
+					}
+				}
+
+				m_stream << '\n';
+			}
+
+		private:
+			static void write_estimate_( Catch::JsonObjectWriter& aObject, Catch::StringRef aKey, Catch::Benchmark::Estimate<Catch::Benchmark::FDuration> const& aEstimate )
+			{
+				auto est = aObject.write( aKey ).writeObject();
+				est.write( "ns" ).write( aEstimate.point.count() );
+				est.write( "lower-ns" ).write( aEstimate.lower_bound.count() );
+				est.write( "upper-ns" ).write( aEstimate.upper_bound.count() );
+			}
+
+		private:
+			std::string mCurrentTestCase;
+			std::vector<BenchmarkRecord_> mRecords;
+	};
+}
+
+CATCH_REGISTER_REPORTER( "benchjson", BenchJsonReporter_ )
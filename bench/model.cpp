@@ -0,0 +1,98 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/mat33.hpp"
+
+#include "../main/ModelObject.hpp"
+#include "../main/ShapeObject.hpp"
+
+namespace
+{
+	constexpr ShapeMaterial kMaterial_{
+		.mVertexColor = { 0.4f, 0.4f, 0.4f },
+		.mSpecular = { 0.846f, 0.846f, 0.846f },
+		.mShininess = 50.f
+	};
+}
+
+TEST_CASE( "ObjectInstanceGroup array builders", "[benchmark][instancing]" )
+{
+	Mat44f const projection = make_perspective_projection( 1.f, 16.f / 9.f, 0.1f, 200.f );
+	Mat44f const world2camera = make_translation( { 0.f, -1.f, -10.f } );
+
+	for( std::size_t count : { 2, 64, 1024 } )
+	{
+		ObjectInstanceGroup group;
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			float const f = float(i);
+			group.CreateInstance( Transform{
+				.mPosition{ f, 0.f, -f },
+				.mRotation{ 0.f, 0.01f * f, 0.f }
+			} );
+		}
+
+		auto const suffix = " (" + std::to_string( count ) + " instances)";
+
+		BENCHMARK( "GetProjCameraWorldArray" + suffix )
+		{
+			return group.GetProjCameraWorldArray( projection, world2camera );
+		};
+
+		BENCHMARK( "GetTranslationArray" + suffix )
+		{
+			return group.GetTranslationArray();
+		};
+
+		BENCHMARK( "GetNormalUpdateArray" + suffix )
+		{
+			return group.GetNormalUpdateArray();
+		};
+	}
+}
+
+TEST_CASE( "OBJ loading", "[benchmark][model]" )
+{
+	uint32_t const landingPadLoadFlags = kLoadVertexColour
+	                                   | kLoadVertexAmbient
+	                                   | kLoadVertexSpecular
+	                                   | kLoadVertexShininess;
+
+	BENCHMARK( "ModelObject landingpad.obj" )
+	{
+		return ModelObject( "assets/cw2/landingpad.obj", landingPadLoadFlags );
+	};
+}
+
+TEST_CASE( "Shape generators", "[benchmark][shapes]" )
+{
+	Transform const preTransform{
+		.mPosition{ 1.6f, 0.9f, 1.f },
+		.mScale{ 1.7f, 0.2f, 0.2f }
+	};
+
+	BENCHMARK( "MakeCylinder (32 subdivisions)" )
+	{
+		return MakeCylinder( true, 32, preTransform, kMaterial_ );
+	};
+
+	BENCHMARK( "MakeCone (32 subdivisions)" )
+	{
+		return MakeCone( true, 32, preTransform, kMaterial_ );
+	};
+
+	BENCHMARK( "MakeCube" )
+	{
+		return MakeCube( preTransform, kMaterial_ );
+	};
+
+	BENCHMARK( "CombineShapeModelObjects" )
+	{
+		ModelObject a = MakeCylinder( true, 32, preTransform, kMaterial_ );
+		ModelObject b = MakeCone( false, 32, preTransform, kMaterial_ );
+		ModelObject c = MakeCube( preTransform, kMaterial_ );
+		return CombineShapeModelObjects( a, b, c );
+	};
+}
@@ -0,0 +1,163 @@
+#include "null_gl.hpp"
+
+#include <type_traits>
+
+#include <glad/glad.h>
+
+namespace
+{
+	GLuint sNextName_ = 0;
+
+	// Replace aFn with a function that ignores its arguments and returns a
+	// value-initialized result.
+	template< typename tRet, typename... tArgs >
+	void stub_( tRet (APIENTRYP& aFn)(tArgs...) )
+	{
+		aFn = []( tArgs... ) -> tRet {
+			if constexpr( !std::is_void_v<tRet> )
+				return tRet{};
+		};
+	}
+
+	void APIENTRY gen_names_( GLsizei aCount, GLuint* aNames )
+	{
+		for( GLsizei i = 0; i < aCount; ++i )
+			aNames[i] = ++sNextName_;
+	}
+
+	GLuint APIENTRY create_name_()
+	{
+		return ++sNextName_;
+	}
+
+	GLuint APIENTRY create_shader_( GLenum )
+	{
+		return ++sNextName_;
+	}
+
+	void APIENTRY get_object_iv_( GLuint, GLenum aName, GLint* aValue )
+	{
+		switch( aName )
+		{
+			case GL_LINK_STATUS:
+			case GL_COMPILE_STATUS:
+			case GL_VALIDATE_STATUS:
+				*aValue = GL_TRUE;
+				break;
+			default:
+				*aValue = 0;
+				break;
+		}
+	}
+
+	void APIENTRY get_integer_v_( GLenum, GLint* aValue )
+	{
+		*aValue = 0;
+	}
+}
+
+void load_null_gl()
+{
+	// Object creation
+	glad_glGenBuffers = &gen_names_;
+	glad_glGenVertexArrays = &gen_names_;
+	glad_glGenTextures = &gen_names_;
+	glad_glGenQueries = &gen_names_;
+	glad_glGenFramebuffers = &gen_names_;
+	glad_glCreateProgram = &create_name_;
+	glad_glCreateShader = &create_shader_;
+
+	glad_glGetProgramiv = &get_object_iv_;
+	glad_glGetShaderiv = &get_object_iv_;
+	glad_glGetIntegerv = &get_integer_v_;
+
+	stub_( glad_glDeleteBuffers );
+	stub_( glad_glDeleteVertexArrays );
+	stub_( glad_glDeleteTextures );
+	stub_( glad_glDeleteQueries );
+	stub_( glad_glDeleteFramebuffers );
+	stub_( glad_glDeleteProgram );
+	stub_( glad_glDeleteShader );
+
+	// Buffers and vertex arrays
+	stub_( glad_glBindBuffer );
+	stub_( glad_glBindBufferBase );
+	stub_( glad_glBindBufferRange );
+	stub_( glad_glBufferData );
+	stub_( glad_glBufferSubData );
+	stub_( glad_glMapBufferRange );
+	stub_( glad_glUnmapBuffer );
+	stub_( glad_glBindVertexArray );
+	stub_( glad_glVertexAttribPointer );
+	stub_( glad_glVertexAttribIPointer );
+	stub_( glad_glVertexAttribDivisor );
+	stub_( glad_glEnableVertexAttribArray );
+	stub_( glad_glDisableVertexAttribArray );
+
+	// Textures
+	stub_( glad_glActiveTexture );
+	stub_( glad_glBindTexture );
+	stub_( glad_glTexImage2D );
+	stub_( glad_glTexSubImage2D );
+	stub_( glad_glTexParameteri );
+	stub_( glad_glTexParameterf );
+	stub_( glad_glGenerateMipmap );
+	stub_( glad_glPixelStorei );
+
+	// Programs and shaders
+	stub_( glad_glShaderSource );
+	stub_( glad_glCompileShader );
+	stub_( glad_glGetShaderInfoLog );
+	stub_( glad_glAttachShader );
+	stub_( glad_glLinkProgram );
+	stub_( glad_glGetProgramInfoLog );
+	stub_( glad_glUseProgram );
+	stub_( glad_glGetUniformLocation );
+	stub_( glad_glGetUniformBlockIndex );
+	stub_( glad_glUniformBlockBinding );
+	stub_( glad_glGetProgramInterfaceiv );
+	stub_( glad_glGetProgramResourceiv );
+	stub_( glad_glGetProgramResourceName );
+
+	stub_( glad_glUniform1i );
+	stub_( glad_glUniform1ui );
+	stub_( glad_glUniform1f );
+	stub_( glad_glUniform2f );
+	stub_( glad_glUniform3f );
+	stub_( glad_glUniform4f );
+	stub_( glad_glUniform1fv );
+	stub_( glad_glUniform2fv );
+	stub_( glad_glUniform3fv );
+	stub_( glad_glUniform4fv );
+	stub_( glad_glUniformMatrix3fv );
+	stub_( glad_glUniformMatrix4fv );
+
+	// Fixed function state
+	stub_( glad_glEnable );
+	stub_( glad_glDisable );
+	stub_( glad_glBlendFunc );
+	stub_( glad_glDepthMask );
+	stub_( glad_glViewport );
+	stub_( glad_glClear );
+	stub_( glad_glClearColor );
+
+	// Drawing
+	stub_( glad_glDrawArrays );
+	stub_( glad_glDrawArraysInstanced );
+	stub_( glad_glDrawElements );
+	stub_( glad_glDrawElementsInstanced );
+	stub_( glad_glMultiDrawElementsIndirect );
+	stub_( glad_glDispatchCompute );
+	stub_( glad_glMemoryBarrier );
+
+	// Synchronization
+	stub_( glad_glFenceSync );
+	stub_( glad_glClientWaitSync );
+	stub_( glad_glDeleteSync );
+
+	// Misc
+	stub_( glad_glGetError );
+	stub_( glad_glGetString );
+	stub_( glad_glFlush );
+	stub_( glad_glFinish );
+}
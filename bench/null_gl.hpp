@@ -0,0 +1,16 @@
+#ifndef NULL_GL_HPP_B4617CF8_B66F_4BB8_9C37_EA042702F162
+#define NULL_GL_HPP_B4617CF8_B66F_4BB8_9C37_EA042702F162
+
+// Installs do-nothing implementations of the OpenGL entry points used by the
+// renderer into glad's function pointers. This lets the benchmarks construct
+// the real GPU-owning classes (ParticleSource, PITBFontManager, ...) without a
+// window or a GL context, so that only the CPU side of them is measured.
+//
+// Object names handed out by glGen*() and glCreate*() are unique and non-zero.
+// Status queries (link/compile status) report success. glGetError() always
+// returns GL_NO_ERROR.
+//
+// Safe to call more than once.
+void load_null_gl();
+
+#endif // NULL_GL_HPP_B4617CF8_B66F_4BB8_9C37_EA042702F162
@@ -0,0 +1,121 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+
+#include "../main/Particle.hpp"
+#include "../main/ParticleSystem.hpp"
+
+#include "null_gl.hpp"
+
+namespace
+{
+	constexpr float kFrameTime_ = 1.f / 60.f;
+
+	PSourceParams make_params_( int aMaxParticles, int aSpawnRate )
+	{
+		return PSourceParams{
+			.Colour = { 1.f, 1.f, 1.f, 1.f },
+			.Velocity = { 0.f, 0.f, 0.f },
+			.SourceOrigin = { -31.60f, -0.1f, 2.1f },
+			.spread = 0.1f,
+			.lifeTime = 0.5f,
+			.fade = 2.f,
+			.size = 0.2f,
+			.maxParticles = aMaxParticles,
+			.spawnRate = aSpawnRate
+		};
+	}
+}
+
+TEST_CASE( "ParticlePool", "[benchmark][particles]" )
+{
+	constexpr std::size_t kCount = 100000;
+
+	ParticlePool pool( kCount );
+	for( std::size_t i = 0; i < kCount; ++i )
+		pool.Spawn( { float(i), 0.f, 0.f }, { 1.f, 1.f, 1.f, 1.f }, 0.2f, 1e6f );
+
+	BENCHMARK( "Integrate (100000 alive, no deaths)" )
+	{
+		pool.Integrate( kFrameTime_, { 0.f, -1.f, 0.f }, 0.f );
+	};
+
+	// Every particle spawned and killed within the same call, which is the
+	// worst case for the free slot bookkeeping.
+	ParticlePool churn( kCount );
+
+	BENCHMARK( "Spawn + Integrate (100000, all die)" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			churn.Spawn( { 0.f, 0.f, 0.f }, { 1.f, 1.f, 1.f, 1.f }, 0.2f, 0.5f );
+		churn.Integrate( 1.f, { 0.f, -1.f, 0.f }, 0.f );
+		return churn.AliveCount();
+	};
+}
+
+TEST_CASE( "ParticleSource::UpdateParticles", "[benchmark][particles]" )
+{
+	load_null_gl();
+
+	// First entry matches the exhaust emitter in main.cpp. With a lifetime of
+	// 0.5s (30 frames), the last one keeps the pool full at 100k particles.
+	struct Config { int maxParticles; int spawnRate; };
+	for( auto const [maxParticles, spawnRate] : { Config{ 200, 2 }, Config{ 10000, 100 }, Config{ 100000, 4000 } } )
+	{
+		ParticleSource source( make_params_( maxParticles, spawnRate ), "assets/cw2/Particle.png" );
+		source.SetActive( true );
+
+		// Reach the steady state before measuring
+		for( int i = 0; i < 120; ++i )
+		{
+			source.SetPosition( source.GetPosition() + Vec3f{ 0.f, 0.01f, 0.f } );
+			source.UpdateParticles( kFrameTime_ );
+		}
+
+		auto const suffix = " (" + std::to_string( maxParticles ) + " max, " + std::to_string( spawnRate ) + " per frame)";
+
+		BENCHMARK( "UpdateParticles" + suffix )
+		{
+			source.UpdateParticles( kFrameTime_ );
+		};
+
+		// CPU side of a frame: the whole pool goes to the GPU in three
+		// copies and is drawn with a single instanced call.
+		BENCHMARK( "UpdateParticles + UploadInstanceData" + suffix )
+		{
+			source.UpdateParticles( kFrameTime_ );
+			source.UploadInstanceData();
+			return source.InstanceCount();
+		};
+	}
+}
+
+TEST_CASE( "ParticleSystem::Update", "[benchmark][particles]" )
+{
+	load_null_gl();
+
+	// 48 emitters at 100 per frame would keep 144k particles alive; the
+	// budget holds them to 50k
+	constexpr int kEmitters = 48;
+	Vec3f const viewer{ 0.f, 0.f, 0.f };
+
+	for( unsigned const workers : { 0u, 3u } )
+	{
+		ParticleSystem system( ParticleBudget{ .maxParticles = 50000, .fullRateDistance = 50.f, .cullDistance = 500.f }, workers );
+		for( int i = 0; i < kEmitters; ++i )
+		{
+			auto const id = system.AddEmitter( make_params_( 4000, 100 ), "assets/cw2/Particle.png" );
+			system.Emitter( id ).SetPosition( { float(i), 0.f, 0.f } );
+		}
+
+		system.SetActive( true );
+		for( int i = 0; i < 120; ++i )
+			system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+		BENCHMARK( "Update (" + std::to_string( kEmitters ) + " emitters, " + std::to_string( workers ) + " workers)" )
+		{
+			system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+			return system.AliveCount();
+		};
+	}
+}
@@ -0,0 +1,50 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../main/RenderQueue.hpp"
+
+// A frame's worth of draw keys, sorted by the queue's radix sort and by a
+// comparison sort. The radix sort wins from somewhere between 1024 and 2048
+// packets (RenderQueue::kRadixSortMinimum); below that, the queue uses the
+// comparison sort.
+TEST_CASE( "Render queue sort", "[benchmark][render]" )
+{
+	std::mt19937 random( 48 );
+	std::uniform_int_distribution<GLuint> name( 1, 40 );
+	std::uniform_real_distribution<float> depth( 0.f, 1.f );
+
+	for( std::size_t count : { 256, 4096 } )
+	{
+		std::vector<RenderQueue::SortItem> packets;
+		for( std::uint32_t i = 0; i < count; ++i )
+		{
+			RenderPacket const packet{
+				.pass = 0 == i % 8 ? RenderPass::Blended : RenderPass::Opaque,
+				.vertexArray = name( random ),
+				.texture = name( random )
+			};
+			packets.push_back( { RenderQueue::MakeKey( packet, depth( random ), i ), i } );
+		}
+
+		auto const suffix = " (" + std::to_string( count ) + " packets)";
+
+		std::vector<RenderQueue::SortItem> items, scratch;
+		BENCHMARK( "Radix sort" + suffix )
+		{
+			items = packets;
+			RenderQueue::RadixSort( items, scratch );
+			return items.front().key;
+		};
+
+		BENCHMARK( "std::stable_sort" + suffix )
+		{
+			items = packets;
+			std::ranges::stable_sort( items, {}, &RenderQueue::SortItem::key );
+			return items.front().key;
+		};
+	}
+}
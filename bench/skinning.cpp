@@ -0,0 +1,150 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../main/Skinning.hpp"
+
+#include "null_gl.hpp"
+
+namespace
+{
+	// A random tree, each joint hanging off an earlier one, in a random
+	// pose
+	Skeleton make_skeleton_( std::size_t aJoints, std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> offset( -1.f, 1.f );
+
+		Skeleton skeleton;
+		skeleton.AddJoint( Skeleton::kNoParent, Transform{} );
+		for( std::size_t i = 1; i < aJoints; ++i )
+		{
+			Skeleton::JointID const parent = std::uniform_int_distribution<std::size_t>( 0, i - 1 )( aRng );
+			skeleton.AddJoint( parent, Transform{ .mPosition{ offset( aRng ), offset( aRng ), offset( aRng ) } } );
+		}
+		return skeleton;
+	}
+
+	std::vector<Transform> make_pose_( Skeleton const& aSkeleton, std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> angle( -1.f, 1.f );
+
+		std::vector<Transform> pose( aSkeleton.BindPose().begin(), aSkeleton.BindPose().end() );
+		for( auto& joint : pose )
+			joint.mRotation = { angle( aRng ), angle( aRng ), angle( aRng ) };
+		return pose;
+	}
+
+	// Four random joints per vertex
+	std::vector<VertexSkin> make_skin_( std::size_t aVertices, std::size_t aJoints, std::mt19937& aRng )
+	{
+		std::uniform_int_distribution<int> joint( 0, int(aJoints) - 1 );
+
+		std::vector<VertexSkin> skin( aVertices );
+		for( auto& s : skin )
+		{
+			for( int k = 0; k < 4; ++k )
+				s.mJoints[k] = std::uint8_t(joint( aRng ));
+			s.mWeights = { 0.4f, 0.3f, 0.2f, 0.1f };
+		}
+		return skin;
+	}
+
+	ModelObject make_model_( std::size_t aVertices )
+	{
+		std::vector<Vec3f> positions( aVertices, Vec3f{ 1.f, 2.f, 3.f } );
+		std::vector<Vec3f> normals( aVertices, Vec3f{ 0.f, 1.f, 0.f } );
+		std::vector<Vec3f> colours( aVertices, Vec3f{ 1.f, 1.f, 1.f } );
+		std::vector<Vec3f> specular( aVertices, Vec3f{ 0.5f, 0.5f, 0.5f } );
+		std::vector<float> shininess( aVertices, 10.f );
+
+		return ModelObject( std::move(positions), std::move(normals), std::move(colours), std::move(specular), std::move(shininess) );
+	}
+}
+
+TEST_CASE( "Skeleton::EvaluatePose", "[benchmark][skinning]" )
+{
+	std::mt19937 rng( 1 );
+
+	for( std::size_t const joints : { 4u, 64u, 256u } )
+	{
+		Skeleton const skeleton = make_skeleton_( joints, rng );
+		std::vector<Transform> const pose = make_pose_( skeleton, rng );
+		std::vector<Mat44f> palette( joints );
+
+		BENCHMARK( "EvaluatePose (" + std::to_string( joints ) + " joints)" )
+		{
+			skeleton.EvaluatePose( pose, palette );
+			return palette.back().v[0];
+		};
+	}
+}
+
+TEST_CASE( "SkinVertices", "[benchmark][skinning]" )
+{
+	std::mt19937 rng( 2 );
+
+	for( std::size_t const joints : { 4u, 256u } )
+	{
+		Skeleton const skeleton = make_skeleton_( joints, rng );
+		std::vector<Mat44f> palette( joints );
+		skeleton.EvaluatePose( make_pose_( skeleton, rng ), palette );
+
+		for( std::size_t const vertices : { 1024u, 16384u, 131072u } )
+		{
+			std::vector<Vec3f> const positions( vertices, Vec3f{ 1.f, 2.f, 3.f } );
+			std::vector<Vec3f> const normals( vertices, Vec3f{ 0.f, 1.f, 0.f } );
+
+			std::vector<std::uint32_t> packed;
+			std::vector<Vec4f> weights;
+			for( auto const& s : make_skin_( vertices, joints, rng ) )
+			{
+				packed.push_back( PackJoints( s ) );
+				weights.push_back( s.mWeights );
+			}
+
+			std::vector<Vec3f> outPositions( vertices ), outNormals( vertices );
+
+			BENCHMARK( "SkinVertices (" + std::to_string( vertices ) + " vertices, " + std::to_string( joints ) + " joints)" )
+			{
+				SkinVertices( palette, positions, normals, packed, weights, outPositions, outNormals );
+				return outPositions.back().x;
+			};
+		}
+	}
+}
+
+// A frame's CPU cost with each backend: the pose, then either skinning and
+// streaming the vertices, or uploading the palette. (The GPU backend's
+// vertex shader work isn't measured; there is no GL here.)
+TEST_CASE( "SkinnedModel::Update", "[benchmark][skinning]" )
+{
+	load_null_gl();
+
+	std::mt19937 rng( 3 );
+
+	constexpr std::size_t kJoints = 64;
+	Skeleton const skeleton = make_skeleton_( kJoints, rng );
+	std::vector<Transform> const pose = make_pose_( skeleton, rng );
+	std::vector<Mat44f> palette( kJoints );
+
+	for( std::size_t const vertices : { 1024u, 131072u } )
+	{
+		ModelObject const model = make_model_( vertices );
+		std::vector<VertexSkin> const skin = make_skin_( vertices, kJoints, rng );
+
+		for( auto const backend : { SkinningBackend::Cpu, SkinningBackend::Gpu } )
+		{
+			SkinnedModel skinned( model, skin, kJoints, backend );
+
+			std::string const name = SkinningBackend::Cpu == backend ? "CPU" : "GPU";
+			BENCHMARK( "Pose + Update, " + name + " skinning (" + std::to_string( vertices ) + " vertices, 64 joints)" )
+			{
+				skeleton.EvaluatePose( pose, palette );
+				skinned.Update( palette );
+				return palette.front().v[0];
+			};
+		}
+	}
+}
@@ -0,0 +1,273 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <filesystem>
+#include <string>
+
+#include "../support/program.hpp"
+
+#include "../main/FontRegistry.hpp"
+#include "../main/PITBFont.hpp"
+#include "../main/SdfGlyphAtlas.hpp"
+
+#include "allocations.hpp"
+#include "null_gl.hpp"
+
+TEST_CASE( "PITB text layout", "[benchmark][text]" )
+{
+	load_null_gl();
+
+	// No sources: with the null GL this "links" an empty program, which is all
+	// that PITBFontManager needs.
+	ShaderProgram progFont;
+
+	PITBFontManager& fm = PITBFontManager::Get();
+	fm.SetShaderProgram( &progFont );
+
+	// Same set up as the HUD in main.cpp
+	PITBStyleID style = fm.MakeStyle( "./assets/cw2/DroidSansMonoDotted.ttf", 0.03f, FonsRGBA( 255, 0, 0, 255 ) );
+	PITBStyleID styleBtnText = fm.MakeStyleDerived( style, 0.03f, FonsRGBA( 0, 0, 0, 255 ), FONS_ALIGN_CENTER | FONS_ALIGN_TOP );
+
+	PITBText& heightText = fm.MakeText( style, { 0.f, 0.f }, "Space ship height:" );
+	fm.MakeText( styleBtnText, { 0.4f, 0.9f }, "Play/Pause" );
+	fm.MakeText( styleBtnText, { 0.6f, 0.9f }, "Reset" );
+
+	// Rasterize the glyphs once, so that we measure the steady state
+	heightText.SetString( "Spaceship height: {0:.2f} meters", 1234.5678f );
+	fm.Update( 1280.f, 720.f );
+
+	BENCHMARK( "Update (HUD, 3 texts)" )
+	{
+		heightText.SetString( "Spaceship height: {0:.2f} meters", 3.14f );
+		fm.Update( 1280.f, 720.f );
+	};
+
+	for( int i = 0; i < 97; ++i )
+		fm.MakeText( style, { 0.01f * float(i % 10), 0.1f * float(i / 10) }, "Static label {}", i );
+
+	fm.Update( 1280.f, 720.f );
+
+	BENCHMARK( "Update (100 texts)" )
+	{
+		heightText.SetString( "Spaceship height: {0:.2f} meters", 3.14f );
+		fm.Update( 1280.f, 720.f );
+	};
+
+	// Retained: nothing changed, so nothing is laid out or uploaded, and
+	// all of it is one draw
+	fm.Update( 1280.f, 720.f );
+	REQUIRE( 0 == fm.GetStats().mTextsLaidOut );
+	REQUIRE( 0 == fm.GetStats().mVerticesUploaded );
+	REQUIRE( 1 == fm.GetStats().mDrawCalls );
+
+	BENCHMARK( "Update (100 static texts)" )
+	{
+		fm.Update( 1280.f, 720.f );
+	};
+
+	// A resize lays out everything again (at least these 100: the manager
+	// is a singleton, and other test cases may have run first)
+	bool wide = false;
+	BENCHMARK( "Update (100 texts, resized every frame)" )
+	{
+		wide = !wide;
+		fm.Update( wide ? 1920.f : 1280.f, 720.f );
+	};
+	REQUIRE( fm.GetStats().mTextsLaidOut >= 100 );
+}
+
+// Overlay text that changes every frame, through the streaming path. Each
+// string used to be its own fontstash flush: three glBufferData() and a draw.
+TEST_CASE( "PITB immediate text", "[benchmark][text]" )
+{
+	load_null_gl();
+
+	ShaderProgram progFont;
+
+	PITBFontManager& fm = PITBFontManager::Get();
+	fm.SetShaderProgram( &progFont );
+
+	PITBStyleID style = fm.MakeStyle( "./assets/cw2/DroidSansMonoDotted.ttf", 0.02f, FonsRGBA( 255, 255, 255, 255 ) );
+
+	auto const overlay = [&] ( float aValue ) {
+		for( int i = 0; i < 100; ++i )
+			fm.DrawImmediate( style, { 0.5f + 0.05f * float(i % 10), 0.1f * float(i / 10) }, "{}: {:.3f}", i, aValue );
+		fm.Update( 1280.f, 720.f );
+	};
+
+	// Rasterize the glyphs once
+	overlay( 0.f );
+
+	PITBFonsStats const before = fm.GetStreamingStats();
+	overlay( 1.f );
+	PITBFonsStats const after = fm.GetStreamingStats();
+
+	// One draw and (without persistent mapping, as here) one upload for all
+	// of it, and nothing allocated
+	REQUIRE( 1 == after.draws - before.draws );
+	REQUIRE( 1 == after.uploads - before.uploads );
+	REQUIRE( 0 == after.bufferAllocations - before.bufferAllocations );
+
+	float value = 0.f;
+	BENCHMARK( "Update (100 immediate texts)" )
+	{
+		value += 0.125f;
+		overlay( value );
+	};
+}
+
+// Dragging the window edge: every frame is a new size. The same strings as
+// retained text (distance fields) and as immediate text (fontstash, which
+// rasterizes glyphs per pixel size).
+TEST_CASE( "PITB text resize", "[benchmark][text]" )
+{
+	load_null_gl();
+
+	ShaderProgram progFont;
+
+	PITBFontManager& fm = PITBFontManager::Get();
+	fm.SetShaderProgram( &progFont );
+
+	PITBStyleID style = fm.MakeStyle( "./assets/cw2/DroidSansMonoDotted.ttf", 0.03f, FonsRGBA( 255, 0, 0, 255 ) );
+	for( int i = 0; i < 20; ++i )
+		fm.MakeText( style, { 0.f, 0.05f * float(i) }, "Spaceship height: {0:.2f} meters", 1000.f + float(i) );
+
+	auto const frame = [&] ( float aHeight ) {
+		for( int i = 0; i < 20; ++i )
+			fm.DrawImmediate( style, { 0.5f, 0.05f * float(i) }, "Spaceship height: {0:.2f} meters", 1000.f + float(i) );
+		fm.Update( 1280.f, aHeight );
+	};
+
+	frame( 720.f );
+
+	SdfAtlasStats const sdfBefore = fm.GetAtlasStats();
+	PITBFonsStats const fonsBefore = fm.GetStreamingStats();
+
+	constexpr int kSizes = 50;
+	for( int i = 1; i <= kSizes; ++i )
+		frame( 720.f + 10.f * float(i) );
+
+	// Retained text rasterized and uploaded nothing; fontstash uploaded
+	// glyphs at every new size
+	REQUIRE( sdfBefore.glyphsRasterized == fm.GetAtlasStats().glyphsRasterized );
+	REQUIRE( sdfBefore.uploads == fm.GetAtlasStats().uploads );
+	REQUIRE( fm.GetStreamingStats().atlasUploads - fonsBefore.atlasUploads >= kSizes );
+
+	// Every test case here made a style from the same file: it is mapped
+	// once. fontstash's atlas grew for all those sizes, but only so far.
+	PITBFontMemory const memory = fm.GetMemoryUsage();
+	REQUIRE( 1 == memory.mFontCount );
+	REQUIRE( fm.GetStreamingStats().atlasGrowths > 0 );
+	REQUIRE( memory.mStreamingAtlas <= 2 * 2048 * 2048 );
+
+	float height = 720.f;
+	BENCHMARK( "Update (20 retained + 20 immediate texts, new size every frame)" )
+	{
+		height += 1.f;
+		frame( height );
+	};
+}
+
+// Startup: the HUD's first frame, from an empty atlas (every glyph
+// rasterized as it is first laid out) and from one baked by font-baker
+TEST_CASE( "PITB glyph atlas startup", "[benchmark][text]" )
+{
+	FontRegistry fonts;
+	auto const data = fonts.Data( fonts.Load( "./assets/cw2/DroidSansMonoDotted.ttf" ) );
+	std::string const path = (std::filesystem::temp_directory_path() / "bench-text.sdfatlas").string();
+
+	{
+		SdfGlyphAtlas baker;
+		auto const font = baker.AddFont( data );
+		baker.Prepare( font, 0x20, 0x7e );
+		baker.SaveBaked( font, path.c_str() );
+	}
+
+	auto const firstFrame = [&] ( bool aBaked ) {
+		SdfGlyphAtlas atlas;
+		auto const font = atlas.AddFont( data );
+		if( aBaked )
+			atlas.LoadBaked( font, path.c_str() );
+
+		std::vector<PITBFonsVertex> quads;
+		atlas.LayOut( font, "Spaceship height: 1234.57 meters", 0.f, 0.f, 21.6f, FONS_ALIGN_LEFT, 0xffffffff, quads );
+		atlas.LayOut( font, "Play/Pause", 512.f, 648.f, 21.6f, FONS_ALIGN_CENTER | FONS_ALIGN_TOP, 0xffffffff, quads );
+		atlas.LayOut( font, "Reset", 768.f, 648.f, 21.6f, FONS_ALIGN_CENTER | FONS_ALIGN_TOP, 0xffffffff, quads );
+		return atlas.Stats().glyphsRasterized;
+	};
+
+	REQUIRE( firstFrame( false ) > 20 );
+	REQUIRE( 0 == firstFrame( true ) );
+
+	BENCHMARK( "First HUD frame, glyphs rasterized as used" )
+	{
+		return firstFrame( false );
+	};
+
+	BENCHMARK( "First HUD frame, glyphs baked" )
+	{
+		return firstFrame( true );
+	};
+
+	std::filesystem::remove( path );
+}
+
+// A HUD of live numeric fields, SetString() every frame. Values that didn't
+// change (at the precision shown) are not laid out again, and steady state
+// frames don't touch the heap either way.
+TEST_CASE( "PITB live text fields", "[benchmark][text]" )
+{
+	load_null_gl();
+
+	ShaderProgram progFont;
+
+	PITBFontManager& fm = PITBFontManager::Get();
+	fm.SetShaderProgram( &progFont );
+
+	PITBStyleID style = fm.MakeStyle( "./assets/cw2/DroidSansMonoDotted.ttf", 0.02f, FonsRGBA( 255, 255, 255, 255 ) );
+
+	constexpr int kFields = 32;
+	std::vector<PITBText*> fields;
+	for( int i = 0; i < kFields; ++i )
+		fields.push_back( &fm.MakeText( style, { 0.f, 0.03f * float(i) }, "" ) );
+
+	auto const frame = [&] ( float aValue ) {
+		for( int i = 0; i < kFields; ++i )
+			fields[i]->SetString( "Field {}: {:.2f} m/s", i, aValue + float(i) );
+		fm.Update( 1280.f, 720.f );
+	};
+
+	// Every string at its longest, and the glyphs of all digits, rasterized
+	frame( 1000.123f );
+	frame( 9876.543f );
+
+	std::size_t const before = heap_allocations();
+	frame( 9876.543f );
+	REQUIRE( 0 == fm.GetStats().mTextsLaidOut );
+	frame( 9876.544f );
+	REQUIRE( 0 == fm.GetStats().mTextsLaidOut );
+	frame( 1234.567f );
+	REQUIRE( kFields == fm.GetStats().mTextsLaidOut );
+	REQUIRE( before == heap_allocations() );
+
+	// Longer than SetString() formats on the stack: still only laid out
+	// when it changes
+	std::string const longer( PITBText::kFormatCapacity + 10, 'x' );
+	fields[0]->SetString( "{}", longer );
+	fm.Update( 1280.f, 720.f );
+	REQUIRE( 1 == fm.GetStats().mTextsLaidOut );
+	fields[0]->SetString( "{}", longer );
+	fm.Update( 1280.f, 720.f );
+	REQUIRE( 0 == fm.GetStats().mTextsLaidOut );
+
+	BENCHMARK( "Update (32 live fields, unchanged)" )
+	{
+		frame( 1234.567f );
+	};
+
+	float value = 1000.f;
+	BENCHMARK( "Update (32 live fields, all changing)" )
+	{
+		value += 0.01f;
+		frame( value );
+	};
+}
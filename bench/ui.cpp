@@ -0,0 +1,134 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include "../main/UIGroup.hpp"
+
+#include "null_gl.hpp"
+
+namespace
+{
+	// A kSide x kSide panel of buttons over the whole screen
+	template< int kSide >
+	struct Panel_
+	{
+		static constexpr int kColumns = kSide;
+		static constexpr int kRows = kSide;
+		static constexpr float kStep = 2.f / kColumns;
+
+		static std::vector<UIElement> Elements()
+		{
+			std::vector<UIElement> elements;
+			for( int i = 0; i < kColumns * kRows; ++i )
+			{
+				UIElementProperties const properties{
+					.uiColour = { 0.1f, 0.9f, 0.1f, 0.5f },
+					.uiPosition = { -1.f + kStep * float(i % kColumns), -1.f + kStep * float(i / kColumns) },
+					.uiWidth = 0.8f * kStep,
+					.uiHeight = 0.8f * kStep,
+					.uiBorderWidth = 0.1f * kStep,
+				};
+				elements.emplace_back( properties );
+			}
+			return elements;
+		}
+
+		// The centre of button aIndex
+		static Vec2f Over( int aIndex )
+		{
+			return { -1.f + kStep * (float(aIndex % kColumns) + 0.4f), -1.f + kStep * (float(aIndex / kColumns) + 0.4f) };
+		}
+	};
+}
+
+// A panel of 400 buttons, with the mouse moving over it. All of them are one
+// draw call; each frame only the buttons whose hover state changed are
+// written again (used to be a VAO bind, a uniform and a draw per button).
+TEST_CASE( "UI batch", "[benchmark][ui]" )
+{
+	load_null_gl();
+
+	using Panel = Panel_<20>;
+	constexpr int kColumns = Panel::kColumns;
+	constexpr int kRows = Panel::kRows;
+	constexpr float kStep = Panel::kStep;
+
+	(void)kStep;
+
+	UIGroup ui( Panel::Elements() );
+	auto const over = &Panel::Over;
+
+	ui.OnCursorMoved( over( 0 ) );
+	ui.Draw();
+
+	// Still over the same button: nothing to write
+	ui.OnCursorMoved( over( 0 ) );
+	ui.Draw();
+	REQUIRE( 1 == ui.GetStats().drawCalls );
+	REQUIRE( 0 == ui.GetStats().elementsRebuilt );
+
+	// Onto the next one: the old one and the new one
+	ui.OnCursorMoved( over( 1 ) );
+	ui.Draw();
+	REQUIRE( 1 == ui.GetStats().drawCalls );
+	REQUIRE( 2 == ui.GetStats().elementsRebuilt );
+
+	BENCHMARK( "Draw (400 buttons, no input)" )
+	{
+		ui.Draw();
+	};
+
+	int hovered = 0;
+	BENCHMARK( "Draw (400 buttons, hover moving)" )
+	{
+		hovered = (hovered + 1) % (kColumns * kRows);
+		ui.OnCursorMoved( over( hovered ) );
+		ui.Draw();
+	};
+}
+
+// Input is event driven, and hit tests through a grid: a frame without input
+// costs the same for 100 or 10000 buttons, and a mouse move only tests the
+// buttons in one cell of the grid.
+TEST_CASE( "UI input", "[benchmark][ui]" )
+{
+	load_null_gl();
+
+	UIGroup small( Panel_<10>::Elements() );
+	UIGroup large( Panel_<100>::Elements() );
+
+	large.OnCursorMoved( Panel_<100>::Over( 5050 ) );
+	REQUIRE( 5050 == large.getHoveredElement() );
+	large.Draw();
+	REQUIRE( 1 == large.GetStats().elementsRebuilt );
+
+	large.Draw();
+	REQUIRE( 0 == large.GetStats().elementsRebuilt );
+
+	// Between buttons
+	large.OnCursorMoved( Panel_<100>::Over( 5050 ) + Vec2f{ 0.45f * Panel_<100>::kStep, 0.f } );
+	REQUIRE( -1 == large.getHoveredElement() );
+
+	BENCHMARK( "Idle frame (100 buttons)" )
+	{
+		small.Draw();
+	};
+	BENCHMARK( "Idle frame (10000 buttons)" )
+	{
+		large.Draw();
+	};
+
+	int hovered = 0;
+	BENCHMARK( "Mouse move and draw (100 buttons)" )
+	{
+		hovered = (hovered + 7) % 100;
+		small.OnCursorMoved( Panel_<10>::Over( hovered ) );
+		small.Draw();
+		return small.getHoveredElement();
+	};
+	BENCHMARK( "Mouse move and draw (10000 buttons)" )
+	{
+		hovered = (hovered + 7) % 10000;
+		large.OnCursorMoved( Panel_<100>::Over( hovered ) );
+		large.Draw();
+		return large.getHoveredElement();
+	};
+}
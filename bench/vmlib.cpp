@@ -0,0 +1,64 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <numbers>
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/mat33.hpp"
+
+#include "../main/ModelObject.hpp"
+
+TEST_CASE( "4x4 matrix operations", "[benchmark][mat44]" )
+{
+	Mat44f const a = make_rotation_x( 0.3f ) * make_translation( { 1.f, 2.f, 3.f } );
+	Mat44f const b = make_rotation_y( 1.1f ) * make_scaling( 2.f, 3.f, 4.f );
+	Vec4f const v{ 1.f, 2.f, 3.f, 1.f };
+
+	BENCHMARK( "multiply" )
+	{
+		return a * b;
+	};
+
+	BENCHMARK( "multiply vector" )
+	{
+		return a * v;
+	};
+
+	BENCHMARK( "invert" )
+	{
+		return invert( a );
+	};
+
+	BENCHMARK( "transpose" )
+	{
+		return transpose( a );
+	};
+
+	BENCHMARK( "make rotation xyz" )
+	{
+		return make_rotation_z( 0.7f ) * make_rotation_y( 0.5f ) * make_rotation_x( 0.3f );
+	};
+
+	BENCHMARK( "make perspective projection" )
+	{
+		return make_perspective_projection( std::numbers::pi_v<float> / 3.f, 1280.f / 720.f, 0.1f, 200.f );
+	};
+}
+
+TEST_CASE( "Transform matrices", "[benchmark][transform]" )
+{
+	Transform const transform{
+		.mPosition{ -32.5f, 0.3f, 2.f },
+		.mRotation{ 0.1f, 1.7f, 0.2f },
+		.mScale{ 1.f, 2.f, 1.f }
+	};
+
+	BENCHMARK( "Transform::Matrix" )
+	{
+		return transform.Matrix();
+	};
+
+	BENCHMARK( "Transform::NormalUpdateMatrix" )
+	{
+		return transform.NormalUpdateMatrix();
+	};
+}
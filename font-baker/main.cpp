@@ -0,0 +1,92 @@
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "../support/error.hpp"
+
+#include "../main/FontRegistry.hpp"
+#include "../main/SdfGlyphAtlas.hpp"
+
+// Bakes the distance field glyphs of a font ahead of time, so that
+// PITBFontManager loads them with one texture upload instead of rasterizing
+// each glyph the first time it is drawn. Distance fields are drawn at any
+// size, so there are no sizes to choose; only which codepoints.
+//
+// Usage: font-baker <font.ttf> <out.sdfatlas> [first-last ...]
+//
+// Ranges are inclusive, in decimal or 0x hexadecimal. The default is
+// printable ASCII (0x20-0x7e).
+
+namespace
+{
+	struct Range_
+	{
+		std::uint32_t first;
+		std::uint32_t last;
+	};
+
+	Range_ parse_range_( std::string const& aArg )
+	{
+		auto const dash = aArg.find( '-', 1 );
+		try
+		{
+			auto const first = std::stoul( aArg.substr( 0, dash ), nullptr, 0 );
+			auto const last = std::string::npos == dash ? first : std::stoul( aArg.substr( dash + 1 ), nullptr, 0 );
+
+			if( last < first || last > 0x10ffff )
+				throw Error( "'{}' is not a range of codepoints", aArg );
+
+			return { std::uint32_t(first), std::uint32_t(last) };
+		}
+		catch( std::logic_error const& )
+		{
+			throw Error( "'{}' is not a range of codepoints", aArg );
+		}
+	}
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	if( aArgc < 3 )
+	{
+		std::print( stderr, "Usage: {} <font.ttf> <out.sdfatlas> [first-last ...]\n", aArgc > 0 ? aArgv[0] : "font-baker" );
+		return 2;
+	}
+
+	std::vector<Range_> ranges;
+	for( int i = 3; i < aArgc; ++i )
+		ranges.push_back( parse_range_( aArgv[i] ) );
+
+	if( ranges.empty() )
+		ranges.push_back( { 0x20, 0x7e } );
+
+	FontRegistry fonts;
+	SdfGlyphAtlas atlas;
+
+	auto const font = atlas.AddFont( fonts.Data( fonts.Load( aArgv[1] ) ) );
+	if( SdfGlyphAtlas::kInvalidFont == font )
+		throw Error( "'{}' is not a TrueType font", aArgv[1] );
+
+	for( auto const& range : ranges )
+		atlas.Prepare( font, range.first, range.last );
+
+	if( auto const dropped = atlas.Stats().dropped )
+		throw Error( "{} glyphs don't fit the atlas; bake fewer", dropped );
+
+	atlas.SaveBaked( font, aArgv[2] );
+
+	std::print( "{}: {} glyphs in {}x{}\n", aArgv[2], atlas.GlyphCount(), atlas.Width(), atlas.Height() );
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::print( stderr, "Top-level Exception ({}):\n", typeid(eErr).name() );
+	std::print( stderr, "{}\n", eErr.what() );
+	std::print( stderr, "Bye.\n" );
+	return 1;
+}
@@ -0,0 +1,387 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../main/AnimationSystem.hpp"
+#include "../main/GpuAnimation.hpp"
+
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	// 0 -> 10 in 1s, hold for 0.5s, -> 20 in 1s
+	constexpr TrackKeyFrame kKeys_[] = {
+		{ 0.f, 0.f, Shapes::None },
+		{ 10.f, 1.f, Shapes::Linear },
+		{ 10.f, 0.5f, Shapes::None },
+		{ 20.f, 1.f, Shapes::Smoothstep }
+	};
+}
+
+TEST_CASE( "Shapes match the shaping functions", "[animation]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	for( int i = 0; i <= 64; ++i )
+	{
+		float const t = float(i) / 64.f;
+		INFO( "t = " << t );
+
+		REQUIRE( 0.f == EvaluateShape( Shapes::None, t ) );
+		REQUIRE( 1.f == EvaluateShape( Shapes::Instant, t ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::Linear, t ), WithinAbs( ShapingFunctions::Linear( t ), 1e-6 ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::Smoothstep, t ), WithinAbs( ShapingFunctions::Smoothstep( t ), 1e-6 ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::Polynomial<3>, t ), WithinAbs( ShapingFunctions::Polynomial<3>( t ), 1e-6 ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::Polynomial<6>, t ), WithinAbs( ShapingFunctions::Polynomial<6>( t ), 1e-6 ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::PolynomialEaseOut<4>, t ), WithinAbs( ShapingFunctions::PolynomialEaseOut<4>( t ), 1e-6 ) );
+		REQUIRE_THAT( EvaluateShape( Shapes::PolynomialEaseOut<8>, t ), WithinAbs( ShapingFunctions::PolynomialEaseOut<8>( t ), 1e-6 ) );
+	}
+}
+
+TEST_CASE( "Animation clip controls", "[animation]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	AnimationSystem animations;
+	auto const clip = animations.AddClip();
+	auto const track = animations.AddTrack( clip, kKeys_ );
+
+	int finished = 0;
+	animations.InsertOnFinishCallback( clip, [&] { ++finished; } );
+
+	// Not playing yet
+	REQUIRE( 0.f == animations.Value( track ) );
+	animations.Update( 0.25f );
+	REQUIRE( 0.f == animations.Value( track ) );
+
+	animations.Play( clip );
+	animations.Update( 0.25f );
+	REQUIRE_THAT( animations.Value( track ), WithinAbs( 2.5, 1e-5 ) );
+
+	SECTION( "Pause and toggle" )
+	{
+		animations.Pause( clip );
+		animations.Update( 0.25f );
+		REQUIRE_THAT( animations.Value( track ), WithinAbs( 2.5, 1e-5 ) );
+
+		animations.Toggle( clip );
+		REQUIRE( animations.IsPlaying( clip ) );
+		animations.Update( 0.25f );
+		REQUIRE_THAT( animations.Value( track ), WithinAbs( 5.0, 1e-5 ) );
+	}
+
+	SECTION( "Finish and stop" )
+	{
+		// Several keyframes in one update
+		animations.Update( 1.5f );
+		REQUIRE_THAT( animations.Value( track ), WithinAbs( 10.0 + 10.0 * ShapingFunctions::Smoothstep( 0.25f ), 1e-4 ) );
+		REQUIRE( 0 == finished );
+
+		animations.Update( 1.f );
+		REQUIRE( 20.f == animations.Value( track ) );
+		REQUIRE( 1 == finished );
+		REQUIRE( animations.IsFinished( clip ) );
+		REQUIRE( !animations.IsPlaying( clip ) );
+
+		// Finished clips stay put, and only call back once
+		animations.Toggle( clip );
+		animations.Update( 1.f );
+		REQUIRE( 20.f == animations.Value( track ) );
+		REQUIRE( 1 == finished );
+
+		animations.Stop( clip );
+		animations.Update( 1.f );
+		REQUIRE( 0.f == animations.Value( track ) );
+		REQUIRE( !animations.IsFinished( clip ) );
+
+		// and it plays again from the start
+		animations.Play( clip );
+		animations.Update( 0.5f );
+		REQUIRE_THAT( animations.Value( track ), WithinAbs( 5.0, 1e-5 ) );
+		animations.Update( 5.f );
+		REQUIRE( 2 == finished );
+	}
+}
+
+TEST_CASE( "Animation clips are independent", "[animation]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	AnimationSystem animations;
+
+	constexpr int kClips = 100;
+	for( int i = 0; i < kClips; ++i )
+	{
+		auto const clip = animations.AddClip();
+		animations.AddTrack( clip, kKeys_ );
+
+		Vec3TrackKeyFrame const keys[] = {
+			{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+			{ { float(i), -float(i), 1.f }, 2.f, Shapes::Linear }
+		};
+		animations.AddVec3Track( clip, keys );
+	}
+
+	// Start the clips one frame apart
+	for( int frame = 0; frame < kClips; ++frame )
+	{
+		animations.Play( frame );
+		animations.Update( 0.01f );
+	}
+
+	REQUIRE( 4 * kClips == animations.TrackCount() );
+	for( int i = 0; i < kClips; ++i )
+	{
+		// Clip i played for kClips - i frames
+		float const time = 0.01f * float(kClips - i);
+		INFO( "clip " << i );
+
+		REQUIRE_THAT( animations.Value( 4 * i ), WithinAbs( 10.f * time, 1e-4 ) );
+
+		Vec3f const v = animations.Vec3Value( 4 * i + 1 );
+		REQUIRE_THAT( v.x, WithinAbs( float(i) * time / 2.f, 1e-4 ) );
+		REQUIRE_THAT( v.y, WithinAbs( -float(i) * time / 2.f, 1e-4 ) );
+		REQUIRE_THAT( v.z, WithinAbs( time / 2.f, 1e-4 ) );
+	}
+}
+
+TEST_CASE( "Animation clips seek", "[animation]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	// A long track: 1000 keys, alternating between 0 and i, with varying
+	// durations and shapes
+	std::vector<TrackKeyFrame> keys;
+	keys.push_back( { 0.f, 0.f, Shapes::None } );
+	for( int i = 1; i < 1000; ++i )
+	{
+		float const duration = 0.01f * float(1 + i % 7);
+		Shape const shape = 0 == i % 3 ? Shapes::Smoothstep : 1 == i % 3 ? Shapes::Linear : Shapes::PolynomialEaseOut<2>;
+		keys.push_back( { 0 == i % 2 ? 0.f : float(i), duration, shape } );
+	}
+
+	// The reference: walk the keys from the start
+	auto const reference = [&] ( float aTime ) {
+		float start = 0.f;
+		for( std::size_t i = 1; i < keys.size(); ++i )
+		{
+			float const end = start + keys[i].mDuration;
+			if( aTime < end || i + 1 == keys.size() )
+			{
+				float const t = std::clamp( (aTime - start) / keys[i].mDuration, 0.f, 1.f );
+				return Lerp( keys[i-1].mValue, keys[i].mValue, EvaluateShape( keys[i].mShape, t ) );
+			}
+			start = end;
+		}
+		return keys.front().mValue;
+	};
+
+	// The keys are up to 1000 apart over 0.01s, so a float's worth of error
+	// in the time (~4e-6 at 30s) is worth ~0.4 in the value
+	constexpr double kTolerance = 0.5;
+
+	AnimationSystem animations;
+	auto const clip = animations.AddClip();
+	auto const track = animations.AddTrack( clip, keys );
+
+	float const duration = animations.Duration( clip );
+	REQUIRE( duration > 30.f );
+
+	SECTION( "Anywhere" )
+	{
+		// Back and forth over the whole clip
+		for( int i = 0; i < 500; ++i )
+		{
+			float const time = duration * float((i * 7919) % 500) / 500.f;
+			INFO( "time " << time );
+
+			animations.Seek( clip, time );
+			animations.Update( 0.f );
+
+			REQUIRE( time == animations.Time( clip ) );
+			REQUIRE_THAT( animations.Value( track ), WithinAbs( reference( time ), kTolerance ) );
+		}
+	}
+
+	SECTION( "Large steps" )
+	{
+		// A stall: one update covers hundreds of keys
+		animations.Play( clip );
+		animations.Update( 0.5f );
+		animations.Update( duration / 2.f );
+
+		float const time = animations.Time( clip );
+		REQUIRE_THAT( animations.Value( track ), WithinAbs( reference( time ), kTolerance ) );
+	}
+
+	SECTION( "Same as playing" )
+	{
+		// Seeking to a time gives what playing up to it gives
+		AnimationSystem played;
+		auto const playedClip = played.AddClip();
+		auto const playedTrack = played.AddTrack( playedClip, keys );
+
+		played.Play( playedClip );
+		for( int i = 0; i < 300; ++i )
+			played.Update( 1.f / 60.f );
+
+		animations.Seek( clip, played.Time( playedClip ) );
+		animations.Update( 0.f );
+
+		REQUIRE( animations.Value( track ) == played.Value( playedTrack ) );
+	}
+
+	SECTION( "Past the end" )
+	{
+		int finished = 0;
+		animations.InsertOnFinishCallback( clip, [&] { ++finished; } );
+
+		// Paused: shows the end, but doesn't finish
+		animations.Seek( clip, duration + 1.f );
+		animations.Update( 0.f );
+		REQUIRE( animations.Value( track ) == keys.back().mValue );
+		REQUIRE( 0 == finished );
+
+		animations.Play( clip );
+		animations.Update( 0.f );
+		REQUIRE( 1 == finished );
+
+		// and back from the end
+		animations.Seek( clip, 0.f );
+		REQUIRE( !animations.IsFinished( clip ) );
+		animations.Play( clip );
+		animations.Update( 0.f );
+		REQUIRE( 0.f == animations.Value( track ) );
+	}
+}
+
+TEST_CASE( "GPU animation clips match AnimationSystem", "[animation][gpu]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	// Every shape, a wait, and a rotation track shorter than the position
+	const Vec3TrackKeyFrame positionKeys[] = {
+		{ { 1.f, 2.f, 3.f }, 0.f, Shapes::None },
+		{ { 1.f, 12.f, 3.f }, 2.f, Shapes::Smoothstep },
+		{ { 1.f, 12.f, 3.f }, 0.5f, Shapes::None },
+		{ { -5.f, 12.f, 8.f }, 1.f, Shapes::Polynomial<6> },
+		{ { -9.f, 0.f, 8.f }, 1.5f, Shapes::PolynomialEaseOut<3> },
+		{ { 0.f, 0.f, 0.f }, 0.25f, Shapes::Instant }
+	};
+	const Vec3TrackKeyFrame rotationKeys[] = {
+		{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+		{ { 0.5f, 1.f, -1.f }, 3.f, Shapes::Linear }
+	};
+	const Vec3TrackKeyFrame stillKeys[] = {
+		{ { 4.f, 5.f, 6.f }, 0.f, Shapes::None }
+	};
+
+	struct ClipSetup_
+	{
+		std::span<const Vec3TrackKeyFrame> position;
+		std::span<const Vec3TrackKeyFrame> rotation;
+		bool loop;
+	};
+	const ClipSetup_ setups[] = {
+		{ positionKeys, rotationKeys, false },
+		{ positionKeys, rotationKeys, true },
+		{ rotationKeys, positionKeys, true },
+		{ stillKeys, stillKeys, true }
+	};
+
+	// The same clips on the CPU, which the GPU values are checked against
+	GpuAnimationClips clips;
+	AnimationSystem reference;
+	std::vector<AnimationSystem::TrackID> referenceTracks;
+	for( auto const& setup : setups )
+	{
+		clips.AddClip( setup.position, setup.rotation, setup.loop );
+
+		auto const clip = reference.AddClip();
+		referenceTracks.push_back( reference.AddVec3Track( clip, setup.position ) );
+		reference.AddVec3Track( clip, setup.rotation );
+
+		REQUIRE( clips.Duration( clip ) == reference.Duration( clip ) );
+	}
+	clips.Upload();
+
+	constexpr std::uint32_t kInstances = 200;
+	std::vector<AnimatedInstance> instances;
+	for( std::uint32_t i = 0; i < kInstances; ++i )
+	{
+		instances.push_back( {
+			.origin = { float(i), 0.f, -float(i) },
+			.clip = i % std::uint32_t(std::size(setups)),
+			.startTime = 0.1f * float(i % 23),
+			.speed = 0.5f + 0.1f * float(i % 13),
+			.pad = { 0.f, 0.f }
+		} );
+	}
+	clips.SetInstances( instances );
+	REQUIRE( kInstances == clips.InstanceCount() );
+
+	ShaderProgram probe( {
+		{ GL_COMPUTE_SHADER, "main-test/animationClipsProbe.comp" },
+		{ GL_COMPUTE_SHADER, "assets/cw2/animationClips.glsl" }
+	} );
+
+	GLuint results = 0;
+	glGenBuffers( 1, &results );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, results );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, 2 * kInstances * sizeof(Vec4f), nullptr, GL_DYNAMIC_READ );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	for( float const time : { 0.f, 0.7f, 2.3f, 4.1f, 6.6f, 13.9f, 40.2f } )
+	{
+		glUseProgram( probe.programId() );
+		glUniform1f( 0, time );
+		glUniform1ui( 1, kInstances );
+		clips.Bind();
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, results );
+		glDispatchCompute( (kInstances + 63) / 64, 1, 1 );
+		glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+		std::vector<Vec4f> gpu( 2 * kInstances );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, results );
+		glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, gpu.size() * sizeof(Vec4f), gpu.data() );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+		for( std::uint32_t i = 0; i < kInstances; ++i )
+		{
+			AnimatedInstance const& instance = instances[i];
+			bool const loop = setups[instance.clip].loop;
+
+			// The instance's clip time, as the shader works it out
+			float clipTime = std::max( (time - instance.startTime) * instance.speed, 0.f );
+			float const duration = reference.Duration( instance.clip );
+			if( loop && duration > 0.f )
+				clipTime -= duration * std::floor( clipTime / duration );
+
+			reference.Seek( instance.clip, clipTime );
+			reference.Update( 0.f );
+
+			Vec3f const position = reference.Vec3Value( referenceTracks[instance.clip] ) + instance.origin;
+			Vec3f const rotation = reference.Vec3Value( referenceTracks[instance.clip] + 3 );
+
+			INFO( "time " << time << ", instance " << i << ", clip time " << clipTime );
+			for( int axis = 0; axis < 3; ++axis )
+			{
+				REQUIRE_THAT( gpu[2 * i][axis], WithinAbs( position[axis], 1e-3 ) );
+				REQUIRE_THAT( gpu[2 * i + 1][axis], WithinAbs( rotation[axis], 1e-3 ) );
+			}
+		}
+	}
+
+	glDeleteBuffers( 1, &results );
+	glUseProgram( 0 );
+}
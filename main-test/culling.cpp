@@ -0,0 +1,135 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../main/Frustum.hpp"
+#include "../main/GeometryBuffer.hpp"
+#include "../main/ModelObject.hpp"
+#include "../main/ShapeObject.hpp"
+#include "../main/StaticDrawBatch.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr float kPi_ = 3.1415926f;
+
+	// Looking down -z from the origin, 90 degrees across
+	Frustum Frustum_()
+	{
+		return MakeFrustum( make_perspective_projection( kPi_ / 2.f, 1.f, 0.1f, 100.f ) );
+	}
+
+	// The visible instances of each command, in order
+	std::vector<std::vector<GLuint>> Visible_( const std::vector<DrawElementsIndirectCommand>& aCommands, const std::vector<GLuint>& aVisible )
+	{
+		std::vector<std::vector<GLuint>> result;
+		for( DrawElementsIndirectCommand const& command : aCommands )
+		{
+			auto const first = aVisible.begin() + command.baseInstance;
+			std::vector<GLuint> visible( first, first + command.instanceCount );
+			std::ranges::sort( visible );
+			result.push_back( std::move( visible ) );
+		}
+
+		return result;
+	}
+}
+
+TEST_CASE( "Frustum planes from the projection", "[culling]" )
+{
+	Frustum const frustum = Frustum_();
+
+	for( Vec4f const& plane : frustum.planes )
+		REQUIRE( Catch::Approx( 1.f ) == plane.x * plane.x + plane.y * plane.y + plane.z * plane.z );
+
+	// Ahead, behind, beyond the far plane, off to the side
+	REQUIRE( Intersects( frustum, { 0.f, 0.f, -10.f, 1.f } ) );
+	REQUIRE_FALSE( Intersects( frustum, { 0.f, 0.f, 10.f, 1.f } ) );
+	REQUIRE_FALSE( Intersects( frustum, { 0.f, 0.f, -110.f, 1.f } ) );
+	REQUIRE_FALSE( Intersects( frustum, { 20.f, 0.f, -10.f, 1.f } ) );
+
+	// Outside, but close enough to the left plane to touch it
+	REQUIRE( Intersects( frustum, { -10.5f, 0.f, -10.f, 1.f } ) );
+	REQUIRE_FALSE( Intersects( frustum, { -12.f, 0.f, -10.f, 1.f } ) );
+
+	// Around the camera: the near plane cuts it
+	REQUIRE( Intersects( frustum, { 0.f, 0.f, 0.f, 0.5f } ) );
+}
+
+// Instances of three meshes scattered around the camera. The compute
+// shader must keep the same instances of each draw as the CPU (in whatever
+// order), and the commands must be the same.
+TEST_CASE( "GPU culling matches the CPU reference", "[culling][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	ShapeMaterial const material{ { 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f }, 1.f };
+	ModelObject const cube = MakeCube( Transform{}, material );
+	ModelObject const cylinder = MakeCylinder( true, 16, Transform{}, material );
+	ModelObject const cone = MakeCone( true, 16, Transform{}, material );
+
+	GeometryBuffer geometry( 4096, 4096 );
+	MeshRange const meshes[] = { geometry.Add( cube ), geometry.Add( cylinder ), geometry.Add( cone ) };
+	REQUIRE( meshes[0].bounds.w > 0.f );
+
+	StaticDrawBatch batch( geometry );
+
+	std::mt19937 random( 50 );
+	std::uniform_real_distribution<float> position( -60.f, 60.f );
+	std::uniform_real_distribution<float> scale( 0.1f, 5.f );
+	std::uniform_real_distribution<float> angle( -kPi_, kPi_ );
+
+	for( std::size_t draw = 0; draw < 12; ++draw )
+	{
+		std::vector<Transform> transforms( 50 + draw * 37 );
+		for( Transform& transform : transforms )
+		{
+			transform.mPosition = { position( random ), position( random ), position( random ) };
+			transform.mRotation = { angle( random ), angle( random ), angle( random ) };
+			transform.mScale = { scale( random ), scale( random ), scale( random ) };
+		}
+
+		batch.Add( meshes[draw % 3], transforms );
+	}
+
+	// The reference on the CPU, as it goes to the GPU
+	Frustum const frustum = Frustum_();
+	batch.Cull( frustum, CullingBackend::Cpu );
+	auto const cpuCommands = batch.ReadCommands();
+	auto const cpu = Visible_( cpuCommands, batch.ReadVisible() );
+
+	batch.Cull( frustum, CullingBackend::Gpu );
+	auto const gpuCommands = batch.ReadCommands();
+	auto const gpu = Visible_( gpuCommands, batch.ReadVisible() );
+
+	std::size_t visible = 0;
+	REQUIRE( batch.DrawCount() == gpuCommands.size() );
+	for( std::size_t i = 0; i < gpuCommands.size(); ++i )
+	{
+		INFO( "Draw " << i );
+		REQUIRE( cpuCommands[i].instanceCount == gpuCommands[i].instanceCount );
+		REQUIRE( cpuCommands[i].count == gpuCommands[i].count );
+		REQUIRE( cpuCommands[i].firstIndex == gpuCommands[i].firstIndex );
+		REQUIRE( cpuCommands[i].baseVertex == gpuCommands[i].baseVertex );
+		REQUIRE( cpuCommands[i].baseInstance == gpuCommands[i].baseInstance );
+		REQUIRE( cpu[i] == gpu[i] );
+
+		visible += gpuCommands[i].instanceCount;
+	}
+
+	// Some of them, not none or all
+	REQUIRE( visible > 0 );
+	REQUIRE( visible < batch.InstanceCount() );
+
+	glUseProgram( 0 );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
@@ -0,0 +1,193 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../main/GeometryBuffer.hpp"
+#include "../main/ModelObject.hpp"
+#include "../main/ShapeObject.hpp"
+#include "../main/StaticDrawBatch.hpp"
+
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr GLsizei kSize_ = 64;
+
+	ShapeMaterial Material_( Vec3f aColour )
+	{
+		return { aColour, { 0.f, 0.f, 0.f }, 1.f };
+	}
+
+	bool Same_( Vec3f aLeft, Vec3f aRight )
+	{
+		return aLeft.x == aRight.x && aLeft.y == aRight.y && aLeft.z == aRight.z;
+	}
+
+	// The colour at aPosition (in NDC); static.frag doesn't write alpha
+	std::array<std::uint8_t, 3> Pixel_( Vec2f aPosition )
+	{
+		GLint const x = GLint((aPosition.x + 1.f) * 0.5f * kSize_);
+		GLint const y = GLint((aPosition.y + 1.f) * 0.5f * kSize_);
+
+		std::array<std::uint8_t, 3> pixel{};
+		glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+		glReadPixels( x, y, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, pixel.data() );
+		return pixel;
+	}
+}
+
+TEST_CASE( "Geometry ranges are allocated first fit and merged when freed", "[geometry]" )
+{
+	RangeAllocator ranges( 100 );
+
+	auto const a = ranges.Allocate( 30 );
+	auto const b = ranges.Allocate( 30 );
+	auto const c = ranges.Allocate( 30 );
+	REQUIRE( a == 0u );
+	REQUIRE( b == 30u );
+	REQUIRE( c == 60u );
+	REQUIRE( 90 == ranges.Used() );
+
+	// Doesn't fit anywhere
+	REQUIRE_FALSE( ranges.Allocate( 20 ).has_value() );
+
+	// The first range that fits, not the best one
+	ranges.Free( { *a, 30 } );
+	REQUIRE( ranges.Allocate( 5 ) == 0u );
+	REQUIRE( 25 == ranges.LargestFree() );
+
+	// Freeing the middle joins both neighbours
+	ranges.Free( { 0, 5 } );
+	ranges.Free( { *c, 30 } );
+	ranges.Free( { *b, 30 } );
+	REQUIRE( 0 == ranges.Used() );
+	REQUIRE( 100 == ranges.LargestFree() );
+	REQUIRE( ranges.Allocate( 100 ) == 0u );
+}
+
+// Triangle soups are indexed: the indices give back every vertex of the
+// soup (zeros may have lost their sign), with the same vertex stored once
+TEST_CASE( "Static geometry is welded", "[geometry]" )
+{
+	ModelObject const cube = MakeCube( Transform{}, Material_( { 1.f, 0.f, 0.f } ) );
+	REQUIRE( 36 == cube.Vertices().size() );
+
+	std::vector<StaticVertex> vertices;
+	std::vector<GLuint> indices;
+	GeometryBuffer::Weld( cube, vertices, indices );
+
+	// Four corners for each face, whose normal they share
+	REQUIRE( 24 == vertices.size() );
+	REQUIRE( 36 == indices.size() );
+
+	for( std::size_t i = 0; i < indices.size(); ++i )
+	{
+		REQUIRE( indices[i] < vertices.size() );
+
+		StaticVertex const& vertex = vertices[indices[i]];
+		REQUIRE( Same_( vertex.position, cube.Vertices()[i] ) );
+		REQUIRE( Same_( vertex.normal, cube.Normals()[i] ) );
+		REQUIRE( Same_( vertex.colour, cube.VertexColours()[i] ) );
+	}
+
+	// Not loaded: no texture coordinates
+	REQUIRE( 0.f == vertices[0].texCoord.x );
+}
+
+// Two meshes, three instances, one glMultiDrawElementsIndirect(); each
+// instance is where its transform puts it and coloured by its own mesh,
+// with the draws found through gl_DrawID and through the base instance
+TEST_CASE( "Static geometry is drawn in one multi-draw", "[geometry][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	GLuint colour = 0, fbo = 0;
+	glGenTextures( 1, &colour );
+	glBindTexture( GL_TEXTURE_2D, colour );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, kSize_, kSize_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	glGenFramebuffers( 1, &fbo );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0 );
+	glViewport( 0, 0, kSize_, kSize_ );
+
+	Transform const small{ .mScale{ 0.2f, 0.2f, 0.2f } };
+	ModelObject const red = MakeCube( small, Material_( { 1.f, 0.f, 0.f } ) );
+	ModelObject const green = MakeCube( small, Material_( { 0.f, 1.f, 0.f } ) );
+
+	GeometryBuffer geometry( 100, 100 );
+	MeshRange const redMesh = geometry.Add( red );
+	MeshRange const greenMesh = geometry.Add( green );
+	REQUIRE( 24 == greenMesh.vertices.first );
+	REQUIRE( 36 == greenMesh.indices.first );
+	REQUIRE( 48 == geometry.Vertices().Used() );
+
+	// Full
+	REQUIRE_THROWS( geometry.Add( red ) );
+	REQUIRE( 48 == geometry.Vertices().Used() );
+
+	StaticDrawBatch batch( geometry );
+
+	std::vector<Transform> const redInstances{
+		{ .mPosition{ -0.5f, 0.5f, 0.f } },
+		{ .mPosition{ 0.5f, 0.5f, 0.f } }
+	};
+	Transform const greenInstance{ .mPosition{ 0.f, -0.5f, 0.f } };
+
+	batch.Add( redMesh, redInstances );
+	batch.Add( greenMesh, {} );
+	batch.Add( greenMesh, { &greenInstance, 1 } );
+
+	// The empty draw is left out
+	REQUIRE( 2 == batch.DrawCount() );
+	REQUIRE( 3 == batch.InstanceCount() );
+	REQUIRE( 2 == batch.Commands()[0].instanceCount );
+	REQUIRE( 2 == batch.Commands()[1].baseInstance );
+	REQUIRE( 24 == batch.Commands()[1].baseVertex );
+
+	std::vector<std::string> variants{ "0" };
+	if( StaticDrawBatch::DrawParameters() )
+		variants.push_back( "1" );
+
+	for( std::string const& drawParameters : variants )
+	{
+		DYNAMIC_SECTION( "DRAW_PARAMETERS " << drawParameters )
+		{
+			ShaderProgram program( {
+				{ GL_VERTEX_SHADER, "assets/cw2/static.vert", { { "DRAW_PARAMETERS", drawParameters } } },
+				{ GL_FRAGMENT_SHADER, "assets/cw2/static.frag", { { "N_LIGHTS", "0" } } }
+			} );
+			glUseProgram( program.programId() );
+
+			// Unlit: the colour is the vertex colour
+			program.setUniform( "uProjCamera", kIdentity44f );
+			program.setUniform( "uSceneAmbient", Vec3f{ 1.f, 1.f, 1.f } );
+			program.setUniform( "uLightDiffuse", Vec3f{ 0.f, 0.f, 0.f } );
+
+			glClearColor( 0.f, 0.f, 0.f, 0.f );
+			glClear( GL_COLOR_BUFFER_BIT );
+			batch.Draw();
+
+			using Rgb_ = std::array<std::uint8_t, 3>;
+			REQUIRE( Rgb_{ 255, 0, 0 } == Pixel_( { -0.5f, 0.5f } ) );
+			REQUIRE( Rgb_{ 255, 0, 0 } == Pixel_( { 0.5f, 0.5f } ) );
+			REQUIRE( Rgb_{ 0, 255, 0 } == Pixel_( { 0.f, -0.5f } ) );
+			REQUIRE( Rgb_{ 0, 0, 0 } == Pixel_( { 0.f, 0.5f } ) );
+			REQUIRE( Rgb_{ 0, 0, 0 } == Pixel_( { -0.5f, -0.5f } ) );
+		}
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	glDeleteFramebuffers( 1, &fbo );
+	glDeleteTextures( 1, &colour );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
@@ -0,0 +1,86 @@
+#include "gl_context.hpp"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "../support/gl_state.hpp"
+
+namespace
+{
+	std::string glfw_error_()
+	{
+		char const* msg = nullptr;
+		int const ecode = glfwGetError( &msg );
+		return std::string( msg ? msg : "unknown error" ) + " (" + std::to_string( ecode ) + ")";
+	}
+
+	GLFWwindow* create_window_( int aPlatform, int aContextApi )
+	{
+		glfwInitHint( GLFW_PLATFORM, aPlatform );
+		if( GLFW_TRUE != glfwInit() )
+			return nullptr;
+
+		glfwDefaultWindowHints();
+		glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE );
+		glfwWindowHint( GLFW_CONTEXT_CREATION_API, aContextApi );
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+		glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE );
+		glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+
+		GLFWwindow* window = glfwCreateWindow( 64, 64, "main-test", nullptr, nullptr );
+		if( !window )
+			glfwTerminate();
+
+		return window;
+	}
+}
+
+TestGLContext::TestGLContext()
+	: mWindow( create_window_( GLFW_ANY_PLATFORM, GLFW_NATIVE_CONTEXT_API ) )
+{
+	// No display? Try headless.
+	if( !mWindow )
+		mWindow = create_window_( GLFW_PLATFORM_NULL, GLFW_EGL_CONTEXT_API );
+
+	if( !mWindow )
+	{
+		mDescription = "Unable to create an OpenGL 4.3 context: " + glfw_error_();
+		return;
+	}
+
+	glfwMakeContextCurrent( mWindow );
+
+	if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
+	{
+		mDescription = "gladLoadGLLoader() failed";
+		glfwDestroyWindow( mWindow );
+		glfwTerminate();
+		mWindow = nullptr;
+		return;
+	}
+
+	// As in main, so that everything is tested through it
+	install_gl_state_cache();
+
+	mDescription = (char const*)glGetString( GL_RENDERER );
+}
+
+TestGLContext::~TestGLContext()
+{
+	if( mWindow )
+	{
+		glfwDestroyWindow( mWindow );
+		glfwTerminate();
+	}
+}
+
+bool TestGLContext::valid() const noexcept
+{
+	return nullptr != mWindow;
+}
+
+std::string const& TestGLContext::description() const noexcept
+{
+	return mDescription;
+}
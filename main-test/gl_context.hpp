@@ -0,0 +1,41 @@
+#ifndef GL_CONTEXT_HPP_6E0C2B8D_37A4_4F51_9D0E_4B8B1C7E2A93
+#define GL_CONTEXT_HPP_6E0C2B8D_37A4_4F51_9D0E_4B8B1C7E2A93
+
+#include <string>
+
+struct GLFWwindow;
+
+// Creates an invisible window with an OpenGL 4.3 core context (the same
+// version that main requests), makes it current and loads the API through
+// glad, with the GL state cache (support/gl_state.hpp) installed. Tests that
+// need a real GL implementation construct one of these and SKIP() when
+// valid() is false.
+//
+// The regular windowing platform is tried first. If there is no display,
+// GLFW's null platform with an EGL context is used instead; with Mesa this
+// gives a headless software renderer (llvmpipe), e.g. in CI:
+//
+//	LIBGL_ALWAYS_SOFTWARE=1 ./bin/main-test-release-x64-gcc.exe "[gpu]"
+//
+// Only one may exist at a time.
+class TestGLContext final
+{
+	public:
+		TestGLContext();
+		~TestGLContext();
+
+		TestGLContext( TestGLContext const& ) = delete;
+		TestGLContext& operator= (TestGLContext const&) = delete;
+
+	public:
+		bool valid() const noexcept;
+
+		// GL_RENDERER, or why no context could be created
+		std::string const& description() const noexcept;
+
+	private:
+		GLFWwindow* mWindow;
+		std::string mDescription;
+};
+
+#endif // GL_CONTEXT_HPP_6E0C2B8D_37A4_4F51_9D0E_4B8B1C7E2A93
@@ -0,0 +1,116 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <glad/glad.h>
+
+#include "../support/gl_state.hpp"
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	GLint Integer_( GLenum aName )
+	{
+		GLint value = 0;
+		glGetIntegerv( aName, &value );
+		return value;
+	}
+}
+
+// Calls that wouldn't change anything are dropped, and counted; GL ends up
+// in the state it was asked for either way
+TEST_CASE( "Redundant GL state changes are elided", "[gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" }
+	} );
+
+	GLuint textures[2];
+	glGenTextures( 2, textures );
+	GLuint buffers[2];
+	glGenBuffers( 2, buffers );
+
+	gl_state_new_frame();
+
+	SECTION( "Binds" )
+	{
+		glUseProgram( program.programId() );
+		glUseProgram( program.programId() );
+		REQUIRE( GLint(program.programId()) == Integer_( GL_CURRENT_PROGRAM ) );
+
+		// Per texture unit
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, textures[0] );
+		glActiveTexture( GL_TEXTURE1 );
+		glBindTexture( GL_TEXTURE_2D, textures[0] );
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, textures[0] );
+		REQUIRE( GLint(textures[0]) == Integer_( GL_TEXTURE_BINDING_2D ) );
+
+		auto const stats = gl_state_new_frame();
+		REQUIRE( 6 == stats.issued );
+		REQUIRE( 2 == stats.elided );
+		REQUIRE( 0 == gl_state_stats().issued );
+	}
+
+	SECTION( "Buffers" )
+	{
+		// glBindBufferBase() binds the generic binding point too
+		glBindBufferBase( GL_UNIFORM_BUFFER, 0, buffers[0] );
+		glBindBuffer( GL_UNIFORM_BUFFER, buffers[0] );
+		REQUIRE( 1 == gl_state_stats().elided );
+
+		glBindBuffer( GL_UNIFORM_BUFFER, buffers[1] );
+		glBindBufferBase( GL_UNIFORM_BUFFER, 0, buffers[0] );
+		REQUIRE( GLint(buffers[0]) == Integer_( GL_UNIFORM_BUFFER_BINDING ) );
+		REQUIRE( 3 == gl_state_stats().issued );
+
+		// Deleting a bound buffer unbinds it: a new one with the same name
+		// still gets bound
+		glBindBuffer( GL_ARRAY_BUFFER, buffers[1] );
+		glDeleteBuffers( 1, &buffers[1] );
+		REQUIRE( 0 == Integer_( GL_ARRAY_BUFFER_BINDING ) );
+
+		glGenBuffers( 1, &buffers[1] );
+		glBindBuffer( GL_ARRAY_BUFFER, buffers[1] );
+		REQUIRE( GLint(buffers[1]) == Integer_( GL_ARRAY_BUFFER_BINDING ) );
+		REQUIRE( 1 == gl_state_stats().elided );
+	}
+
+	SECTION( "Fixed function" )
+	{
+		for( int i = 0; i < 2; ++i )
+		{
+			glEnable( GL_BLEND );
+			glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+			glDepthMask( GL_FALSE );
+			glDisable( GL_DEPTH_TEST );
+			glViewport( 0, 0, 32, 16 );
+		}
+
+		REQUIRE( 5 == gl_state_stats().issued );
+		REQUIRE( 5 == gl_state_stats().elided );
+
+		REQUIRE( GL_TRUE == glIsEnabled( GL_BLEND ) );
+		REQUIRE( GL_FALSE == glIsEnabled( GL_DEPTH_TEST ) );
+		REQUIRE( GL_ONE == Integer_( GL_BLEND_DST_RGB ) );
+
+		GLint viewport[4] = {};
+		glGetIntegerv( GL_VIEWPORT, viewport );
+		REQUIRE( 16 == viewport[3] );
+
+		// After a reset, nothing is known to be set
+		reset_gl_state_cache();
+		glEnable( GL_BLEND );
+		REQUIRE( 6 == gl_state_stats().issued );
+	}
+
+	glDeleteBuffers( 2, buffers );
+	glDeleteTextures( 2, textures );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
@@ -1,14 +1,24 @@
 #version 430
 
+// Instances drawn from per-instance uniform arrays, for the ShaderProgram
+// tests: no shader of the scene has uniform arrays (the instances come from
+// storage buffers), and these are sized by a define. Goes with
+// materialColour.frag.
+
+// Uniform array sizes; specialized by ShaderProgram::ShaderSource::defines
+#ifndef MAX_INSTANCES
+#define MAX_INSTANCES 2
+#endif
+
 layout( location = 0 ) in vec3 iPosition;
 layout( location = 1 ) in vec3 iColor;
 layout( location = 2 ) in vec3 iNormal;
 layout( location = 3 ) in vec3 iSpecRef;
 layout( location = 4 ) in float iShininess;
 
-uniform mat4 uProjCameraWorld[2];
-uniform vec3 uModelTransform[2];
-uniform mat3 uNormalTransform[2];
+uniform mat4 uProjCameraWorld[MAX_INSTANCES];
+uniform vec3 uModelTransform[MAX_INSTANCES];
+uniform mat3 uNormalTransform[MAX_INSTANCES];
 
 out vec3 v2fColor; // v2f = vertex to fragment
 out vec3 v2fNormal;
@@ -0,0 +1,353 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "../main/Particle.hpp"
+#include "../main/ParticleSystem.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr float kFrameTime_ = 1.f / 60.f;
+
+	PSourceParams make_params_( ParticleBackend aBackend )
+	{
+		return PSourceParams{
+			.Colour = { 1.f, 0.8f, 0.6f, 1.f },
+			.Velocity = { 0.f, 0.f, 0.f },
+			.SourceOrigin = { -31.60f, -0.1f, 2.1f },
+			.spread = 0.5f,
+			.lifeTime = 0.5f,
+			.fade = 2.f,
+			.size = 0.2f,
+			.maxParticles = 4096,
+			.spawnRate = 64,
+			.backend = aBackend
+		};
+	}
+
+	struct Moments_
+	{
+		Vec3f mean;
+		Vec3f variance;
+		float meanAlpha;
+		float meanLife;
+	};
+
+	Moments_ moments_( ParticlePool const& aPool )
+	{
+		Moments_ ret{};
+
+		auto const positions = aPool.Positions();
+		auto const colours = aPool.Colours();
+		auto const lives = aPool.Lives();
+		float const n = float(aPool.AliveCount());
+
+		for( std::size_t i = 0; i < aPool.AliveCount(); ++i )
+		{
+			ret.mean += positions[i];
+			ret.meanAlpha += colours[i].w;
+			ret.meanLife += lives[i];
+		}
+		ret.mean = ret.mean / n;
+		ret.meanAlpha /= n;
+		ret.meanLife /= n;
+
+		for( auto const& p : positions )
+		{
+			Vec3f const d = p - ret.mean;
+			ret.variance += Vec3f{ d.x*d.x, d.y*d.y, d.z*d.z };
+		}
+		ret.variance = ret.variance / n;
+
+		return ret;
+	}
+}
+
+// The two backends use different random number generators, so individual
+// particles can't be compared. Everything that doesn't depend on the random
+// offsets must match closely; the spawn offsets must have the same
+// distribution.
+TEST_CASE( "Compute shader particles match the CPU reference", "[particles][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	ParticleSource cpu( make_params_( ParticleBackend::Cpu ), "assets/cw2/Particle.png" );
+	ParticleSource gpu( make_params_( ParticleBackend::Gpu ), "assets/cw2/Particle.png" );
+	REQUIRE( ParticleBackend::Gpu == gpu.Backend() );
+
+	cpu.SetActive( true );
+	gpu.SetActive( true );
+
+	// Move the source around, so that the velocity (and with it the
+	// integration) is exercised too
+	auto const step = [&] ( int aFrame ) {
+		float const angle = 0.05f * float(aFrame);
+		Vec3f const position = cpu.GetOrigin() + Vec3f{ std::cos( angle ), 0.1f * float(aFrame % 7), std::sin( angle ) };
+
+		for( ParticleSource* source : { &cpu, &gpu } )
+		{
+			source->SetPosition( position );
+			source->UpdateParticles( kFrameTime_ );
+		}
+	};
+
+	int frame = 0;
+	for( ; frame < 120; ++frame )
+		step( frame );
+
+	SECTION( "Steady state" )
+	{
+		ParticlePool const cpuParticles = cpu.SnapshotParticles();
+		ParticlePool const gpuParticles = gpu.SnapshotParticles();
+
+		// 0.5s lifetime = 30 frames of 64 particles. Allow for the last
+		// batch to be rounded differently.
+		REQUIRE( cpuParticles.AliveCount() > 0 );
+		REQUIRE( std::abs( double(cpuParticles.AliveCount()) - double(gpuParticles.AliveCount()) ) <= 64.0 );
+
+		Moments_ const c = moments_( cpuParticles );
+		Moments_ const g = moments_( gpuParticles );
+
+		// Fade and lifetime are deterministic per particle
+		REQUIRE_THAT( g.meanAlpha, Catch::Matchers::WithinAbs( c.meanAlpha, 0.05 ) );
+		REQUIRE_THAT( g.meanLife, Catch::Matchers::WithinAbs( c.meanLife, 0.02 ) );
+
+		// The offsets are uniform in [-spread, spread]^3. With this many
+		// samples, the sample means differ by well under 6 standard errors.
+		float const spread = make_params_( ParticleBackend::Cpu ).spread;
+		double const n = double(cpuParticles.AliveCount());
+		double const offsetVariance = spread*spread / 3.0;
+		double const meanTolerance = 6.0 * std::sqrt( 2.0 * offsetVariance / n );
+
+		REQUIRE_THAT( g.mean.x, Catch::Matchers::WithinAbs( c.mean.x, meanTolerance ) );
+		REQUIRE_THAT( g.mean.y, Catch::Matchers::WithinAbs( c.mean.y, meanTolerance ) );
+		REQUIRE_THAT( g.mean.z, Catch::Matchers::WithinAbs( c.mean.z, meanTolerance ) );
+
+		REQUIRE_THAT( g.variance.x, Catch::Matchers::WithinRel( c.variance.x, 0.15f ) );
+		REQUIRE_THAT( g.variance.y, Catch::Matchers::WithinRel( c.variance.y, 0.15f ) );
+		REQUIRE_THAT( g.variance.z, Catch::Matchers::WithinRel( c.variance.z, 0.15f ) );
+
+		// Nothing dead is kept around
+		for( float const life : gpuParticles.Lives() )
+			REQUIRE( life > 0.f );
+	}
+
+	SECTION( "Capacity" )
+	{
+		// 64 per frame for 0.5s doesn't fit in 256 slots; both must stop at
+		// the limit
+		auto params = make_params_( ParticleBackend::Cpu );
+		params.maxParticles = 256;
+		ParticleSource cpuSmall( params, "assets/cw2/Particle.png" );
+		params.backend = ParticleBackend::Gpu;
+		ParticleSource gpuSmall( params, "assets/cw2/Particle.png" );
+
+		cpuSmall.SetActive( true );
+		gpuSmall.SetActive( true );
+		for( int i = 0; i < 10; ++i )
+		{
+			cpuSmall.UpdateParticles( kFrameTime_ );
+			gpuSmall.UpdateParticles( kFrameTime_ );
+		}
+
+		REQUIRE( 256 == cpuSmall.SnapshotParticles().AliveCount() );
+		REQUIRE( 256 == gpuSmall.SnapshotParticles().AliveCount() );
+	}
+
+	SECTION( "Reset" )
+	{
+		gpu.DeleteParticles();
+		REQUIRE( 0 == gpu.SnapshotParticles().AliveCount() );
+
+		// and it starts spawning again
+		step( frame );
+		REQUIRE( 64 == gpu.SnapshotParticles().AliveCount() );
+	}
+}
+
+TEST_CASE( "GPU particle count is tracked without a read back", "[particles][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	auto params = make_params_( ParticleBackend::Gpu );
+	params.maxParticles = 1000;
+	ParticleSource gpu( params, "assets/cw2/Particle.png" );
+	REQUIRE( ParticleBackend::Gpu == gpu.Backend() );
+
+	gpu.SetActive( true );
+	for( int i = 0; i < 60; ++i )
+	{
+		// Vary the spawn count and run into the capacity now and then
+		gpu.UpdateParticles( kFrameTime_, (i * 37) % 100 );
+		REQUIRE( gpu.AliveCount() == gpu.SnapshotParticles().AliveCount() );
+	}
+}
+
+TEST_CASE( "Particle system budget", "[particles][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	Vec3f const viewer{ 0.f, 0.f, 0.f };
+
+	auto params = make_params_( ParticleBackend::Cpu );
+	params.SourceOrigin = viewer;
+
+	SECTION( "Global limit" )
+	{
+		// 24 emitters at 64 per frame would keep ~46k particles alive
+		ParticleSystem system( ParticleBudget{ .maxParticles = 5000, .fullRateDistance = 10.f, .cullDistance = 100.f }, 3 );
+		for( int i = 0; i < 24; ++i )
+			system.AddEmitter( params, "assets/cw2/Particle.png" );
+
+		system.SetActive( true );
+		double lastSecond = 0.0;
+		for( int i = 0; i < 120; ++i )
+		{
+			system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+			REQUIRE( system.AliveCount() <= 5000 );
+
+			if( i >= 60 )
+				lastSecond += double(system.AliveCount()) / 60.0;
+		}
+
+		// and it is actually used. The emitters all started on the same
+		// frame, so their particles die in bursts, and the count dips for a
+		// frame until they are replaced.
+		REQUIRE( lastSecond > 4000.0 );
+	}
+
+	SECTION( "Priority" )
+	{
+		ParticleSystem system( ParticleBudget{ .maxParticles = 2000, .fullRateDistance = 10.f, .cullDistance = 100.f }, 3 );
+		auto const low = system.AddEmitter( params, "assets/cw2/Particle.png", 1.f );
+		auto const high = system.AddEmitter( params, "assets/cw2/Particle.png", 4.f );
+
+		system.SetActive( true );
+		for( int i = 0; i < 120; ++i )
+			system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+		REQUIRE( system.Emitter( high ).AliveCount() > 2 * system.Emitter( low ).AliveCount() );
+	}
+
+	SECTION( "Distance" )
+	{
+		ParticleSystem system( ParticleBudget{ .maxParticles = 100000, .fullRateDistance = 10.f, .cullDistance = 100.f }, 3 );
+		auto const near = system.AddEmitter( params, "assets/cw2/Particle.png" );
+		auto const middle = system.AddEmitter( params, "assets/cw2/Particle.png" );
+		auto const far = system.AddEmitter( params, "assets/cw2/Particle.png" );
+		system.Emitter( middle ).SetPosition( { 55.f, 0.f, 0.f } );
+		system.Emitter( far ).SetPosition( { 0.f, 0.f, 150.f } );
+
+		system.SetActive( true );
+		for( int i = 0; i < 120; ++i )
+			system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+		// Half way between fullRateDistance and cullDistance: half the rate
+		double const nearCount = double(system.Emitter( near ).AliveCount());
+		REQUIRE( nearCount > 0.0 );
+		REQUIRE_THAT( double(system.Emitter( middle ).AliveCount()), Catch::Matchers::WithinRel( nearCount / 2.0, 0.1 ) );
+		REQUIRE( 0 == system.Emitter( far ).AliveCount() );
+	}
+}
+
+// GPU emitters with the same texture share one pool: each particle must
+// still be integrated with, and counted for, its own emitter
+TEST_CASE( "GPU emitters share a pool per texture", "[particles][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	Vec3f const viewer{ 0.f, 0.f, 0.f };
+	ParticleSystem system( ParticleBudget{ .maxParticles = 100000, .fullRateDistance = 100.f, .cullDistance = 200.f }, 0 );
+
+	std::vector<ParticleSystem::EmitterID> emitters;
+	for( int i = 0; i < 3; ++i )
+	{
+		auto params = make_params_( ParticleBackend::Gpu );
+		params.SourceOrigin = { 10.f * float(i), 0.f, 0.f };
+		params.spawnRate = 16 << i;
+		params.maxParticles = 256 << i;
+
+		emitters.push_back( system.AddEmitter( params, "assets/cw2/Particle.png" ) );
+		REQUIRE( ParticleBackend::Gpu == system.Emitter( emitters.back() ).Backend() );
+	}
+
+	auto const check = [&] {
+		for( auto const id : emitters )
+		{
+			ParticlePool const particles = system.SnapshotParticles( id );
+			REQUIRE( system.Emitter( id ).AliveCount() == particles.AliveCount() );
+
+			Vec3f const origin = system.Emitter( id ).GetPosition();
+			float const spread = system.Emitter( id ).GetParams().spread;
+			for( Vec3f const& position : particles.Positions() )
+			{
+				REQUIRE( std::abs( position.x - origin.x ) <= spread );
+				REQUIRE( std::abs( position.y - origin.y ) <= spread );
+				REQUIRE( std::abs( position.z - origin.z ) <= spread );
+			}
+		}
+	};
+
+	system.SetActive( true );
+	for( int i = 0; i < 40; ++i )
+		system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+	REQUIRE( system.Emitter( emitters[2] ).AliveCount() > 0 );
+	check();
+
+	SECTION( "Inactive emitters keep their particles" )
+	{
+		system.Emitter( emitters[0] ).SetActive( false );
+		auto const before = system.SnapshotParticles( emitters[0] );
+		system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+		REQUIRE( before.AliveCount() == system.SnapshotParticles( emitters[0] ).AliveCount() );
+		check();
+	}
+
+	SECTION( "Deleting one emitter's particles" )
+	{
+		system.Emitter( emitters[1] ).DeleteParticles();
+		system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+
+		// Only this frame's spawns are left
+		REQUIRE( 32 == system.SnapshotParticles( emitters[1] ).AliveCount() );
+		REQUIRE( system.Emitter( emitters[0] ).AliveCount() > 32 );
+		check();
+	}
+
+	SECTION( "Adding an emitter grows the pool" )
+	{
+		auto params = make_params_( ParticleBackend::Gpu );
+		params.SourceOrigin = { 0.f, 10.f, 0.f };
+		emitters.push_back( system.AddEmitter( params, "assets/cw2/Particle.png" ) );
+		system.Emitter( emitters.back() ).SetActive( true );
+		check();
+
+		system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+		REQUIRE( 64 == system.Emitter( emitters.back() ).AliveCount() );
+		check();
+	}
+
+	SECTION( "Deleting all" )
+	{
+		system.DeleteParticles();
+		REQUIRE( 0 == system.SnapshotParticles( emitters[2] ).AliveCount() );
+
+		system.Update( kFrameTime_, std::span( &viewer, 1 ) );
+		check();
+	}
+}
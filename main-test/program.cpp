@@ -0,0 +1,357 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../support/program.hpp"
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	std::vector<std::filesystem::path> Binaries_( std::filesystem::path const& aDirectory )
+	{
+		std::vector<std::filesystem::path> binaries;
+		for( auto const& entry : std::filesystem::directory_iterator( aDirectory ) )
+			binaries.push_back( entry.path() );
+		return binaries;
+	}
+
+	GLint ActiveUniforms_( ShaderProgram const& aProgram )
+	{
+		GLint count = 0;
+		glGetProgramiv( aProgram.programId(), GL_ACTIVE_UNIFORMS, &count );
+		return count;
+	}
+}
+
+// Linked once, loaded from the binary after that, and compiled again when
+// the source changes or the binary is unusable
+TEST_CASE( "Shader program binaries are cached", "[gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	GLint formats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	if( 0 == formats )
+		SKIP( "No program binary formats: " << context.description() );
+
+	auto const directory = std::filesystem::temp_directory_path() / "main-test-shader-cache";
+	std::filesystem::remove_all( directory );
+
+	// A copy of a shader, to edit
+	auto const fragment = (directory.parent_path() / "main-test-shader-cache.frag").string();
+	std::filesystem::copy_file( "assets/cw2/uiShader.frag", fragment, std::filesystem::copy_options::overwrite_existing );
+
+	ShaderProgram::setBinaryCache( directory.string() );
+
+	auto const sources = std::vector<ShaderProgram::ShaderSource>{
+		{ GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" },
+		{ GL_FRAGMENT_SHADER, fragment }
+	};
+
+	auto const before = ShaderProgram::cacheStats();
+
+	GLint uniforms = 0;
+	{
+		ShaderProgram program( sources );
+		uniforms = ActiveUniforms_( program );
+	}
+	REQUIRE( before.compiled + 1 == ShaderProgram::cacheStats().compiled );
+	REQUIRE( before.stored + 1 == ShaderProgram::cacheStats().stored );
+	REQUIRE( 1 == Binaries_( directory ).size() );
+
+	SECTION( "Loaded" )
+	{
+		ShaderProgram program( sources );
+		REQUIRE( before.compiled + 1 == ShaderProgram::cacheStats().compiled );
+		REQUIRE( before.loaded + 1 == ShaderProgram::cacheStats().loaded );
+		REQUIRE( 0 != program.programId() );
+		REQUIRE( uniforms == ActiveUniforms_( program ) );
+
+		// Reloading uses it too
+		program.reload();
+		REQUIRE( before.loaded + 2 == ShaderProgram::cacheStats().loaded );
+	}
+
+	SECTION( "Edited source" )
+	{
+		std::ofstream( fragment, std::ios::app ) << "\n// Edited\n";
+
+		ShaderProgram program( sources );
+		REQUIRE( before.compiled + 2 == ShaderProgram::cacheStats().compiled );
+		REQUIRE( 2 == Binaries_( directory ).size() );
+	}
+
+	SECTION( "Rejected binary" )
+	{
+		auto const binary = Binaries_( directory ).front();
+		auto const size = std::filesystem::file_size( binary );
+
+		// Keep the header, garble the binary
+		{
+			std::fstream file( binary, std::ios::in | std::ios::out | std::ios::binary );
+			file.seekp( std::streamoff(size / 2) );
+			for( std::uintmax_t i = size / 2; i < size; ++i )
+				file.put( char(0xa5) );
+		}
+
+		ShaderProgram program( sources );
+		REQUIRE( before.rejected + 1 == ShaderProgram::cacheStats().rejected );
+		REQUIRE( before.compiled + 2 == ShaderProgram::cacheStats().compiled );
+		REQUIRE( uniforms == ActiveUniforms_( program ) );
+
+		// Replaced
+		ShaderProgram again( sources );
+		REQUIRE( before.loaded + 1 == ShaderProgram::cacheStats().loaded );
+	}
+
+	REQUIRE( GL_NO_ERROR == glGetError() );
+
+	ShaderProgram::setBinaryCache( {} );
+	std::filesystem::remove_all( directory );
+	std::filesystem::remove( fragment );
+}
+
+// Submitted together, finished later; the same programs as a blocking build
+TEST_CASE( "Shader programs build in the background", "[gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() << (ShaderProgram::parallelCompile() ? ", parallel compile" : "") );
+
+	auto const ui = std::vector<ShaderProgram::ShaderSource>{
+		{ GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" }
+	};
+	auto const font = std::vector<ShaderProgram::ShaderSource>{
+		{ GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" }
+	};
+
+	std::vector<ShaderProgram> programs;
+	programs.emplace_back( ui, ShaderProgram::Build::async );
+	programs.emplace_back( font, ShaderProgram::Build::async );
+
+	for( auto const& program : programs )
+	{
+		REQUIRE( program.pending() );
+		REQUIRE( 0 == program.programId() );
+	}
+
+	// Either the driver says when, or finish() compiles
+	for( auto& program : programs )
+	{
+		while( !program.ready() )
+			;
+
+		program.finish();
+		REQUIRE( !program.pending() );
+		REQUIRE( 0 != program.programId() );
+	}
+
+	REQUIRE( ActiveUniforms_( ShaderProgram( font ) ) == ActiveUniforms_( programs[1] ) );
+
+	// Errors come out of finish(), and keep the program there was
+	auto const broken = (std::filesystem::temp_directory_path() / "main-test-broken.frag").string();
+	std::ofstream( broken ) << "#version 430\nvoid main() { undefined(); }\n";
+
+	ShaderProgram program( { { GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" }, { GL_FRAGMENT_SHADER, broken } }, ShaderProgram::Build::async );
+	REQUIRE_THROWS( program.finish() );
+	REQUIRE( !program.pending() );
+	REQUIRE( 0 == program.programId() );
+
+	std::filesystem::remove( broken );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
+
+// Defines size the arrays and loops they are used for, each set of them is
+// one program, and errors still point at the file's own lines
+TEST_CASE( "Shader variants are specialized by defines", "[gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	auto const material = [] ( std::string aLights, std::string aInstances ) {
+		return std::vector<ShaderProgram::ShaderSource>{
+			{ GL_VERTEX_SHADER, "main-test/instancedProbe.vert", { { "MAX_INSTANCES", aInstances } } },
+			{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag", { { "N_LIGHTS", aLights } } }
+		};
+	};
+
+	auto const arraySize = [] ( ShaderProgram const& aProgram, char const* aName ) {
+		GLuint index = GL_INVALID_INDEX;
+		glGetUniformIndices( aProgram.programId(), 1, &aName, &index );
+		REQUIRE( GL_INVALID_INDEX != index );
+
+		GLint size = 0;
+		glGetActiveUniformsiv( aProgram.programId(), 1, &index, GL_UNIFORM_SIZE, &size );
+		return size;
+	};
+
+	ShaderVariantCache variants;
+
+	auto& defaults = variants.get( material( "3", "2" ) );
+	auto& unlit = variants.get( material( "0", "1" ) );
+	auto& crowded = variants.get( material( "8", "16" ) );
+	REQUIRE( 3 == variants.size() );
+
+	REQUIRE( 2 == arraySize( defaults, "uProjCameraWorld[0]" ) );
+	REQUIRE( 16 == arraySize( crowded, "uProjCameraWorld[0]" ) );
+
+	// No lights, no light block
+	REQUIRE( GL_INVALID_INDEX == glGetUniformBlockIndex( unlit.programId(), "LightBlock" ) );
+
+	GLint blockSize = 0;
+	glGetActiveUniformBlockiv( crowded.programId(), glGetUniformBlockIndex( crowded.programId(), "LightBlock" ), GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize );
+	REQUIRE( 8 * 3 * 16 == blockSize );
+
+	// Asked for again (defines in any order): the same program
+	REQUIRE( &defaults == &variants.get( material( "3", "2" ) ) );
+
+	auto sources = material( "3", "2" );
+	sources[1].defines.push_back( { "A_DEFINE", "1" } );
+	auto& withDefine = variants.get( sources );
+	std::swap( sources[1].defines.front(), sources[1].defines.back() );
+	REQUIRE( &withDefine == &variants.get( sources ) );
+	REQUIRE( 4 == variants.size() );
+
+	// Without defines, the files' own defaults: 3 lights, 2 instances
+	ShaderProgram plain( {
+		{ GL_VERTEX_SHADER, "main-test/instancedProbe.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag" }
+	} );
+	REQUIRE( 2 == arraySize( plain, "uProjCameraWorld[0]" ) );
+
+	variants.reloadAll();
+	REQUIRE( 4 == variants.size() );
+
+	// Line 3, with or without defines before it. Mesa's log says "0:3(..)".
+	auto const broken = (std::filesystem::temp_directory_path() / "main-test-line.frag").string();
+	std::ofstream( broken ) << "#version 430\nout vec4 o;\nvoid main() { o = undefined; }\n";
+
+	auto const error = [&] ( std::vector<ShaderProgram::Define> aDefines ) {
+		try
+		{
+			ShaderProgram program( { { GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" }, { GL_FRAGMENT_SHADER, broken, aDefines } } );
+		}
+		catch( std::exception const& eErr )
+		{
+			return std::string( eErr.what() );
+		}
+		return std::string();
+	};
+
+	auto const plainError = error( {} );
+	REQUIRE( !plainError.empty() );
+	REQUIRE( error( { { "ONE", "1" }, { "TWO", "2" } } ) == plainError );
+
+	// Failed builds aren't cached
+	REQUIRE_THROWS( variants.get( { { GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" }, { GL_FRAGMENT_SHADER, broken } } ) );
+	REQUIRE( 4 == variants.size() );
+
+	std::filesystem::remove( broken );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
+
+// Locations and blocks come from the reflection, and setUniform() only
+// uploads values that changed
+TEST_CASE( "Uniforms are reflected at link time", "[gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	ShaderProgram terrain( {
+		{ GL_VERTEX_SHADER, "assets/cw2/static.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/static.frag" }
+	} );
+
+	GLint const ambientLocation = glGetUniformLocation( terrain.programId(), "uSceneAmbient" );
+	REQUIRE( -1 != ambientLocation );
+	REQUIRE( ambientLocation == terrain.uniformLocation( "uSceneAmbient" ) );
+	REQUIRE( glGetUniformLocation( terrain.programId(), "uProjCamera" ) == terrain.uniformLocation( "uProjCamera" ) );
+	REQUIRE( glGetUniformLocation( terrain.programId(), "uCamPosition" ) == terrain.uniformLocation( "uCamPosition" ) );
+	REQUIRE( -1 == terrain.uniformLocation( "uNotThere" ) );
+
+	// Explicit locations
+	ShaderProgram particles( {
+		{ GL_VERTEX_SHADER, "assets/cw2/particleShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/particleShader.frag" }
+	} );
+	REQUIRE( 0 == particles.uniformLocation( "uProjCameraWorld" ) );
+	REQUIRE( 2 == particles.uniformLocation( "uCameraUp" ) );
+
+	REQUIRE( glGetUniformBlockIndex( terrain.programId(), "LightBlock" ) == terrain.uniformBlockIndex( "LightBlock" ) );
+	REQUIRE( GL_INVALID_INDEX == terrain.uniformBlockIndex( "NotABlock" ) );
+
+	ShaderProgram simulate( { { GL_COMPUTE_SHADER, "assets/cw2/particleSimulate.comp" } } );
+	REQUIRE( GL_INVALID_INDEX != simulate.storageBlockIndex( "DestParticles" ) );
+	REQUIRE( GL_INVALID_INDEX == simulate.uniformBlockIndex( "DestParticles" ) );
+
+	SECTION( "Skipped" )
+	{
+		Vec3f const ambient{ 0.05f, 0.05f, 0.05f };
+		terrain.setUniform( "uSceneAmbient", ambient );
+		terrain.setUniform( "uSceneAmbient", ambient );
+		REQUIRE( 1 == terrain.uniformStats().issued );
+		REQUIRE( 1 == terrain.uniformStats().skipped );
+
+		// Set on the program, not the one in use
+		Vec3f value{};
+		glGetUniformfv( terrain.programId(), ambientLocation, &value.x );
+		REQUIRE( 0.05f == value.y );
+
+		terrain.setUniform( "uSceneAmbient", Vec3f{ 0.1f, 0.05f, 0.05f } );
+		REQUIRE( 2 == terrain.uniformStats().issued );
+
+		// Unknown names cost nothing
+		terrain.setUniform( "uNotThere", ambient );
+		REQUIRE( 2 == terrain.uniformStats().issued );
+		REQUIRE( 1 == terrain.uniformStats().skipped );
+	}
+
+	SECTION( "Arrays" )
+	{
+		ShaderProgram material( {
+			{ GL_VERTEX_SHADER, "main-test/instancedProbe.vert", { { "MAX_INSTANCES", "2" } } },
+			{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag" }
+		} );
+
+		// "name" and "name[0]" are the same uniform
+		REQUIRE( -1 != material.uniformLocation( "uProjCameraWorld" ) );
+		REQUIRE( material.uniformLocation( "uProjCameraWorld[0]" ) == material.uniformLocation( "uProjCameraWorld" ) );
+
+		std::array<std::array<float, 3>, 2> translations{ { { 1.f, 2.f, 3.f }, { 4.f, 5.f, 6.f } } };
+		material.setUniform( "uModelTransform", translations.data(), 2 );
+		material.setUniform( "uModelTransform", translations.data(), 2 );
+		REQUIRE( 1 == material.uniformStats().skipped );
+
+		// Changing the second element only is still a change
+		translations[1][2] = 7.f;
+		material.setUniform( "uModelTransform", translations.data(), 2 );
+		REQUIRE( 2 == material.uniformStats().issued );
+
+		float second[3]{};
+		glGetUniformfv( material.programId(), glGetUniformLocation( material.programId(), "uModelTransform[1]" ), second );
+		REQUIRE( 7.f == second[2] );
+
+		Mat44f const transforms[2] = { kIdentity44f, kIdentity44f };
+		material.setUniform( "uProjCameraWorld", transforms, 2 );
+		REQUIRE( 3 == material.uniformStats().issued );
+	}
+
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
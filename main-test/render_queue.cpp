@@ -0,0 +1,198 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "../main/RenderQueue.hpp"
+
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+// The same order as a stable comparison sort, ties in submission order
+TEST_CASE( "Render queue radix sort", "[render]" )
+{
+	std::mt19937_64 random( 48 );
+
+	for( std::size_t count : { 0, 1, 2, 100, 5000 } )
+	{
+		std::vector<RenderQueue::SortItem> items( count );
+		for( std::uint32_t i = 0; i < count; ++i )
+		{
+			// Few distinct keys, so that there are ties; some bytes all equal
+			std::uint64_t const key = (random() % 16) << 56 | (random() % 4) << 20 | 0xabcd00;
+			items[i] = { key, i };
+		}
+
+		auto expected = items;
+		std::ranges::stable_sort( expected, {}, &RenderQueue::SortItem::key );
+
+		std::vector<RenderQueue::SortItem> scratch;
+		RenderQueue::RadixSort( items, scratch );
+
+		REQUIRE( items.size() == expected.size() );
+		for( std::size_t i = 0; i < items.size(); ++i )
+		{
+			REQUIRE( items[i].key == expected[i].key );
+			REQUIRE( items[i].packet == expected[i].packet );
+		}
+	}
+}
+
+TEST_CASE( "Render keys order passes, state and depth", "[render]" )
+{
+	RenderPacket opaque{ .vertexArray = 5, .texture = 2 };
+	RenderPacket otherTexture{ .vertexArray = 1, .texture = 3 };
+	RenderPacket blended{ .pass = RenderPass::Blended, .vertexArray = 5 };
+	RenderPacket overlay{ .pass = RenderPass::Overlay };
+
+	auto const key = &RenderQueue::MakeKey;
+
+	// Passes first, whatever the depth
+	REQUIRE( key( opaque, 1.f, 9 ) < key( blended, 0.f, 0 ) );
+	REQUIRE( key( blended, 0.f, 9 ) < key( overlay, 0.f, 0 ) );
+
+	// Opaque: state, then front to back
+	REQUIRE( key( opaque, 0.2f, 0 ) < key( opaque, 0.3f, 0 ) );
+	REQUIRE( key( opaque, 0.9f, 0 ) < key( otherTexture, 0.1f, 0 ) );
+
+	// Blended: back to front, before state
+	REQUIRE( key( blended, 0.3f, 0 ) < key( blended, 0.2f, 0 ) );
+
+	// Overlay: submission order
+	REQUIRE( key( overlay, 0.9f, 1 ) < key( overlay, 0.1f, 2 ) );
+
+	// Beyond the far distance is as far as it goes
+	REQUIRE( key( opaque, 7.f, 0 ) == key( opaque, 1.f, 0 ) );
+}
+
+// Packets submitted interleaved are drawn grouped by program and texture,
+// each switch made once, and the opaque state is left behind
+TEST_CASE( "Render queue groups draws by state", "[render][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	ShaderProgram programs[2] = {
+		ShaderProgram( { { GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" }, { GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" } } ),
+		ShaderProgram( { { GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" }, { GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" } } )
+	};
+	GLuint textures[2];
+	glGenTextures( 2, textures );
+
+	// Ordered by program name, then texture name
+	auto const programOrder = programs[0].programId() < programs[1].programId() ? 0 : 1;
+	auto const textureOrder = textures[0] < textures[1] ? 0 : 1;
+
+	std::vector<int> drawn;
+	RenderQueue queue;
+	queue.BeginView( { 0.f, 0.f, 0.f }, 100.f );
+
+	struct Draw_ { int program, texture; float distance; };
+	Draw_ const draws[] = { { 0, 0, 50.f }, { 1, 1, 0.f }, { 0, 1, 0.f }, { 1, 0, 0.f }, { 0, 0, 10.f } };
+
+	// Blended, and submitted first: drawn after all of the opaque ones
+	queue.Submit( {
+		.pass = RenderPass::Blended,
+		.program = &programs[programOrder],
+		.draw = [&] { drawn.push_back( -1 ); }
+	} );
+
+	for( int i = 0; i < 5; ++i )
+	{
+		queue.Submit( {
+			.program = &programs[draws[i].program],
+			.texture = textures[draws[i].texture],
+			.position = { 0.f, 0.f, draws[i].distance },
+			.draw = [&drawn, i] { drawn.push_back( i ); }
+		} );
+	}
+
+	queue.Flush();
+
+	auto const rank = [&] ( int aDraw ) {
+		Draw_ const& draw = draws[aDraw];
+		return std::tuple( draw.program != programOrder, draw.texture != textureOrder, draw.distance );
+	};
+
+	REQUIRE( 6 == drawn.size() );
+	REQUIRE( -1 == drawn.back() );
+	REQUIRE( std::ranges::is_sorted( drawn.begin(), drawn.end() - 1, {}, rank ) );
+
+	// Nearer first among the same state
+	REQUIRE( std::ranges::find( drawn, 4 ) < std::ranges::find( drawn, 0 ) );
+
+	// Two programs, two textures each; the blended packet goes back to the
+	// first program
+	auto const& stats = queue.GetStats();
+	REQUIRE( 6 == stats.packets );
+	REQUIRE( 3 == stats.programSwitches );
+	REQUIRE( 4 == stats.textureSwitches );
+
+	REQUIRE( GL_TRUE == glIsEnabled( GL_DEPTH_TEST ) );
+	REQUIRE( GL_FALSE == glIsEnabled( GL_BLEND ) );
+
+	GLboolean depthMask = GL_FALSE;
+	glGetBooleanv( GL_DEPTH_WRITEMASK, &depthMask );
+	REQUIRE( GL_TRUE == depthMask );
+
+	glDeleteTextures( 2, textures );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
+
+// A draw() that binds state of its own doesn't make the next packet skip
+// binding its own
+TEST_CASE( "Render queue rebinds after a draw binds its own state", "[render][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	ShaderProgram programs[2] = {
+		ShaderProgram( { { GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" }, { GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" } } ),
+		ShaderProgram( { { GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" }, { GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" } } )
+	};
+	GLuint textures[2];
+	glGenTextures( 2, textures );
+
+	GLint program = 0, texture = 0;
+	RenderQueue queue;
+	queue.BeginView( { 0.f, 0.f, 0.f }, 100.f );
+
+	// Same program and texture, the first drawn first (nearer)
+	queue.Submit( {
+		.program = &programs[0],
+		.texture = textures[0],
+		.position = { 0.f, 0.f, 1.f },
+		.draw = [&] {
+			glUseProgram( programs[1].programId() );
+			glBindTexture( GL_TEXTURE_2D, textures[1] );
+		}
+	} );
+	queue.Submit( {
+		.program = &programs[0],
+		.texture = textures[0],
+		.position = { 0.f, 0.f, 2.f },
+		.draw = [&] {
+			glGetIntegerv( GL_CURRENT_PROGRAM, &program );
+			glGetIntegerv( GL_TEXTURE_BINDING_2D, &texture );
+		}
+	} );
+
+	queue.Flush();
+
+	REQUIRE( GLint(programs[0].programId()) == program );
+	REQUIRE( GLint(textures[0]) == texture );
+
+	// Between the packets, nothing changed
+	auto const& stats = queue.GetStats();
+	REQUIRE( 1 == stats.programSwitches );
+	REQUIRE( 1 == stats.textureSwitches );
+
+	glDeleteTextures( 2, textures );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
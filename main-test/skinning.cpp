@@ -0,0 +1,258 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../main/ShapeObject.hpp"
+#include "../main/Skinning.hpp"
+
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr float kHalfPi_ = 1.5707964f;
+
+	Vec3f transform_point_( Mat44f const& aM, Vec3f aP )
+	{
+		Vec4f const r = aM * Vec4f{ aP.x, aP.y, aP.z, 1.f };
+		return { r.x, r.y, r.z };
+	}
+
+	// A random tree: each joint hangs off an earlier one
+	Skeleton make_skeleton_( std::size_t aJoints, std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> offset( -1.f, 1.f );
+
+		Skeleton skeleton;
+		skeleton.AddJoint( Skeleton::kNoParent, Transform{} );
+		for( std::size_t i = 1; i < aJoints; ++i )
+		{
+			Skeleton::JointID const parent = std::uniform_int_distribution<std::size_t>( 0, i - 1 )( aRng );
+			skeleton.AddJoint( parent, Transform{ .mPosition{ offset( aRng ), offset( aRng ), offset( aRng ) } } );
+		}
+		return skeleton;
+	}
+
+	std::vector<Transform> random_pose_( Skeleton const& aSkeleton, std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> angle( -1.f, 1.f );
+
+		std::vector<Transform> pose( aSkeleton.BindPose().begin(), aSkeleton.BindPose().end() );
+		for( auto& joint : pose )
+			joint.mRotation = { angle( aRng ), angle( aRng ), angle( aRng ) };
+		return pose;
+	}
+
+	std::vector<VertexSkin> random_skin_( std::size_t aVertices, std::size_t aJoints, std::mt19937& aRng )
+	{
+		std::uniform_int_distribution<int> joint( 0, int(aJoints) - 1 );
+		std::uniform_real_distribution<float> weight( 0.f, 1.f );
+
+		std::vector<VertexSkin> skin( aVertices );
+		for( auto& s : skin )
+		{
+			float sum = 0.f;
+			for( int k = 0; k < 4; ++k )
+			{
+				s.mJoints[k] = std::uint8_t(joint( aRng ));
+				s.mWeights[k] = weight( aRng );
+				sum += s.mWeights[k];
+			}
+			s.mWeights = s.mWeights / sum;
+		}
+		return skin;
+	}
+}
+
+TEST_CASE( "Skeleton pose evaluation", "[skinning]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	// A chain: root at the origin, an elbow one up, a hand one further
+	Skeleton skeleton;
+	auto const root = skeleton.AddJoint( Skeleton::kNoParent, Transform{} );
+	auto const elbow = skeleton.AddJoint( root, Transform{ .mPosition{ 0.f, 1.f, 0.f } } );
+	auto const hand = skeleton.AddJoint( elbow, Transform{ .mPosition{ 0.f, 1.f, 0.f } } );
+
+	REQUIRE( 3 == skeleton.JointCount() );
+	REQUIRE( elbow == skeleton.Parent( hand ) );
+
+	std::vector<Mat44f> palette( 3 );
+
+	SECTION( "The bind pose gives identities" )
+	{
+		skeleton.EvaluatePose( skeleton.BindPose(), palette );
+		for( auto const& m : palette )
+			for( int i = 0; i < 16; ++i )
+				REQUIRE_THAT( m.v[i], WithinAbs( kIdentity44f.v[i], 1e-6 ) );
+	}
+
+	SECTION( "Children follow their parents" )
+	{
+		// Bend the elbow 90 degrees about z: the hand swings from (0,2,0)
+		// to (-1,1,0)
+		std::vector<Transform> pose( skeleton.BindPose().begin(), skeleton.BindPose().end() );
+		pose[elbow].mRotation.z = kHalfPi_;
+		skeleton.EvaluatePose( pose, palette );
+
+		Vec3f const atHand = transform_point_( palette[hand], { 0.f, 2.f, 0.f } );
+		REQUIRE_THAT( atHand.x, WithinAbs( -1.f, 1e-5 ) );
+		REQUIRE_THAT( atHand.y, WithinAbs( 1.f, 1e-5 ) );
+
+		// The elbow itself doesn't move
+		Vec3f const atElbow = transform_point_( palette[elbow], { 0.f, 1.f, 0.f } );
+		REQUIRE_THAT( atElbow.x, WithinAbs( 0.f, 1e-5 ) );
+		REQUIRE_THAT( atElbow.y, WithinAbs( 1.f, 1e-5 ) );
+
+		// Moving the root moves everything
+		pose[root].mPosition = { 5.f, 0.f, 0.f };
+		skeleton.EvaluatePose( pose, palette );
+		Vec3f const moved = transform_point_( palette[hand], { 0.f, 2.f, 0.f } );
+		REQUIRE_THAT( moved.x, WithinAbs( 4.f, 1e-5 ) );
+		REQUIRE_THAT( moved.y, WithinAbs( 1.f, 1e-5 ) );
+	}
+}
+
+TEST_CASE( "CPU skinning matches the reference", "[skinning]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	std::mt19937 rng( 1234 );
+	Skeleton const skeleton = make_skeleton_( 64, rng );
+
+	std::vector<Mat44f> palette( skeleton.JointCount() );
+	skeleton.EvaluatePose( random_pose_( skeleton, rng ), palette );
+
+	// Odd count, so that the vectorized loop has a remainder
+	constexpr std::size_t kVertices = 1001;
+	std::uniform_real_distribution<float> coordinate( -2.f, 2.f );
+	std::vector<Vec3f> positions, normals;
+	for( std::size_t i = 0; i < kVertices; ++i )
+	{
+		positions.push_back( { coordinate( rng ), coordinate( rng ), coordinate( rng ) } );
+		normals.push_back( normalize( Vec3f{ coordinate( rng ), coordinate( rng ), coordinate( rng ) } ) );
+	}
+
+	std::vector<VertexSkin> skin = random_skin_( kVertices, skeleton.JointCount(), rng );
+	skin[0] = RigidSkin( 7 );
+
+	std::vector<std::uint32_t> joints;
+	std::vector<Vec4f> weights;
+	for( auto const& s : skin )
+	{
+		joints.push_back( PackJoints( s ) );
+		weights.push_back( s.mWeights );
+	}
+
+	std::vector<Vec3f> outPositions( kVertices ), outNormals( kVertices );
+	SkinVertices( palette, positions, normals, joints, weights, outPositions, outNormals );
+
+	for( std::size_t i = 0; i < kVertices; ++i )
+	{
+		INFO( "vertex " << i );
+
+		// Blend the transformed points rather than the matrices
+		Vec3f position{ 0.f, 0.f, 0.f };
+		Vec3f normal{ 0.f, 0.f, 0.f };
+		for( int k = 0; k < 4; ++k )
+		{
+			Mat44f const& m = palette[skin[i].mJoints[k]];
+			position += skin[i].mWeights[k] * transform_point_( m, positions[i] );
+
+			Vec4f const n = m * Vec4f{ normals[i].x, normals[i].y, normals[i].z, 0.f };
+			normal += skin[i].mWeights[k] * Vec3f{ n.x, n.y, n.z };
+		}
+
+		for( int axis = 0; axis < 3; ++axis )
+		{
+			REQUIRE_THAT( outPositions[i][axis], WithinAbs( position[axis], 1e-4 ) );
+			REQUIRE_THAT( outNormals[i][axis], WithinAbs( normal[axis], 1e-4 ) );
+		}
+	}
+
+	// Rigid vertices are exactly their joint's transform
+	Vec3f const rigid = transform_point_( palette[7], positions[0] );
+	for( int axis = 0; axis < 3; ++axis )
+		REQUIRE_THAT( outPositions[0][axis], WithinAbs( rigid[axis], 1e-5 ) );
+}
+
+// Runs the real skinned.vert through transform feedback, and compares the
+// GPU backend's output with the CPU backend's
+TEST_CASE( "GPU skinning matches CPU skinning", "[skinning][gpu]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	std::mt19937 rng( 99 );
+	Skeleton const skeleton = make_skeleton_( 32, rng );
+
+	ModelObject const model = MakeCylinder( true, 64, Transform{ .mScale{ 2.f, 0.5f, 0.5f } }, ShapeMaterial{ { 1.f, 1.f, 1.f }, { 0.5f, 0.5f, 0.5f }, 10.f } );
+	std::vector<VertexSkin> const skin = random_skin_( model.Vertices().size(), skeleton.JointCount(), rng );
+
+	SkinnedModel cpu( model, skin, skeleton.JointCount(), SkinningBackend::Cpu );
+	SkinnedModel gpu( model, skin, skeleton.JointCount(), SkinningBackend::Gpu );
+
+	std::vector<Mat44f> palette( skeleton.JointCount() );
+	skeleton.EvaluatePose( random_pose_( skeleton, rng ), palette );
+	cpu.Update( palette );
+	gpu.Update( palette );
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/skinned.vert" },
+		{ GL_VERTEX_SHADER, "assets/cw2/skinning.glsl" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag" }
+	} );
+
+	// Capture the world positions and normals
+	char const* varyings[] = { "v2fPosition", "v2fNormal" };
+	glTransformFeedbackVaryings( program.programId(), 2, varyings, GL_INTERLEAVED_ATTRIBS );
+	glLinkProgram( program.programId() );
+	GLint linked = 0;
+	glGetProgramiv( program.programId(), GL_LINK_STATUS, &linked );
+	REQUIRE( GL_TRUE == linked );
+
+	std::size_t const count = model.Vertices().size();
+	GLuint captured = 0;
+	glGenBuffers( 1, &captured );
+	glBindBuffer( GL_TRANSFORM_FEEDBACK_BUFFER, captured );
+	glBufferData( GL_TRANSFORM_FEEDBACK_BUFFER, 2 * count * sizeof(Vec3f), nullptr, GL_STATIC_READ );
+
+	glUseProgram( program.programId() );
+	glUniformMatrix4fv( 0, 1, GL_TRUE, kIdentity44f.v );
+	glUniformMatrix4fv( 1, 1, GL_TRUE, kIdentity44f.v );
+
+	glEnable( GL_RASTERIZER_DISCARD );
+	glBindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, 0, captured );
+	glBeginTransformFeedback( GL_TRIANGLES );
+	gpu.Draw();
+	glEndTransformFeedback();
+	glDisable( GL_RASTERIZER_DISCARD );
+
+	std::vector<Vec3f> result( 2 * count );
+	glGetBufferSubData( GL_TRANSFORM_FEEDBACK_BUFFER, 0, result.size() * sizeof(Vec3f), result.data() );
+	glDeleteBuffers( 1, &captured );
+	glBindVertexArray( 0 );
+	glUseProgram( 0 );
+
+	auto const positions = cpu.SkinnedPositions();
+	auto const normals = cpu.SkinnedNormals();
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		INFO( "vertex " << i );
+
+		Vec3f const normal = normalize( normals[i] );
+		for( int axis = 0; axis < 3; ++axis )
+		{
+			REQUIRE_THAT( result[2 * i][axis], WithinAbs( positions[i][axis], 1e-3 ) );
+			REQUIRE_THAT( result[2 * i + 1][axis], WithinAbs( normal[axis], 1e-3 ) );
+		}
+	}
+}
@@ -0,0 +1,555 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../main/FontRegistry.hpp"
+#include "../main/SdfGlyphAtlas.hpp"
+#include "../main/fontstashbackend.hpp"
+
+#include "../support/error.hpp"
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr GLsizei kWidth_ = 256;
+	constexpr GLsizei kHeight_ = 128;
+
+	// An offscreen target to draw text into
+	struct Target_
+	{
+		GLuint fbo = 0;
+		GLuint colour = 0;
+
+		Target_()
+		{
+			glGenTextures( 1, &colour );
+			glBindTexture( GL_TEXTURE_2D, colour );
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, kWidth_, kHeight_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+			glBindTexture( GL_TEXTURE_2D, 0 );
+
+			glGenFramebuffers( 1, &fbo );
+			glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+			glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0 );
+			glViewport( 0, 0, kWidth_, kHeight_ );
+		}
+
+		// Sum of the alpha channel
+		double coverage() const
+		{
+			double sum = 0.0;
+			auto const pixels = read();
+			for( std::size_t i = 3; i < pixels.size(); i += 4 )
+				sum += pixels[i] / 255.0;
+			return sum;
+		}
+
+		~Target_()
+		{
+			glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+			glDeleteFramebuffers( 1, &fbo );
+			glDeleteTextures( 1, &colour );
+		}
+
+		void clear() const
+		{
+			glClearColor( 0.f, 0.f, 0.f, 0.f );
+			glClear( GL_COLOR_BUFFER_BIT );
+		}
+
+		std::vector<std::uint8_t> read() const
+		{
+			std::vector<std::uint8_t> pixels( std::size_t(kWidth_) * kHeight_ * 4 );
+			glReadPixels( 0, 0, kWidth_, kHeight_, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data() );
+			return pixels;
+		}
+	};
+}
+
+// fonsDrawText() only appends to the backend's ring; each frame is one draw,
+// and the ring is reused (round all its segments) without new allocations
+TEST_CASE( "Streamed text is drawn once per frame", "[text][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	Target_ target;
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" }
+	} );
+	glUseProgram( program.programId() );
+	glUniform2f( glGetUniformLocation( program.programId(), "uViewPortDimensions" ), float(kWidth_), float(kHeight_) );
+
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	PITBFonsContext* backend = nullptr;
+	FONScontext* fs = CreateFons( 512, 512, FONS_ZERO_TOPLEFT, &backend );
+	REQUIRE( backend );
+
+	int const font = fonsAddFont( fs, "droid", "assets/cw2/DroidSansMonoDotted.ttf" );
+	REQUIRE( FONS_INVALID != font );
+
+	auto const frame = [&] ( int aLines ) {
+		target.clear();
+
+		fonsClearState( fs );
+		fonsSetFont( fs, font );
+		fonsSetSize( fs, 12.f );
+		fonsSetColor( fs, FonsRGBA( 255, 255, 255, 255 ) );
+
+		// Each string is its own fontstash flush
+		for( int i = 0; i < aLines; ++i )
+			fonsDrawText( fs, float(i % 4) * 64.f, 12.f + float(i / 4 % 10) * 12.f, "Text 0123", nullptr );
+
+		FonsFlushFrame( backend );
+		return target.read();
+	};
+
+	std::vector<std::uint8_t> const reference = frame( 40 );
+	REQUIRE( std::any_of( reference.begin(), reference.end(), [] ( std::uint8_t a ) { return a != 0; } ) );
+
+	// Twice round the ring
+	PITBFonsStats const before = backend->stats;
+	for( std::size_t i = 0; i < 2 * kFonsRingSegments; ++i )
+	{
+		INFO( "frame " << i );
+		REQUIRE( reference == frame( 40 ) );
+	}
+	PITBFonsStats const after = backend->stats;
+
+	REQUIRE( 2 * kFonsRingSegments == after.draws - before.draws );
+	REQUIRE( 1 == after.bufferAllocations );
+	if( backend->mapped )
+		REQUIRE( 0 == after.uploads );
+	else
+		REQUIRE( 2 * kFonsRingSegments == after.uploads - before.uploads );
+
+	// More than a segment in one frame: drawn early, then the segment is
+	// reused once the GPU is done with it
+	std::size_t const lines = kFonsSegmentVertices / (6 * 9) + 10;
+	std::size_t const draws = backend->stats.draws;
+	frame( int(lines) );
+	REQUIRE( 2 == backend->stats.draws - draws );
+	REQUIRE( GL_NO_ERROR == glGetError() );
+
+	// The same text as before once it fits again
+	REQUIRE( reference == frame( 40 ) );
+
+	DeleteFons( fs );
+	glUseProgram( 0 );
+	glDisable( GL_BLEND );
+}
+
+// A small atlas grows (and, at its largest, is emptied) in the middle of a
+// frame; what was streamed before is drawn from the texture it was laid out
+// for, so the frame looks the same as with an atlas big enough to start with
+TEST_CASE( "Streamed text survives the atlas growing and resetting", "[text][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	Target_ target;
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" }
+	} );
+	glUseProgram( program.programId() );
+	glUniform2f( glGetUniformLocation( program.programId(), "uViewPortDimensions" ), float(kWidth_), float(kHeight_) );
+
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	FontRegistry fonts;
+	auto const data = fonts.Data( fonts.Load( "assets/cw2/DroidSansMonoDotted.ttf" ) );
+
+	auto const frame = [&] ( int aSize, int aMaxSize, PITBFonsStats& aStats ) {
+		PITBFonsContext* backend = nullptr;
+		FONScontext* fs = CreateFons( aSize, aSize, FONS_ZERO_TOPLEFT, &backend, aMaxSize );
+		int const font = fonsAddFontMem( fs, "droid", const_cast<unsigned char*>(data.data()), int(data.size()), 0 );
+		REQUIRE( FONS_INVALID != font );
+
+		target.clear();
+		fonsClearState( fs );
+		fonsSetFont( fs, font );
+		fonsSetColor( fs, FonsRGBA( 255, 255, 255, 255 ) );
+		for( int i = 0; i < 6; ++i )
+		{
+			fonsSetSize( fs, 14.f + 4.f * float(i) );
+			fonsDrawText( fs, 2.f, 20.f * float(i + 1), "Aggregate 0123", nullptr );
+		}
+		FonsFlushFrame( backend );
+
+		aStats = backend->stats;
+		auto const pixels = target.read();
+		DeleteFons( fs );
+		return pixels;
+	};
+
+	PITBFonsStats roomy, growing, resetting;
+	auto const reference = frame( 1024, 1024, roomy );
+	REQUIRE( 0 == roomy.atlasGrowths );
+	REQUIRE( 0 == roomy.atlasResets );
+
+	REQUIRE( reference == frame( 64, 1024, growing ) );
+	REQUIRE( growing.atlasGrowths > 0 );
+	REQUIRE( 0 == growing.atlasResets );
+
+	REQUIRE( reference == frame( 128, 128, resetting ) );
+	REQUIRE( 0 == resetting.atlasGrowths );
+	REQUIRE( resetting.atlasResets > 0 );
+
+	REQUIRE( GL_NO_ERROR == glGetError() );
+	glUseProgram( 0 );
+	glDisable( GL_BLEND );
+}
+
+TEST_CASE( "Font files are mapped once", "[text]" )
+{
+	FontRegistry fonts;
+
+	FontRegistry::FontID const font = fonts.Load( "assets/cw2/DroidSansMonoDotted.ttf" );
+	REQUIRE( font == fonts.Load( "./assets/cw2/DroidSansMonoDotted.ttf" ) );
+	REQUIRE( font == fonts.Load( "assets/cw2/../cw2/DroidSansMonoDotted.ttf" ) );
+	REQUIRE( 1 == fonts.FontCount() );
+
+	// A TrueType file, in place
+	auto const data = fonts.Data( font );
+	REQUIRE( data.size() == fonts.MappedBytes() );
+	REQUIRE( data.size() > 4 );
+	REQUIRE( 0 == data[0] );
+	REQUIRE( 1 == data[1] );
+
+	REQUIRE_THROWS_AS( fonts.Load( "assets/cw2/no-such-font.ttf" ), Error );
+	REQUIRE( 1 == fonts.FontCount() );
+}
+
+TEST_CASE( "Distance field glyphs are laid out like fontstash's", "[text][gpu]" )
+{
+	using Catch::Matchers::WithinAbs;
+
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	char const* const path = "assets/cw2/DroidSansMonoDotted.ttf";
+	char const* const text = "Spaceship height: 12.34";
+
+	FontRegistry fonts;
+	std::vector<unsigned char> const garbage( 64, 0 );
+
+	SdfGlyphAtlas atlas;
+	SdfGlyphAtlas::FontID const sdfFont = atlas.AddFont( fonts.Data( fonts.Load( path ) ) );
+	REQUIRE( SdfGlyphAtlas::kInvalidFont != sdfFont );
+	REQUIRE( SdfGlyphAtlas::kInvalidFont == atlas.AddFont( garbage ) );
+
+	FONScontext* fs = CreateFons( 512, 512, FONS_ZERO_TOPLEFT );
+	int const fonsFont = fonsAddFont( fs, "droid", path );
+	REQUIRE( FONS_INVALID != fonsFont );
+
+	std::size_t rasterized = 0;
+	for( float const size : { 12.f, 24.f, 40.f } )
+	{
+		for( int const align : { FONS_ALIGN_LEFT | FONS_ALIGN_BASELINE, FONS_ALIGN_CENTER | FONS_ALIGN_TOP, FONS_ALIGN_RIGHT | FONS_ALIGN_MIDDLE } )
+		{
+			INFO( "size " << size << ", align " << align );
+
+			fonsClearState( fs );
+			fonsSetFont( fs, fonsFont );
+			fonsSetSize( fs, size );
+			fonsSetAlign( fs, align );
+
+			// fontstash's quads, leaving out the spaces (which are blank)
+			std::vector<FONSquad> expected;
+			FONStextIter iter;
+			FONSquad q;
+			fonsTextIterInit( fs, &iter, 100.f, 50.f, text, nullptr );
+			while( fonsTextIterNext( fs, &iter, &q ) )
+			{
+				if( ' ' != iter.codepoint )
+					expected.push_back( q );
+			}
+
+			std::vector<PITBFonsVertex> quads;
+			float const end = atlas.LayOut( sdfFont, text, 100.f, 50.f, size, align, 0xffffffff, quads );
+			REQUIRE( quads.size() == 6 * expected.size() );
+
+			for( std::size_t i = 0; i < expected.size(); ++i )
+			{
+				INFO( "glyph " << i );
+
+				// The same glyph centres. fontstash rounds each advance to a
+				// whole pixel, so allow for that to add up along the line (and,
+				// when aligned by the line's width, along all of it).
+				PITBFonsVertex const& topLeft = quads[6 * i];
+				PITBFonsVertex const& bottomRight = quads[6 * i + 1];
+				float const slack = 1.5f + 0.5f * float(align & FONS_ALIGN_LEFT ? i : std::strlen( text ));
+
+				REQUIRE_THAT( 0.5f * (topLeft.x + bottomRight.x), WithinAbs( 0.5f * (expected[i].x0 + expected[i].x1), slack ) );
+				REQUIRE_THAT( 0.5f * (topLeft.y + bottomRight.y), WithinAbs( 0.5f * (expected[i].y0 + expected[i].y1), 1.5f ) );
+			}
+
+			if( align & FONS_ALIGN_LEFT )
+				REQUIRE_THAT( end, WithinAbs( fonsTextBounds( fs, 100.f, 50.f, text, nullptr, nullptr ) + 100.f, 0.5f * std::strlen( text ) ) );
+		}
+
+		// Every size after the first reuses the same glyphs
+		if( 0 == rasterized )
+			rasterized = atlas.Stats().glyphsRasterized;
+		REQUIRE( rasterized == atlas.Stats().glyphsRasterized );
+	}
+
+	DeleteFons( fs );
+}
+
+// Drawn with fontShader.frag, distance field glyphs cover about as much as
+// fontstash's bitmaps at the same size, small or large
+TEST_CASE( "Distance field glyphs render at any size", "[text][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	Target_ target;
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" }
+	} );
+	glUseProgram( program.programId() );
+	glUniform2f( glGetUniformLocation( program.programId(), "uViewPortDimensions" ), float(kWidth_), float(kHeight_) );
+	GLint const distanceField = glGetUniformLocation( program.programId(), "uDistanceField" );
+
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	char const* const path = "assets/cw2/DroidSansMonoDotted.ttf";
+
+	PITBFonsContext* backend = nullptr;
+	FONScontext* fs = CreateFons( 512, 512, FONS_ZERO_TOPLEFT, &backend );
+	int const fonsFont = fonsAddFont( fs, "droid", path );
+
+	FontRegistry fonts;
+	SdfGlyphAtlas atlas;
+	SdfGlyphAtlas::FontID const sdfFont = atlas.AddFont( fonts.Data( fonts.Load( path ) ) );
+
+	GLuint vao = 0, vbo = 0;
+	glGenVertexArrays( 1, &vao );
+	glGenBuffers( 1, &vbo );
+	glBindVertexArray( vao );
+	glBindBuffer( GL_ARRAY_BUFFER, vbo );
+	glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, x)) );
+	glVertexAttribPointer( 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, colour)) );
+	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, s)) );
+	for( GLuint i = 0; i < 3; ++i )
+		glEnableVertexAttribArray( i );
+
+	for( float const size : { 10.f, 20.f, 48.f, 96.f } )
+	{
+		INFO( "size " << size );
+
+		char const* const text = size > 50.f ? "Ag" : "Aggregate";
+
+		// fontstash, rasterized at this size
+		target.clear();
+		glUniform1i( distanceField, 0 );
+		fonsClearState( fs );
+		fonsSetFont( fs, fonsFont );
+		fonsSetSize( fs, size );
+		fonsSetColor( fs, FonsRGBA( 255, 255, 255, 255 ) );
+		fonsDrawText( fs, 4.f, size, text, nullptr );
+		FonsFlushFrame( backend );
+		double const expected = target.coverage();
+
+		// The distance field, rasterized at kReferenceSize
+		std::vector<PITBFonsVertex> quads;
+		atlas.LayOut( sdfFont, text, 4.f, size, size, FONS_ALIGN_LEFT, 0xffffffff, quads );
+		atlas.Upload();
+
+		target.clear();
+		glUniform1i( distanceField, 1 );
+		glBindVertexArray( vao );
+		glBindBuffer( GL_ARRAY_BUFFER, vbo );
+		glBufferData( GL_ARRAY_BUFFER, quads.size() * sizeof(PITBFonsVertex), quads.data(), GL_STREAM_DRAW );
+		glBindTexture( GL_TEXTURE_2D, atlas.Texture() );
+		glDrawArrays( GL_TRIANGLES, 0, GLsizei(quads.size()) );
+		double const actual = target.coverage();
+
+		REQUIRE( expected > 0.0 );
+		// Small sizes come out slightly bolder, as the field is minified
+		REQUIRE( actual > 0.8 * expected );
+		REQUIRE( actual < 1.3 * expected );
+	}
+
+	glDeleteBuffers( 1, &vbo );
+	glDeleteVertexArrays( 1, &vao );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	DeleteFons( fs );
+	glUseProgram( 0 );
+	glDisable( GL_BLEND );
+}
+
+// The atlas doubles while it can, without moving glyphs; at its largest, new
+// glyphs take the place of the least recently used ones, but never of ones
+// used in the same frame
+TEST_CASE( "Distance field atlas grows, then evicts least recently used glyphs", "[text][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	FontRegistry fonts;
+
+	// Four cells, then sixteen
+	int const cell = SdfGlyphAtlas::kCellSize;
+	SdfGlyphAtlas atlas( 2 * cell, 4 * cell );
+	SdfGlyphAtlas::FontID const font = atlas.AddFont( fonts.Data( fonts.Load( "assets/cw2/DroidSansMonoDotted.ttf" ) ) );
+
+	auto const layOut = [&] ( std::string const& aText ) {
+		std::vector<PITBFonsVertex> quads;
+		atlas.LayOut( font, aText, 0.f, 32.f, 32.f, FONS_ALIGN_LEFT, 0xffffffff, quads );
+		return quads;
+	};
+
+	auto const first = layOut( "A" );
+	REQUIRE( 6 == first.size() );
+
+	// Texture coordinates are in texels, so still right after growing
+	REQUIRE( 12 == layOut( "AB" ).size() );
+	layOut( "CDEFGHIJ" );
+	REQUIRE( 1 == atlas.Stats().growths );
+	REQUIRE( 4 * cell == atlas.Width() );
+	REQUIRE( first[0].s == layOut( "A" )[0].s );
+	REQUIRE( first[0].t == layOut( "A" )[0].t );
+
+	layOut( "KLMNOP" );
+	REQUIRE( 16 == atlas.GlyphCount() );
+	REQUIRE( 0 == atlas.Stats().evictions );
+	REQUIRE( 0 == atlas.Generation() );
+
+	// A full atlas, but all of it used this frame: the new glyph is dropped
+	REQUIRE( layOut( "Q" ).empty() );
+	REQUIRE( 1 == atlas.Stats().dropped );
+	REQUIRE( 0 == atlas.Stats().evictions );
+
+	// One glyph a frame, so that "A" is the least recently used, then "B"
+	for( char const glyph : std::string( "ABCDEFGHIJKLMNOP" ) )
+	{
+		atlas.BeginFrame();
+		layOut( std::string( 1, glyph ) );
+	}
+
+	atlas.BeginFrame();
+	REQUIRE( 6 == layOut( "Q" ).size() );
+	REQUIRE( 1 == atlas.Stats().evictions );
+	REQUIRE( 1 == atlas.Generation() );
+	REQUIRE( 16 == atlas.GlyphCount() );
+
+	// "B" is still there; "A" comes back in the place of "C", the oldest
+	// now that "B" was used again
+	std::size_t const rasterized = atlas.Stats().glyphsRasterized;
+	layOut( "B" );
+	REQUIRE( rasterized == atlas.Stats().glyphsRasterized );
+	layOut( "A" );
+	REQUIRE( rasterized + 1 == atlas.Stats().glyphsRasterized );
+	REQUIRE( 2 == atlas.Stats().evictions );
+	layOut( "DEFGHIJKLMNOP" );
+	REQUIRE( rasterized + 1 == atlas.Stats().glyphsRasterized );
+	layOut( "C" );
+	REQUIRE( rasterized + 2 == atlas.Stats().glyphsRasterized );
+	REQUIRE( 2 == atlas.Stats().dropped );
+
+	// Grown once, not past the largest size
+	REQUIRE( 1 == atlas.Stats().growths );
+	REQUIRE( std::size_t(2 * 16 * cell * cell) == atlas.MemoryBytes() );
+
+	atlas.Upload();
+	REQUIRE( GL_NO_ERROR == glGetError() );
+}
+
+// A baked atlas lays out exactly like the atlas it was baked from, without
+// rasterizing anything it has; what it left out is rasterized as before. No
+// GL: baking and loading don't touch the texture.
+TEST_CASE( "Baked distance field atlas", "[text]" )
+{
+	FontRegistry fonts;
+	auto const data = fonts.Data( fonts.Load( "assets/cw2/DroidSansMonoDotted.ttf" ) );
+	std::string const path = (std::filesystem::temp_directory_path() / "main-test-text.sdfatlas").string();
+
+	auto const layOut = [] ( SdfGlyphAtlas& aAtlas, SdfGlyphAtlas::FontID aFont, std::string const& aText ) {
+		std::vector<PITBFonsVertex> quads;
+		aAtlas.LayOut( aFont, aText, 10.f, 40.f, 24.f, FONS_ALIGN_LEFT, 0xffffffff, quads );
+		return quads;
+	};
+
+	std::string const text = "Spaceship height: 12.34 meters";
+
+	SdfGlyphAtlas baker;
+	auto const bakedFont = baker.AddFont( data );
+	baker.Prepare( bakedFont, 0x20, 0x7e );
+	REQUIRE( 95 == baker.GlyphCount() );
+	REQUIRE( 0 == baker.Stats().dropped );
+	baker.SaveBaked( bakedFont, path.c_str() );
+
+	SdfGlyphAtlas atlas;
+	auto const font = atlas.AddFont( data );
+	REQUIRE( atlas.LoadBaked( font, path.c_str() ) );
+	REQUIRE( 95 == atlas.Stats().baked );
+	REQUIRE( baker.Width() == atlas.Width() );
+
+	auto const expected = layOut( baker, bakedFont, text );
+	auto const actual = layOut( atlas, font, text );
+	REQUIRE( expected.size() == actual.size() );
+	for( std::size_t i = 0; i < expected.size(); ++i )
+	{
+		INFO( "vertex " << i );
+		REQUIRE( expected[i].x == actual[i].x );
+		REQUIRE( expected[i].y == actual[i].y );
+		REQUIRE( expected[i].s == actual[i].s );
+		REQUIRE( expected[i].t == actual[i].t );
+	}
+	REQUIRE( 0 == atlas.Stats().glyphsRasterized );
+
+	// Not baked: rasterized into a free cell
+	REQUIRE( 6 == layOut( atlas, font, "\xc3\xa9" ).size() );
+	REQUIRE( 1 == atlas.Stats().glyphsRasterized );
+	REQUIRE( 96 == atlas.GlyphCount() );
+
+	// Only into an empty atlas...
+	REQUIRE_FALSE( atlas.LoadBaked( font, path.c_str() ) );
+
+	// ... and only for the font it was baked from
+	SdfGlyphAtlas other;
+	std::vector<unsigned char> modified( data.begin(), data.end() );
+	modified.back() ^= 1;
+	REQUIRE_FALSE( other.LoadBaked( other.AddFont( modified ), path.c_str() ) );
+	REQUIRE_FALSE( other.LoadBaked( other.AddFont( data ), "assets/cw2/no-such-font.sdfatlas" ) );
+	REQUIRE( 0 == other.GlyphCount() );
+
+	// Truncated
+	std::filesystem::resize_file( path, std::filesystem::file_size( path ) - 1 );
+	SdfGlyphAtlas truncated;
+	REQUIRE_FALSE( truncated.LoadBaked( truncated.AddFont( data ), path.c_str() ) );
+
+	std::filesystem::remove( path );
+}
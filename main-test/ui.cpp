@@ -0,0 +1,181 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <random>
+#include <cstdint>
+#include <vector>
+
+#include "../main/UIGroup.hpp"
+
+#include "../support/program.hpp"
+
+#include "gl_context.hpp"
+
+namespace
+{
+	constexpr GLsizei kSize_ = 64;
+
+	UIElementProperties Button_( Vec2f aPosition, Vec4f aColour )
+	{
+		return { aColour, aPosition, 0.8f, 0.8f, 0.25f };
+	}
+
+	// The pixel at aPosition (in NDC)
+	std::array<std::uint8_t, 4> Pixel_( Vec2f aPosition )
+	{
+		GLint const x = GLint((aPosition.x + 1.f) * 0.5f * kSize_);
+		GLint const y = GLint((aPosition.y + 1.f) * 0.5f * kSize_);
+
+		std::array<std::uint8_t, 4> pixel{};
+		glReadPixels( x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel.data() );
+		return pixel;
+	}
+}
+
+// Both buttons come from one draw, each in its own colour, with an opaque
+// border; hovering one rewrites only its vertices
+TEST_CASE( "UI elements are drawn in one batch", "[ui][gpu]" )
+{
+	TestGLContext context;
+	if( !context.valid() )
+		SKIP( context.description() );
+
+	INFO( "Renderer: " << context.description() );
+
+	GLuint colour = 0, fbo = 0;
+	glGenTextures( 1, &colour );
+	glBindTexture( GL_TEXTURE_2D, colour );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, kSize_, kSize_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	glGenFramebuffers( 1, &fbo );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0 );
+	glViewport( 0, 0, kSize_, kSize_ );
+
+	ShaderProgram program( {
+		{ GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" }
+	} );
+	glUseProgram( program.programId() );
+
+	UIGroup ui( {
+		UIElement( Button_( { -0.9f, -0.4f }, { 1.f, 0.f, 0.f, 1.f } ) ),
+		UIElement( Button_( { 0.1f, -0.4f }, { 0.f, 1.f, 0.f, 0.5f } ) )
+	} );
+	REQUIRE( 2 == ui.GetStats().elementsRebuilt );
+
+	auto const frame = [&] ( Vec2f aMouse ) {
+		glClearColor( 0.f, 0.f, 0.f, 0.f );
+		glClear( GL_COLOR_BUFFER_BIT );
+		ui.OnCursorMoved( aMouse );
+		ui.Draw();
+	};
+
+	Vec2f const redFill{ -0.5f, 0.f }, redBorder{ -0.8f, 0.f };
+	Vec2f const greenFill{ 0.5f, 0.f }, greenBorder{ 0.2f, 0.f };
+	Vec2f const outside{ 0.f, 0.9f };
+
+	frame( outside );
+	REQUIRE( 1 == ui.GetStats().drawCalls );
+	REQUIRE( 0 == ui.GetStats().elementsRebuilt );
+
+	REQUIRE( Pixel_( redFill ) == std::array<std::uint8_t, 4>{ 255, 0, 0, 255 } );
+	REQUIRE( Pixel_( redBorder ) == std::array<std::uint8_t, 4>{ 255, 0, 0, 255 } );
+	REQUIRE( Pixel_( greenFill ) == std::array<std::uint8_t, 4>{ 0, 255, 0, 128 } );
+	REQUIRE( Pixel_( greenBorder ) == std::array<std::uint8_t, 4>{ 0, 255, 0, 255 } );
+	REQUIRE( Pixel_( outside ) == std::array<std::uint8_t, 4>{ 0, 0, 0, 0 } );
+
+	// Hovered: half the colour (and alpha, but not on the border)
+	frame( greenFill );
+	REQUIRE( 1 == ui.GetStats().drawCalls );
+	REQUIRE( 1 == ui.GetStats().elementsRebuilt );
+	REQUIRE( ui.getElement( 1 ).Vertices().size() == ui.GetStats().verticesUploaded );
+	REQUIRE( Pixel_( greenFill ) == std::array<std::uint8_t, 4>{ 0, 128, 0, 64 } );
+	REQUIRE( Pixel_( greenBorder ) == std::array<std::uint8_t, 4>{ 0, 128, 0, 255 } );
+	REQUIRE( Pixel_( redFill ) == std::array<std::uint8_t, 4>{ 255, 0, 0, 255 } );
+
+	// Idle: nothing to write
+	ui.Draw();
+	REQUIRE( 0 == ui.GetStats().elementsRebuilt );
+
+	// Clicks go to the element under the mouse only
+	int redClicks = 0, greenClicks = 0;
+	ui.getElement( 0 ).InsertOnClickCallback( [&] { ++redClicks; } );
+	ui.getElement( 1 ).InsertOnClickCallback( [&] { ++greenClicks; } );
+
+	ui.OnMouseButton( GLFW_PRESS );
+	ui.Draw();
+	REQUIRE( 1 == ui.GetStats().elementsRebuilt );
+	REQUIRE( Pixel_( greenBorder ) == std::array<std::uint8_t, 4>{ 0, 64, 0, 255 } );
+	ui.OnMouseButton( GLFW_RELEASE );
+	REQUIRE( 0 == redClicks );
+	REQUIRE( 1 == greenClicks );
+
+	// No border now: fewer vertices, so the batch is repacked
+	ui.SetProperties( 0, { { 0.f, 0.f, 1.f, 1.f }, { -0.9f, -0.4f }, 0.8f, 0.8f, 0.f } );
+	frame( greenFill );
+	REQUIRE( 2 == ui.GetStats().elementsRebuilt );
+	REQUIRE( Pixel_( redBorder ) == std::array<std::uint8_t, 4>{ 0, 0, 255, 255 } );
+	REQUIRE( Pixel_( greenFill ) == std::array<std::uint8_t, 4>{ 0, 128, 0, 64 } );
+
+	REQUIRE( GL_NO_ERROR == glGetError() );
+
+	glUseProgram( 0 );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	glDeleteFramebuffers( 1, &fbo );
+	glDeleteTextures( 1, &colour );
+}
+
+// Against testing every rectangle, topmost first
+TEST_CASE( "UI hit grid finds the topmost element", "[ui]" )
+{
+	std::minstd_rand rng( 42 );
+	std::uniform_real_distribution<float> position( -1.f, 1.f );
+	std::uniform_real_distribution<float> size( 0.f, 0.3f );
+
+	std::vector<UIRect> rects;
+	for( int i = 0; i < 500; ++i )
+	{
+		auto const x = position( rng ), y = position( rng );
+		rects.push_back( { x, x + size( rng ), y, y + size( rng ) } );
+	}
+
+	// A degenerate one, and one over everything else
+	rects.push_back( { 0.5f, 0.5f, 0.5f, 0.5f } );
+
+	UIHitGrid grid;
+	grid.Build( rects );
+	REQUIRE( grid.Columns() * grid.Rows() >= 500 );
+
+	auto const linear = [&] ( Vec2f aPoint ) {
+		for( auto i = int(rects.size()); i-- > 0; )
+		{
+			auto const& rect = rects[i];
+			if( rect.left <= aPoint.x && aPoint.x <= rect.right && rect.bottom <= aPoint.y && aPoint.y <= rect.top )
+				return i;
+		}
+		return -1;
+	};
+
+	std::size_t tested = 0;
+	for( int i = 0; i < 10000; ++i )
+	{
+		Vec2f const point{ 1.4f * position( rng ), 1.4f * position( rng ) };
+		REQUIRE( linear( point ) == grid.HitTest( point ) );
+		tested += grid.LastTested();
+	}
+
+	// A handful per test, not hundreds
+	REQUIRE( tested < 10000 * 10 );
+
+	REQUIRE( int(rects.size()) - 1 == grid.HitTest( { 0.5f, 0.5f } ) );
+
+	rects.push_back( { -2.f, 2.f, -2.f, 2.f } );
+	grid.Build( rects );
+	REQUIRE( int(rects.size()) - 1 == grid.HitTest( { 0.5f, 0.5f } ) );
+	REQUIRE( int(rects.size()) - 1 == grid.HitTest( { 2.f, 2.f } ) );
+	REQUIRE( -1 == grid.HitTest( { 2.1f, 0.f } ) );
+
+	grid.Build( {} );
+	REQUIRE( -1 == grid.HitTest( { 0.f, 0.f } ) );
+}
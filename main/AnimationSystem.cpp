@@ -0,0 +1,352 @@
+#include "AnimationSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace
+{
+	// Looks up each track's clip time, and counts the tracks whose time is
+	// outside [aValidFrom, aValidUntil). Separate (and with restrict), so
+	// that the loop vectorizes: GCC can't check for aliasing at runtime
+	// when there is a gather.
+	std::size_t GatherTimes_( std::size_t aCount, float const* __restrict aClipTimes, std::uint32_t const* __restrict aTrackClips, float const* __restrict aValidFrom, float const* __restrict aValidUntil, float* __restrict aTimes )
+	{
+		std::uint32_t outside = 0;
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			const float time = aClipTimes[aTrackClips[i]];
+			aTimes[i] = time;
+			outside += std::uint32_t(time < aValidFrom[i]) | std::uint32_t(time >= aValidUntil[i]);
+		}
+
+		return outside;
+	}
+}
+
+AnimationSystem::ClipID AnimationSystem::AddClip()
+{
+	const ClipID id = mClips.size();
+
+	Clip_& clip = mClips.emplace_back();
+	clip.duration = -1.f;
+	clip.isPlaying = false;
+	clip.isFinished = false;
+
+	mClipTimes.push_back( 0.f );
+
+	return id;
+}
+
+
+AnimationSystem::TrackID AnimationSystem::AddTrack( ClipID aClip, std::span<const TrackKeyFrame> aKeyFrames )
+{
+	const TrackID id = AddTrack_( aClip, aKeyFrames.size() );
+
+	float time = 0.f;
+	for( std::size_t i = 0; i < aKeyFrames.size(); ++i )
+	{
+		if( i > 0 )
+		{
+			time += aKeyFrames[i].mDuration;
+		}
+
+		mKeyTimes.push_back( time );
+		mKeyValues.push_back( aKeyFrames[i].mValue );
+		mKeyShapes.push_back( aKeyFrames[i].mShape );
+	}
+
+	if( aKeyFrames.size() > 1 )
+	{
+		mClips[aClip].duration = std::max( mClips[aClip].duration, time );
+	}
+
+	mValues[id] = aKeyFrames.empty() ? 0.f : aKeyFrames.front().mValue;
+	FindSegment_( id, 0.f );
+
+	return id;
+}
+
+
+AnimationSystem::TrackID AnimationSystem::AddVec3Track( ClipID aClip, std::span<const Vec3TrackKeyFrame> aKeyFrames )
+{
+	std::vector<TrackKeyFrame> components( aKeyFrames.size() );
+
+	TrackID first = 0;
+	for( int axis = 0; axis < 3; ++axis )
+	{
+		for( std::size_t i = 0; i < aKeyFrames.size(); ++i )
+		{
+			Vec3f const& value = aKeyFrames[i].mValue;
+			components[i] = {
+				0 == axis ? value.x : 1 == axis ? value.y : value.z,
+				aKeyFrames[i].mDuration,
+				aKeyFrames[i].mShape
+			};
+		}
+
+		const TrackID id = AddTrack( aClip, components );
+		if( 0 == axis )
+		{
+			first = id;
+		}
+	}
+
+	return first;
+}
+
+
+void AnimationSystem::Play( ClipID aClip )
+{
+	mClips[aClip].isPlaying = true;
+}
+
+
+void AnimationSystem::Pause( ClipID aClip )
+{
+	mClips[aClip].isPlaying = false;
+}
+
+
+void AnimationSystem::Stop( ClipID aClip )
+{
+	// The tracks notice the time going back in Update()
+	Clip_& clip = mClips[aClip];
+	mClipTimes[aClip] = 0.f;
+	clip.isFinished = false;
+	clip.isPlaying = false;
+}
+
+
+void AnimationSystem::Toggle( ClipID aClip )
+{
+	mClips[aClip].isPlaying = !mClips[aClip].isPlaying;
+}
+
+
+bool AnimationSystem::IsPlaying( ClipID aClip ) const
+{
+	return mClips[aClip].isPlaying;
+}
+
+
+bool AnimationSystem::IsFinished( ClipID aClip ) const
+{
+	return mClips[aClip].isFinished;
+}
+
+
+void AnimationSystem::Seek( ClipID aClip, float aTime )
+{
+	// As with Stop(), the tracks notice in Update()
+	mClipTimes[aClip] = std::max( aTime, 0.f );
+	mClips[aClip].isFinished = false;
+}
+
+
+float AnimationSystem::Time( ClipID aClip ) const
+{
+	return mClipTimes[aClip];
+}
+
+
+float AnimationSystem::Duration( ClipID aClip ) const
+{
+	return mClips[aClip].duration;
+}
+
+
+void AnimationSystem::InsertOnFinishCallback( ClipID aClip, std::function<void()> aCallback )
+{
+	mClips[aClip].onFinishCallbacks.push_back( std::move(aCallback) );
+}
+
+
+void AnimationSystem::ToggleAll()
+{
+	for( ClipID clip = 0; clip < mClips.size(); ++clip )
+	{
+		Toggle( clip );
+	}
+}
+
+
+void AnimationSystem::StopAll()
+{
+	for( ClipID clip = 0; clip < mClips.size(); ++clip )
+	{
+		Stop( clip );
+	}
+}
+
+
+void AnimationSystem::Update( float aDeltaTime )
+{
+	for( ClipID id = 0; id < mClips.size(); ++id )
+	{
+		if( mClips[id].isPlaying && !mClips[id].isFinished )
+		{
+			mClipTimes[id] += aDeltaTime;
+		}
+	}
+
+	// Tracks only need a new segment when the time leaves their current
+	// one, which is rare: clips move forward a little each frame. So
+	// first check all of them at once, and only look for the ones that
+	// left if there are any.
+	const std::size_t trackCount = mValues.size();
+	const std::size_t outside = GatherTimes_( trackCount, mClipTimes.data(), mTrackClips.data(), mValidFrom.data(), mValidUntil.data(), mTimes.data() );
+
+	if( outside > 0 )
+	{
+		for( std::size_t i = 0; i < trackCount; ++i )
+		{
+			if( mTimes[i] < mValidFrom[i] || mTimes[i] >= mValidUntil[i] )
+			{
+				FindSegment_( i, mTimes[i] );
+			}
+		}
+	}
+
+	// The actual evaluation, branch free over flat arrays
+	float* values = mValues.data();
+	float const* times = mTimes.data();
+	float const* starts = mSegmentStarts.data();
+	float const* scales = mSegmentScales.data();
+	float const* from = mFrom.data();
+	float const* to = mTo.data();
+	std::int32_t const* kinds = mShapeKinds.data();
+	std::int32_t const* degrees = mShapeDegrees.data();
+
+	for( std::size_t i = 0; i < trackCount; ++i )
+	{
+		const float progress = std::clamp( (times[i] - starts[i]) * scales[i], 0.f, 1.f );
+		values[i] = Lerp( from[i], to[i], EvaluateShape( ShapeKind(kinds[i]), degrees[i], progress ) );
+	}
+
+	// Callbacks last, so that they see this frame's values. They may
+	// control clips (and add new ones), so no references are kept.
+	for( ClipID id = 0; id < mClips.size(); ++id )
+	{
+		Clip_& clip = mClips[id];
+		if( !clip.isPlaying || clip.isFinished || clip.duration < 0.f || mClipTimes[id] < clip.duration )
+		{
+			continue;
+		}
+
+		clip.isFinished = true;
+		clip.isPlaying = false;
+
+		const auto callbacks = clip.onFinishCallbacks;
+		for( auto const& cb : callbacks )
+		{
+			cb();
+		}
+	}
+}
+
+
+float AnimationSystem::Value( TrackID aTrack ) const
+{
+	return mValues[aTrack];
+}
+
+
+Vec3f AnimationSystem::Vec3Value( TrackID aTrack ) const
+{
+	return { mValues[aTrack], mValues[aTrack + 1], mValues[aTrack + 2] };
+}
+
+
+std::span<const float> AnimationSystem::Values() const
+{
+	return mValues;
+}
+
+
+std::size_t AnimationSystem::ClipCount() const
+{
+	return mClips.size();
+}
+
+
+std::size_t AnimationSystem::TrackCount() const
+{
+	return mValues.size();
+}
+
+
+AnimationSystem::TrackID AnimationSystem::AddTrack_( ClipID aClip, std::size_t aKeyCount )
+{
+	assert( aClip < mClips.size() );
+
+	const TrackID id = mValues.size();
+
+	mTrackClips.push_back( std::uint32_t(aClip) );
+	mTrackFirstKeys.push_back( std::uint32_t(mKeyTimes.size()) );
+	mTrackKeyCounts.push_back( std::uint32_t(aKeyCount) );
+	mValues.push_back( 0.f );
+
+	mValidFrom.push_back( 0.f );
+	mValidUntil.push_back( 0.f );
+	mSegmentStarts.push_back( 0.f );
+	mSegmentScales.push_back( 0.f );
+	mFrom.push_back( 0.f );
+	mTo.push_back( 0.f );
+	mShapeKinds.push_back( 0 );
+	mShapeDegrees.push_back( 0 );
+	mTimes.push_back( 0.f );
+
+	return id;
+}
+
+
+void AnimationSystem::FindSegment_( TrackID aTrack, float aTime )
+{
+	constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+	const std::uint32_t first = mTrackFirstKeys[aTrack];
+	const std::uint32_t count = mTrackKeyCounts[aTrack];
+
+	if( count < 2 )
+	{
+		mValidFrom[aTrack] = -kInfinity;
+		mValidUntil[aTrack] = kInfinity;
+		mSegmentStarts[aTrack] = 0.f;
+		mSegmentScales[aTrack] = 0.f;
+		mFrom[aTrack] = mTo[aTrack] = count > 0 ? mKeyValues[first] : 0.f;
+		mShapeKinds[aTrack] = std::int32_t(ShapeKind::None);
+		mShapeDegrees[aTrack] = 0;
+		return;
+	}
+
+	// The key times are the running sum of the durations, so the segment
+	// is found by binary search: the number of inner keys at or before the
+	// time. (The first key is always before it, and the last segment also
+	// covers everything after the end.)
+	float const* innerKeys = mKeyTimes.data() + first + 1;
+	const std::uint32_t segment = std::uint32_t(std::upper_bound( innerKeys, innerKeys + (count - 2), aTime ) - innerKeys);
+
+	const std::uint32_t key = first + segment;
+	const float start = mKeyTimes[key];
+	const float end = mKeyTimes[key + 1];
+
+	// The first segment also covers times before the clip starts, the last
+	// one everything after it ends
+	mValidFrom[aTrack] = 0 == segment ? -kInfinity : start;
+	mValidUntil[aTrack] = segment + 2 == count ? kInfinity : end;
+
+	mSegmentStarts[aTrack] = start;
+	mSegmentScales[aTrack] = end > start ? 1.f / (end - start) : 0.f;
+	mFrom[aTrack] = mKeyValues[key];
+	mTo[aTrack] = mKeyValues[key + 1];
+	mShapeKinds[aTrack] = std::int32_t(mKeyShapes[key + 1].mKind);
+	mShapeDegrees[aTrack] = mKeyShapes[key + 1].mDegree;
+
+	// Only the last segment can be empty (earlier ones are skipped over), and
+	// the time is past it
+	if( end <= start )
+	{
+		mFrom[aTrack] = mTo[aTrack];
+	}
+}
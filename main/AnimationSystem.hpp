@@ -0,0 +1,152 @@
+#ifndef ANIMATION_SYSTEM_HPP
+#define ANIMATION_SYSTEM_HPP
+
+#include "AnimationTools.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+// Same meaning as FloatKeyFrame: the value is reached mDuration seconds after
+// the previous keyframe, along mShape. The duration and shape of a track's
+// first keyframe are unused.
+struct TrackKeyFrame
+{
+	float mValue;
+	float mDuration;
+	Shape mShape;
+};
+
+struct Vec3TrackKeyFrame
+{
+	Vec3f mValue;
+	float mDuration;
+	Shape mShape;
+};
+
+// ===========================================================================
+//		AnimationSystem
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Owns all keyframed tracks and evaluates them together, once per frame.
+//
+//	Tracks belong to clips. A clip has the media player controls of
+//	KeyFramedFloat (play, pause, stop, toggle) and on-finish callbacks, and
+//	all its tracks share its time. A clip finishes when its longest track
+//	reaches its last keyframe.
+//
+//	The keyframes of all tracks are stored back to back, as separate arrays
+//	of times, values and shapes. Each track caches the keyframe pair around
+//	its clip's time; Update() only looks for a new one (with a binary
+//	search over the key times) when the time leaves that segment, so
+//	large time steps and seeks cost the same as small ones. It then
+//	evaluates every track's shape and lerp in one pass over flat arrays,
+//	which the compiler vectorizes. Vec3 tracks are three float tracks with
+//	the same key times.
+// ---------------------------------------------------------------------------
+class AnimationSystem
+{
+public:
+	using ClipID = std::size_t;
+	using TrackID = std::size_t;
+
+	ClipID AddClip();
+
+	TrackID AddTrack( ClipID aClip, std::span<const TrackKeyFrame> aKeyFrames );
+
+	// Returns the ID of the x track; y and z follow it
+	TrackID AddVec3Track( ClipID aClip, std::span<const Vec3TrackKeyFrame> aKeyFrames );
+
+	void Play( ClipID aClip );
+	void Pause( ClipID aClip );
+	void Stop( ClipID aClip );
+	void Toggle( ClipID aClip );
+
+	bool IsPlaying( ClipID aClip ) const;
+	bool IsFinished( ClipID aClip ) const;
+
+	// Jumps to aTime seconds from the start of the clip; the tracks follow
+	// in the next Update() (use a delta time of 0 to only apply the seek).
+	// Finding the keyframes is a binary search, so any time is equally
+	// quick. Playing or not is kept. A clip sought to its end finishes, and
+	// calls back, in the next Update() while it plays.
+	void Seek( ClipID aClip, float aTime );
+
+	float Time( ClipID aClip ) const;
+
+	// Negative if the clip has nothing to play
+	float Duration( ClipID aClip ) const;
+
+	// Called from Update(), once each time the clip finishes
+	void InsertOnFinishCallback( ClipID aClip, std::function<void()> aCallback );
+
+	// Applied to all clips
+	void ToggleAll();
+	void StopAll();
+
+	void Update( float aDeltaTime );
+
+	// As of the last Update(). Before that, the first keyframe's value.
+	float Value( TrackID aTrack ) const;
+	Vec3f Vec3Value( TrackID aTrack ) const;
+	std::span<const float> Values() const;
+
+	std::size_t ClipCount() const;
+	std::size_t TrackCount() const;
+
+private:
+	struct Clip_
+	{
+		// End of the longest track. Negative if no track has more than one
+		// keyframe, in which case the clip never finishes (like
+		// KeyFramedFloat).
+		float duration;
+
+		bool isPlaying;
+		bool isFinished;
+
+		std::vector<std::function<void()>> onFinishCallbacks;
+	};
+
+private:
+	TrackID AddTrack_( ClipID aClip, std::size_t aKeyCount );
+	void FindSegment_( TrackID aTrack, float aTime );
+
+private:
+	std::vector<Clip_> mClips;
+	std::vector<float> mClipTimes;
+
+	// Keyframes of all tracks, back to back. Times are from the start of the
+	// clip.
+	std::vector<float> mKeyTimes;
+	std::vector<float> mKeyValues;
+	std::vector<Shape> mKeyShapes;
+
+	// Per track
+	std::vector<std::uint32_t> mTrackClips;
+	std::vector<std::uint32_t> mTrackFirstKeys;
+	std::vector<std::uint32_t> mTrackKeyCounts;
+	std::vector<float> mValues;
+
+	// Per track, the segment (keyframe pair) around the clip time. While
+	// the clip time stays in [mValidFrom, mValidUntil), nothing here
+	// changes, and the evaluation only needs the time.
+	std::vector<float> mValidFrom;
+	std::vector<float> mValidUntil;
+	std::vector<float> mSegmentStarts;
+	std::vector<float> mSegmentScales; // 1 / length
+	std::vector<float> mFrom;
+	std::vector<float> mTo;
+	std::vector<std::int32_t> mShapeKinds;
+	std::vector<std::int32_t> mShapeDegrees;
+
+	// Per track clip time, gathered for the evaluation pass
+	std::vector<float> mTimes;
+};
+
+#endif
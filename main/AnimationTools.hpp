@@ -6,6 +6,7 @@
 #include "../vmlib/mat44.hpp"
 #include <functional>
 #include <algorithm>
+#include <cstdint>
 
 
 constexpr
@@ -70,6 +71,88 @@ namespace ShapingFunctions
 
 
 
+// The same curves as data, for tracks that are evaluated in bulk by
+// AnimationSystem. A function pointer or std::function per keyframe would
+// mean one call per track per frame; a kind and a degree can be evaluated
+// for many tracks at once.
+enum class ShapeKind : std::uint8_t
+{
+	None,
+	Instant,
+	Polynomial,        // t^degree, degree 1 is Linear
+	PolynomialEaseOut, // 1 - (1-t)^degree
+	Smoothstep
+};
+
+struct Shape
+{
+	ShapeKind mKind;
+	std::uint8_t mDegree;
+};
+
+constexpr int kMaxShapeDegree = 8;
+
+namespace Shapes
+{
+	inline constexpr Shape None{ ShapeKind::None, 0 };
+	inline constexpr Shape Instant{ ShapeKind::Instant, 0 };
+	inline constexpr Shape Linear{ ShapeKind::Polynomial, 1 };
+	inline constexpr Shape Smoothstep{ ShapeKind::Smoothstep, 0 };
+
+	template <int DEGREE> requires (DEGREE >= 1 && DEGREE <= kMaxShapeDegree)
+	inline constexpr Shape Polynomial{ ShapeKind::Polynomial, std::uint8_t(DEGREE) };
+
+	template <int DEGREE> requires (DEGREE >= 1 && DEGREE <= kMaxShapeDegree)
+	inline constexpr Shape PolynomialEaseOut{ ShapeKind::PolynomialEaseOut, std::uint8_t(DEGREE) };
+}
+
+
+namespace detail
+{
+	// x^n for n < 16, in a fixed number of steps
+	constexpr
+	float PowerBySquaring( float x, int n ) noexcept
+	{
+		const float x2 = x * x;
+		const float x4 = x2 * x2;
+		const float x8 = x4 * x4;
+
+		const float a = (n & 1) ? x : 1.f;
+		const float b = (n & 2) ? x2 : 1.f;
+		const float c = (n & 4) ? x4 : 1.f;
+		const float d = (n & 8) ? x8 : 1.f;
+		return a * b * c * d;
+	}
+}
+
+
+// The matching ShapingFunctions, up to rounding. There are no branches on
+// the kind or degree, so loops over it vectorize.
+constexpr
+float EvaluateShape( ShapeKind aKind, int aDegree, float t ) noexcept
+{
+	const float u = 1.f - t;
+	const float tn = detail::PowerBySquaring( t, aDegree );
+	const float un = detail::PowerBySquaring( u, aDegree );
+
+	const float smooth = Lerp( t * t, 1.f - u * u, t );
+
+	// A sum with one non-zero term rather than a chain of selects, which
+	// GCC turns back into branches
+	return float(ShapeKind::Instant == aKind)
+		+ float(ShapeKind::Polynomial == aKind) * tn
+		+ float(ShapeKind::PolynomialEaseOut == aKind) * (1.f - un)
+		+ float(ShapeKind::Smoothstep == aKind) * smooth;
+}
+
+constexpr
+float EvaluateShape( Shape aShape, float t ) noexcept
+{
+	return EvaluateShape( aShape.mKind, aShape.mDegree, t );
+}
+
+
+
 
 struct FloatKeyFrame
 {
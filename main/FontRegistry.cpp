@@ -0,0 +1,55 @@
+#include "FontRegistry.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+
+FontRegistry::FontID FontRegistry::Load( const char* aPath )
+{
+	// Fall back to the path as given if it can't be resolved; mapping it
+	// then reports the error
+	std::error_code error;
+	std::string key = std::filesystem::weakly_canonical( aPath, error ).string();
+	if( error )
+	{
+		key = aPath;
+	}
+
+	if( auto const it = mByPath.find( key ); it != mByPath.end() )
+	{
+		return it->second;
+	}
+
+	MappedFile& file = mFiles.emplace_back( aPath );
+	mMappedBytes += file.bytes().size();
+
+	const FontID id = mPaths.size();
+	mPaths.push_back( aPath );
+	mByPath.emplace( std::move(key), id );
+
+	return id;
+}
+
+
+std::span<const unsigned char> FontRegistry::Data( FontID aFont ) const
+{
+	return mFiles[aFont].bytes();
+}
+
+
+const std::string& FontRegistry::Path( FontID aFont ) const
+{
+	return mPaths[aFont];
+}
+
+
+std::size_t FontRegistry::FontCount() const
+{
+	return mFiles.size();
+}
+
+
+std::size_t FontRegistry::MappedBytes() const
+{
+	return mMappedBytes;
+}
@@ -0,0 +1,47 @@
+#ifndef FONT_REGISTRY_HPP
+#define FONT_REGISTRY_HPP
+
+#include "../support/mapped_file.hpp"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// ===========================================================================
+//		FontRegistry
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Font files, each loaded once. Load() maps the file the first time a
+//	path is seen, and returns the same FontID for any later path naming the
+//	same file ("./a.ttf" and "a.ttf" are one font). The mapping lives as long
+//	as the registry, so fontstash and SdfGlyphAtlas can both parse the one
+//	copy in place instead of each keeping their own.
+// ---------------------------------------------------------------------------
+class FontRegistry
+{
+public:
+	using FontID = std::size_t;
+
+	// Throws Error if the file can't be mapped
+	FontID Load( const char* aPath );
+
+	std::span<const unsigned char> Data( FontID aFont ) const;
+	const std::string& Path( FontID aFont ) const;
+
+	std::size_t FontCount() const;
+
+	// All fonts' files together
+	std::size_t MappedBytes() const;
+
+private:
+	std::unordered_map<std::string, FontID> mByPath;
+	std::vector<std::string> mPaths;
+	std::vector<MappedFile> mFiles;
+	std::size_t mMappedBytes = 0;
+};
+
+#endif
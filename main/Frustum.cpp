@@ -0,0 +1,38 @@
+#include "Frustum.hpp"
+
+#include <cmath>
+
+Frustum MakeFrustum( const Mat44f& aProjCamera )
+{
+	const auto row = [&] ( std::size_t aRow ) {
+		return Vec4f{ aProjCamera[aRow, 0], aProjCamera[aRow, 1], aProjCamera[aRow, 2], aProjCamera[aRow, 3] };
+	};
+
+	const Vec4f x = row( 0 ), y = row( 1 ), z = row( 2 ), w = row( 3 );
+
+	Frustum frustum{ {
+		w + x, w - x,
+		w + y, w - y,
+		w + z, w - z
+	} };
+
+	for( Vec4f& plane : frustum.planes )
+	{
+		const float length = std::sqrt( plane.x * plane.x + plane.y * plane.y + plane.z * plane.z );
+		plane = plane / length;
+	}
+
+	return frustum;
+}
+
+
+bool Intersects( const Frustum& aFrustum, Vec4f aSphere )
+{
+	for( const Vec4f& plane : aFrustum.planes )
+	{
+		if( plane.x * aSphere.x + plane.y * aSphere.y + plane.z * aSphere.z + plane.w < -aSphere.w )
+			return false;
+	}
+
+	return true;
+}
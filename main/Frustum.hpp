@@ -0,0 +1,36 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+
+#include <array>
+
+// Where the GPU does the culling too, the CPU is the reference (as with
+// SkinningBackend)
+enum class CullingBackend
+{
+	Cpu, // On the CPU, before the instances are uploaded
+	Gpu  // In staticCull.comp, which writes the indirect draw arguments
+};
+
+// The six planes of a view frustum, in world space: left, right, bottom,
+// top, near and far. Each is (normal, distance), with the normal unit length
+// and pointing inside, so a point p is inside a plane when
+// dot(normal, p) + distance >= 0.
+struct Frustum
+{
+	std::array<Vec4f, 6> planes;
+};
+
+// The frustum of aProjCamera (projection * world to camera), the planes
+// taken from its rows (Gribb and Hartmann)
+Frustum MakeFrustum( const Mat44f& aProjCamera );
+
+// Whether the sphere (centre xyz, radius w) may be inside. Conservative: a
+// sphere just off a corner, outside the frustum but not wholly outside any
+// one plane, is kept. staticCull.comp makes the same test.
+bool Intersects( const Frustum& aFrustum, Vec4f aSphere );
+
+#endif
@@ -0,0 +1,295 @@
+#include "GeometryBuffer.hpp"
+
+#include "ModelObject.hpp"
+
+#include "../support/error.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+	// Vertices are welded when they are the same bit for bit, once negative
+	// zeros are made positive (x + 0 is +0 for both)
+	void PositiveZeros_( StaticVertex& aVertex )
+	{
+		float* values = reinterpret_cast<float*>(&aVertex);
+		for( std::size_t i = 0; i < sizeof(StaticVertex) / sizeof(float); ++i )
+			values[i] += 0.f;
+	}
+
+	// Around the middle of the bounding box; not the smallest sphere, but
+	// close for the boxy models of the scene
+	Vec4f BoundingSphere_( const std::vector<StaticVertex>& aVertices )
+	{
+		if( aVertices.empty() )
+			return { 0.f, 0.f, 0.f, 0.f };
+
+		Vec3f low = aVertices.front().position;
+		Vec3f high = low;
+		for( const StaticVertex& vertex : aVertices )
+		{
+			low = { std::min( low.x, vertex.position.x ), std::min( low.y, vertex.position.y ), std::min( low.z, vertex.position.z ) };
+			high = { std::max( high.x, vertex.position.x ), std::max( high.y, vertex.position.y ), std::max( high.z, vertex.position.z ) };
+		}
+
+		const Vec3f centre = (low + high) * 0.5f;
+
+		float radius = 0.f;
+		for( const StaticVertex& vertex : aVertices )
+			radius = std::max( radius, length( vertex.position - centre ) );
+
+		return { centre.x, centre.y, centre.z, radius };
+	}
+
+	struct VertexHash_
+	{
+		std::size_t operator()( const StaticVertex& aVertex ) const noexcept
+		{
+			return std::hash<std::string_view>{}( std::string_view( reinterpret_cast<const char*>(&aVertex), sizeof(StaticVertex) ) );
+		}
+	};
+
+	struct VertexEqual_
+	{
+		bool operator()( const StaticVertex& aLeft, const StaticVertex& aRight ) const noexcept
+		{
+			return 0 == std::memcmp( &aLeft, &aRight, sizeof(StaticVertex) );
+		}
+	};
+}
+
+
+RangeAllocator::RangeAllocator( GLuint aCapacity )
+	: mCapacity( aCapacity )
+	, mUsed( 0 )
+{
+	if( aCapacity > 0 )
+		mFree.push_back( { 0, aCapacity } );
+}
+
+
+std::optional<GLuint> RangeAllocator::Allocate( GLuint aCount )
+{
+	if( 0 == aCount )
+		return 0;
+
+	for( auto it = mFree.begin(); it != mFree.end(); ++it )
+	{
+		if( it->count < aCount )
+			continue;
+
+		const GLuint first = it->first;
+		it->first += aCount;
+		it->count -= aCount;
+		if( 0 == it->count )
+			mFree.erase( it );
+
+		mUsed += aCount;
+		return first;
+	}
+
+	return std::nullopt;
+}
+
+
+void RangeAllocator::Free( GeometryRange aRange )
+{
+	if( 0 == aRange.count )
+		return;
+
+	mUsed -= aRange.count;
+
+	auto next = std::ranges::lower_bound( mFree, aRange.first, {}, &GeometryRange::first );
+	auto it = mFree.insert( next, aRange );
+
+	// Merge with the following range, then with the preceding one
+	if( auto following = it + 1; following != mFree.end() && it->first + it->count == following->first )
+	{
+		it->count += following->count;
+		mFree.erase( following );
+	}
+
+	if( it != mFree.begin() )
+	{
+		auto preceding = it - 1;
+		if( preceding->first + preceding->count == it->first )
+		{
+			preceding->count += it->count;
+			mFree.erase( it );
+		}
+	}
+}
+
+
+GLuint RangeAllocator::Capacity() const
+{
+	return mCapacity;
+}
+
+
+GLuint RangeAllocator::Used() const
+{
+	return mUsed;
+}
+
+
+GLuint RangeAllocator::LargestFree() const
+{
+	GLuint largest = 0;
+	for( const GeometryRange& range : mFree )
+		largest = std::max( largest, range.count );
+
+	return largest;
+}
+
+
+GeometryBuffer::GeometryBuffer( GLuint aVertexCapacity, GLuint aIndexCapacity )
+	: mVertices( aVertexCapacity )
+	, mIndices( aIndexCapacity )
+	, mVertexBuffer( 0 )
+	, mIndexBuffer( 0 )
+	, mVertexArray( 0 )
+{
+	glGenBuffers( 1, &mVertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(aVertexCapacity) * sizeof(StaticVertex), nullptr, GL_STATIC_DRAW );
+
+	// Index data goes through the copy target, which (unlike the element
+	// array one) isn't vertex array state
+	glGenBuffers( 1, &mIndexBuffer );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mIndexBuffer );
+	glBufferData( GL_COPY_WRITE_BUFFER, GLsizeiptr(aIndexCapacity) * sizeof(GLuint), nullptr, GL_STATIC_DRAW );
+
+	glGenVertexArrays( 1, &mVertexArray );
+	SetupVertexArray( mVertexArray );
+}
+
+
+GeometryBuffer::~GeometryBuffer()
+{
+	glDeleteVertexArrays( 1, &mVertexArray );
+	glDeleteBuffers( 1, &mIndexBuffer );
+	glDeleteBuffers( 1, &mVertexBuffer );
+}
+
+
+MeshRange GeometryBuffer::Add( const ModelObject& aModel )
+{
+	Weld( aModel, mWeldedVertices, mWeldedIndices );
+
+	const auto vertexCount = GLuint(mWeldedVertices.size());
+	const auto indexCount = GLuint(mWeldedIndices.size());
+
+	const auto firstVertex = mVertices.Allocate( vertexCount );
+	if( !firstVertex )
+		throw Error( "GeometryBuffer: no room for {} vertices (at most {} in one range)", vertexCount, mVertices.LargestFree() );
+
+	const auto firstIndex = mIndices.Allocate( indexCount );
+	if( !firstIndex )
+	{
+		mVertices.Free( { *firstVertex, vertexCount } );
+		throw Error( "GeometryBuffer: no room for {} indices (at most {} in one range)", indexCount, mIndices.LargestFree() );
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+	glBufferSubData( GL_ARRAY_BUFFER, GLintptr(*firstVertex) * sizeof(StaticVertex), GLsizeiptr(vertexCount) * sizeof(StaticVertex), mWeldedVertices.data() );
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mIndexBuffer );
+	glBufferSubData( GL_COPY_WRITE_BUFFER, GLintptr(*firstIndex) * sizeof(GLuint), GLsizeiptr(indexCount) * sizeof(GLuint), mWeldedIndices.data() );
+
+	return { { *firstVertex, vertexCount }, { *firstIndex, indexCount }, BoundingSphere_( mWeldedVertices ) };
+}
+
+
+void GeometryBuffer::Remove( const MeshRange& aMesh )
+{
+	mVertices.Free( aMesh.vertices );
+	mIndices.Free( aMesh.indices );
+}
+
+
+void GeometryBuffer::Weld( const ModelObject& aModel, std::vector<StaticVertex>& aVertices, std::vector<GLuint>& aIndices )
+{
+	const auto& positions = aModel.Vertices();
+	const auto& colours = aModel.VertexColours();
+	const auto& normals = aModel.Normals();
+	const auto& specular = aModel.VertexSpecular();
+	const auto& shininess = aModel.VertexShininess();
+	const auto& texCoords = aModel.TextureCoords();
+
+	const std::size_t count = positions.size();
+
+	aVertices.clear();
+	aIndices.clear();
+	aVertices.reserve( count );
+	aIndices.reserve( count );
+
+	std::unordered_map<StaticVertex, GLuint, VertexHash_, VertexEqual_> welded;
+	welded.reserve( count );
+
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		StaticVertex vertex{
+			positions[i],
+			colours.size() == count ? colours[i] : Vec3f{ 1.f, 1.f, 1.f },
+			normals.size() == count ? normals[i] : Vec3f{ 0.f, 1.f, 0.f },
+			specular.size() == count ? specular[i] : Vec3f{ 0.5f, 0.5f, 0.5f },
+			shininess.size() == count ? shininess[i] : 50.f,
+			texCoords.size() == count ? texCoords[i] : Vec2f{ 0.f, 0.f }
+		};
+
+		PositiveZeros_( vertex );
+
+		const auto [it, added] = welded.try_emplace( vertex, GLuint(aVertices.size()) );
+		if( added )
+			aVertices.push_back( vertex );
+
+		aIndices.push_back( it->second );
+	}
+}
+
+
+GLuint GeometryBuffer::VertexArray() const
+{
+	return mVertexArray;
+}
+
+
+void GeometryBuffer::SetupVertexArray( GLuint aVertexArray ) const
+{
+	glBindVertexArray( aVertexArray );
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+
+	const auto attribute = [] ( GLuint aIndex, GLint aSize, std::size_t aOffset ) {
+		glVertexAttribPointer( aIndex, aSize, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), reinterpret_cast<const void*>(aOffset) );
+		glEnableVertexAttribArray( aIndex );
+	};
+
+	attribute( 0, 3, offsetof(StaticVertex, position) );
+	attribute( 1, 3, offsetof(StaticVertex, colour) );
+	attribute( 2, 3, offsetof(StaticVertex, normal) );
+	attribute( 3, 3, offsetof(StaticVertex, specular) );
+	attribute( 4, 1, offsetof(StaticVertex, shininess) );
+	attribute( 5, 2, offsetof(StaticVertex, texCoord) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer );
+
+	glBindVertexArray( 0 );
+}
+
+
+const RangeAllocator& GeometryBuffer::Vertices() const
+{
+	return mVertices;
+}
+
+
+const RangeAllocator& GeometryBuffer::Indices() const
+{
+	return mIndices;
+}
@@ -0,0 +1,133 @@
+#ifndef GEOMETRY_BUFFER_HPP
+#define GEOMETRY_BUFFER_HPP
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class ModelObject;
+
+// A range of elements (vertices or indices) in a GeometryBuffer
+struct GeometryRange
+{
+	GLuint first = 0;
+	GLuint count = 0;
+};
+
+// Where a mesh lives in a GeometryBuffer. Its indices are relative to its
+// first vertex, which is the base vertex of its draws.
+struct MeshRange
+{
+	GeometryRange vertices;
+	GeometryRange indices;
+
+	// Bounding sphere in model space: centre (xyz) and radius (w)
+	Vec4f bounds{ 0.f, 0.f, 0.f, 0.f };
+};
+
+// One vertex of static geometry, interleaved. Attribute locations as in
+// static.vert.
+struct StaticVertex
+{
+	Vec3f position;  // 0
+	Vec3f colour;    // 1
+	Vec3f normal;    // 2
+	Vec3f specular;  // 3
+	float shininess; // 4
+	Vec2f texCoord;  // 5
+};
+
+static_assert( sizeof(StaticVertex) == 60 );
+
+
+// ===========================================================================
+//		RangeAllocator
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Hands out ranges of [0, capacity), first fit. Freed ranges are merged
+//	with the free ones next to them, so freeing everything leaves one range
+//	again.
+// ---------------------------------------------------------------------------
+class RangeAllocator
+{
+public:
+	explicit RangeAllocator( GLuint aCapacity );
+
+	// The first of aCount elements, if there is a free range that large
+	std::optional<GLuint> Allocate( GLuint aCount );
+
+	// aRange must have come from Allocate()
+	void Free( GeometryRange aRange );
+
+	GLuint Capacity() const;
+	GLuint Used() const;
+	GLuint LargestFree() const;
+
+private:
+	GLuint mCapacity;
+	GLuint mUsed;
+
+	// Sorted by first, none empty and none adjacent
+	std::vector<GeometryRange> mFree;
+};
+
+
+// ===========================================================================
+//		GeometryBuffer
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	One vertex buffer and one index buffer for all static meshes, so that
+//	they can share a vertex array and be drawn together (StaticDrawBatch).
+//	Add() suballocates a mesh's vertices and indices; Remove() gives them
+//	back. The capacities are fixed when it is created.
+//
+//	ModelObjects are triangle soups, three vertices per triangle. Add()
+//	welds the vertices that are the same in every attribute, which for the
+//	terrain removes most of them, and indexes the rest. Attributes the
+//	model didn't load get white, a specular reflectance of 0.5 and a
+//	shininess of 50.
+// ---------------------------------------------------------------------------
+class GeometryBuffer
+{
+public:
+	GeometryBuffer( GLuint aVertexCapacity, GLuint aIndexCapacity );
+	~GeometryBuffer();
+
+	GeometryBuffer( const GeometryBuffer& ) = delete;
+	GeometryBuffer& operator=( const GeometryBuffer& ) = delete;
+
+	// Throws Error if either buffer has no room left for it
+	MeshRange Add( const ModelObject& aModel );
+	void Remove( const MeshRange& aMesh );
+
+	// The welded vertices and their indices, as Add() uploads them
+	static void Weld( const ModelObject& aModel, std::vector<StaticVertex>& aVertices, std::vector<GLuint>& aIndices );
+
+	// Attributes 0 to 5 (see StaticVertex) and the index buffer
+	GLuint VertexArray() const;
+	void SetupVertexArray( GLuint aVertexArray ) const;
+
+	const RangeAllocator& Vertices() const;
+	const RangeAllocator& Indices() const;
+
+private:
+	RangeAllocator mVertices;
+	RangeAllocator mIndices;
+
+	GLuint mVertexBuffer;
+	GLuint mIndexBuffer;
+	GLuint mVertexArray;
+
+	std::vector<StaticVertex> mWeldedVertices;
+	std::vector<GLuint> mWeldedIndices;
+};
+
+#endif
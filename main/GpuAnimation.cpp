@@ -0,0 +1,137 @@
+#include "GpuAnimation.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// Empty buffers can't be bound, so each has at least one element
+	template< typename T >
+	void UploadStorage_( GLuint aBuffer, std::vector<T> const& aData )
+	{
+		const T none{};
+
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, aBuffer );
+		if( aData.empty() )
+		{
+			glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(T), &none, GL_STATIC_DRAW );
+		}
+		else
+		{
+			glBufferData( GL_SHADER_STORAGE_BUFFER, aData.size() * sizeof(T), aData.data(), GL_STATIC_DRAW );
+		}
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	}
+}
+
+GpuAnimationClips::GpuAnimationClips()
+	: mBuffers{ 0, 0, 0, 0 }
+	, mInstanceCount( 0 )
+{
+	glGenBuffers( 4, mBuffers );
+
+	Upload();
+	SetInstances( {} );
+}
+
+
+GpuAnimationClips::~GpuAnimationClips()
+{
+	glDeleteBuffers( 4, mBuffers );
+}
+
+
+GpuAnimationClips::ClipID GpuAnimationClips::AddClip( std::span<const Vec3TrackKeyFrame> aPositionKeys, std::span<const Vec3TrackKeyFrame> aRotationKeys, bool aLoop )
+{
+	const ClipID id = mClips.size();
+
+	Clip_& clip = mClips.emplace_back();
+	clip.firstTrack = std::uint32_t(mTracks.size());
+	clip.loop = aLoop ? 1 : 0;
+	clip.pad = 0;
+
+	const float positionDuration = AddVec3Track_( aPositionKeys );
+	const float rotationDuration = AddVec3Track_( aRotationKeys );
+	clip.duration = std::max( positionDuration, rotationDuration );
+
+	return id;
+}
+
+
+float GpuAnimationClips::Duration( ClipID aClip ) const
+{
+	return mClips[aClip].duration;
+}
+
+
+std::size_t GpuAnimationClips::ClipCount() const
+{
+	return mClips.size();
+}
+
+
+void GpuAnimationClips::Upload()
+{
+	UploadStorage_( mBuffers[0], mKeys );
+	UploadStorage_( mBuffers[1], mTracks );
+	UploadStorage_( mBuffers[2], mClips );
+}
+
+
+void GpuAnimationClips::SetInstances( std::span<const AnimatedInstance> aInstances )
+{
+	UploadStorage_( mBuffers[3], std::vector<AnimatedInstance>( aInstances.begin(), aInstances.end() ) );
+	mInstanceCount = aInstances.size();
+}
+
+
+std::size_t GpuAnimationClips::InstanceCount() const
+{
+	return mInstanceCount;
+}
+
+
+void GpuAnimationClips::Bind() const
+{
+	for( GLuint i = 0; i < 4; ++i )
+	{
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 4 + i, mBuffers[i] );
+	}
+}
+
+
+float GpuAnimationClips::AddVec3Track_( std::span<const Vec3TrackKeyFrame> aKeyFrames )
+{
+	// As AnimationSystem::AddTrack(): the key times are the running sum of
+	// the durations, and each key holds the shape of the segment ending at it
+	float duration = -1.f;
+	for( int axis = 0; axis < 3; ++axis )
+	{
+		Track_& track = mTracks.emplace_back();
+		track.firstKey = std::uint32_t(mKeys.size());
+		track.keyCount = std::uint32_t(aKeyFrames.size());
+
+		float time = 0.f;
+		for( std::size_t i = 0; i < aKeyFrames.size(); ++i )
+		{
+			if( i > 0 )
+			{
+				time += aKeyFrames[i].mDuration;
+			}
+
+			Vec3f const& value = aKeyFrames[i].mValue;
+			mKeys.push_back( {
+				time,
+				0 == axis ? value.x : 1 == axis ? value.y : value.z,
+				std::uint32_t(aKeyFrames[i].mShape.mKind),
+				std::uint32_t(aKeyFrames[i].mShape.mDegree)
+			} );
+		}
+
+		if( aKeyFrames.size() > 1 )
+		{
+			duration = time;
+		}
+	}
+
+	return duration;
+}
@@ -0,0 +1,109 @@
+#ifndef GPU_ANIMATION_HPP
+#define GPU_ANIMATION_HPP
+
+#include "AnimationSystem.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// One animated instance: where it is, which clip it plays and from when.
+// Must match AnimatedInstance in animationClips.glsl (std430).
+struct AnimatedInstance
+{
+	Vec3f origin;
+	std::uint32_t clip;
+
+	// The clip time is (time - startTime) * speed; nothing moves before it
+	float startTime;
+	float speed;
+
+	float pad[2];
+};
+
+static_assert( sizeof(AnimatedInstance) == 32 );
+
+// ===========================================================================
+//		GpuAnimationClips
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Keyframed clips baked into storage buffers, for instances that are
+//	animated entirely on the GPU (animationClips.glsl). A clip is a position
+//	and a rotation (Euler angles, as in Transform), each a Vec3 track with
+//	the same meaning as in AnimationSystem.
+//
+//	Each instance plays its clip from its own start time and at its own
+//	speed, and looping clips wrap around, so a crowd of thousands needs no
+//	per-frame work on the CPU: the shaders only take the current time.
+// ---------------------------------------------------------------------------
+class GpuAnimationClips
+{
+public:
+	using ClipID = std::size_t;
+
+	GpuAnimationClips();
+	~GpuAnimationClips();
+
+	GpuAnimationClips( GpuAnimationClips const& ) = delete;
+	GpuAnimationClips& operator= ( GpuAnimationClips const& ) = delete;
+
+	// The position is added to the instance's origin. Takes effect with
+	// the next Upload().
+	ClipID AddClip( std::span<const Vec3TrackKeyFrame> aPositionKeys, std::span<const Vec3TrackKeyFrame> aRotationKeys, bool aLoop );
+
+	// Negative if the clip has nothing to play
+	float Duration( ClipID aClip ) const;
+	std::size_t ClipCount() const;
+
+	// Uploads the clips added so far
+	void Upload();
+
+	void SetInstances( std::span<const AnimatedInstance> aInstances );
+	std::size_t InstanceCount() const;
+
+	// Binds the buffers to the bindings of animationClips.glsl (4 to 7)
+	void Bind() const;
+
+private:
+	// Must match the structs in animationClips.glsl (std430)
+	struct Key_
+	{
+		float time;
+		float value;
+		std::uint32_t kind;
+		std::uint32_t degree;
+	};
+
+	struct Track_
+	{
+		std::uint32_t firstKey;
+		std::uint32_t keyCount;
+	};
+
+	struct Clip_
+	{
+		std::uint32_t firstTrack;
+		float duration;
+		std::uint32_t loop;
+		std::uint32_t pad;
+	};
+
+private:
+	float AddVec3Track_( std::span<const Vec3TrackKeyFrame> aKeyFrames );
+
+private:
+	std::vector<Key_> mKeys;
+	std::vector<Track_> mTracks;
+	std::vector<Clip_> mClips;
+
+	// Keys, tracks, clips and instances
+	GLuint mBuffers[4];
+	std::size_t mInstanceCount;
+};
+
+#endif
@@ -582,12 +582,6 @@ Mat33f Transform::NormalUpdateMatrix() const
 	return N3;
 }
 
-ObjectInstanceGroup::ObjectInstanceGroup( ModelObjectGPU& modelObjectGPU )
-	: mModelObjectGPU( modelObjectGPU )
-{
-}
-
-
 void ObjectInstanceGroup::CreateInstance( const Transform& transform )
 {
 	mTransformList.push_back( transform );
@@ -665,15 +659,3 @@ Transform& ObjectInstanceGroup::GetTransform( size_t instanceIndex )
 }
 
 
-const ModelObjectGPU& ObjectInstanceGroup::GetModel() const
-{
-	return mModelObjectGPU;
-}
-
-
-ModelObjectGPU& ObjectInstanceGroup::GetModel()
-{
-	return mModelObjectGPU;
-}
-
-
@@ -227,10 +227,12 @@ Transform operator+( const Transform& left, const Transform& right ) noexcept
 
 
 
+// The transforms of a model's instances; the model itself is drawn from
+// wherever it was uploaded to (e.g. a GeometryBuffer)
 class ObjectInstanceGroup
 {
 public:
-	ObjectInstanceGroup( ModelObjectGPU& modelObjectGPU );
+	ObjectInstanceGroup() = default;
 
 	~ObjectInstanceGroup() = default;
 
@@ -252,12 +254,8 @@ public:
 	const Transform& GetTransform( size_t instanceIndex ) const;
 	Transform& GetTransform( size_t instanceIndex );
 
-	const ModelObjectGPU& GetModel() const;
-	ModelObjectGPU& GetModel();
-
 
 private:
-	ModelObjectGPU& mModelObjectGPU;
 	std::vector<Transform> mTransformList;
 };
 
@@ -1,10 +1,36 @@
 #include "PITBFont.hpp"
 
+#include <cstddef>
+#include <filesystem>
+
+
+namespace
+{
+	// Texts are given ranges in multiples of this many vertices (16 glyphs),
+	// and always at least this much room to grow, so that a changing number
+	// rarely needs the buffer repacked
+	constexpr std::size_t kRangeGranularity_ = 6 * 16;
+
+	// fontstash's atlas starts this big, and doubles up to the largest
+	constexpr int kFonsAtlasSize_ = 512;
+	constexpr int kFonsMaxAtlasSize_ = 2048;
+
+	// Passes over all texts after a glyph eviction (see Update())
+	constexpr int kMaxLayoutPasses_ = 3;
+
+	// Where font-baker puts a font's distance field glyphs
+	std::string BakedAtlasPath_(const std::string& aFontPath)
+	{
+		return std::filesystem::path(aFontPath).replace_extension(".sdfatlas").string();
+	}
+}
+
 
 PITBStyle::PITBStyle(int aFont, float aFontSize, uint32_t aColour, int alignment /* = FONS_ALIGN_LEFT*/)
 	: mFontSize( aFontSize )
 	, mColour( aColour )
 	, mAlignment( alignment )
+	, mVersion( 0 )
 {
 	if( FONS_INVALID == aFont )
 	{
@@ -33,6 +59,7 @@ void PITBStyle::SetFont( int aFont )
 	{
 		mFont = aFont;
 	}
+	++mVersion;
 }
 
 
@@ -45,6 +72,7 @@ float PITBStyle::GetFontSize() const
 void PITBStyle::SetFontSize( float aSize )
 {
 	mFontSize = aSize;
+	++mVersion;
 }
 
 
@@ -57,6 +85,7 @@ uint32_t PITBStyle::GetColour() const
 void PITBStyle::SetColour( uint32_t aColour )
 {
 	mColour = aColour;
+	++mVersion;
 }
 
 int PITBStyle::GetAlignment() const
@@ -68,6 +97,7 @@ int PITBStyle::GetAlignment() const
 void PITBStyle::SetAlignment(  int alignment )
 {
 	mAlignment = alignment;
+	++mVersion;
 }
 
 
@@ -78,6 +108,10 @@ PITBText::PITBText(PITBStyleID aStyle, Vec2f aPositionScreen, std::string aStrin
 	: mFontStyle( aStyle )
 	, mString( std::move(aString) )
 	, mScreenLocation( aPositionScreen )
+	, mDirty( true )
+	, mStyleVersion( 0 )
+	, mVertexCount( 0 )
+	, mFirstVertex( 0 )
 {
 }
 
@@ -88,6 +122,16 @@ const std::string& PITBText::GetString() const
 }
 
 
+void PITBText::Assign_(std::string_view aString)
+{
+	if (aString != mString)
+	{
+		mString.assign(aString);
+		mDirty = true;
+	}
+}
+
+
 PITBStyleID PITBText::GetStyleID() const
 {
 	return mFontStyle;
@@ -97,6 +141,7 @@ PITBStyleID PITBText::GetStyleID() const
 void PITBText::SetStyleID(PITBStyleID aID)
 {
 	mFontStyle = aID;
+	mDirty = true;
 }
 
 
@@ -109,6 +154,7 @@ Vec2f PITBText::GetScreenLocation() const
 void PITBText::SetScreenLocation( Vec2f aLocation )
 {
 	mScreenLocation = aLocation;
+	mDirty = true;
 }
 
 
@@ -116,14 +162,40 @@ void PITBText::SetScreenLocation( Vec2f aLocation )
 
 
 PITBFontManager::PITBFontManager()
-	: mShaderProgram(nullptr)
+	: mFsBackend(nullptr)
+	, mShaderProgram(nullptr)
+	, mViewPortDimensions{ 0.f, 0.f }
+	, mSdfGeneration(0)
+	, mVao(0)
+	, mVbo(0)
+	, mVboVertices(0)
 {
-	mFs = CreateFons(2048, 2048, FONS_ZERO_TOPLEFT);
+	mFs = CreateFons(kFonsAtlasSize_, kFonsAtlasSize_, FONS_ZERO_TOPLEFT, &mFsBackend, kFonsMaxAtlasSize_);
+
+	glGenVertexArrays(1, &mVao);
+	glGenBuffers(1, &mVbo);
+
+	glBindVertexArray(mVao);
+	glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, x)));
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, colour)));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(PITBFonsVertex), reinterpret_cast<void*>(offsetof(PITBFonsVertex, s)));
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 
 PITBFontManager::~PITBFontManager()
 {
+	glDeleteBuffers(1, &mVbo);
+	glDeleteVertexArrays(1, &mVao);
 	DeleteFons(mFs);
 }
 
@@ -138,6 +210,9 @@ PITBFontManager& PITBFontManager::Get()
 void PITBFontManager::SetShaderProgram(ShaderProgram* aShaderProgram)
 {
 	mShaderProgram = aShaderProgram;
+
+	// A new program hasn't got the viewport yet
+	mViewPortDimensions = { 0.f, 0.f };
 }
 
 
@@ -148,6 +223,7 @@ void PITBFontManager::Update(float fbWidth, float fbHeight)
 		throw std::runtime_error("PBIT Font Manager shader program is not loaded!");
 	}
 
+	mStats = {};
 
 	glUseProgram(mShaderProgram->programId());
 	glDisable(GL_DEPTH_TEST);
@@ -155,41 +231,196 @@ void PITBFontManager::Update(float fbWidth, float fbHeight)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 
-	GLint uViewPortDimensions = glGetUniformLocation( mShaderProgram->programId(), "uViewPortDimensions" );
-	Vec2f viewPortDims{ fbWidth, fbHeight };
-	glUniform2fv(uViewPortDimensions, 1, &viewPortDims.x);
+	// Everything is laid out in pixels, so a resize invalidates every text
+	const bool resized = fbWidth != mViewPortDimensions.x || fbHeight != mViewPortDimensions.y;
+	if (resized)
+	{
+		mViewPortDimensions = { fbWidth, fbHeight };
+		mShaderProgram->setUniform("uViewPortDimensions", mViewPortDimensions);
+	}
 
 	fonsClearState(mFs);
+	mSdfAtlas.BeginFrame();
 
+	bool outgrown = false;
 	for (auto& text : mTexts)
 	{
+		if (resized || text.mStyleVersion != mFontStyles.at(text.GetStyleID().mID).mVersion)
+		{
+			text.mDirty = true;
+		}
+
+		if (text.mDirty)
+		{
+			outgrown |= !LayOut_(text, fbWidth, fbHeight);
+			++mStats.mTextsLaidOut;
+		}
+	}
 
-		const PITBStyle& style = mFontStyles.at(text.GetStyleID().mID);
+	// A full atlas evicts glyphs unused this frame, which unchanged texts
+	// (or ones laid out before) may still point at: lay everything out
+	// again. That marks all their glyphs used, so the next pass evicts
+	// nothing they need and this settles.
+	bool relaidOut = false;
+	for (int pass = 0; pass < kMaxLayoutPasses_ && mSdfGeneration != mSdfAtlas.Generation(); ++pass)
+	{
+		mSdfGeneration = mSdfAtlas.Generation();
+		for (auto& text : mTexts)
+		{
+			outgrown |= !LayOut_(text, fbWidth, fbHeight);
+			++mStats.mTextsLaidOut;
+		}
+		relaidOut = true;
+	}
 
-		// Calculate relative fontsize
-		float relativeFontSize = fbHeight * style.GetFontSize();
+	if (outgrown || resized || relaidOut)
+	{
+		Repack_();
+	}
+	else if (mStats.mTextsLaidOut > 0)
+	{
+		// Rewrite only the ranges that changed
+		glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+		for (auto& text : mTexts)
+		{
+			if (text.mDirty)
+			{
+				glBufferSubData(GL_ARRAY_BUFFER, text.mFirstVertex * sizeof(PITBFonsVertex), text.mQuads.size() * sizeof(PITBFonsVertex), text.mQuads.data());
+				mStats.mVerticesUploaded += text.mQuads.size();
+				text.mDirty = false;
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-		float relativeScreenX = fbWidth * text.mScreenLocation.x;
-		float relativeScreenY = fbHeight * text.mScreenLocation.y;
+	// Glyphs rasterized by the layout above (only ever new ones: they are
+	// rasterized once, for all sizes)
+	mSdfAtlas.Upload();
+
+	if (mVboVertices > 0)
+	{
+		glBindVertexArray(mVao);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, mSdfAtlas.Texture());
+		mShaderProgram->setUniform("uDistanceField", GLint(1));
+		glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mVboVertices));
+		++mStats.mDrawCalls;
+	}
 
-		fonsSetSize(mFs, relativeFontSize);
-		fonsSetFont(mFs, style.GetFont());
-		fonsSetColor(mFs, style.GetColour());
-		fonsSetAlign(mFs, style.GetAlignment());
+	// Immediate text, on top. fonsDrawText() only appends to the backend's
+	// ring; FonsFlushFrame() draws all of it at once.
+	const std::size_t streamedDraws = mFsBackend->stats.draws;
+	mShaderProgram->setUniform("uDistanceField", GLint(0));
+	for (const auto& text : mImmediateTexts)
+	{
+		const float fontSize = ApplyStyle_(mFontStyles.at(text.mStyle.mID), fbHeight);
 
-		fonsDrawText(mFs, relativeScreenX, relativeScreenY + relativeFontSize, text.mString.c_str(), NULL);
+		const char* str = mImmediateChars.data();
+		fonsDrawText(mFs, fbWidth * text.mScreenLocation.x, fbHeight * text.mScreenLocation.y + fontSize, str + text.mBegin, str + text.mEnd);
 	}
+	FonsFlushFrame(mFsBackend);
+	mStats.mDrawCalls += mFsBackend->stats.draws - streamedDraws;
+
+	mImmediateTexts.clear();
+	mImmediateChars.clear();
 
-	glUseProgram(0);
 	glDisable(GL_BLEND);
 	glEnable(GL_DEPTH_TEST);
 }
 
 
+float PITBFontManager::ApplyStyle_(const PITBStyle& aStyle, float fbHeight)
+{
+	// Calculate relative fontsize
+	float relativeFontSize = fbHeight * aStyle.GetFontSize();
+
+	fonsSetSize(mFs, relativeFontSize);
+	fonsSetFont(mFs, aStyle.GetFont());
+	fonsSetColor(mFs, aStyle.GetColour());
+	fonsSetAlign(mFs, aStyle.GetAlignment());
+
+	return relativeFontSize;
+}
+
+
+bool PITBFontManager::LayOut_(PITBText& aText, float fbWidth, float fbHeight)
+{
+	const PITBStyle& style = mFontStyles.at(aText.GetStyleID().mID);
+
+	// Calculate relative fontsize
+	float relativeFontSize = fbHeight * style.GetFontSize();
+
+	float relativeScreenX = fbWidth * aText.mScreenLocation.x;
+	float relativeScreenY = fbHeight * aText.mScreenLocation.y;
+
+	// Same layout as fonsDrawText(), from the distance field atlas
+	const std::size_t range = aText.mQuads.size();
+	aText.mQuads.clear();
+
+	mSdfAtlas.LayOut(mSdfFonts.at(style.GetFont()), aText.mString, relativeScreenX, relativeScreenY + relativeFontSize, relativeFontSize, style.GetAlignment(), style.GetColour(), aText.mQuads);
+
+	aText.mVertexCount = aText.mQuads.size();
+	aText.mStyleVersion = style.mVersion;
+
+	// Pad the rest of the range with degenerate triangles
+	const bool fits = aText.mVertexCount <= range;
+	aText.mQuads.resize(fits ? range : aText.mVertexCount, PITBFonsVertex{});
+
+	return fits;
+}
+
+
+void PITBFontManager::Repack_()
+{
+	mPacked.clear();
+
+	for (auto& text : mTexts)
+	{
+		const std::size_t range = (text.mVertexCount / kRangeGranularity_ + 1) * kRangeGranularity_;
+		text.mQuads.resize(range, PITBFonsVertex{});
+
+		text.mFirstVertex = mPacked.size();
+		mPacked.insert(mPacked.end(), text.mQuads.begin(), text.mQuads.end());
+		text.mDirty = false;
+	}
+
+	mVboVertices = mPacked.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+	glBufferData(GL_ARRAY_BUFFER, mPacked.size() * sizeof(PITBFonsVertex), mPacked.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mStats.mVerticesUploaded += mPacked.size();
+}
+
+
 PITBStyleID PITBFontManager::MakeStyle(const char* aFontPath, float aFontSize, uint32_t aColour, int aAlignment /*= FONS_ALIGN_LEFT*/)
 {
-	int font = fonsAddFont(mFs, aFontPath, aFontPath);
-	mFontStyles.emplace_back(font, aFontSize, aColour, aAlignment);
+	const FontRegistry::FontID file = mFontFiles.Load(aFontPath);
+
+	// First style with this file: both fontstash and the distance field
+	// atlas parse the mapping in place
+	if (file == mFonsFonts.size())
+	{
+		const auto data = mFontFiles.Data(file);
+		int font = fonsAddFontMem(mFs, mFontFiles.Path(file).c_str(), const_cast<unsigned char*>(data.data()), static_cast<int>(data.size()), 0);
+		mFonsFonts.push_back(font);
+
+		if (FONS_INVALID != font)
+		{
+			if (mSdfFonts.size() <= static_cast<std::size_t>(font))
+			{
+				mSdfFonts.resize(font + 1, SdfGlyphAtlas::kInvalidFont);
+			}
+			mSdfFonts[font] = mSdfAtlas.AddFont(data);
+
+			// Its glyphs baked ahead of time, if this is the first font;
+			// anything the bake left out is rasterized as it is used
+			mSdfAtlas.LoadBaked(mSdfFonts[font], BakedAtlasPath_(mFontFiles.Path(file)).c_str());
+		}
+	}
+
+	mFontStyles.emplace_back(mFonsFonts[file], aFontSize, aColour, aAlignment);
 
 	return PITBStyleID(mFontStyles.size() - 1);
 }
@@ -215,3 +446,35 @@ PITBStyle& PITBFontManager::GetStyle( PITBStyleID aID )
 {
 	return mFontStyles.at(aID.mID);
 }
+
+
+const PITBFontStats& PITBFontManager::GetStats() const
+{
+	return mStats;
+}
+
+
+const PITBFonsStats& PITBFontManager::GetStreamingStats() const
+{
+	return mFsBackend->stats;
+}
+
+
+const SdfAtlasStats& PITBFontManager::GetAtlasStats() const
+{
+	return mSdfAtlas.Stats();
+}
+
+
+PITBFontMemory PITBFontManager::GetMemoryUsage() const
+{
+	PITBFontMemory memory;
+	memory.mFontFiles = mFontFiles.MappedBytes();
+	memory.mFontCount = mFontFiles.FontCount();
+	memory.mDistanceFieldAtlas = mSdfAtlas.MemoryBytes();
+
+	// fontstash's copy, and the texture
+	memory.mStreamingAtlas = 2 * static_cast<std::size_t>(mFsBackend->width) * static_cast<std::size_t>(mFsBackend->height);
+
+	return memory;
+}
@@ -7,12 +7,18 @@
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/vec2.hpp"
+#include <array>
 #include <string>
+#include <string_view>
 #include <format>
+#include <utility>
+#include <iterator>
 #include <vector>
 #include <deque>
 #include <unordered_map>
 #include "fontstashbackend.hpp"
+#include "SdfGlyphAtlas.hpp"
+#include "FontRegistry.hpp"
 #include "../support/program.hpp"
 
 
@@ -64,6 +70,10 @@ private:
 	float mFontSize;
 	uint32_t mColour;
 	int mAlignment;
+
+	// Bumped by every setter, so that texts laid out with an older
+	// version know to lay themselves out again
+	uint32_t mVersion;
 };
 
 
@@ -95,12 +105,28 @@ class PITBText
 public:
 	friend class PITBFontManager;
 
+	// Strings up to this long are formatted without touching the heap
+	static constexpr std::size_t kFormatCapacity = 128;
+
 	const std::string& GetString() const;
 
+	// Formats into a buffer on the stack, and only replaces the string (and
+	// has the text laid out again) if that changed it. The string keeps its
+	// capacity, so a live value costs no allocations frame to frame.
 	template <typename... Ts>
 	void SetString(std::format_string<Ts...> fmt, Ts&&... args)
 	{
-		mString = std::format(fmt, std::forward<Ts>(args)...);
+		std::array<char, kFormatCapacity> buffer;
+		const auto result = std::format_to_n(buffer.data(), buffer.size(), fmt, std::forward<Ts>(args)...);
+
+		if (std::cmp_less_equal(result.size, buffer.size()))
+		{
+			Assign_(std::string_view(buffer.data(), static_cast<std::size_t>(result.size)));
+		}
+		else
+		{
+			Assign_(std::vformat(fmt.get(), std::make_format_args(args...)));
+		}
 	}
 
 
@@ -126,10 +152,23 @@ public:
 	PITBText& operator=(PITBText&&) = default;
 
 
+private:
+	void Assign_(std::string_view aString);
+
 private:
 	PITBStyleID mFontStyle;
 	std::string mString;
 	Vec2f mScreenLocation;
+
+	// Retained layout: the glyph quads of the last layout, and where they
+	// live in PITBFontManager's vertex buffer. mQuads is padded with
+	// degenerate triangles to its whole range, so that it can be rewritten
+	// in place while the text doesn't outgrow it.
+	bool mDirty;
+	uint32_t mStyleVersion;
+	std::vector<PITBFonsVertex> mQuads;
+	std::size_t mVertexCount;
+	std::size_t mFirstVertex;
 };
 
 
@@ -154,7 +193,39 @@ private:
 *		 might need it to modify the text.
 *
 *		 Also don't forget to call Update() every frame!!!
+*
+*		 Text is retained: a text is only laid out again when its string, location or style
+*		 changed, or the framebuffer was resized. All texts share one vertex buffer and are
+*		 drawn with a single draw call. Their glyphs are distance fields, rasterized once and
+*		 drawn at any size, so resizing the window doesn't rasterize anything. font-baker bakes
+*		 them ahead of time (next to the font, as .sdfatlas), so most are not even rasterized
+*		 the first time they are used.
+*
+*		 For text that changes every frame anyway, DrawImmediate() skips the bookkeeping: it
+*		 is streamed through fontstash for the next Update() only, also in one draw call.
+*
+*		 Each font file is mapped once however many styles use it, and shared by fontstash
+*		 and the distance field atlas. Both atlases start small and grow as glyphs are added;
+*		 GetMemoryUsage() says how big everything got.
 */
+struct PITBFontStats
+{
+	std::size_t mTextsLaidOut = 0;
+	std::size_t mVerticesUploaded = 0;
+	std::size_t mDrawCalls = 0;
+};
+
+
+// Bytes held by PITBFontManager, for fonts and their glyphs
+struct PITBFontMemory
+{
+	std::size_t mFontFiles = 0;      // Mapped, not copied
+	std::size_t mFontCount = 0;
+	std::size_t mDistanceFieldAtlas = 0;
+	std::size_t mStreamingAtlas = 0; // fontstash's
+};
+
+
 class PITBFontManager
 {
 public:
@@ -176,6 +247,18 @@ public:
 	PITBText& MakeText(PITBStyleID aStyle, Vec2f aPositionRelative, std::string aString);
 
 
+	// Immediate text: drawn by the next Update() only, streamed through
+	// fontstash rather than retained. For overlays that change every frame,
+	// where keeping a layout would be wasted work.
+	template <typename... Ts>
+	void DrawImmediate(PITBStyleID aStyle, Vec2f aPositionRelative, std::format_string<Ts...> fmt, Ts&&... args)
+	{
+		const std::size_t begin = mImmediateChars.size();
+		std::format_to(std::back_inserter(mImmediateChars), fmt, std::forward<Ts>(args)...);
+		mImmediateTexts.push_back({ aStyle, aPositionRelative, begin, mImmediateChars.size() });
+	}
+
+
 	PITBStyleID MakeStyle(const char* aFontPath, float aFontSize, uint32_t aColour, int aAlignment = FONS_ALIGN_LEFT);
 
 
@@ -185,6 +268,18 @@ public:
 	PITBStyle& GetStyle( PITBStyleID aID );
 
 
+	// What the last Update() did
+	const PITBFontStats& GetStats() const;
+
+	// What the streaming (immediate) path has done so far
+	const PITBFonsStats& GetStreamingStats() const;
+
+	// Glyphs rasterized and uploaded for retained text so far
+	const SdfAtlasStats& GetAtlasStats() const;
+
+	PITBFontMemory GetMemoryUsage() const;
+
+
 private:
 	PITBFontManager();
 	~PITBFontManager();
@@ -193,11 +288,54 @@ private:
 	PITBFontManager operator=(PITBFontManager&) = delete;
 
 
+	// Sets fontstash up for aStyle; returns the font size in pixels
+	float ApplyStyle_( const PITBStyle& aStyle, float fbHeight );
+
+	// Lays out aText into its mQuads; returns false if it outgrew its range
+	bool LayOut_( PITBText& aText, float fbWidth, float fbHeight );
+
+	// Gives every text a range sized for its quads (rounded up, so that
+	// small edits fit) and uploads the whole buffer
+	void Repack_();
+
+
 private:
 	FONScontext* mFs;
+	PITBFonsContext* mFsBackend;
 	ShaderProgram* mShaderProgram;
 	std::deque<PITBText> mTexts;
 	std::vector<PITBStyle> mFontStyles;
+
+	Vec2f mViewPortDimensions;
+
+	// Every font file, and its font in fontstash (indexed by FontID)
+	FontRegistry mFontFiles;
+	std::vector<int> mFonsFonts;
+
+	// Retained text is drawn from distance fields, so that resizing doesn't
+	// rasterize anything. Indexed by fontstash's font ID.
+	SdfGlyphAtlas mSdfAtlas;
+	std::vector<SdfGlyphAtlas::FontID> mSdfFonts;
+	std::uint32_t mSdfGeneration;
+
+	// All texts' quads, interleaved, drawn in one go
+	GLuint mVao;
+	GLuint mVbo;
+	std::size_t mVboVertices;
+	std::vector<PITBFonsVertex> mPacked;
+
+	// Queued by DrawImmediate(), all strings in one buffer
+	struct ImmediateText_
+	{
+		PITBStyleID mStyle;
+		Vec2f mScreenLocation;
+		std::size_t mBegin;
+		std::size_t mEnd;
+	};
+	std::vector<ImmediateText_> mImmediateTexts;
+	std::string mImmediateChars;
+
+	PITBFontStats mStats;
 };
 
 
@@ -1,79 +1,749 @@
 #include "Particle.hpp"
 #include "ModelObject.hpp"
+#include "../support/error.hpp"
 #include <stb_image.h>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <print>
 #include <random>
 #include <string>
 
+namespace
+{
+	// Bytes of instance data per particle: position, colour and size
+	constexpr std::size_t kInstanceStride_ = sizeof(Vec3f) + sizeof(Vec4f) + sizeof(float);
+
+	// Must match Particle and DrawCommand in particleSimulate.comp (std430)
+	struct GpuParticle_
+	{
+		Vec4f positionSize;
+		Vec4f colour;
+		Vec4f life;
+	};
+
+	struct DrawArraysIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+
+	// An empty pool: the billboard quad, zero instances
+	constexpr DrawArraysIndirectCommand_ kNoParticles_{ 6, 0, 0, 0 };
+
+	// local_size_x in particleSimulate.comp
+	constexpr std::size_t kSimulateGroupSize_ = 64;
+
+	// Emitters in particleSimulate.comp, and its flags
+	constexpr GLuint kEmittersBinding_ = 13;
+	constexpr std::uint32_t kEmitterActive_ = 1 << 0;
+	constexpr std::uint32_t kEmitterKill_ = 1 << 1;
+}
+
+ParticlePool::ParticlePool( std::size_t aCapacity )
+	: mPositions( aCapacity )
+	, mColours( aCapacity )
+	, mSizes( aCapacity, 0.f )
+	, mLives( aCapacity, 0.f )
+	, mAliveCount( 0 )
+{
+}
+
+
+bool ParticlePool::Spawn( Vec3f aPosition, Vec4f aColour, float aSize, float aLife )
+{
+	if( mAliveCount == mLives.size() )
+	{
+		return false;
+	}
+
+	mPositions[mAliveCount] = aPosition;
+	mColours[mAliveCount] = aColour;
+	mSizes[mAliveCount] = aSize;
+	mLives[mAliveCount] = aLife;
+	mAliveCount++;
+
+	return true;
+}
+
+
+void ParticlePool::Integrate( float aDeltaTime, Vec3f aVelocity, float aFade )
+{
+	const std::size_t count = mAliveCount;
+	const Vec3f step = aDeltaTime * aVelocity;
+	const float fadeStep = aDeltaTime * aFade;
+
+	// Branch free loops over the packed range so that they vectorize
+	Vec3f* __restrict positions = mPositions.data();
+	Vec4f* __restrict colours = mColours.data();
+	float* __restrict lives = mLives.data();
+
+	for( std::size_t i = 0; i < count; i++ )
+	{
+		lives[i] -= aDeltaTime;
+	}
+
+	for( std::size_t i = 0; i < count; i++ )
+	{
+		positions[i].x -= step.x;
+		positions[i].y -= step.y;
+		positions[i].z -= step.z;
+	}
+
+	for( std::size_t i = 0; i < count; i++ )
+	{
+		colours[i].w -= fadeStep;
+	}
+
+	// Remove the dead. Walk backwards so that the particle swapped into a
+	// slot has already been checked.
+	for( std::size_t i = count; i-- > 0; )
+	{
+		if( lives[i] <= 0.f )
+		{
+			Kill( i );
+		}
+	}
+}
+
+
+void ParticlePool::KillAll()
+{
+	mAliveCount = 0;
+}
+
+
+std::size_t ParticlePool::AliveCount() const
+{
+	return mAliveCount;
+}
+
+
+std::size_t ParticlePool::Capacity() const
+{
+	return mLives.size();
+}
+
+
+std::span<const Vec3f> ParticlePool::Positions() const
+{
+	return { mPositions.data(), mAliveCount };
+}
+
+
+std::span<const Vec4f> ParticlePool::Colours() const
+{
+	return { mColours.data(), mAliveCount };
+}
+
+
+std::span<const float> ParticlePool::Sizes() const
+{
+	return { mSizes.data(), mAliveCount };
+}
+
+
+std::span<const float> ParticlePool::Lives() const
+{
+	return { mLives.data(), mAliveCount };
+}
+
+
+void ParticlePool::Kill( std::size_t aIndex )
+{
+	const std::size_t last = mAliveCount - 1;
+
+	mPositions[aIndex] = mPositions[last];
+	mColours[aIndex] = mColours[last];
+	mSizes[aIndex] = mSizes[last];
+	mLives[aIndex] = mLives[last];
+
+	mAliveCount = last;
+}
+
+
+
+GLuint MakeParticleQuadVBO()
+{
+	Vec3f LL = { 0.f, 0.f, 0.f };
+	Vec3f UL = { 0.f, 1.f, 0.f };
+	Vec3f LR = { 1.f, 0.f, 0.f };
+	Vec3f UR = { 1.f, 1.f, 0.f };
+	std::vector<Vec3f> pV = {UL, LL, UR, UR, LL, LR};
+
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, pV.size() * sizeof(Vec3f), pV.data(), GL_STATIC_DRAW);
+
+	return vbo;
+}
+
+GLuint MakeParticleTexCoordsVBO()
+{
+	Vec2f LL = { 0.f, 0.f};
+	Vec2f UL = { 0.f, 1.f};
+	Vec2f LR = { 1.f, 0.f};
+	Vec2f UR = { 1.f, 1.f};
+	std::vector<Vec2f> tV = { UL, LL, UR, UR, LL, LR };
+
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, tV.size() * sizeof(Vec2f), tV.data(), GL_STATIC_DRAW);
+
+	return vbo;
+}
+
+GLuint MakeParticleVAO(GLuint aQuadVBO, GLuint aTexCoordsVBO, GLuint aInstanceVBO, std::size_t aCapacity)
+{
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, aQuadVBO);
+	glVertexAttribPointer(
+		0,
+		3, GL_FLOAT, GL_FALSE,
+		0,
+		0
+	);
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, aTexCoordsVBO);
+	glVertexAttribPointer(
+		1,
+		2, GL_FLOAT, GL_FALSE,
+		0,
+		0
+	);
+	glEnableVertexAttribArray(1);
+
+	// Per-particle attributes, advanced once per instance
+	glBindBuffer(GL_ARRAY_BUFFER, aInstanceVBO);
+	glVertexAttribPointer(
+		2,
+		3, GL_FLOAT, GL_FALSE,
+		0,
+		(void*)0
+	);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+
+	glVertexAttribPointer(
+		3,
+		4, GL_FLOAT, GL_FALSE,
+		0,
+		(void*)(aCapacity * sizeof(Vec3f))
+	);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+
+	glVertexAttribPointer(
+		4,
+		1, GL_FLOAT, GL_FALSE,
+		0,
+		(void*)(aCapacity * (sizeof(Vec3f) + sizeof(Vec4f)))
+	);
+	glEnableVertexAttribArray(4);
+	glVertexAttribDivisor(4, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return vao;
+}
+
+std::size_t ParticleInstanceBufferSize(std::size_t aCapacity)
+{
+	return aCapacity * kInstanceStride_;
+}
+
+void UploadParticleInstances(GLuint aInstanceVBO, std::size_t aCapacity, std::span<const Vec3f> aPositions, std::span<const Vec4f> aColours, std::span<const float> aSizes)
+{
+	const std::size_t count = aPositions.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, aInstanceVBO);
+
+	// Orphan last frame's storage so that we don't wait for the draws that
+	// still read from it
+	glBufferData(GL_ARRAY_BUFFER, aCapacity * kInstanceStride_, nullptr, GL_STREAM_DRAW);
+
+	if (count > 0)
+	{
+		// Packed arrays, so each goes up in one copy
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Vec3f), aPositions.data());
+		glBufferSubData(GL_ARRAY_BUFFER, aCapacity * sizeof(Vec3f), count * sizeof(Vec4f), aColours.data());
+		glBufferSubData(GL_ARRAY_BUFFER, aCapacity * (sizeof(Vec3f) + sizeof(Vec4f)), count * sizeof(float), aSizes.data());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+
+
+GpuParticlePool::GpuParticlePool( std::size_t aCapacity, GLuint aQuadVBO, GLuint aTexCoordsVBO )
+	: mSimulateProgram( { { GL_COMPUTE_SHADER, "assets/cw2/particleSimulate.comp" } } )
+	, mParticleBuffers{ 0, 0 }
+	, mCommandBuffers{ 0, 0 }
+	, mVAOs{ 0, 0 }
+	, mCurrent( 0 )
+	, mEmitterBuffer( 0 )
+	, mCapacity( aCapacity )
+	, mFrame( 0 )
+{
+	glGenBuffers( 2, mParticleBuffers );
+	glGenBuffers( 2, mCommandBuffers );
+	glGenBuffers( 1, &mEmitterBuffer );
+
+	for( unsigned i = 0; i < 2; i++ )
+	{
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mParticleBuffers[i] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, std::max<std::size_t>( mCapacity, 1 ) * sizeof(GpuParticle_), nullptr, GL_DYNAMIC_COPY );
+
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommandBuffers[i] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(kNoParticles_), &kNoParticles_, GL_DYNAMIC_COPY );
+
+		CreateVAO( i, aQuadVBO, aTexCoordsVBO );
+	}
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+
+GpuParticlePool::~GpuParticlePool()
+{
+	glDeleteVertexArrays( 2, mVAOs );
+	glDeleteBuffers( 1, &mEmitterBuffer );
+	glDeleteBuffers( 2, mCommandBuffers );
+	glDeleteBuffers( 2, mParticleBuffers );
+}
+
+
+void GpuParticlePool::Simulate( float aDeltaTime, std::span<const GpuParticleEmitter> aEmitters )
+{
+	if( aEmitters.empty() )
+	{
+		return;
+	}
+
+	const unsigned src = mCurrent;
+	const unsigned dst = 1 - mCurrent;
+
+	// Each emitter's spawns follow the previous one's
+	std::size_t spawnCount = 0;
+	mEmitters.clear();
+	for( GpuParticleEmitter const& emitter : aEmitters )
+	{
+		PSourceParams const& params = *emitter.params;
+		const std::size_t spawns = emitter.active ? emitter.spawnCount : 0;
+
+		mEmitters.push_back( {
+			{ emitter.position.x, emitter.position.y, emitter.position.z, params.spread },
+			params.Colour,
+			{ params.Velocity.x, params.Velocity.y, params.Velocity.z, params.fade },
+			{ params.size, params.lifeTime, 0.f, 0.f },
+			std::uint32_t(spawnCount),
+			std::uint32_t(spawns),
+			(emitter.active ? kEmitterActive_ : 0) | (emitter.kill ? kEmitterKill_ : 0),
+			0
+		} );
+
+		spawnCount += spawns;
+	}
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mEmitterBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, mEmitters.size() * sizeof(Emitter_), mEmitters.data(), GL_STREAM_DRAW );
+
+	// Reset the destination's append counter
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommandBuffers[dst] );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(kNoParticles_), &kNoParticles_ );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	glUseProgram( mSimulateProgram.programId() );
+	glUniform1f( 0, aDeltaTime );
+	glUniform1ui( 1, GLuint(mCapacity) );
+	glUniform1ui( 2, GLuint(spawnCount) );
+	glUniform1ui( 3, mFrame++ );
+	glUniform1ui( 4, GLuint(mEmitters.size()) );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, mParticleBuffers[src] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, mCommandBuffers[src] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 2, mParticleBuffers[dst] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 3, mCommandBuffers[dst] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kEmittersBinding_, mEmitterBuffer );
+
+	// One thread per slot; the shader works out which ones are in use
+	const GLuint groups = GLuint( (mCapacity + kSimulateGroupSize_ - 1) / kSimulateGroupSize_ );
+	if( groups > 0 )
+	{
+		glDispatchCompute( groups, 1, 1 );
+	}
+
+	// Next readers: the draw (attributes + indirect arguments), next
+	// frame's dispatch, and the counter resets (glBufferSubData() in the
+	// next Simulate() and in KillAll())
+	glMemoryBarrier( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	mCurrent = dst;
+}
+
+
+void GpuParticlePool::Reserve( std::size_t aCapacity )
+{
+	if( aCapacity <= mCapacity )
+	{
+		return;
+	}
+
+	// The latest frame's particles go aside while the buffers grow. The
+	// names stay the same, so the VAOs still point at them.
+	const GLsizeiptr oldSize = GLsizeiptr( std::max<std::size_t>( mCapacity, 1 ) * sizeof(GpuParticle_) );
+
+	GLuint scratch = 0;
+	glGenBuffers( 1, &scratch );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, scratch );
+	glBufferData( GL_COPY_WRITE_BUFFER, oldSize, nullptr, GL_STREAM_COPY );
+	glBindBuffer( GL_COPY_READ_BUFFER, mParticleBuffers[mCurrent] );
+	glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize );
+
+	for( unsigned i = 0; i < 2; i++ )
+	{
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mParticleBuffers[i] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, aCapacity * sizeof(GpuParticle_), nullptr, GL_DYNAMIC_COPY );
+	}
+
+	glBindBuffer( GL_COPY_READ_BUFFER, scratch );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mParticleBuffers[mCurrent] );
+	glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize );
+
+	glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	glDeleteBuffers( 1, &scratch );
+
+	mCapacity = aCapacity;
+}
+
+
+void GpuParticlePool::KillAll()
+{
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommandBuffers[mCurrent] );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(kNoParticles_), &kNoParticles_ );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+
+void GpuParticlePool::Draw() const
+{
+	glBindVertexArray( mVAOs[mCurrent] );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffers[mCurrent] );
+	glDrawArraysIndirect( GL_TRIANGLES, nullptr );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+
+std::size_t GpuParticlePool::Capacity() const
+{
+	return mCapacity;
+}
+
+
+ParticlePool GpuParticlePool::ReadBack() const
+{
+	return ReadBack( 0, true );
+}
+
+
+ParticlePool GpuParticlePool::ReadBack( std::size_t aEmitter ) const
+{
+	return ReadBack( aEmitter, false );
+}
+
+
+ParticlePool GpuParticlePool::ReadBack( std::size_t aEmitter, bool aAll ) const
+{
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	DrawArraysIndirectCommand_ command{};
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommandBuffers[mCurrent] );
+	glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), &command );
+
+	std::vector<GpuParticle_> particles( std::min<std::size_t>( command.instanceCount, mCapacity ) );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mParticleBuffers[mCurrent] );
+	glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(GpuParticle_), particles.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	ParticlePool pool( mCapacity );
+	for( auto const& particle : particles )
+	{
+		if( !aAll && std::bit_cast<std::uint32_t>( particle.life.y ) != aEmitter )
+		{
+			continue;
+		}
+
+		const Vec3f position{ particle.positionSize.x, particle.positionSize.y, particle.positionSize.z };
+		pool.Spawn( position, particle.colour, particle.positionSize.w, particle.life.x );
+	}
+
+	return pool;
+}
+
+
+void GpuParticlePool::CreateVAO( unsigned aIndex, GLuint aQuadVBO, GLuint aTexCoordsVBO )
+{
+	glGenVertexArrays( 1, &mVAOs[aIndex] );
+	glBindVertexArray( mVAOs[aIndex] );
+
+	// Same attributes as ParticleSource's VAO, but the per-particle ones
+	// are interleaved in the SSBO
+	glBindBuffer( GL_ARRAY_BUFFER, aQuadVBO );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+	glEnableVertexAttribArray( 0 );
+
+	glBindBuffer( GL_ARRAY_BUFFER, aTexCoordsVBO );
+	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 0, 0 );
+	glEnableVertexAttribArray( 1 );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mParticleBuffers[aIndex] );
+
+	glVertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle_), (void*)offsetof(GpuParticle_, positionSize) );
+	glEnableVertexAttribArray( 2 );
+	glVertexAttribDivisor( 2, 1 );
+
+	glVertexAttribPointer( 3, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticle_), (void*)offsetof(GpuParticle_, colour) );
+	glEnableVertexAttribArray( 3 );
+	glVertexAttribDivisor( 3, 1 );
+
+	glVertexAttribPointer( 4, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle_), (void*)(offsetof(GpuParticle_, positionSize) + 3 * sizeof(float)) );
+	glEnableVertexAttribArray( 4 );
+	glVertexAttribDivisor( 4, 1 );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+
+
+
+
 ParticleSource::ParticleSource(PSourceParams params, std::string tex_path)
-	: mVboVertices(0)
+	: ParticleSource(params, LoadTexture2D(tex_path.c_str()))
+{
+	mOwnsTexture = true;
+}
+
+ParticleSource::ParticleSource(PSourceParams params, GLuint texture, ParticleStorage storage)
+	: mParticles(params.maxParticles > 0 ? std::size_t(params.maxParticles) : 0)
+	, mVboVertices(0)
+	, mTextureCoordsVBO(0)
+	, mInstanceVBO(0)
 	, mParticleVAO(0)
+	, mOwnsTexture(false)
+	, mStorage(storage)
 	, mRandomGenerator(0)
 	, mDistribution(-1.f, 1.f)
+	, mGpuAliveCount(0)
+	, mGpuKill(false)
 {
 	mParams = params;
 	mActive = false;
 	mSourceOrigin = params.SourceOrigin;
 	mSourcePosition = params.SourceOrigin;
-	for (int i = 0; i < params.maxParticles; i++) 
+
+	mTextureID = texture;
+
+	if (storage == ParticleStorage::Shared)
 	{
-		mParticles.push_back(Particle());
+		return;
 	}
-	
-	mTextureID = LoadTexture2D(tex_path.c_str());
+
 	CreatePositionsVBO();
 	CreateTextureCoordsVBO();
-	CreateParticleVAO();
 
+	if (mParams.backend == ParticleBackend::Gpu)
+	{
+		try
+		{
+			mGpuParticles = std::make_unique<GpuParticlePool>(mParticles.Capacity(), mVboVertices, mTextureCoordsVBO);
+		}
+		catch (Error const& eErr)
+		{
+			std::print(stderr, "Compute shader particles unavailable, using the CPU path:\n{}\n", eErr.what());
+			mParams.backend = ParticleBackend::Cpu;
+		}
+	}
+
+	// The GPU pool has buffers of its own
+	if (mParams.backend == ParticleBackend::Cpu)
+	{
+		CreateInstanceVBO();
+		CreateParticleVAO();
+	}
 }
 
-void ParticleSource::UpdateParticles(float dt)
+ParticleSource::~ParticleSource()
 {
-	//spawn particles
-	int spawned = 0;
+	// The GPU pool goes first; it only uses the quad's buffers
+	mGpuParticles.reset();
 
-	if (mActive)
-	{
-		for (size_t i = 0; i < mParticles.size() && spawned < mParams.spawnRate; i++) {
+	glDeleteVertexArrays(1, &mParticleVAO);
+	glDeleteBuffers(1, &mInstanceVBO);
+	glDeleteBuffers(1, &mTextureCoordsVBO);
+	glDeleteBuffers(1, &mVboVertices);
 
-			for (size_t j = 0; j < mParticles.size(); j++) {
+	if (mOwnsTexture)
+	{
+		glDeleteTextures(1, &mTextureID);
+	}
+}
 
-				if (mParticles[j].life <= 0) {
-					SpawnParticle(j, mParams.spread);
-					spawned++;
-					break;
-				}
-			}
+void ParticleSource::UpdateParticles(float dt)
+{
+	UpdateParticles(dt, mParams.spawnRate);
+}
 
+void ParticleSource::UpdateParticles(float dt, int spawnCount)
+{
+	if (mParams.backend == ParticleBackend::Gpu)
+	{
+		if (mGpuParticles && mActive)
+		{
+			const GpuParticleEmitter emitter = AdvanceGpu(dt, spawnCount);
+			mGpuParticles->Simulate(dt, { &emitter, 1 });
 		}
-	
-	
+		return;
+	}
 
-		//update living particles
-		for (size_t i = 0; i < mParticles.size(); i++) 
+	if (mActive)
+	{
+		//spawn particles
+		for (int i = 0; i < spawnCount && mParticles.AliveCount() < mParticles.Capacity(); i++)
 		{
-			mParticles[i].life -= dt;
-			if (mParticles[i].life > 0) 
-			{
-				mParticles[i].Position -= dt * mParams.Velocity;
-				mParticles[i].Colour.w -= dt * mParams.fade;
-			}
-		
+			SpawnParticle(mParams.spread);
 		}
+
+		//update living particles
+		mParticles.Integrate(dt, mParams.Velocity, mParams.fade);
 	}
 
 }
 
-std::vector<Particle> ParticleSource::GetParticles() 
+GpuParticleEmitter ParticleSource::AdvanceGpu(float dt, int spawnCount)
+{
+	GpuParticleEmitter emitter{ &mParams, mSourcePosition, 0, mActive, mGpuKill };
+	mGpuKill = false;
+
+	if (!mActive)
+	{
+		return emitter;
+	}
+
+	emitter.spawnCount = std::min(std::size_t(std::max(spawnCount, 0)), mParticles.Capacity() - mGpuAliveCount);
+
+	// Every particle lives exactly lifeTime, so a batch spawned together
+	// also dies together. Age the batches the same way the shader ages the
+	// particles.
+	mGpuBatches.push_back({ mParams.lifeTime, emitter.spawnCount });
+	mGpuAliveCount += emitter.spawnCount;
+	for (GpuBatch& batch : mGpuBatches)
+	{
+		batch.life -= dt;
+	}
+	while (!mGpuBatches.empty() && mGpuBatches.front().life <= 0.f)
+	{
+		mGpuAliveCount -= mGpuBatches.front().count;
+		mGpuBatches.pop_front();
+	}
+
+	return emitter;
+}
+
+const ParticlePool& ParticleSource::GetParticles() const
 {
 	return mParticles;
 }
 
+ParticlePool ParticleSource::SnapshotParticles() const
+{
+	if (mGpuParticles)
+	{
+		return mGpuParticles->ReadBack();
+	}
+
+	return mParticles;
+}
+
+ParticleBackend ParticleSource::Backend() const
+{
+	return mParams.backend;
+}
+
+std::size_t ParticleSource::AliveCount() const
+{
+	return mParams.backend == ParticleBackend::Gpu ? mGpuAliveCount : mParticles.AliveCount();
+}
+
+const PSourceParams& ParticleSource::GetParams() const
+{
+	return mParams;
+}
+
+void ParticleSource::UploadInstanceData()
+{
+	if (mParams.backend == ParticleBackend::Gpu || mStorage == ParticleStorage::Shared)
+	{
+		return;
+	}
+
+	UploadParticleInstances(mInstanceVBO, mParticles.Capacity(), mParticles.Positions(), mParticles.Colours(), mParticles.Sizes());
+}
+
+GLsizei ParticleSource::InstanceCount() const
+{
+	return GLsizei(mParticles.AliveCount());
+}
+
+void ParticleSource::Draw() const
+{
+	if (mParams.backend == ParticleBackend::Gpu)
+	{
+		// With shared storage, the owner draws them
+		if (mGpuParticles)
+		{
+			mGpuParticles->Draw();
+		}
+		return;
+	}
+
+	if (mStorage == ParticleStorage::Shared)
+	{
+		return;
+	}
+
+	glBindVertexArray(mParticleVAO);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, InstanceCount());
+}
+
 void ParticleSource::DeleteParticles()
 {
-	for (size_t i = 0; i < mParticles.size(); i++) 
+	mParticles.KillAll();
+
+	// With shared storage, the owner drops them with the next AdvanceGpu()
+	if (mGpuParticles)
+	{
+		mGpuParticles->KillAll();
+	}
+	else if (mParams.backend == ParticleBackend::Gpu)
 	{
-		mParticles[i].life = 0;
+		mGpuKill = true;
 	}
+
+	mGpuBatches.clear();
+	mGpuAliveCount = 0;
 }
 
 //getters and setters
@@ -128,67 +798,42 @@ void ParticleSource::SetActive(bool active)
 	mActive = active;
 }
 
+bool ParticleSource::IsActive() const
+{
+	return mActive;
+}
+
 
 //private functions
 void ParticleSource::CreateTextureCoordsVBO() 
 {
-	Vec2f LL = { 0.f, 0.f};
-	Vec2f UL = { 0.f, 1.f};
-	Vec2f LR = { 1.f, 0.f};
-	Vec2f UR = { 1.f, 1.f};
-	std::vector<Vec2f> tV = { UL, LL, UR, UR, LL, LR };
-
-	glGenBuffers(1, &mTextureCoordsVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mTextureCoordsVBO);
-	glBufferData(GL_ARRAY_BUFFER, tV.size() * sizeof(Vec2f), tV.data(), GL_STATIC_DRAW);
+	mTextureCoordsVBO = MakeParticleTexCoordsVBO();
+}
 
+void ParticleSource::CreateInstanceVBO()
+{
+	glGenBuffers(1, &mInstanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, mParticles.Capacity() * kInstanceStride_, nullptr, GL_STREAM_DRAW);
 }
 
 void ParticleSource::CreatePositionsVBO() 
 {
-	Vec3f LL = { 0.f, 0.f, 0.f };
-	Vec3f UL = { 0.f, 1.f, 0.f };
-	Vec3f LR = { 1.f, 0.f, 0.f };
-	Vec3f UR = { 1.f, 1.f, 0.f };
-	std::vector<Vec3f> pV = {UL, LL, UR, UR, LL, LR};
-
-	glGenBuffers(1, &mVboVertices);
-	glBindBuffer(GL_ARRAY_BUFFER, mVboVertices);
-	glBufferData(GL_ARRAY_BUFFER, pV.size() * sizeof(Vec3f), pV.data(), GL_STATIC_DRAW);
-
+	mVboVertices = MakeParticleQuadVBO();
 }
 
 void ParticleSource::CreateParticleVAO() 
 {
-	glGenVertexArrays(1, &mParticleVAO);
-	glBindVertexArray(mParticleVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, mVboVertices);
-	glVertexAttribPointer(
-		0,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, mTextureCoordsVBO);
-	glVertexAttribPointer(
-		1,
-		2, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(1);
+	mParticleVAO = MakeParticleVAO(mVboVertices, mTextureCoordsVBO, mInstanceVBO, mParticles.Capacity());
 }
 
-void ParticleSource::SpawnParticle(int pIndex, float spread)
+void ParticleSource::SpawnParticle(float spread)
 {
-	mParticles[pIndex].life = mParams.lifeTime;
-	mParticles[pIndex].Colour = mParams.Colour;
-
 	float rndx = mDistribution(mRandomGenerator);
 	float rndy = mDistribution(mRandomGenerator);
 	float rndz = mDistribution(mRandomGenerator);
 
-	mParticles[pIndex].Position = Vec3f{ spread * rndx, spread * rndy, spread * rndz } + mSourcePosition;
+	Vec3f position = Vec3f{ spread * rndx, spread * rndy, spread * rndz } + mSourcePosition;
+
+	mParticles.Spawn(position, mParams.Colour, mParams.size, mParams.lifeTime);
 }
\ No newline at end of file
@@ -5,19 +5,24 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/vec2.hpp"
 
+#include "../support/program.hpp"
+
 #include "glad/glad.h"
+#include <span>
+#include <deque>
+#include <memory>
+#include <cstdint>
 #include <vector>
 #include <random>
+#include <string>
+#include <cstddef>
 
-struct Particle 
+// Where a ParticleSource runs its simulation. The CPU path is the reference
+// implementation and the fallback if the compute shader can't be built.
+enum class ParticleBackend
 {
-	Vec3f Position;
-	Vec4f Colour;
-	float life;
-
-	Particle()
-		: Position(0.f), Colour({1.f, 1.f, 1.f, 1.f}), life(0.f) {
-	}
+	Cpu,
+	Gpu
 };
 
 struct PSourceParams 
@@ -28,18 +33,246 @@ struct PSourceParams
 	float spread;
 	float lifeTime;
 	float fade;
+	float size;
 	int maxParticles;
 	int spawnRate;
+	ParticleBackend backend = ParticleBackend::Cpu;
+};
+
+// ===========================================================================
+//		ParticlePool
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Structure of arrays particle storage. Living particles are kept packed in
+//	[0, AliveCount()), so spawning is an append and a dying particle is
+//	swapped with the last living one. Nothing is ever scanned for a free slot
+//	and the arrays can be handed to the renderer as they are (see
+//	ParticleSource::UploadInstanceData()).
+// ---------------------------------------------------------------------------
+class ParticlePool
+{
+public:
+	explicit ParticlePool( std::size_t aCapacity );
+
+	// Returns false (and does nothing) if the pool is full
+	bool Spawn( Vec3f aPosition, Vec4f aColour, float aSize, float aLife );
+
+	// Moves every living particle by -dt * velocity, fades it and removes
+	// the ones whose life ran out.
+	void Integrate( float aDeltaTime, Vec3f aVelocity, float aFade );
+
+	void KillAll();
+
+	std::size_t AliveCount() const;
+	std::size_t Capacity() const;
+
+	// Views over the living particles only
+	std::span<const Vec3f> Positions() const;
+	std::span<const Vec4f> Colours() const;
+	std::span<const float> Sizes() const;
+	std::span<const float> Lives() const;
+
+private:
+	void Kill( std::size_t aIndex );
+
+private:
+	std::vector<Vec3f> mPositions;
+	std::vector<Vec4f> mColours;
+	std::vector<float> mSizes;
+	std::vector<float> mLives;
+	std::size_t mAliveCount;
+};
+
+
+// Building blocks for drawing particles with particleShader.vert, shared by
+// ParticleSource and ParticleSystem.
+//
+// The billboard quad is 6 vertices: positions in attribute 0 and texture
+// coordinates in attribute 1. The per-particle attributes (2-4) come from an
+// instance buffer holding three arrays back to back,
+// [ positions | colours | sizes ], each aCapacity elements long.
+GLuint MakeParticleQuadVBO();
+GLuint MakeParticleTexCoordsVBO();
+GLuint MakeParticleVAO(GLuint aQuadVBO, GLuint aTexCoordsVBO, GLuint aInstanceVBO, std::size_t aCapacity);
+
+std::size_t ParticleInstanceBufferSize(std::size_t aCapacity);
+
+// Orphans the buffer and uploads the three arrays (all the same length, at
+// most aCapacity)
+void UploadParticleInstances(GLuint aInstanceVBO, std::size_t aCapacity, std::span<const Vec3f> aPositions, std::span<const Vec4f> aColours, std::span<const float> aSizes);
+
+
+// One emitter's part in a frame of GpuParticlePool::Simulate()
+struct GpuParticleEmitter
+{
+	const PSourceParams* params;
+	Vec3f position;
+	std::size_t spawnCount;
+
+	// Inactive emitters neither spawn nor age their particles
+	bool active;
+
+	// Drop the emitter's particles from last frame
+	bool kill;
+};
+
+
+// ===========================================================================
+//		GpuParticlePool
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Particle storage and simulation on the GPU (particleSimulate.comp). The
+//	particles live in two SSBOs that are ping-ponged every frame: the compute
+//	shader reads last frame's buffer, spawns and integrates, and appends the
+//	survivors to the other one. Each buffer has a matching
+//	DrawArraysIndirectCommand whose instanceCount is the append counter, so
+//	Draw() never needs the particle count on the CPU.
+//
+//	Any number of emitters can share a pool, so that they are simulated with
+//	one dispatch and drawn with one indirect draw (see ParticleSystem). Each
+//	particle remembers which of Simulate()'s emitters it came from, so they
+//	must be passed in the same order every frame.
+// ---------------------------------------------------------------------------
+class GpuParticlePool
+{
+public:
+	// aQuadVBO and aTexCoordsVBO are the billboard quad (6 vertices) that
+	// each particle is drawn with. They are not owned by the pool.
+	GpuParticlePool( std::size_t aCapacity, GLuint aQuadVBO, GLuint aTexCoordsVBO );
+	~GpuParticlePool();
+
+	GpuParticlePool( GpuParticlePool const& ) = delete;
+	GpuParticlePool& operator= ( GpuParticlePool const& ) = delete;
+
+	// One frame: spawn each emitter's particles at its position (if there
+	// is room), then integrate as ParticlePool::Integrate() does. Leaves
+	// the compute program bound.
+	void Simulate( float aDeltaTime, std::span<const GpuParticleEmitter> aEmitters );
+
+	// Grows the pool to aCapacity, keeping the particles
+	void Reserve( std::size_t aCapacity );
+
+	void KillAll();
+
+	// Issues one indirect instanced draw with particleShader.vert. Binds its
+	// own VAO.
+	void Draw() const;
+
+	std::size_t Capacity() const;
+
+	// Copies the living particles back into a CPU pool, all of them or
+	// those of one emitter (by its index in Simulate()). This stalls the
+	// pipeline, so it is meant for tests and debugging only.
+	ParticlePool ReadBack() const;
+	ParticlePool ReadBack( std::size_t aEmitter ) const;
+
+private:
+	// Must match Emitter in particleSimulate.comp (std430)
+	struct Emitter_
+	{
+		Vec4f positionSpread;
+		Vec4f colour;
+		Vec4f velocityFade;
+		Vec4f sizeLife;
+		std::uint32_t spawnFirst;
+		std::uint32_t spawnCount;
+		std::uint32_t flags;
+		std::uint32_t pad;
+	};
+
+	static_assert( sizeof(Emitter_) == 80 );
+
+private:
+	void CreateVAO( unsigned aIndex, GLuint aQuadVBO, GLuint aTexCoordsVBO );
+	ParticlePool ReadBack( std::size_t aEmitter, bool aAll ) const;
+
+private:
+	ShaderProgram mSimulateProgram;
+
+	// Ping-pong pair; [mCurrent] holds the latest frame
+	GLuint mParticleBuffers[2];
+	GLuint mCommandBuffers[2];
+	GLuint mVAOs[2];
+	unsigned mCurrent;
+
+	GLuint mEmitterBuffer;
+	std::vector<Emitter_> mEmitters;
+
+	std::size_t mCapacity;
+	std::uint32_t mFrame;
+};
+
+
+
+// Where a ParticleSource's particles are drawn from and, on the GPU,
+// simulated
+enum class ParticleStorage
+{
+	Own,   // Its own instance buffer and VAO, or GpuParticlePool
+	Shared // Its owner's, shared with other sources (see ParticleSystem). The
+	       // source creates no GL objects.
 };
 
 class ParticleSource 
 {
 public:
+	// Loads the texture, which the source then owns
 	explicit ParticleSource(PSourceParams params, std::string tex_path);
+
+	// Uses an existing texture, e.g. one shared by many emitters. The
+	// texture is not owned by the source.
+	explicit ParticleSource(PSourceParams params, GLuint texture, ParticleStorage storage = ParticleStorage::Own);
+
+	~ParticleSource();
+
+	ParticleSource(const ParticleSource&) = delete;
+	ParticleSource& operator=(const ParticleSource&) = delete;
 	
 	void UpdateParticles(float dt);
 
-	std::vector<Particle> GetParticles();
+	// As above, but spawns at most spawnCount particles instead of
+	// params.spawnRate (see ParticleSystem). The CPU backend touches
+	// nothing but this source, so different sources can be updated on
+	// different threads. The GPU backend issues GL calls, and does
+	// nothing with shared storage, where the owner uses AdvanceGpu().
+	void UpdateParticles(float dt, int spawnCount);
+
+	// GPU backend: this frame's part in a GpuParticlePool::Simulate(), with
+	// at most spawnCount new particles. Keeps AliveCount() up to date, so
+	// it must go with every Simulate() (UpdateParticles() calls it for the
+	// source's own pool).
+	GpuParticleEmitter AdvanceGpu(float dt, int spawnCount);
+
+	// CPU backend only; empty when the simulation runs on the GPU
+	const ParticlePool& GetParticles() const;
+
+	// Copy of the living particles from either backend. Reads back from
+	// the GPU if needed (slow). Empty with shared storage on the GPU (see
+	// ParticleSystem::SnapshotParticles()).
+	ParticlePool SnapshotParticles() const;
+
+	ParticleBackend Backend() const;
+
+	// Living particles. Exact on the CPU backend; on the GPU backend it is
+	// worked out from the spawn history, without reading anything back.
+	std::size_t AliveCount() const;
+
+	const PSourceParams& GetParams() const;
+
+	// Streams the living particles into the instance buffer. Call once per
+	// frame after UpdateParticles(). Does nothing on the GPU backend, where
+	// the data never leaves the GPU, or with shared storage.
+	void UploadInstanceData();
+
+	// Number of particles Draw() will render (CPU backend)
+	GLsizei InstanceCount() const;
+
+	// One instanced draw of all particles with particleShader.vert. Binds
+	// the VAO; the caller sets up the program, uniforms and texture. Does
+	// nothing with shared storage, where the owner draws them.
+	void Draw() const;
 
 	void DeleteParticles();
 
@@ -62,32 +295,53 @@ public:
 
 	void SetActive(bool active);
 
+	bool IsActive() const;
+
 private:
 	void CreatePositionsVBO();
 
 	void CreateTextureCoordsVBO();
 
+	void CreateInstanceVBO();
+
 	void CreateParticleVAO();
 
-	void SpawnParticle(int pIndex, float spread);
+	void SpawnParticle(float spread);
 
 
 private:
-	std::vector<Particle> mParticles;
+	ParticlePool mParticles;
+	std::unique_ptr<GpuParticlePool> mGpuParticles;
 	Vec3f mSourceOrigin;
 	Vec3f mSourcePosition;
 	Vec3f mRelativePositionToParent; //whatever parent you decide (in this case ship)
 
 	GLuint mVboVertices;
 	GLuint mTextureCoordsVBO;
+	GLuint mInstanceVBO;
 	GLuint mParticleVAO;
 	GLuint mTextureID;
+	bool mOwnsTexture;
+	ParticleStorage mStorage;
 
 	std::default_random_engine mRandomGenerator;
 	std::uniform_real_distribution<float> mDistribution;
 
 	PSourceParams mParams;
 	bool mActive;
+
+	// GPU backend bookkeeping for AliveCount(): particles spawned together
+	// die together, lifeTime later
+	struct GpuBatch
+	{
+		float life;
+		std::size_t count;
+	};
+	std::deque<GpuBatch> mGpuBatches;
+	std::size_t mGpuAliveCount;
+
+	// DeleteParticles() since the last AdvanceGpu()
+	bool mGpuKill;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "ParticleSystem.hpp"
+#include "ModelObject.hpp"
+
+#include "../support/error.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <print>
+
+ParticleSystem::ParticleSystem( ParticleBudget aBudget, unsigned aWorkerThreads )
+	: mBudget( aBudget )
+	, mWorkers( aWorkerThreads )
+	, mQuadVBO( MakeParticleQuadVBO() )
+	, mTexCoordsVBO( MakeParticleTexCoordsVBO() )
+	, mAliveCount( 0 )
+{
+}
+
+
+ParticleSystem::~ParticleSystem()
+{
+	for( Batch_& batch : mBatches )
+	{
+		glDeleteVertexArrays( 1, &batch.vao );
+		glDeleteBuffers( 1, &batch.instanceVBO );
+		glDeleteTextures( 1, &batch.texture );
+	}
+
+	glDeleteBuffers( 1, &mQuadVBO );
+	glDeleteBuffers( 1, &mTexCoordsVBO );
+}
+
+
+ParticleSystem::EmitterID ParticleSystem::AddEmitter( PSourceParams aParams, std::string const& aTexturePath, float aPriority )
+{
+	// Textures are loaded once and shared by everything in the batch
+	auto batchIt = std::find_if( mBatches.begin(), mBatches.end(), [&] ( Batch_ const& aBatch ) {
+		return aBatch.texturePath == aTexturePath;
+	} );
+
+	if( batchIt == mBatches.end() )
+	{
+		Batch_& batch = mBatches.emplace_back();
+		batch.texturePath = aTexturePath;
+		batch.texture = LoadTexture2D( aTexturePath.c_str() );
+		batch.capacity = 0;
+		batch.instanceVBO = 0;
+		batch.vao = 0;
+		batch.instanceCount = 0;
+
+		batchIt = mBatches.end() - 1;
+	}
+
+	Batch_& batch = *batchIt;
+	const EmitterID id = mEmitters.size();
+
+	// GPU emitters go into the batch's pool, which grows to fit them. If
+	// the compute shader can't be built, they fall back to the CPU.
+	if( ParticleBackend::Gpu == aParams.backend )
+	{
+		const std::size_t capacity = aParams.maxParticles > 0 ? std::size_t(aParams.maxParticles) : 0;
+
+		try
+		{
+			if( batch.gpuPool )
+			{
+				batch.gpuPool->Reserve( batch.gpuPool->Capacity() + capacity );
+			}
+			else
+			{
+				batch.gpuPool = std::make_unique<GpuParticlePool>( capacity, mQuadVBO, mTexCoordsVBO );
+			}
+		}
+		catch( Error const& eErr )
+		{
+			std::print( stderr, "Compute shader particles unavailable, using the CPU path:\n{}\n", eErr.what() );
+			aParams.backend = ParticleBackend::Cpu;
+		}
+	}
+
+	Emitter_& emitter = mEmitters.emplace_back();
+	emitter.source = std::make_unique<ParticleSource>( aParams, batch.texture, ParticleStorage::Shared );
+	emitter.priority = aPriority;
+	emitter.spawnWanted = 0.f;
+	emitter.demand = 0.f;
+	emitter.spawnCarry = 0.f;
+	emitter.spawnCount = 0;
+
+	if( ParticleBackend::Gpu == emitter.source->Backend() )
+	{
+		batch.gpuEmitters.push_back( id );
+		return id;
+	}
+
+	batch.cpuEmitters.push_back( id );
+
+	// Grow the batch's instance buffer to fit the new emitter
+	batch.capacity += emitter.source->GetParticles().Capacity();
+
+	glDeleteVertexArrays( 1, &batch.vao );
+	glDeleteBuffers( 1, &batch.instanceVBO );
+
+	glGenBuffers( 1, &batch.instanceVBO );
+	glBindBuffer( GL_ARRAY_BUFFER, batch.instanceVBO );
+	glBufferData( GL_ARRAY_BUFFER, ParticleInstanceBufferSize( batch.capacity ), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	batch.vao = MakeParticleVAO( mQuadVBO, mTexCoordsVBO, batch.instanceVBO, batch.capacity );
+
+	batch.positions.reserve( batch.capacity );
+	batch.colours.reserve( batch.capacity );
+	batch.sizes.reserve( batch.capacity );
+
+	return id;
+}
+
+
+ParticleSource& ParticleSystem::Emitter( EmitterID aEmitter )
+{
+	return *mEmitters[aEmitter].source;
+}
+
+
+const ParticleSource& ParticleSystem::Emitter( EmitterID aEmitter ) const
+{
+	return *mEmitters[aEmitter].source;
+}
+
+
+std::size_t ParticleSystem::EmitterCount() const
+{
+	return mEmitters.size();
+}
+
+
+ParticlePool ParticleSystem::SnapshotParticles( EmitterID aEmitter ) const
+{
+	ParticleSource const& source = *mEmitters[aEmitter].source;
+	if( ParticleBackend::Cpu == source.Backend() )
+	{
+		return source.SnapshotParticles();
+	}
+
+	// Its index in the pool is the one in the batch
+	for( Batch_ const& batch : mBatches )
+	{
+		auto const it = std::find( batch.gpuEmitters.begin(), batch.gpuEmitters.end(), aEmitter );
+		if( it != batch.gpuEmitters.end() )
+		{
+			return batch.gpuPool->ReadBack( std::size_t(it - batch.gpuEmitters.begin()) );
+		}
+	}
+
+	return ParticlePool( 0 );
+}
+
+
+void ParticleSystem::SetActive( bool aActive )
+{
+	for( Emitter_& emitter : mEmitters )
+	{
+		emitter.source->SetActive( aActive );
+	}
+}
+
+
+void ParticleSystem::ToggleActive()
+{
+	for( Emitter_& emitter : mEmitters )
+	{
+		emitter.source->ToggleActive();
+	}
+}
+
+
+void ParticleSystem::DeleteParticles()
+{
+	for( Emitter_& emitter : mEmitters )
+	{
+		emitter.source->DeleteParticles();
+		emitter.spawnCarry = 0.f;
+	}
+
+	for( Batch_& batch : mBatches )
+	{
+		batch.instanceCount = 0;
+
+		if( batch.gpuPool )
+		{
+			batch.gpuPool->KillAll();
+		}
+	}
+
+	mAliveCount = 0;
+}
+
+
+void ParticleSystem::Update( float aDeltaTime, std::span<const Vec3f> aViewerPositions )
+{
+	AllocateSpawns( aDeltaTime, aViewerPositions );
+
+	// GPU emitters issue GL calls, so they stay on this thread: one
+	// dispatch per batch. A batch whose emitters are all inactive (and have
+	// nothing to drop) is left as it is.
+	for( Batch_& batch : mBatches )
+	{
+		batch.gpuFrame.clear();
+		bool changed = false;
+		for( EmitterID id : batch.gpuEmitters )
+		{
+			GpuParticleEmitter const& emitter = batch.gpuFrame.emplace_back( mEmitters[id].source->AdvanceGpu( aDeltaTime, mEmitters[id].spawnCount ) );
+			changed = changed || emitter.active || emitter.kill;
+		}
+
+		if( changed )
+		{
+			batch.gpuPool->Simulate( aDeltaTime, batch.gpuFrame );
+		}
+	}
+
+	// CPU emitters only touch their own pools
+	mWorkers.ParallelFor( mEmitters.size(), [&] ( std::size_t aIndex ) {
+		Emitter_& emitter = mEmitters[aIndex];
+		if( ParticleBackend::Cpu == emitter.source->Backend() )
+		{
+			emitter.source->UpdateParticles( aDeltaTime, emitter.spawnCount );
+		}
+	} );
+
+	mAliveCount = 0;
+	for( Emitter_ const& emitter : mEmitters )
+	{
+		mAliveCount += emitter.source->AliveCount();
+	}
+
+	for( Batch_& batch : mBatches )
+	{
+		UploadBatch( batch );
+	}
+}
+
+
+void ParticleSystem::Draw() const
+{
+	for( Batch_ const& batch : mBatches )
+	{
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, batch.texture );
+
+		if( batch.instanceCount > 0 )
+		{
+			glBindVertexArray( batch.vao );
+			glDrawArraysInstanced( GL_TRIANGLES, 0, 6, batch.instanceCount );
+		}
+
+		if( !batch.gpuEmitters.empty() )
+		{
+			batch.gpuPool->Draw();
+		}
+	}
+}
+
+
+std::size_t ParticleSystem::AliveCount() const
+{
+	return mAliveCount;
+}
+
+
+const ParticleBudget& ParticleSystem::Budget() const
+{
+	return mBudget;
+}
+
+
+void ParticleSystem::SetBudget( ParticleBudget aBudget )
+{
+	mBudget = aBudget;
+}
+
+
+void ParticleSystem::AllocateSpawns( float aDeltaTime, std::span<const Vec3f> aViewerPositions )
+{
+	// What each emitter would spawn this frame, given how far away it is,
+	// and how many particles that keeps alive once it has settled
+	float totalDemand = 0.f;
+	float totalWeightedDemand = 0.f;
+
+	for( Emitter_& emitter : mEmitters )
+	{
+		ParticleSource const& source = *emitter.source;
+
+		emitter.spawnWanted = 0.f;
+		emitter.demand = 0.f;
+		if( !source.IsActive() )
+		{
+			continue;
+		}
+
+		float distance = aViewerPositions.empty() ? 0.f : std::numeric_limits<float>::max();
+		for( Vec3f const& viewer : aViewerPositions )
+		{
+			distance = std::min( distance, length( source.GetPosition() - viewer ) );
+		}
+
+		float falloff = 1.f;
+		if( distance >= mBudget.cullDistance )
+		{
+			falloff = 0.f;
+		}
+		else if( distance > mBudget.fullRateDistance )
+		{
+			falloff = (mBudget.cullDistance - distance) / (mBudget.cullDistance - mBudget.fullRateDistance);
+		}
+
+		PSourceParams const& params = source.GetParams();
+		emitter.spawnWanted = float(std::max( params.spawnRate, 0 )) * falloff;
+
+		const float framesAlive = aDeltaTime > 0.f ? std::ceil( params.lifeTime / aDeltaTime ) : 1.f;
+		emitter.demand = std::min( emitter.spawnWanted * framesAlive, float(source.GetParticles().Capacity()) );
+
+		totalDemand += emitter.demand;
+		totalWeightedDemand += emitter.demand * emitter.priority;
+	}
+
+	// Over budget: every emitter gets a share of the budget by priority
+	// (and demand), and only spawns to refill its share. Handing out just
+	// the room that is free each frame would not work: the deaths free up
+	// exactly what the same emitters need to respawn, so whoever filled up
+	// first would keep their particles.
+	if( totalDemand > float(mBudget.maxParticles) && totalWeightedDemand > 0.f )
+	{
+		for( Emitter_& emitter : mEmitters )
+		{
+			const float quota = float(mBudget.maxParticles) * emitter.demand * emitter.priority / totalWeightedDemand;
+			const float refill = std::max( quota - float(emitter.source->AliveCount()), 0.f );
+			emitter.spawnWanted = std::min( emitter.spawnWanted, refill );
+		}
+	}
+
+	// Shares can be over-full for a while (e.g. after a priority change),
+	// and carried fractions round up, so the free room is a hard limit too.
+	// The alive count is last frame's, before this frame's deaths, so this
+	// errs on the safe side.
+	std::size_t room = mAliveCount < mBudget.maxParticles ? mBudget.maxParticles - mAliveCount : 0;
+
+	for( Emitter_& emitter : mEmitters )
+	{
+		emitter.spawnCarry += emitter.spawnWanted;
+		emitter.spawnCount = int(std::min( std::size_t(std::floor( emitter.spawnCarry )), room ));
+		emitter.spawnCarry = std::min( emitter.spawnCarry - float(emitter.spawnCount), 1.f );
+
+		room -= std::size_t(emitter.spawnCount);
+	}
+}
+
+
+void ParticleSystem::UploadBatch( Batch_& aBatch )
+{
+	aBatch.positions.clear();
+	aBatch.colours.clear();
+	aBatch.sizes.clear();
+
+	for( EmitterID id : aBatch.cpuEmitters )
+	{
+		ParticlePool const& particles = mEmitters[id].source->GetParticles();
+		aBatch.positions.insert( aBatch.positions.end(), particles.Positions().begin(), particles.Positions().end() );
+		aBatch.colours.insert( aBatch.colours.end(), particles.Colours().begin(), particles.Colours().end() );
+		aBatch.sizes.insert( aBatch.sizes.end(), particles.Sizes().begin(), particles.Sizes().end() );
+	}
+
+	aBatch.instanceCount = GLsizei(aBatch.positions.size());
+
+	if( !aBatch.cpuEmitters.empty() )
+	{
+		UploadParticleInstances( aBatch.instanceVBO, aBatch.capacity, aBatch.positions, aBatch.colours, aBatch.sizes );
+	}
+}
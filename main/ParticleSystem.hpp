@@ -0,0 +1,150 @@
+#ifndef PARTICLE_SYSTEM_HPP
+#define PARTICLE_SYSTEM_HPP
+
+#include "Particle.hpp"
+#include "ThreadPool.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ParticleBudget
+{
+	// Particles alive at once, over all emitters
+	std::size_t maxParticles;
+
+	// Emitters within this distance of a viewer spawn at their full rate.
+	// Beyond it the rate falls off linearly, down to nothing at
+	// cullDistance.
+	float fullRateDistance;
+	float cullDistance;
+};
+
+// ===========================================================================
+//		ParticleSystem
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Owns all particle emitters and updates them once per frame, however
+//	many views are drawn.
+//
+//	Update() first decides how many particles each emitter may spawn: its
+//	spawn rate, scaled down with the distance to the nearest viewer. If that
+//	would keep more particles alive than the global budget allows, each
+//	emitter only refills its share of the budget, weighted by its priority.
+//	The CPU emitters are then updated in parallel on a thread pool, and the
+//	ones that share a texture are packed into one
+//	instance buffer, so Draw() is a single instanced draw per texture. GPU
+//	emitters that share a texture share a GpuParticlePool too: one dispatch
+//	on the calling thread simulates them all, and one indirect draw draws
+//	them, in the same texture batch.
+// ---------------------------------------------------------------------------
+class ParticleSystem
+{
+public:
+	using EmitterID = std::size_t;
+
+	explicit ParticleSystem( ParticleBudget aBudget, unsigned aWorkerThreads = ThreadPool::DefaultWorkerCount() );
+	~ParticleSystem();
+
+	ParticleSystem( ParticleSystem const& ) = delete;
+	ParticleSystem& operator= ( ParticleSystem const& ) = delete;
+
+	// Emitters with the same texture path are drawn together. Higher
+	// priority emitters get a larger share of the budget when it runs out.
+	EmitterID AddEmitter( PSourceParams aParams, std::string const& aTexturePath, float aPriority = 1.f );
+
+	ParticleSource& Emitter( EmitterID aEmitter );
+	const ParticleSource& Emitter( EmitterID aEmitter ) const;
+	std::size_t EmitterCount() const;
+
+	// Copy of the emitter's living particles, read back from the GPU if
+	// needed (slow; for tests and debugging)
+	ParticlePool SnapshotParticles( EmitterID aEmitter ) const;
+
+	// Applied to all emitters
+	void SetActive( bool aActive );
+	void ToggleActive();
+	void DeleteParticles();
+
+	// Once per frame. aViewerPositions are the world space positions of the
+	// cameras that will see the particles this frame.
+	void Update( float aDeltaTime, std::span<const Vec3f> aViewerPositions );
+
+	// Once per view. The caller binds particleShader and sets its uniforms;
+	// this binds the VAOs and texture unit 0.
+	void Draw() const;
+
+	// Over all emitters, as of the last Update()
+	std::size_t AliveCount() const;
+
+	const ParticleBudget& Budget() const;
+	void SetBudget( ParticleBudget aBudget );
+
+private:
+	struct Emitter_
+	{
+		std::unique_ptr<ParticleSource> source;
+		float priority;
+
+		// This frame's spawns. The fraction of a particle is carried over
+		// between frames, so that throttled rates below one per frame
+		// still spawn.
+		float spawnWanted;
+		float spawnCarry;
+
+		// Particles alive at spawnWanted per frame, in the steady state
+		float demand;
+		int spawnCount;
+	};
+
+	// Emitters sharing a texture
+	struct Batch_
+	{
+		std::string texturePath;
+		GLuint texture;
+
+		std::vector<EmitterID> cpuEmitters;
+		std::vector<EmitterID> gpuEmitters;
+
+		// The particles of all gpuEmitters, in that order, and their part
+		// in this frame's simulation
+		std::unique_ptr<GpuParticlePool> gpuPool;
+		std::vector<GpuParticleEmitter> gpuFrame;
+
+		// Instance data of all cpuEmitters, packed together
+		std::size_t capacity;
+		GLuint instanceVBO;
+		GLuint vao;
+		GLsizei instanceCount;
+
+		std::vector<Vec3f> positions;
+		std::vector<Vec4f> colours;
+		std::vector<float> sizes;
+	};
+
+private:
+	void AllocateSpawns( float aDeltaTime, std::span<const Vec3f> aViewerPositions );
+	void UploadBatch( Batch_& aBatch );
+
+private:
+	ParticleBudget mBudget;
+	ThreadPool mWorkers;
+
+	std::vector<Emitter_> mEmitters;
+	std::vector<Batch_> mBatches;
+
+	// Shared by all batches
+	GLuint mQuadVBO;
+	GLuint mTexCoordsVBO;
+
+	std::size_t mAliveCount;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "RenderQueue.hpp"
+
+#include "../support/program.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace
+{
+	constexpr int kPassShift_ = 62;
+	constexpr int kDepthBits_ = 24;
+	constexpr std::uint64_t kDepthMax_ = (std::uint64_t(1) << kDepthBits_) - 1;
+
+	// program:10 texture:12 vertex array:12, from the top of 34 bits
+	std::uint64_t StateBits_( const RenderPacket& aPacket )
+	{
+		const GLuint program = aPacket.program ? aPacket.program->programId() : 0;
+		return (std::uint64_t(program & 0x3ff) << 24)
+			| (std::uint64_t(aPacket.texture & 0xfff) << 12)
+			| std::uint64_t(aPacket.vertexArray & 0xfff);
+	}
+}
+
+
+void RenderQueue::BeginView( Vec3f aEye, float aFarDistance )
+{
+	mEye = aEye;
+	mFarDistance = aFarDistance > 0.f ? aFarDistance : 1.f;
+
+	mPackets.clear();
+	mItems.clear();
+}
+
+
+void RenderQueue::Submit( RenderPacket aPacket )
+{
+	const float depth = length( aPacket.position - mEye ) / mFarDistance;
+	const auto sequence = std::uint32_t(mPackets.size());
+
+	mItems.push_back({ MakeKey( aPacket, depth, sequence ), sequence });
+	mPackets.push_back( std::move(aPacket) );
+}
+
+
+std::uint64_t RenderQueue::MakeKey( const RenderPacket& aPacket, float aDepth, std::uint32_t aSequence )
+{
+	const std::uint64_t pass = std::uint64_t(aPacket.pass) << kPassShift_;
+	const std::uint64_t depth = std::uint64_t(std::clamp( aDepth, 0.f, 1.f ) * float(kDepthMax_));
+
+	switch( aPacket.pass )
+	{
+		case RenderPass::Opaque:
+			return pass | (StateBits_( aPacket ) << 28) | (depth << 4);
+		case RenderPass::Blended:
+			return pass | ((kDepthMax_ - depth) << 38) | (StateBits_( aPacket ) << 4);
+		case RenderPass::Overlay:
+			return pass | (std::uint64_t(aSequence) << 30);
+	}
+
+	return pass;
+}
+
+
+void RenderQueue::RadixSort( std::vector<SortItem>& aItems, std::vector<SortItem>& aScratch )
+{
+	aScratch.resize( aItems.size() );
+	if( aItems.size() < 2 )
+		return;
+
+	// Bytes that are the same in every key don't change the order. The
+	// histograms of all bytes are counted in one read of the keys.
+	std::uint64_t differing = 0;
+	std::array<std::array<std::uint32_t, 256>, 8> counts{};
+	for( const SortItem& item : aItems )
+	{
+		differing |= item.key ^ aItems.front().key;
+		for( int byte = 0; byte < 8; ++byte )
+			++counts[byte][(item.key >> (8 * byte)) & 0xff];
+	}
+
+	for( int byte = 0; byte < 8; ++byte )
+	{
+		const int shift = 8 * byte;
+		if( 0 == ((differing >> shift) & 0xff) )
+			continue;
+
+		std::array<std::uint32_t, 256> offsets;
+		std::uint32_t offset = 0;
+		for( std::size_t i = 0; i < offsets.size(); ++i )
+		{
+			offsets[i] = offset;
+			offset += counts[byte][i];
+		}
+
+		for( const SortItem& item : aItems )
+			aScratch[offsets[(item.key >> shift) & 0xff]++] = item;
+
+		aItems.swap( aScratch );
+	}
+}
+
+
+void RenderQueue::Flush()
+{
+	mStats = {};
+	mStats.packets = mPackets.size();
+	if( mPackets.empty() )
+		return;
+
+	if( mItems.size() < kRadixSortMinimum )
+		std::ranges::stable_sort( mItems, {}, &SortItem::key );
+	else
+		RadixSort( mItems, mScratch );
+
+	// Every packet binds all it has: a draw() may have bound something of
+	// its own, so what the previous packet bound can't be assumed. The GL
+	// state cache (support/gl_state.hpp) drops the binds that change
+	// nothing. The switches counted are those from one packet to the next.
+	GLuint program = 0;
+	GLuint texture = 0;
+	GLuint vertexArray = 0;
+	bool first = true;
+	RenderPass pass = RenderPass::Opaque;
+
+	for( const SortItem& item : mItems )
+	{
+		const RenderPacket& packet = mPackets[item.packet];
+
+		ApplyPass_( packet, first || packet.pass != pass );
+		pass = packet.pass;
+		first = false;
+
+		const GLuint packetProgram = packet.program ? packet.program->programId() : 0;
+		if( packetProgram != 0 )
+		{
+			glUseProgram( packetProgram );
+			if( packetProgram != program )
+				++mStats.programSwitches;
+		}
+
+		if( packet.texture != 0 )
+		{
+			glActiveTexture( GL_TEXTURE0 );
+			glBindTexture( GL_TEXTURE_2D, packet.texture );
+			if( packet.texture != texture )
+				++mStats.textureSwitches;
+		}
+
+		if( packet.vertexArray != 0 )
+		{
+			glBindVertexArray( packet.vertexArray );
+			if( packet.vertexArray != vertexArray )
+				++mStats.vertexArraySwitches;
+		}
+
+		program = packetProgram;
+		texture = packet.texture;
+		vertexArray = packet.vertexArray;
+
+		if( packet.draw )
+			packet.draw();
+	}
+
+	// Back to the opaque pass' state
+	glEnable( GL_DEPTH_TEST );
+	glDepthMask( GL_TRUE );
+	glDisable( GL_BLEND );
+}
+
+
+void RenderQueue::ApplyPass_( const RenderPacket& aPacket, bool aNewPass )
+{
+	if( aNewPass )
+	{
+		switch( aPacket.pass )
+		{
+			case RenderPass::Opaque:
+				glEnable( GL_DEPTH_TEST );
+				glDepthMask( GL_TRUE );
+				glDisable( GL_BLEND );
+				break;
+			case RenderPass::Blended:
+				glEnable( GL_DEPTH_TEST );
+				glDepthMask( GL_FALSE );
+				glEnable( GL_BLEND );
+				break;
+			case RenderPass::Overlay:
+				glDisable( GL_DEPTH_TEST );
+				glDepthMask( GL_TRUE );
+				glEnable( GL_BLEND );
+				break;
+		}
+	}
+
+	if( RenderPass::Opaque != aPacket.pass )
+		glBlendFunc( aPacket.blendSource, aPacket.blendDestination );
+}
+
+
+std::span<const RenderQueue::SortItem> RenderQueue::Order() const
+{
+	return mItems;
+}
+
+
+const RenderQueueStats& RenderQueue::GetStats() const
+{
+	return mStats;
+}
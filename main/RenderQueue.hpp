@@ -0,0 +1,131 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include "../vmlib/vec3.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+class ShaderProgram;
+
+// Passes are drawn in this order, each with its own fixed function state
+enum class RenderPass : std::uint8_t
+{
+	Opaque,  // Depth tested and written, front to back
+	Blended, // Depth tested, not written, back to front
+	Overlay  // No depth, in submission order (UI, text)
+};
+
+struct RenderPacket
+{
+	RenderPass pass = RenderPass::Opaque;
+
+	// Bound before draw() if not null/0. The texture goes on unit 0.
+	ShaderProgram* program = nullptr;
+	GLuint vertexArray = 0;
+	GLuint texture = 0;
+
+	// Blended only
+	GLenum blendSource = GL_SRC_ALPHA;
+	GLenum blendDestination = GL_ONE_MINUS_SRC_ALPHA;
+
+	// World space, for the depth order
+	Vec3f position{ 0.f, 0.f, 0.f };
+
+	// Sets the draw's own uniforms and draws
+	std::function<void()> draw;
+};
+
+// What the last Flush() did. A switch is a packet whose program (texture,
+// vertex array) differs from the previous packet's; the GL state cache
+// drops the binds that don't.
+struct RenderQueueStats
+{
+	std::size_t packets = 0;
+	std::size_t programSwitches = 0;
+	std::size_t textureSwitches = 0;
+	std::size_t vertexArraySwitches = 0;
+};
+
+
+// ===========================================================================
+//		RenderQueue
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Systems submit draws as packets instead of drawing in a fixed order;
+//	Flush() sorts them by a 64 bit key and draws them. The key is, from the
+//	top bit down:
+//
+//	  Opaque   pass:2 program:10 texture:12 vertex array:12 depth:24 -:4
+//	  Blended  pass:2 depth:24 program:10 texture:12 vertex array:12 -:4
+//	  Overlay  pass:2 submission:32 -:30
+//
+//	so opaque draws sharing a program, then a texture, then a vertex array
+//	are drawn together (each switch made once), and front to back within
+//	those for early depth rejection. Blended draws are back to front, which
+//	they need to look right, and only then grouped by state. Names are
+//	truncated to their fields; two that collide cost an extra switch, not a
+//	wrong draw, since the packet keeps the whole name.
+//
+//	Depth is the distance from the view's eye, as a fraction of its far
+//	distance. The keys are sorted with an LSD radix sort, 8 bits per pass,
+//	skipping the bytes that all keys share; below kRadixSortMinimum
+//	packets, where a comparison sort is faster (see bench/render_queue),
+//	with std::stable_sort. Either is stable, so equal keys draw in
+//	submission order.
+//
+//	One queue is flushed per view: BeginView(), Submit() every packet,
+//	Flush(). Flush() leaves the opaque pass' state behind (depth test and
+//	writes on, no blending).
+// ---------------------------------------------------------------------------
+class RenderQueue
+{
+public:
+	struct SortItem
+	{
+		std::uint64_t key;
+		std::uint32_t packet;
+	};
+
+	static constexpr std::size_t kRadixSortMinimum = 1024;
+
+	// Starts a view, dropping anything submitted but not flushed
+	void BeginView( Vec3f aEye, float aFarDistance );
+
+	void Submit( RenderPacket aPacket );
+
+	// Sorts the packets and draws them
+	void Flush();
+
+	// Sorts aItems by key, stably, using aScratch (resized to match)
+	static void RadixSort( std::vector<SortItem>& aItems, std::vector<SortItem>& aScratch );
+
+	// The key aPacket gets, at aDepth (0 at the eye, 1 at the far distance)
+	// and submitted aSequence-th
+	static std::uint64_t MakeKey( const RenderPacket& aPacket, float aDepth, std::uint32_t aSequence );
+
+	// Packets in draw order, as of the last sort
+	std::span<const SortItem> Order() const;
+
+	const RenderQueueStats& GetStats() const;
+
+private:
+	void ApplyPass_( const RenderPacket& aPacket, bool aNewPass );
+
+private:
+	Vec3f mEye{ 0.f, 0.f, 0.f };
+	float mFarDistance = 1.f;
+
+	std::vector<RenderPacket> mPackets;
+	std::vector<SortItem> mItems;
+	std::vector<SortItem> mScratch;
+
+	RenderQueueStats mStats;
+};
+
+#endif
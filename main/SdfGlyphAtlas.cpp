@@ -0,0 +1,663 @@
+#include "SdfGlyphAtlas.hpp"
+
+#include "../support/error.hpp"
+#include "../support/mapped_file.hpp"
+
+#include <stb_truetype.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <unordered_set>
+
+
+struct SdfGlyphAtlas::Font_
+{
+	std::span<const unsigned char> data;
+	stbtt_fontinfo info;
+
+	// Relative to the font's height (ascent - descent), as fontstash's
+	float ascender;
+	float descender;
+	float referenceScale;
+};
+
+
+namespace
+{
+	// The distance field's value on the glyph's edge, and how much it
+	// changes per pixel (at kReferenceSize): kPadding pixels out is zero
+	constexpr unsigned char kOnEdge_ = 128;
+	constexpr float kPixelDistScale_ = float(kOnEdge_) / float(SdfGlyphAtlas::kPadding);
+
+	constexpr std::uint64_t Cell_( int aX, int aY )
+	{
+		return std::uint64_t(aX) << 32 | std::uint32_t(aY);
+	}
+
+	// A baked atlas: the header, glyphCount glyphs, then the pixels, row by
+	// row. Native byte order; it is baked on the machine it's used on.
+	constexpr char kBakedMagic_[4] = { 'S', 'D', 'F', 'A' };
+	constexpr std::uint32_t kBakedVersion_ = 1;
+
+	struct BakedHeader_
+	{
+		char magic[4];
+		std::uint32_t version;
+
+		// Of the font file, so that a stale bake is ignored
+		std::uint64_t fontBytes;
+		std::uint64_t fontHash;
+
+		std::int32_t width, height;
+		std::int32_t cellSize, padding;
+		float referenceSize;
+		std::uint32_t glyphCount;
+	};
+
+	struct BakedGlyph_
+	{
+		std::int32_t index;
+		std::int32_t x, y, w, h;
+		float xoff, yoff;
+		float texel;
+		std::int32_t advance;
+	};
+
+	// FNV-1a
+	std::uint64_t Hash_( std::span<const unsigned char> aData )
+	{
+		std::uint64_t hash = 0xcbf29ce484222325ull;
+		for( unsigned char const byte : aData )
+		{
+			hash = (hash ^ byte) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	// Decodes the UTF-8 sequence at aText[aAt], and moves past it. Invalid
+	// bytes decode as U+FFFD.
+	std::uint32_t NextCodepoint_( std::string_view aText, std::size_t& aAt )
+	{
+		const unsigned char lead = static_cast<unsigned char>(aText[aAt++]);
+
+		int extra;
+		std::uint32_t codepoint;
+		if( lead < 0x80 )
+		{
+			return lead;
+		}
+		else if( (lead & 0xe0) == 0xc0 )
+		{
+			extra = 1;
+			codepoint = lead & 0x1f;
+		}
+		else if( (lead & 0xf0) == 0xe0 )
+		{
+			extra = 2;
+			codepoint = lead & 0x0f;
+		}
+		else if( (lead & 0xf8) == 0xf0 )
+		{
+			extra = 3;
+			codepoint = lead & 0x07;
+		}
+		else
+		{
+			return 0xfffd;
+		}
+
+		for( ; extra > 0; --extra )
+		{
+			if( aAt == aText.size() || (static_cast<unsigned char>(aText[aAt]) & 0xc0) != 0x80 )
+			{
+				return 0xfffd;
+			}
+			codepoint = (codepoint << 6) | (static_cast<unsigned char>(aText[aAt++]) & 0x3f);
+		}
+
+		return codepoint;
+	}
+}
+
+
+SdfGlyphAtlas::SdfGlyphAtlas( int aInitialSize, int aMaxSize )
+	: mWidth( aInitialSize )
+	, mHeight( aInitialSize )
+	, mMaxSize( std::max( aInitialSize, aMaxSize ) )
+	, mTexture( 0 )
+	, mFrame( 1 )
+	, mGeneration( 0 )
+	, mDropped{}
+	, mPixels( std::size_t(aInitialSize) * aInitialSize, 0 )
+	, mDirty{ aInitialSize, aInitialSize, 0, 0 }
+	, mResized( true )
+{
+	for( int y = 0; y + kCellSize <= mHeight; y += kCellSize )
+	{
+		for( int x = 0; x + kCellSize <= mWidth; x += kCellSize )
+		{
+			mFreeCells.push_back( Cell_( x, y ) );
+		}
+	}
+}
+
+
+SdfGlyphAtlas::~SdfGlyphAtlas()
+{
+	if( mTexture )
+	{
+		glDeleteTextures( 1, &mTexture );
+	}
+}
+
+
+SdfGlyphAtlas::FontID SdfGlyphAtlas::AddFont( std::span<const unsigned char> aData )
+{
+	auto font = std::make_unique<Font_>();
+
+	if( aData.empty() || !stbtt_InitFont( &font->info, aData.data(), 0 ) )
+	{
+		return kInvalidFont;
+	}
+
+	font->data = aData;
+
+	int ascent, descent, lineGap;
+	stbtt_GetFontVMetrics( &font->info, &ascent, &descent, &lineGap );
+
+	const float height = float(ascent - descent);
+	font->ascender = float(ascent) / height;
+	font->descender = float(descent) / height;
+	font->referenceScale = stbtt_ScaleForPixelHeight( &font->info, kReferenceSize );
+
+	mFonts.push_back( std::move(font) );
+	return FontID(mFonts.size() - 1);
+}
+
+
+void SdfGlyphAtlas::BeginFrame()
+{
+	++mFrame;
+}
+
+
+void SdfGlyphAtlas::Prepare( FontID aFont, std::uint32_t aFirst, std::uint32_t aLast )
+{
+	if( aFont < 0 || std::size_t(aFont) >= mFonts.size() )
+	{
+		return;
+	}
+
+	Font_ const& font = *mFonts[aFont];
+	for( std::uint32_t codepoint = aFirst; codepoint <= aLast && codepoint >= aFirst; ++codepoint )
+	{
+		if( const int index = stbtt_FindGlyphIndex( &font.info, int(codepoint) ) )
+		{
+			GlyphFor_( aFont, index );
+		}
+	}
+}
+
+
+void SdfGlyphAtlas::SaveBaked( FontID aFont, const char* aPath ) const
+{
+	if( aFont < 0 || std::size_t(aFont) >= mFonts.size() )
+	{
+		throw Error( "SdfGlyphAtlas: no font {} to bake", aFont );
+	}
+
+	std::vector<BakedGlyph_> glyphs;
+	for( auto const& [key, glyph] : mGlyphs )
+	{
+		if( FontID(key >> 32) == aFont )
+		{
+			glyphs.push_back( { std::int32_t(key & 0xffffffffu), glyph.x, glyph.y, glyph.w, glyph.h, glyph.xoff, glyph.yoff, glyph.texel, glyph.advance } );
+		}
+	}
+
+	BakedHeader_ header{};
+	std::memcpy( header.magic, kBakedMagic_, sizeof(header.magic) );
+	header.version = kBakedVersion_;
+	header.fontBytes = mFonts[aFont]->data.size();
+	header.fontHash = Hash_( mFonts[aFont]->data );
+	header.width = mWidth;
+	header.height = mHeight;
+	header.cellSize = kCellSize;
+	header.padding = kPadding;
+	header.referenceSize = kReferenceSize;
+	header.glyphCount = std::uint32_t(glyphs.size());
+
+	std::FILE* fout = std::fopen( aPath, "wb" );
+	if( !fout )
+	{
+		throw Error( "SdfGlyphAtlas: unable to open '{}' for writing", aPath );
+	}
+
+	const bool written = 1 == std::fwrite( &header, sizeof(header), 1, fout )
+		&& glyphs.size() == std::fwrite( glyphs.data(), sizeof(BakedGlyph_), glyphs.size(), fout )
+		&& mPixels.size() == std::fwrite( mPixels.data(), 1, mPixels.size(), fout );
+
+	if( 0 != std::fclose( fout ) || !written )
+	{
+		throw Error( "SdfGlyphAtlas: error while writing '{}'", aPath );
+	}
+}
+
+
+bool SdfGlyphAtlas::LoadBaked( FontID aFont, const char* aPath )
+{
+	if( aFont < 0 || std::size_t(aFont) >= mFonts.size() || !mGlyphs.empty() || !std::filesystem::exists( aPath ) )
+	{
+		return false;
+	}
+
+	MappedFile const file( aPath );
+	auto const bytes = file.bytes();
+
+	BakedHeader_ header;
+	if( bytes.size() < sizeof(header) )
+	{
+		return false;
+	}
+	std::memcpy( &header, bytes.data(), sizeof(header) );
+
+	Font_ const& font = *mFonts[aFont];
+	const bool valid = 0 == std::memcmp( header.magic, kBakedMagic_, sizeof(header.magic) )
+		&& kBakedVersion_ == header.version
+		&& font.data.size() == header.fontBytes
+		&& kCellSize == header.cellSize
+		&& kPadding == header.padding
+		&& kReferenceSize == header.referenceSize
+		&& header.width >= kCellSize && header.width <= mMaxSize
+		&& header.height >= kCellSize && header.height <= mMaxSize
+		&& bytes.size() == sizeof(header) + header.glyphCount * sizeof(BakedGlyph_) + std::size_t(header.width) * std::size_t(header.height)
+		&& Hash_( font.data ) == header.fontHash;
+
+	if( !valid )
+	{
+		return false;
+	}
+
+	// Every glyph in a cell of its own
+	std::unordered_map<std::uint64_t, Glyph_> glyphs;
+	std::unordered_set<std::uint64_t> used;
+	for( std::uint32_t i = 0; i < header.glyphCount; ++i )
+	{
+		BakedGlyph_ baked;
+		std::memcpy( &baked, bytes.data() + sizeof(header) + i * sizeof(BakedGlyph_), sizeof(baked) );
+
+		if( baked.w > 0 )
+		{
+			const bool inCell = baked.x >= 0 && baked.y >= 0 && 0 == baked.x % kCellSize && 0 == baked.y % kCellSize
+				&& baked.x + kCellSize <= header.width && baked.y + kCellSize <= header.height
+				&& baked.w < kCellSize && baked.h < kCellSize;
+
+			if( !inCell || !used.insert( Cell_( baked.x, baked.y ) ).second )
+			{
+				return false;
+			}
+		}
+
+		const std::uint64_t key = (std::uint64_t(aFont) << 32) | std::uint32_t(baked.index);
+		glyphs.emplace( key, Glyph_{ baked.x, baked.y, baked.w, baked.h, baked.xoff, baked.yoff, baked.texel, baked.advance, 0 } );
+	}
+
+	mWidth = header.width;
+	mHeight = header.height;
+	mPixels.assign( bytes.end() - std::ptrdiff_t(std::size_t(mWidth) * mHeight), bytes.end() );
+	mGlyphs = std::move(glyphs);
+
+	mFreeCells.clear();
+	for( int y = 0; y + kCellSize <= mHeight; y += kCellSize )
+	{
+		for( int x = 0; x + kCellSize <= mWidth; x += kCellSize )
+		{
+			if( !used.count( Cell_( x, y ) ) )
+			{
+				mFreeCells.push_back( Cell_( x, y ) );
+			}
+		}
+	}
+
+	// All of it in the next Upload()
+	mResized = true;
+	mStats.baked += mGlyphs.size();
+
+	return true;
+}
+
+
+float SdfGlyphAtlas::LayOut( FontID aFont, std::string_view aText, float aX, float aY, float aSize, int aAlign, uint32_t aColour, std::vector<PITBFonsVertex>& aOut )
+{
+	if( aFont < 0 || std::size_t(aFont) >= mFonts.size() )
+	{
+		return aX;
+	}
+
+	Font_ const& font = *mFonts[aFont];
+	const float scale = stbtt_ScaleForPixelHeight( &font.info, aSize );
+	const float toSize = aSize / kReferenceSize;
+
+	// Align horizontally, by the advance of the whole string
+	if( aAlign & (FONS_ALIGN_RIGHT | FONS_ALIGN_CENTER) )
+	{
+		float width = 0.f;
+		int previous = -1;
+		for( std::size_t at = 0; at < aText.size(); )
+		{
+			const int glyph = stbtt_FindGlyphIndex( &font.info, int(NextCodepoint_( aText, at )) );
+			if( previous != -1 )
+			{
+				width += scale * float(stbtt_GetGlyphKernAdvance( &font.info, previous, glyph ));
+			}
+			width += scale * float(GlyphFor_( aFont, glyph ).advance);
+			previous = glyph;
+		}
+
+		aX -= (aAlign & FONS_ALIGN_RIGHT) ? width : 0.5f * width;
+	}
+
+	// Align vertically; y grows downwards (FONS_ZERO_TOPLEFT)
+	if( aAlign & FONS_ALIGN_TOP )
+	{
+		aY += font.ascender * aSize;
+	}
+	else if( aAlign & FONS_ALIGN_MIDDLE )
+	{
+		aY += 0.5f * (font.ascender + font.descender) * aSize;
+	}
+	else if( aAlign & FONS_ALIGN_BOTTOM )
+	{
+		aY += font.descender * aSize;
+	}
+
+	int previous = -1;
+	for( std::size_t at = 0; at < aText.size(); )
+	{
+		const int index = stbtt_FindGlyphIndex( &font.info, int(NextCodepoint_( aText, at )) );
+		if( previous != -1 )
+		{
+			aX += scale * float(stbtt_GetGlyphKernAdvance( &font.info, previous, index ));
+		}
+		previous = index;
+
+		Glyph_ const& glyph = GlyphFor_( aFont, index );
+		if( glyph.w > 0 )
+		{
+			const float toPixels = glyph.texel * toSize;
+			const float x0 = aX + glyph.xoff * toSize;
+			const float y0 = aY + glyph.yoff * toSize;
+			const float x1 = x0 + float(glyph.w) * toPixels;
+			const float y1 = y0 + float(glyph.h) * toPixels;
+
+			const float s0 = float(glyph.x);
+			const float t0 = float(glyph.y);
+			const float s1 = float(glyph.x + glyph.w);
+			const float t1 = float(glyph.y + glyph.h);
+
+			// Same winding as fonsDrawText()
+			aOut.push_back( { x0, y0, s0, t0, aColour } );
+			aOut.push_back( { x1, y1, s1, t1, aColour } );
+			aOut.push_back( { x1, y0, s1, t0, aColour } );
+
+			aOut.push_back( { x0, y0, s0, t0, aColour } );
+			aOut.push_back( { x0, y1, s0, t1, aColour } );
+			aOut.push_back( { x1, y1, s1, t1, aColour } );
+		}
+
+		aX += scale * float(glyph.advance);
+	}
+
+	return aX;
+}
+
+
+void SdfGlyphAtlas::Upload()
+{
+	if( 0 == mTexture )
+	{
+		glGenTextures( 1, &mTexture );
+		glBindTexture( GL_TEXTURE_2D, mTexture );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+
+	glBindTexture( GL_TEXTURE_2D, mTexture );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	if( mResized )
+	{
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, mWidth, mHeight, 0, GL_RED, GL_UNSIGNED_BYTE, mPixels.data() );
+		++mStats.uploads;
+	}
+	else if( mDirty[0] < mDirty[2] && mDirty[1] < mDirty[3] )
+	{
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, mWidth );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, mDirty[0] );
+		glPixelStorei( GL_UNPACK_SKIP_ROWS, mDirty[1] );
+
+		glTexSubImage2D( GL_TEXTURE_2D, 0, mDirty[0], mDirty[1], mDirty[2] - mDirty[0], mDirty[3] - mDirty[1], GL_RED, GL_UNSIGNED_BYTE, mPixels.data() );
+
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
+		glPixelStorei( GL_UNPACK_SKIP_ROWS, 0 );
+		++mStats.uploads;
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mDirty[0] = mWidth;
+	mDirty[1] = mHeight;
+	mDirty[2] = 0;
+	mDirty[3] = 0;
+	mResized = false;
+}
+
+
+GLuint SdfGlyphAtlas::Texture() const
+{
+	return mTexture;
+}
+
+
+int SdfGlyphAtlas::Width() const
+{
+	return mWidth;
+}
+
+
+int SdfGlyphAtlas::Height() const
+{
+	return mHeight;
+}
+
+
+std::uint32_t SdfGlyphAtlas::Generation() const
+{
+	return mGeneration;
+}
+
+
+std::size_t SdfGlyphAtlas::GlyphCount() const
+{
+	return mGlyphs.size();
+}
+
+
+std::size_t SdfGlyphAtlas::MemoryBytes() const
+{
+	return 2 * mPixels.size();
+}
+
+
+const SdfAtlasStats& SdfGlyphAtlas::Stats() const
+{
+	return mStats;
+}
+
+
+SdfGlyphAtlas::Glyph_ const& SdfGlyphAtlas::GlyphFor_( FontID aFont, int aGlyphIndex )
+{
+	const std::uint64_t key = (std::uint64_t(aFont) << 32) | std::uint32_t(aGlyphIndex);
+	if( auto const it = mGlyphs.find( key ); it != mGlyphs.end() )
+	{
+		it->second.lastUsed = mFrame;
+		return it->second;
+	}
+
+	Font_ const& font = *mFonts[aFont];
+
+	Glyph_ glyph{};
+	glyph.texel = 1.f;
+	glyph.lastUsed = mFrame;
+
+	int leftSideBearing;
+	stbtt_GetGlyphHMetrics( &font.info, aGlyphIndex, &glyph.advance, &leftSideBearing );
+
+	// Rasterize smaller until the glyph and its border fit a cell; only
+	// the odd oversize glyph (at kReferenceSize, a Latin one is about 30
+	// texels) takes a second try
+	float scale = font.referenceScale;
+	int w = 0, h = 0, xoff = 0, yoff = 0;
+	unsigned char* sdf = nullptr;
+	for( int attempt = 0; attempt < 4; ++attempt )
+	{
+		sdf = stbtt_GetGlyphSDF( &font.info, scale, aGlyphIndex, kPadding, kOnEdge_, kPixelDistScale_, &w, &h, &xoff, &yoff );
+		++mStats.glyphsRasterized;
+
+		if( !sdf || (w < kCellSize && h < kCellSize) )
+		{
+			break;
+		}
+
+		stbtt_FreeSDF( sdf, nullptr );
+		sdf = nullptr;
+		scale *= float(kCellSize - 1) / float(std::max( w, h ) + 1);
+	}
+
+	if( !sdf )
+	{
+		// Blank (a space), or hopelessly large: just the advance. These
+		// take no room, so stay cached.
+		return mGlyphs.emplace( key, glyph ).first->second;
+	}
+
+	int x, y;
+	if( !AllocateCell_( x, y ) )
+	{
+		stbtt_FreeSDF( sdf, nullptr );
+		++mStats.dropped;
+
+		mDropped = glyph;
+		return mDropped;
+	}
+
+	for( int row = 0; row < kCellSize; ++row )
+	{
+		unsigned char* const line = mPixels.data() + std::size_t(y + row) * mWidth + x;
+		if( row < h )
+		{
+			std::copy_n( sdf + row * w, w, line );
+			std::fill( line + w, line + kCellSize, 0 );
+		}
+		else
+		{
+			std::fill( line, line + kCellSize, 0 );
+		}
+	}
+	stbtt_FreeSDF( sdf, nullptr );
+
+	glyph.x = x;
+	glyph.y = y;
+	glyph.w = w;
+	glyph.h = h;
+	glyph.texel = font.referenceScale / scale;
+	glyph.xoff = float(xoff) * glyph.texel;
+	glyph.yoff = float(yoff) * glyph.texel;
+
+	mDirty[0] = std::min( mDirty[0], x );
+	mDirty[1] = std::min( mDirty[1], y );
+	mDirty[2] = std::max( mDirty[2], x + kCellSize );
+	mDirty[3] = std::max( mDirty[3], y + kCellSize );
+
+	return mGlyphs.emplace( key, glyph ).first->second;
+}
+
+
+bool SdfGlyphAtlas::AllocateCell_( int& aX, int& aY )
+{
+	if( mFreeCells.empty() && mWidth < mMaxSize )
+	{
+		Grow_();
+	}
+
+	if( mFreeCells.empty() )
+	{
+		// Evict the least recently used glyph, unless it's been used this
+		// frame: its quads are about to be drawn
+		auto victim = mGlyphs.end();
+		for( auto it = mGlyphs.begin(); it != mGlyphs.end(); ++it )
+		{
+			if( it->second.w > 0 && it->second.lastUsed < mFrame && (mGlyphs.end() == victim || it->second.lastUsed < victim->second.lastUsed) )
+			{
+				victim = it;
+			}
+		}
+
+		if( mGlyphs.end() == victim )
+		{
+			return false;
+		}
+
+		mFreeCells.push_back( Cell_( victim->second.x, victim->second.y ) );
+		mGlyphs.erase( victim );
+
+		++mGeneration;
+		++mStats.evictions;
+	}
+
+	const std::uint64_t cell = mFreeCells.back();
+	mFreeCells.pop_back();
+
+	aX = int(cell >> 32);
+	aY = int(cell & 0xffffffffu);
+	return true;
+}
+
+
+void SdfGlyphAtlas::Grow_()
+{
+	const int width = std::min( 2 * mWidth, mMaxSize );
+	const int height = std::min( 2 * mHeight, mMaxSize );
+
+	// The glyphs stay where they are (texture coordinates are in texels)
+	std::vector<unsigned char> pixels( std::size_t(width) * height, 0 );
+	for( int row = 0; row < mHeight; ++row )
+	{
+		std::copy_n( mPixels.data() + std::size_t(row) * mWidth, mWidth, pixels.data() + std::size_t(row) * width );
+	}
+
+	// Cells of the new area, used last to first
+	for( int y = 0; y + kCellSize <= height; y += kCellSize )
+	{
+		for( int x = 0; x + kCellSize <= width; x += kCellSize )
+		{
+			if( x + kCellSize > mWidth || y + kCellSize > mHeight )
+			{
+				mFreeCells.push_back( Cell_( x, y ) );
+			}
+		}
+	}
+	std::reverse( mFreeCells.begin(), mFreeCells.end() );
+
+	mPixels = std::move(pixels);
+	mWidth = width;
+	mHeight = height;
+	mResized = true;
+	++mStats.growths;
+}
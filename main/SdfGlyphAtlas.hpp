@@ -0,0 +1,162 @@
+#ifndef SDF_GLYPH_ATLAS_HPP
+#define SDF_GLYPH_ATLAS_HPP
+
+#include "fontstashbackend.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+struct SdfAtlasStats
+{
+	std::size_t glyphsRasterized = 0;
+	std::size_t uploads = 0;
+	std::size_t growths = 0;
+	std::size_t evictions = 0;
+	std::size_t dropped = 0;   // Glyphs with no room, even after evicting
+	std::size_t baked = 0;     // Loaded by LoadBaked() instead
+};
+
+
+// ===========================================================================
+//		SdfGlyphAtlas
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Glyphs as signed distance fields, rasterized once at kReferenceSize and
+//	drawn at any size: fontShader.frag (with uDistanceField set) finds the
+//	edge at 0.5, about a pixel wide whatever the scale. A glyph is only ever
+//	rasterized the first time it is used, so resizing the window costs a
+//	new layout but no rasterization and no texture uploads.
+//
+//	LayOut() places glyphs the way fonsDrawText() does with
+//	FONS_ZERO_TOPLEFT (same sizes, alignment and kerning), so styles look
+//	the same with either. Its texture coordinates are in texels; the shader
+//	divides by the atlas size.
+//
+//	All glyphs are the same size in the atlas, so it is a grid of kCellSize
+//	cells. It starts small and doubles (keeping every glyph where it is)
+//	until aMaxSize; after that, glyphs not used since the last BeginFrame()
+//	are evicted, least recently used first. An eviction bumps Generation():
+//	quads laid out before it may point at another glyph now.
+//
+//	The glyphs can be baked ahead of time (font-baker, with Prepare() and
+//	SaveBaked()) and loaded with LoadBaked(): one texture upload, and only
+//	the glyphs the bake left out are rasterized. The texture is created by
+//	the first Upload(), so baking needs no GL context.
+// ---------------------------------------------------------------------------
+class SdfGlyphAtlas
+{
+public:
+	using FontID = int;
+	static constexpr FontID kInvalidFont = -1;
+
+	// Pixel height glyphs are rasterized at, and the distance (in pixels at
+	// that size) the field reaches out from the edge
+	static constexpr float kReferenceSize = 32.f;
+	static constexpr int kPadding = 4;
+
+	// One glyph and a texel of border. Glyphs that don't fit are rasterized
+	// a little smaller.
+	static constexpr int kCellSize = 48;
+
+	explicit SdfGlyphAtlas( int aInitialSize = 256, int aMaxSize = 2048 );
+	~SdfGlyphAtlas();
+
+	SdfGlyphAtlas( SdfGlyphAtlas const& ) = delete;
+	SdfGlyphAtlas& operator= ( SdfGlyphAtlas const& ) = delete;
+
+	// The font file is parsed in place, and must outlive the atlas (see
+	// FontRegistry). kInvalidFont if it isn't a font.
+	FontID AddFont( std::span<const unsigned char> aData );
+
+	// Starts a new frame for the LRU: glyphs used from now on won't be
+	// evicted until the next call
+	void BeginFrame();
+
+	// Rasterizes the glyphs of codepoints aFirst to aLast (those the font
+	// has), as if they had been laid out
+	void Prepare( FontID aFont, std::uint32_t aFirst, std::uint32_t aLast );
+
+	// Writes the atlas, with aFont's glyphs, to aPath. Throws Error.
+	void SaveBaked( FontID aFont, const char* aPath ) const;
+
+	// Replaces an empty atlas with one saved by SaveBaked(), for aFont.
+	// False (and nothing changes) if the atlas already has glyphs, or the
+	// file is missing, malformed or was baked from another font.
+	bool LoadBaked( FontID aFont, const char* aPath );
+
+	// Appends the quads of aText, aSize pixels high, to aOut; returns the
+	// x the next glyph would go at. aAlign is FONS_ALIGN_* flags.
+	float LayOut( FontID aFont, std::string_view aText, float aX, float aY, float aSize, int aAlign, uint32_t aColour, std::vector<PITBFonsVertex>& aOut );
+
+	// Uploads the glyphs rasterized since the last call
+	void Upload();
+
+	GLuint Texture() const;
+	int Width() const;
+	int Height() const;
+
+	std::uint32_t Generation() const;
+	std::size_t GlyphCount() const;
+
+	// The texture, and its copy in memory
+	std::size_t MemoryBytes() const;
+
+	const SdfAtlasStats& Stats() const;
+
+private:
+	struct Font_;
+
+	struct Glyph_
+	{
+		// In the atlas; zero sized for blank glyphs (spaces) and ones that
+		// didn't fit
+		int x, y, w, h;
+
+		// Of the bitmap from the pen position, and the size of a texel, in
+		// pixels at kReferenceSize
+		float xoff, yoff;
+		float texel;
+
+		int advance; // Font units
+
+		std::uint64_t lastUsed; // Frame
+	};
+
+	Glyph_ const& GlyphFor_( FontID aFont, int aGlyphIndex );
+	bool AllocateCell_( int& aX, int& aY );
+	void Grow_();
+
+private:
+	int mWidth;
+	int mHeight;
+	int mMaxSize;
+	GLuint mTexture;
+
+	std::vector<std::unique_ptr<Font_>> mFonts;
+	std::unordered_map<std::uint64_t, Glyph_> mGlyphs;
+	std::vector<std::uint64_t> mFreeCells; // x << 32 | y
+
+	std::uint64_t mFrame;
+	std::uint32_t mGeneration;
+
+	// Returned for glyphs that got no cell; not cached, so that they are
+	// tried again
+	Glyph_ mDropped;
+
+	// CPU copy of the texture, and what of it the GPU hasn't seen yet
+	std::vector<unsigned char> mPixels;
+	int mDirty[4];
+	bool mResized;
+
+	SdfAtlasStats mStats;
+};
+
+#endif // SDF_GLYPH_ATLAS_HPP
@@ -0,0 +1,292 @@
+#include "Skinning.hpp"
+
+#include "../support/error.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace
+{
+	// Vertex attributes of skinned.vert, after the position, colour, normal,
+	// specular reflectance and shininess
+	constexpr GLuint kJointsAttrib_ = 5;
+	constexpr GLuint kWeightsAttrib_ = 6;
+
+	// uSkinOnGpu in skinned.vert
+	constexpr GLint kSkinOnGpuLocation_ = 2;
+
+	// SkinPalette in skinning.glsl
+	constexpr GLuint kPaletteBinding_ = 8;
+
+	// The palette matrices are row major, so the first twelve floats are
+	// the affine part. The SIMD is within each vertex: blending the four
+	// matrices is a loop over contiguous rows, which the compiler
+	// vectorizes. (Vectorizing over the vertices instead means a gather per
+	// matrix element, which measured several times slower than plain
+	// scalar code.)
+	//
+	// The normals are not renormalized; skinned.vert normalizes them
+	// anyway.
+	void SkinKernel_( std::size_t aCount, float const* __restrict aPalette, std::uint32_t const* __restrict aJoints, float const* __restrict aWeights, float const* __restrict aPositions, float const* __restrict aNormals, float* __restrict aOutPositions, float* __restrict aOutNormals )
+	{
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			const std::uint32_t joints = aJoints[i];
+			float const* p0 = aPalette + 16 * (joints & 0xff);
+			float const* p1 = aPalette + 16 * ((joints >> 8) & 0xff);
+			float const* p2 = aPalette + 16 * ((joints >> 16) & 0xff);
+			float const* p3 = aPalette + 16 * (joints >> 24);
+
+			const float w0 = aWeights[4 * i + 0];
+			const float w1 = aWeights[4 * i + 1];
+			const float w2 = aWeights[4 * i + 2];
+			const float w3 = aWeights[4 * i + 3];
+
+			float m[12];
+			for( int e = 0; e < 12; ++e )
+			{
+				m[e] = w0 * p0[e] + w1 * p1[e] + w2 * p2[e] + w3 * p3[e];
+			}
+
+			const float x = aPositions[3 * i + 0];
+			const float y = aPositions[3 * i + 1];
+			const float z = aPositions[3 * i + 2];
+			aOutPositions[3 * i + 0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+			aOutPositions[3 * i + 1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+			aOutPositions[3 * i + 2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+
+			const float nx = aNormals[3 * i + 0];
+			const float ny = aNormals[3 * i + 1];
+			const float nz = aNormals[3 * i + 2];
+			aOutNormals[3 * i + 0] = m[0] * nx + m[1] * ny + m[2] * nz;
+			aOutNormals[3 * i + 1] = m[4] * nx + m[5] * ny + m[6] * nz;
+			aOutNormals[3 * i + 2] = m[8] * nx + m[9] * ny + m[10] * nz;
+		}
+	}
+}
+
+Skeleton::JointID Skeleton::AddJoint( JointID aParent, Transform const& aBindPose )
+{
+	assert( kNoParent == aParent || aParent < mParents.size() );
+
+	if( mParents.size() >= kMaxJoints )
+	{
+		throw Error( "Skeleton: more than {} joints", kMaxJoints );
+	}
+
+	const JointID id = mParents.size();
+
+	const Mat44f global = kNoParent == aParent
+		? aBindPose.Matrix()
+		: invert( mInverseBind[aParent] ) * aBindPose.Matrix();
+
+	mParents.push_back( aParent );
+	mBindPose.push_back( aBindPose );
+	mInverseBind.push_back( invert( global ) );
+
+	return id;
+}
+
+
+std::size_t Skeleton::JointCount() const
+{
+	return mParents.size();
+}
+
+
+Skeleton::JointID Skeleton::Parent( JointID aJoint ) const
+{
+	return mParents[aJoint];
+}
+
+
+std::span<const Transform> Skeleton::BindPose() const
+{
+	return mBindPose;
+}
+
+
+void Skeleton::EvaluatePose( std::span<const Transform> aLocalPose, std::span<Mat44f> aPalette ) const
+{
+	assert( aLocalPose.size() == JointCount() && aPalette.size() == JointCount() );
+
+	// Parents come first, so theirs are already done: the palette holds
+	// the joints' model space transforms after this pass...
+	for( JointID i = 0; i < mParents.size(); ++i )
+	{
+		const Mat44f local = aLocalPose[i].Matrix();
+		aPalette[i] = kNoParent == mParents[i] ? local : aPalette[mParents[i]] * local;
+	}
+
+	// ... and the skinning matrices after this one
+	for( JointID i = 0; i < mParents.size(); ++i )
+	{
+		aPalette[i] = aPalette[i] * mInverseBind[i];
+	}
+}
+
+
+void SkinVertices( std::span<const Mat44f> aPalette, std::span<const Vec3f> aPositions, std::span<const Vec3f> aNormals, std::span<const std::uint32_t> aJoints, std::span<const Vec4f> aWeights, std::span<Vec3f> aOutPositions, std::span<Vec3f> aOutNormals )
+{
+	const std::size_t count = aPositions.size();
+	assert( aNormals.size() == count && aJoints.size() == count && aWeights.size() == count );
+	assert( aOutPositions.size() == count && aOutNormals.size() == count );
+
+	if( aPalette.empty() )
+	{
+		return;
+	}
+
+	SkinKernel_( count, aPalette.front().v, aJoints.data(), &aWeights.data()->x, &aPositions.data()->x, &aNormals.data()->x, &aOutPositions.data()->x, &aOutNormals.data()->x );
+}
+
+
+SkinnedModel::SkinnedModel( ModelObject const& aModel, std::span<const VertexSkin> aSkin, std::size_t aJointCount, SkinningBackend aBackend )
+	: mModelGPU( aModel )
+	, mBackend( aBackend )
+	, mVertexCount( aModel.Vertices().size() )
+	, mJointCount( aJointCount )
+	, mVertexBuffer( 0 )
+	, mPaletteBuffer( 0 )
+	, mVAO( 0 )
+{
+	if( aSkin.size() != mVertexCount )
+	{
+		throw Error( "SkinnedModel: {} vertices, but {} skin weights", mVertexCount, aSkin.size() );
+	}
+
+	glGenVertexArrays( 1, &mVAO );
+	glBindVertexArray( mVAO );
+
+	// Same attributes as the ship's VAO
+	auto const attribute = [] ( GLuint aIndex, GLuint aBuffer, GLint aSize, GLsizei aStride, std::size_t aOffset ) {
+		glBindBuffer( GL_ARRAY_BUFFER, aBuffer );
+		glVertexAttribPointer( aIndex, aSize, GL_FLOAT, GL_FALSE, aStride, reinterpret_cast<void const*>(aOffset) );
+		glEnableVertexAttribArray( aIndex );
+	};
+
+	attribute( 1, mModelGPU.BufferId( kVboVertexColor ), 3, 0, 0 );
+	attribute( 3, mModelGPU.BufferId( kVboVertexSpecular ), 3, 0, 0 );
+	attribute( 4, mModelGPU.BufferId( kVboVertexShininess ), 1, 0, 0 );
+
+	glGenBuffers( 1, &mVertexBuffer );
+
+	if( SkinningBackend::Cpu == mBackend )
+	{
+		mBindPositions = aModel.Vertices();
+		mBindNormals = aModel.Normals();
+		for( VertexSkin const& skin : aSkin )
+		{
+			mJoints.push_back( PackJoints( skin ) );
+			mWeights.push_back( skin.mWeights );
+		}
+		mSkinnedPositions = mBindPositions;
+		mSkinnedNormals = mBindNormals;
+
+		// Streamed: positions, then normals
+		glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+		glBufferData( GL_ARRAY_BUFFER, 2 * mVertexCount * sizeof(Vec3f), nullptr, GL_STREAM_DRAW );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, mVertexCount * sizeof(Vec3f), mSkinnedPositions.data() );
+		glBufferSubData( GL_ARRAY_BUFFER, mVertexCount * sizeof(Vec3f), mVertexCount * sizeof(Vec3f), mSkinnedNormals.data() );
+
+		attribute( 0, mVertexBuffer, 3, 0, 0 );
+		attribute( 2, mVertexBuffer, 3, 0, mVertexCount * sizeof(Vec3f) );
+	}
+	else
+	{
+		attribute( 0, mModelGPU.BufferId( kVboPositions ), 3, 0, 0 );
+		attribute( 2, mModelGPU.BufferId( kVboNormals ), 3, 0, 0 );
+
+		glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+		glBufferData( GL_ARRAY_BUFFER, mVertexCount * sizeof(VertexSkin), aSkin.data(), GL_STATIC_DRAW );
+
+		glVertexAttribIPointer( kJointsAttrib_, 4, GL_UNSIGNED_BYTE, sizeof(VertexSkin), reinterpret_cast<void const*>(offsetof(VertexSkin, mJoints)) );
+		glEnableVertexAttribArray( kJointsAttrib_ );
+		attribute( kWeightsAttrib_, mVertexBuffer, 4, sizeof(VertexSkin), offsetof(VertexSkin, mWeights) );
+
+		// Identity until the first Update()
+		std::vector<Mat44f> const identity( std::max<std::size_t>( mJointCount, 1 ), kIdentity44f );
+		glGenBuffers( 1, &mPaletteBuffer );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mPaletteBuffer );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, identity.size() * sizeof(Mat44f), identity.data(), GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	}
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+
+SkinnedModel::~SkinnedModel()
+{
+	glDeleteVertexArrays( 1, &mVAO );
+	glDeleteBuffers( 1, &mVertexBuffer );
+	glDeleteBuffers( 1, &mPaletteBuffer );
+}
+
+
+void SkinnedModel::Update( std::span<const Mat44f> aPalette )
+{
+	assert( aPalette.size() == mJointCount );
+
+	if( SkinningBackend::Cpu == mBackend )
+	{
+		SkinVertices( aPalette, mBindPositions, mBindNormals, mJoints, mWeights, mSkinnedPositions, mSkinnedNormals );
+
+		// Orphan, so that the driver doesn't wait for last frame's draw
+		glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+		glBufferData( GL_ARRAY_BUFFER, 2 * mVertexCount * sizeof(Vec3f), nullptr, GL_STREAM_DRAW );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, mVertexCount * sizeof(Vec3f), mSkinnedPositions.data() );
+		glBufferSubData( GL_ARRAY_BUFFER, mVertexCount * sizeof(Vec3f), mVertexCount * sizeof(Vec3f), mSkinnedNormals.data() );
+	}
+	else
+	{
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mPaletteBuffer );
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, aPalette.size() * sizeof(Mat44f), aPalette.data() );
+	}
+}
+
+
+void SkinnedModel::Draw() const
+{
+	glUniform1ui( kSkinOnGpuLocation_, SkinningBackend::Gpu == mBackend ? 1 : 0 );
+
+	if( SkinningBackend::Gpu == mBackend )
+	{
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kPaletteBinding_, mPaletteBuffer );
+	}
+
+	glBindVertexArray( mVAO );
+	glDrawArrays( GL_TRIANGLES, 0, GLsizei(mVertexCount) );
+}
+
+
+SkinningBackend SkinnedModel::Backend() const
+{
+	return mBackend;
+}
+
+
+std::size_t SkinnedModel::VertexCount() const
+{
+	return mVertexCount;
+}
+
+
+std::size_t SkinnedModel::JointCount() const
+{
+	return mJointCount;
+}
+
+
+std::span<const Vec3f> SkinnedModel::SkinnedPositions() const
+{
+	return mSkinnedPositions;
+}
+
+
+std::span<const Vec3f> SkinnedModel::SkinnedNormals() const
+{
+	return mSkinnedNormals;
+}
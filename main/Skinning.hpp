@@ -0,0 +1,160 @@
+#ifndef SKINNING_HPP
+#define SKINNING_HPP
+
+#include "ModelObject.hpp"
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Where a SkinnedModel deforms its vertices. Both take the same palette
+// (Skeleton::EvaluatePose()); the CPU path is the reference.
+enum class SkinningBackend
+{
+	Cpu, // SkinVertices() into a streaming vertex buffer
+	Gpu  // In skinned.vert, with the palette in a storage buffer
+};
+
+// Up to four joints per vertex, and their weights (which should add up to
+// one). Unused slots have a weight of zero.
+struct VertexSkin
+{
+	std::uint8_t mJoints[4];
+	Vec4f mWeights;
+};
+
+static_assert( sizeof(VertexSkin) == 20 );
+
+// A VertexSkin for vertices that only follow one joint
+constexpr VertexSkin RigidSkin( std::uint8_t aJoint ) noexcept
+{
+	return { { aJoint, 0, 0, 0 }, { 1.f, 0.f, 0.f, 0.f } };
+}
+
+// The four joints in one integer, joint k in bits 8k to 8k+7
+constexpr std::uint32_t PackJoints( VertexSkin const& aSkin ) noexcept
+{
+	return std::uint32_t(aSkin.mJoints[0])
+		| std::uint32_t(aSkin.mJoints[1]) << 8
+		| std::uint32_t(aSkin.mJoints[2]) << 16
+		| std::uint32_t(aSkin.mJoints[3]) << 24;
+}
+
+
+// ===========================================================================
+//		Skeleton
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	A joint hierarchy and its bind (rest) pose. Joints are stored parents
+//	first, so a pose is evaluated in one forward pass.
+//
+//	A pose is a Transform per joint, relative to its parent, like the bind
+//	pose. EvaluatePose() turns it into the skinning palette: per joint, the
+//	matrix that takes a vertex from the bind pose to the posed model, which
+//	is what both skinning backends consume.
+// ---------------------------------------------------------------------------
+class Skeleton
+{
+public:
+	using JointID = std::size_t;
+
+	static constexpr JointID kNoParent = JointID(-1);
+
+	// VertexSkin indexes joints with a byte
+	static constexpr std::size_t kMaxJoints = 256;
+
+	// The parent must already exist (or be kNoParent)
+	JointID AddJoint( JointID aParent, Transform const& aBindPose );
+
+	std::size_t JointCount() const;
+	JointID Parent( JointID aJoint ) const;
+
+	std::span<const Transform> BindPose() const;
+
+	// aLocalPose and aPalette have JointCount() elements. The bind pose
+	// gives identity matrices.
+	void EvaluatePose( std::span<const Transform> aLocalPose, std::span<Mat44f> aPalette ) const;
+
+private:
+	std::vector<JointID> mParents;
+	std::vector<Transform> mBindPose;
+
+	// Model space to joint space, in the bind pose
+	std::vector<Mat44f> mInverseBind;
+};
+
+
+// Linear blend skinning: each vertex is moved by the weighted sum of its
+// joints' palette matrices. The normals are transformed by the same
+// matrices (which is right for rotations and uniform scales), but not
+// renormalized. The skins are split into PackJoints() and the weights,
+// which streams through the cache better than VertexSkin. The arrays of
+// vertices all have the same length.
+void SkinVertices( std::span<const Mat44f> aPalette, std::span<const Vec3f> aPositions, std::span<const Vec3f> aNormals, std::span<const std::uint32_t> aJoints, std::span<const Vec4f> aWeights, std::span<Vec3f> aOutPositions, std::span<Vec3f> aOutNormals );
+
+
+// ===========================================================================
+//		SkinnedModel
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	A model whose vertices follow a skeleton, drawn with skinned.vert.
+//
+//	The colours, materials and (for the GPU backend) the bind pose live in
+//	the model's ModelObjectGPU. The CPU backend skins every vertex in
+//	Update() and streams the positions and normals into a vertex buffer
+//	that is orphaned each frame. The GPU backend only uploads the palette;
+//	the joints and weights are vertex attributes and the vertex shader
+//	blends the matrices (skinning.glsl).
+// ---------------------------------------------------------------------------
+class SkinnedModel
+{
+public:
+	SkinnedModel( ModelObject const& aModel, std::span<const VertexSkin> aSkin, std::size_t aJointCount, SkinningBackend aBackend );
+	~SkinnedModel();
+
+	SkinnedModel( SkinnedModel const& ) = delete;
+	SkinnedModel& operator= ( SkinnedModel const& ) = delete;
+
+	// aPalette comes from Skeleton::EvaluatePose()
+	void Update( std::span<const Mat44f> aPalette );
+
+	// With skinned.vert bound; sets its uSkinOnGpu. Binds its own VAO.
+	void Draw() const;
+
+	SkinningBackend Backend() const;
+	std::size_t VertexCount() const;
+	std::size_t JointCount() const;
+
+	// The skinned vertices of the last Update(), CPU backend only
+	std::span<const Vec3f> SkinnedPositions() const;
+	std::span<const Vec3f> SkinnedNormals() const;
+
+private:
+	ModelObjectGPU mModelGPU;
+	SkinningBackend mBackend;
+	std::size_t mVertexCount;
+	std::size_t mJointCount;
+
+	// CPU backend
+	std::vector<Vec3f> mBindPositions;
+	std::vector<Vec3f> mBindNormals;
+	std::vector<std::uint32_t> mJoints;
+	std::vector<Vec4f> mWeights;
+	std::vector<Vec3f> mSkinnedPositions;
+	std::vector<Vec3f> mSkinnedNormals;
+
+	// Positions, then normals (CPU), or joints and weights (GPU)
+	GLuint mVertexBuffer;
+	GLuint mPaletteBuffer;
+	GLuint mVAO;
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "StaticDrawBatch.hpp"
+
+#include "ModelObject.hpp"
+
+#include "../vmlib/mat33.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+	constexpr GLuint kCullGroupSize_ = 64; // local_size_x of staticCull.comp
+
+	// Replaces the contents of aBuffer (the old storage is orphaned, so the
+	// GPU may still be reading it)
+	template< typename T >
+	void Stream_( GLenum aTarget, GLuint aBuffer, std::vector<T> const& aData )
+	{
+		glBindBuffer( aTarget, aBuffer );
+		glBufferData( aTarget, GLsizeiptr(aData.size() * sizeof(T)), aData.data(), GL_STREAM_DRAW );
+	}
+
+	Mat44f Embed_( Mat33f const& aMatrix )
+	{
+		Mat44f result = kIdentity44f;
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+				result[i, j] = aMatrix[i, j];
+		}
+
+		return result;
+	}
+
+	// aBounds (in model space) where aTransform puts it. Transform scales
+	// before it rotates, so the largest scale bounds the radius.
+	Vec4f WorldSphere_( const Transform& aTransform, const Mat44f& aWorld, Vec4f aBounds )
+	{
+		const Vec4f centre = aWorld * Vec4f{ aBounds.x, aBounds.y, aBounds.z, 1.f };
+		const float scale = std::max( { std::abs( aTransform.mScale.x ), std::abs( aTransform.mScale.y ), std::abs( aTransform.mScale.z ) } );
+
+		return { centre.x, centre.y, centre.z, aBounds.w * scale };
+	}
+
+	template< typename T >
+	std::vector<T> Read_( GLuint aBuffer, std::size_t aCount )
+	{
+		glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+		std::vector<T> data( aCount );
+		glBindBuffer( GL_COPY_READ_BUFFER, aBuffer );
+		glGetBufferSubData( GL_COPY_READ_BUFFER, 0, GLsizeiptr(aCount * sizeof(T)), data.data() );
+		glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+		return data;
+	}
+}
+
+
+StaticDrawBatch::StaticDrawBatch( const GeometryBuffer& aGeometry )
+	: mCullProgram( { { GL_COMPUTE_SHADER, "assets/cw2/staticCull.comp" } } )
+	, mVertexArray( 0 )
+	, mBuffers{ 0, 0, 0, 0, 0 }
+	, mInstanceNumbers( 0 )
+	, mUploaded( false )
+	, mCulled( false )
+{
+	glGenBuffers( 5, mBuffers );
+
+	glGenVertexArrays( 1, &mVertexArray );
+	aGeometry.SetupVertexArray( mVertexArray );
+
+	glBindVertexArray( mVertexArray );
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffers[3] );
+	glVertexAttribIPointer( kInstanceAttribute, 1, GL_UNSIGNED_INT, 0, nullptr );
+	glVertexAttribDivisor( kInstanceAttribute, 1 );
+	glEnableVertexAttribArray( kInstanceAttribute );
+	glBindVertexArray( 0 );
+}
+
+
+StaticDrawBatch::~StaticDrawBatch()
+{
+	glDeleteVertexArrays( 1, &mVertexArray );
+	glDeleteBuffers( 5, mBuffers );
+}
+
+
+void StaticDrawBatch::Clear()
+{
+	mCommands.clear();
+	mDraws.clear();
+	mInstances.clear();
+	mUploaded = false;
+	mCulled = false;
+}
+
+
+void StaticDrawBatch::Add( const MeshRange& aMesh, std::span<const Transform> aInstances, const StaticMaterial& aMaterial )
+{
+	if( aInstances.empty() || 0 == aMesh.indices.count )
+		return;
+
+	const auto draw = std::uint32_t(mDraws.size());
+	const auto firstInstance = std::uint32_t(mInstances.size());
+
+	mCommands.push_back( {
+		aMesh.indices.count,
+		GLuint(aInstances.size()),
+		aMesh.indices.first,
+		GLint(aMesh.vertices.first),
+		firstInstance
+	} );
+	mDraws.push_back( { firstInstance, aMaterial.flags, aMaterial.pointLightScale, 0 } );
+
+	for( const Transform& transform : aInstances )
+	{
+		const Mat44f world = transform.Matrix();
+		mInstances.push_back( {
+			world,
+			Embed_( transform.NormalUpdateMatrix() ),
+			WorldSphere_( transform, world, aMesh.bounds ),
+			draw,
+			{ 0, 0, 0 }
+		} );
+	}
+
+	mUploaded = false;
+	mCulled = false;
+}
+
+
+void StaticDrawBatch::Cull( const Frustum& aFrustum, CullingBackend aBackend )
+{
+	if( mCommands.empty() )
+		return;
+
+	if( !mUploaded )
+		Upload_();
+
+	mCulledCommands = mCommands;
+
+	if( CullingBackend::Cpu == aBackend )
+	{
+		// Each draw's visible instances go from its first instance on, as the
+		// shader has them
+		mVisible.resize( mInstances.size() );
+		for( DrawElementsIndirectCommand& command : mCulledCommands )
+		{
+			GLuint visible = 0;
+			for( GLuint i = command.baseInstance; i < command.baseInstance + command.instanceCount; ++i )
+			{
+				if( Intersects( aFrustum, mInstances[i].sphere ) )
+					mVisible[command.baseInstance + visible++] = i;
+			}
+
+			command.instanceCount = visible;
+		}
+
+		Stream_( GL_DRAW_INDIRECT_BUFFER, mBuffers[0], mCulledCommands );
+		Stream_( GL_SHADER_STORAGE_BUFFER, mBuffers[4], mVisible );
+	}
+	else
+	{
+		// The shader counts the instances it keeps, from zero
+		for( DrawElementsIndirectCommand& command : mCulledCommands )
+			command.instanceCount = 0;
+
+		Stream_( GL_DRAW_INDIRECT_BUFFER, mBuffers[0], mCulledCommands );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mBuffers[4] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(mInstances.size() * sizeof(GLuint)), nullptr, GL_STREAM_DRAW );
+
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kDrawsBinding, mBuffers[1] );
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kInstancesBinding, mBuffers[2] );
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kVisibleBinding, mBuffers[4] );
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCommandsBinding, mBuffers[0] );
+
+		glUseProgram( mCullProgram.programId() );
+		glUniform4fv( 0, GLsizei(aFrustum.planes.size()), &aFrustum.planes[0].x );
+		glUniform1ui( 6, GLuint(mInstances.size()) );
+
+		// One thread per instance
+		glDispatchCompute( GLuint( (mInstances.size() + kCullGroupSize_ - 1) / kCullGroupSize_ ), 1, 1 );
+
+		// Next readers: the draw (indirect arguments) and static.vert
+		glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+	}
+
+	mCulled = true;
+}
+
+
+void StaticDrawBatch::Draw()
+{
+	if( mCommands.empty() )
+		return;
+
+	if( !mUploaded )
+		Upload_();
+
+	// Not culled: every instance, in order, which are the instance numbers
+	if( !mCulled )
+		Stream_( GL_DRAW_INDIRECT_BUFFER, mBuffers[0], mCommands );
+	else
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBuffers[0] );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kDrawsBinding, mBuffers[1] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kInstancesBinding, mBuffers[2] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kVisibleBinding, mBuffers[mCulled ? 4 : 3] );
+
+	glBindVertexArray( mVertexArray );
+	glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(mCommands.size()), 0 );
+}
+
+
+void StaticDrawBatch::Upload_()
+{
+	// The instance numbers only change when there are more instances than
+	// ever before
+	if( mInstances.size() > mInstanceNumbers )
+	{
+		std::vector<GLuint> numbers( mInstances.size() );
+		std::iota( numbers.begin(), numbers.end(), GLuint(0) );
+		glBindBuffer( GL_ARRAY_BUFFER, mBuffers[3] );
+		glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(numbers.size() * sizeof(GLuint)), numbers.data(), GL_STATIC_DRAW );
+		mInstanceNumbers = numbers.size();
+	}
+
+	Stream_( GL_SHADER_STORAGE_BUFFER, mBuffers[1], mDraws );
+	Stream_( GL_SHADER_STORAGE_BUFFER, mBuffers[2], mInstances );
+
+	mUploaded = true;
+}
+
+
+GLuint StaticDrawBatch::VertexArray() const
+{
+	return mVertexArray;
+}
+
+
+std::size_t StaticDrawBatch::DrawCount() const
+{
+	return mCommands.size();
+}
+
+
+std::size_t StaticDrawBatch::InstanceCount() const
+{
+	return mInstances.size();
+}
+
+
+std::span<const DrawElementsIndirectCommand> StaticDrawBatch::Commands() const
+{
+	return mCommands;
+}
+
+
+std::vector<DrawElementsIndirectCommand> StaticDrawBatch::ReadCommands() const
+{
+	return Read_<DrawElementsIndirectCommand>( mBuffers[0], mCommands.size() );
+}
+
+
+std::vector<GLuint> StaticDrawBatch::ReadVisible() const
+{
+	return Read_<GLuint>( mBuffers[mCulled ? 4 : 3], mInstances.size() );
+}
+
+
+bool StaticDrawBatch::DrawParameters()
+{
+	// Looked up once. It is core in GL 4.6, but static.vert is GLSL 4.30,
+	// where gl_DrawID is only there with the extension.
+	static bool const supported = [] {
+		GLint count = 0;
+		glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+
+		for( GLint i = 0; i < count; ++i )
+		{
+			auto const* name = reinterpret_cast<char const*>(glGetStringi( GL_EXTENSIONS, GLuint(i) ));
+			if( name && 0 == std::strcmp( name, "GL_ARB_shader_draw_parameters" ) )
+				return true;
+		}
+
+		return false;
+	}();
+
+	return supported;
+}
@@ -0,0 +1,171 @@
+#ifndef STATIC_DRAW_BATCH_HPP
+#define STATIC_DRAW_BATCH_HPP
+
+#include "Frustum.hpp"
+#include "GeometryBuffer.hpp"
+
+#include "../support/program.hpp"
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec4.hpp"
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct Transform;
+
+enum StaticMaterialFlags : std::uint32_t
+{
+	kStaticTextured = 1 << 0 // Colour from uTexture (unit 0), not the vertices
+};
+
+// How a draw's instances are shaded by static.frag
+struct StaticMaterial
+{
+	std::uint32_t flags = 0;
+
+	// Scales the point lights' distance attenuation
+	float pointLightScale = 10.f;
+};
+
+// The arguments of one draw in glMultiDrawElementsIndirect()
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+static_assert( sizeof(DrawElementsIndirectCommand) == 20 );
+
+
+// ===========================================================================
+//		StaticDrawBatch
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Draws instances of meshes in a GeometryBuffer, all of them with a single
+//	glMultiDrawElementsIndirect(): one command per Add(), however many there
+//	are. The draw calls no longer grow with the objects.
+//
+//	What differs between draws is in storage buffers that static.vert reads:
+//	per draw, its material and where its instances start (binding 9), per
+//	instance, its transforms and bounding sphere (binding 10), and the
+//	instances to draw, each draw's together from its first instance on
+//	(binding 11). static.vert finds its draw with gl_DrawID
+//	(ARB_shader_draw_parameters, see DrawParameters()). GL 4.3 has no
+//	gl_DrawID, so without the extension the slot in that list comes from
+//	attribute 6 instead: an instanced attribute counting up from zero,
+//	offset by each command's base instance, which is the draw's first
+//	instance. The instance records then say which draw they belong to.
+//
+//	Cull() drops the instances outside a frustum. On the CPU, it builds the
+//	list of instances to draw and the commands' instance counts, which are
+//	uploaded. On the GPU, staticCull.comp tests every instance in parallel
+//	and appends those inside to their draw's part of the list, counting
+//	them in the command's instanceCount (binding 12), so that nothing per
+//	instance happens on the CPU beyond the upload of the transforms. The
+//	instances of a draw then come in no particular order. Without Cull(),
+//	every instance is drawn.
+//
+//	Clear(), Add() the frame's draws, Cull() them, and Draw() with the
+//	static program bound; the buffers are uploaded once per frame,
+//	orphaning last frame's.
+// ---------------------------------------------------------------------------
+class StaticDrawBatch
+{
+public:
+	static constexpr GLuint kDrawsBinding = 9;
+	static constexpr GLuint kInstancesBinding = 10;
+	static constexpr GLuint kVisibleBinding = 11;
+	static constexpr GLuint kCommandsBinding = 12;
+	static constexpr GLuint kInstanceAttribute = 6;
+
+	explicit StaticDrawBatch( const GeometryBuffer& aGeometry );
+	~StaticDrawBatch();
+
+	StaticDrawBatch( const StaticDrawBatch& ) = delete;
+	StaticDrawBatch& operator=( const StaticDrawBatch& ) = delete;
+
+	void Clear();
+
+	// One draw of aMesh, an instance per transform. Draws without instances
+	// are left out.
+	void Add( const MeshRange& aMesh, std::span<const Transform> aInstances, const StaticMaterial& aMaterial = {} );
+
+	// Leaves out the instances outside aFrustum (by their mesh's bounding
+	// sphere) until the next Clear(). The GPU backend leaves its compute
+	// program bound.
+	void Cull( const Frustum& aFrustum, CullingBackend aBackend );
+
+	void Draw();
+
+	// The geometry's attributes and attribute 6
+	GLuint VertexArray() const;
+
+	std::size_t DrawCount() const;
+	std::size_t InstanceCount() const;
+	std::span<const DrawElementsIndirectCommand> Commands() const;
+
+	// The commands and the list of instances to draw as the GPU has them,
+	// after Cull(). This stalls the pipeline, so it is meant for tests and
+	// debugging only.
+	std::vector<DrawElementsIndirectCommand> ReadCommands() const;
+	std::vector<GLuint> ReadVisible() const;
+
+	// Whether static.vert can be built with DRAW_PARAMETERS set
+	static bool DrawParameters();
+
+private:
+	// Must match static.vert (std430)
+	struct Draw_
+	{
+		std::uint32_t firstInstance;
+		std::uint32_t flags;
+		float pointLightScale;
+		std::uint32_t pad;
+	};
+
+	struct Instance_
+	{
+		Mat44f world;
+		Mat44f normal;
+		Vec4f sphere;
+		std::uint32_t draw;
+		std::uint32_t pad[3];
+	};
+
+	static_assert( sizeof(Draw_) == 16 );
+	static_assert( sizeof(Instance_) == 160 );
+
+private:
+	void Upload_();
+
+private:
+	ShaderProgram mCullProgram;
+
+	std::vector<DrawElementsIndirectCommand> mCommands;
+	std::vector<Draw_> mDraws;
+	std::vector<Instance_> mInstances;
+
+	// Cull()'s, on the CPU
+	std::vector<DrawElementsIndirectCommand> mCulledCommands;
+	std::vector<GLuint> mVisible;
+
+	GLuint mVertexArray;
+
+	// Commands, draws, instances, instance numbers and visible instances.
+	// Without culling, the instance numbers are the list of instances.
+	GLuint mBuffers[5];
+	std::size_t mInstanceNumbers;
+
+	bool mUploaded;
+	bool mCulled;
+};
+
+#endif
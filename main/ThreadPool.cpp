@@ -0,0 +1,104 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool( unsigned aWorkerCount )
+	: mFunc( nullptr )
+	, mCount( 0 )
+	, mNext( 0 )
+	, mGeneration( 0 )
+	, mBusyWorkers( 0 )
+{
+	mWorkers.reserve( aWorkerCount );
+	for( unsigned i = 0; i < aWorkerCount; i++ )
+	{
+		mWorkers.emplace_back( [this] ( std::stop_token aStop ) { WorkerLoop( aStop ); } );
+	}
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	// std::jthread requests a stop and joins. mWake is a
+	// condition_variable_any, so the stop request wakes the workers up.
+	mWorkers.clear();
+}
+
+
+void ThreadPool::ParallelFor( std::size_t aCount, std::function<void( std::size_t )> const& aFunc )
+{
+	if( mWorkers.empty() || aCount <= 1 )
+	{
+		for( std::size_t i = 0; i < aCount; i++ )
+		{
+			aFunc( i );
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mFunc = &aFunc;
+		mCount = aCount;
+		mNext = 0;
+		mBusyWorkers = unsigned(mWorkers.size());
+		mGeneration++;
+	}
+	mWake.notify_all();
+
+	RunItems();
+
+	// Every worker has to check in, even if it found nothing left to do, so
+	// that none of them is still looking at this job when the next starts.
+	std::unique_lock<std::mutex> lock( mMutex );
+	mDone.wait( lock, [this] { return 0 == mBusyWorkers; } );
+	mFunc = nullptr;
+}
+
+
+unsigned ThreadPool::WorkerCount() const
+{
+	return unsigned(mWorkers.size());
+}
+
+
+unsigned ThreadPool::DefaultWorkerCount()
+{
+	const unsigned hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+
+void ThreadPool::WorkerLoop( std::stop_token aStop )
+{
+	std::size_t seenGeneration = 0;
+
+	while( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			if( !mWake.wait( lock, aStop, [&] { return mGeneration != seenGeneration; } ) )
+			{
+				return;
+			}
+			seenGeneration = mGeneration;
+		}
+
+		RunItems();
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if( 0 == --mBusyWorkers )
+			{
+				mDone.notify_one();
+			}
+		}
+	}
+}
+
+
+void ThreadPool::RunItems()
+{
+	for( std::size_t i = mNext.fetch_add( 1 ); i < mCount; i = mNext.fetch_add( 1 ) )
+	{
+		(*mFunc)( i );
+	}
+}
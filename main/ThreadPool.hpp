@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ===========================================================================
+//		ThreadPool
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	A fixed set of worker threads for per-frame data parallel work. The only
+//	operation is ParallelFor(), which blocks until every item is done; the
+//	calling thread works on items too, so a pool with zero workers simply
+//	runs the loop serially.
+//
+//	Items are handed out one at a time from a shared counter, so uneven
+//	items (e.g. emitters of different sizes) balance out by themselves.
+//	Functions passed to ParallelFor() must not throw.
+// ---------------------------------------------------------------------------
+class ThreadPool
+{
+public:
+	explicit ThreadPool( unsigned aWorkerCount );
+	~ThreadPool();
+
+	ThreadPool( ThreadPool const& ) = delete;
+	ThreadPool& operator= ( ThreadPool const& ) = delete;
+
+	// Calls aFunc( i ) for every i in [0, aCount)
+	void ParallelFor( std::size_t aCount, std::function<void( std::size_t )> const& aFunc );
+
+	unsigned WorkerCount() const;
+
+	// Hardware threads minus the calling one
+	static unsigned DefaultWorkerCount();
+
+private:
+	void WorkerLoop( std::stop_token aStop );
+	void RunItems();
+
+private:
+	std::mutex mMutex;
+	std::condition_variable_any mWake;
+	std::condition_variable mDone;
+
+	// Current job. Written under mMutex before a new generation starts.
+	std::function<void( std::size_t )> const* mFunc;
+	std::size_t mCount;
+	std::atomic<std::size_t> mNext;
+	std::size_t mGeneration;
+	unsigned mBusyWorkers;
+
+	// Last, so that the threads are joined before the rest goes away
+	std::vector<std::jthread> mWorkers;
+};
+
+#endif
@@ -1,42 +1,164 @@
 #include "UIGroup.hpp"
 
+#include <cstddef>
+#include <span>
+#include <utility>
+
 UIGroup::UIGroup(std::vector<UIElement> UIelements)
-	: elementCount(0)
+	: uiElements(std::move(UIelements))
+	, elementCount(static_cast<int>(uiElements.size()))
+	, uiVbo(0)
+	, uiVao(0)
+	, uiMousePos{ -2.f, -2.f }
+	, uiMouseStatus(GLFW_RELEASE)
+	, uiHovered(-1)
+{
+	glGenBuffers(1, &uiVbo);
+	glGenVertexArrays(1, &uiVao);
+
+	glBindVertexArray(uiVao);
+	glBindBuffer(GL_ARRAY_BUFFER, uiVbo);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(UIVertex), reinterpret_cast<void*>(offsetof(UIVertex, position)));
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(UIVertex), reinterpret_cast<void*>(offsetof(UIVertex, colour)));
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	Repack();
+	RebuildHitGrid();
+}
+
+UIGroup::~UIGroup()
+{
+	ReleaseBuffers();
+}
+
+UIGroup::UIGroup(UIGroup&& other) noexcept
+	: uiElements(std::move(other.uiElements))
+	, elementCount(std::exchange(other.elementCount, 0))
+	, uiBatch(std::move(other.uiBatch))
+	, uiFirstVertex(std::move(other.uiFirstVertex))
+	, uiVbo(std::exchange(other.uiVbo, 0))
+	, uiVao(std::exchange(other.uiVao, 0))
+	, uiDirtyElements(std::move(other.uiDirtyElements))
+	, uiHitGrid(std::move(other.uiHitGrid))
+	, uiMousePos(other.uiMousePos)
+	, uiMouseStatus(other.uiMouseStatus)
+	, uiHovered(std::exchange(other.uiHovered, -1))
+	, uiStats(other.uiStats)
 {
-	for (auto const& element : UIelements)
+}
+
+UIGroup& UIGroup::operator=(UIGroup&& other) noexcept
+{
+	if (this != &other)
 	{
-		uiElements.push_back(element);
-		uiElementGPUs.push_back(UIElementGPU(element));
-		elementCount += 1;
+		ReleaseBuffers();
+
+		uiElements = std::move(other.uiElements);
+		elementCount = std::exchange(other.elementCount, 0);
+		uiBatch = std::move(other.uiBatch);
+		uiFirstVertex = std::move(other.uiFirstVertex);
+		uiVbo = std::exchange(other.uiVbo, 0);
+		uiVao = std::exchange(other.uiVao, 0);
+		uiDirtyElements = std::move(other.uiDirtyElements);
+		uiHitGrid = std::move(other.uiHitGrid);
+		uiMousePos = other.uiMousePos;
+		uiMouseStatus = other.uiMouseStatus;
+		uiHovered = std::exchange(other.uiHovered, -1);
+		uiStats = other.uiStats;
 	}
+
+	return *this;
 }
 
-void UIGroup::checkMouseInterractions(Vec2f mousePos, int mouseStatus)
+void UIGroup::OnCursorMoved(Vec2f mousePos)
 {
-	for (int i = 0; i < elementCount; i++)
+	uiMousePos = mousePos;
+	Hover(uiHitGrid.HitTest(mousePos));
+}
+
+void UIGroup::OnMouseButton(int mouseStatus)
+{
+	uiMouseStatus = mouseStatus;
+
+	if (uiHovered >= 0)
 	{
-		uiElements[i].checkUpdates(mousePos, mouseStatus);
+		UpdateElement(uiHovered, true);
 	}
 }
 
-const UIElement& UIGroup::getElement(int index) const
+void UIGroup::SetProperties(int index, UIElementProperties properties)
 {
-	return uiElements[index];
+	uiElements[index].SetProperties(properties);
+	uiDirtyElements.push_back(index);
+
+	RebuildHitGrid();
+
+	// The element may have moved under (or away from) the mouse; if it is
+	// still hovered, it needs its hover colour back
+	const int hovered = uiHitGrid.HitTest(uiMousePos);
+	if (hovered == uiHovered && hovered == index)
+	{
+		UpdateElement(index, true);
+	}
+	Hover(hovered);
 }
 
-UIElement& UIGroup::getElement(int index)
+void UIGroup::Draw()
 {
-	return uiElements[index];
+	uiStats = {};
+
+	bool resized = false;
+	for (int i : uiDirtyElements)
+	{
+		resized |= uiElements[i].Vertices().size() != uiFirstVertex[i + 1] - uiFirstVertex[i];
+	}
+
+	if (resized)
+	{
+		Repack();
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, uiVbo);
+		for (int i : uiDirtyElements)
+		{
+			if (uiElements[i].IsDirty())
+			{
+				const size_t first = uiFirstVertex[i];
+				const size_t count = uiFirstVertex[i + 1] - first;
+
+				uiElements[i].WriteVertices(std::span(uiBatch).subspan(first, count));
+				glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(UIVertex), count * sizeof(UIVertex), uiBatch.data() + first);
+
+				uiStats.elementsRebuilt += 1;
+				uiStats.verticesUploaded += count;
+			}
+		}
+	}
+	uiDirtyElements.clear();
+
+	if (!uiBatch.empty())
+	{
+		glBindVertexArray(uiVao);
+		glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(uiBatch.size()));
+		uiStats.drawCalls += 1;
+	}
 }
 
-const UIElementGPU& UIGroup::getElementGPU(int index) const
+const UIElement& UIGroup::getElement(int index) const
 {
-	return uiElementGPUs[index];
+	return uiElements[index];
 }
 
-UIElementGPU& UIGroup::getElementGPU(int index)
+UIElement& UIGroup::getElement(int index)
 {
-	return uiElementGPUs[index];
+	return uiElements[index];
 }
 
 const int& UIGroup::getElementCount() const
@@ -47,4 +169,88 @@ const int& UIGroup::getElementCount() const
 int& UIGroup::getElementCount()
 {
 	return elementCount;
-}
\ No newline at end of file
+}
+
+int UIGroup::getHoveredElement() const
+{
+	return uiHovered;
+}
+
+const UIBatchStats& UIGroup::GetStats() const
+{
+	return uiStats;
+}
+
+void UIGroup::Repack()
+{
+	uiFirstVertex.assign(1, 0);
+	for (int i = 0; i < elementCount; i++)
+	{
+		uiFirstVertex.push_back(uiFirstVertex.back() + uiElements[i].Vertices().size());
+	}
+
+	uiBatch.resize(uiFirstVertex.back());
+	for (int i = 0; i < elementCount; i++)
+	{
+		const size_t first = uiFirstVertex[i];
+		uiElements[i].WriteVertices(std::span(uiBatch).subspan(first, uiFirstVertex[i + 1] - first));
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, uiVbo);
+	glBufferData(GL_ARRAY_BUFFER, uiBatch.size() * sizeof(UIVertex), uiBatch.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	uiStats.elementsRebuilt += elementCount;
+	uiStats.verticesUploaded += uiBatch.size();
+}
+
+void UIGroup::ReleaseBuffers()
+{
+	glDeleteBuffers(1, &uiVbo);
+	glDeleteVertexArrays(1, &uiVao);
+
+	uiVbo = 0;
+	uiVao = 0;
+}
+
+void UIGroup::Hover(int index)
+{
+	if (index == uiHovered)
+	{
+		return;
+	}
+
+	if (uiHovered >= 0)
+	{
+		UpdateElement(uiHovered, false);
+	}
+
+	uiHovered = index;
+
+	if (uiHovered >= 0)
+	{
+		UpdateElement(uiHovered, true);
+	}
+}
+
+void UIGroup::UpdateElement(int index, bool mouseOver)
+{
+	uiElements[index].checkUpdates(mouseOver, uiMouseStatus);
+
+	if (uiElements[index].IsDirty())
+	{
+		uiDirtyElements.push_back(index);
+	}
+}
+
+void UIGroup::RebuildHitGrid()
+{
+	std::vector<UIRect> bounds;
+	bounds.reserve(uiElements.size());
+	for (const auto& element : uiElements)
+	{
+		bounds.push_back(element.Bounds());
+	}
+
+	uiHitGrid.Build(bounds);
+}
@@ -2,27 +2,96 @@
 #define UI_GROUP_HPP
 
 #include "UIObject.hpp"
+#include "UIHitGrid.hpp"
 
+#include <cstddef>
+
+// What the last Draw() did
+struct UIBatchStats
+{
+	size_t elementsRebuilt = 0;
+	size_t verticesUploaded = 0;
+	size_t drawCalls = 0;
+};
+
+// All elements are drawn from one vertex buffer, with their colour in the
+// vertices (uiShader.vert), in one draw call. Draw() only rewrites the
+// vertices of elements that are dirty (their colour changed in
+// checkUpdates(), or their geometry in SetProperties()), and repacks the
+// whole buffer only if an element's vertex count changed.
+//
+// Input is event driven: OnCursorMoved() and OnMouseButton() are called
+// from the GLFW callbacks, hit test through a UIHitGrid, and only update
+// the element the mouse left and the one it is over now. Elements are in
+// z-order (later ones are drawn on top), and only the topmost element
+// under the mouse is hovered or clicked. A frame without input costs
+// nothing per element.
 class UIGroup
 {
 public:
 	explicit UIGroup(std::vector<UIElement> UIelements);
+	~UIGroup();
+
+	UIGroup(const UIGroup&) = delete;
+	UIGroup& operator=(const UIGroup&) = delete;
+
+	UIGroup(UIGroup&& other) noexcept;
+	UIGroup& operator=(UIGroup&& other) noexcept;
+
+	// Mouse position in NDC
+	void OnCursorMoved(Vec2f mousePos);
+
+	// GLFW_PRESS or GLFW_RELEASE, of the left button
+	void OnMouseButton(int mouseStatus);
+
+	// New geometry for an element; re-indexes it for hit testing
+	void SetProperties(int index, UIElementProperties properties);
 
-	void checkMouseInterractions(Vec2f mousePos, int mouseStatus);
+	// With uiShader bound
+	void Draw();
 
+	// Geometry changes go through SetProperties() above, so that the hit
+	// grid knows about them
 	const UIElement& getElement(int index) const;
 	UIElement& getElement(int index);
 
-	const UIElementGPU& getElementGPU(int index) const;
-	UIElementGPU& getElementGPU(int index);
+	// The element under the mouse, or -1
+	int getHoveredElement() const;
 
 	const int& getElementCount() const;
 	int& getElementCount();
 
+	const UIBatchStats& GetStats() const;
+
+private:
+	void Repack();
+	void ReleaseBuffers();
+
+	void Hover(int index);
+	void UpdateElement(int index, bool mouseOver);
+	void RebuildHitGrid();
+
 private:
 	std::vector<UIElement> uiElements;
-	std::vector<UIElementGPU> uiElementGPUs;
 	int elementCount;
+
+	// Every element's vertices, back to back; uiFirstVertex[i] is where
+	// element i's start (and uiFirstVertex[elementCount] the end)
+	std::vector<UIVertex> uiBatch;
+	std::vector<size_t> uiFirstVertex;
+
+	GLuint uiVbo;
+	GLuint uiVao;
+
+	// Elements whose state changed since the last Draw(); may repeat
+	std::vector<int> uiDirtyElements;
+
+	UIHitGrid uiHitGrid;
+	Vec2f uiMousePos;
+	int uiMouseStatus;
+	int uiHovered;
+
+	UIBatchStats uiStats;
 };
 
-#endif
\ No newline at end of file
+#endif
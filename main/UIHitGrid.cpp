@@ -0,0 +1,105 @@
+#include "UIHitGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void UIHitGrid::Build( std::span<const UIRect> aRects )
+{
+	mRects.assign( aRects.begin(), aRects.end() );
+	mCellStart.clear();
+	mItems.clear();
+	mColumns = mRows = 0;
+
+	if( mRects.empty() )
+		return;
+
+	mLeft = mBottom = INFINITY;
+	mRight = mTop = -INFINITY;
+	for( auto const& rect : mRects )
+	{
+		mLeft = std::min( mLeft, rect.left );
+		mRight = std::max( mRight, rect.right );
+		mBottom = std::min( mBottom, rect.bottom );
+		mTop = std::max( mTop, rect.top );
+	}
+
+	// About one cell per rectangle
+	auto const side = std::clamp( int(std::ceil( std::sqrt( float(mRects.size()) ) )), 1, kMaxCells );
+	mColumns = mRight > mLeft ? side : 1;
+	mRows = mTop > mBottom ? side : 1;
+	mColumnScale = mRight > mLeft ? float(mColumns) / (mRight - mLeft) : 0.f;
+	mRowScale = mTop > mBottom ? float(mRows) / (mTop - mBottom) : 0.f;
+
+	// Counted first, then filled, each cell in one run of mItems. Filled
+	// from the last rectangle, so that each cell lists the topmost first.
+	mCellStart.assign( std::size_t(mColumns) * mRows + 1, 0 );
+
+	auto const forEachCell = [&] ( UIRect const& aRect, auto&& aFunc ) {
+		auto const x0 = CellIndex_( aRect.left, mLeft, mColumnScale, mColumns );
+		auto const x1 = CellIndex_( aRect.right, mLeft, mColumnScale, mColumns );
+		auto const y0 = CellIndex_( aRect.bottom, mBottom, mRowScale, mRows );
+		auto const y1 = CellIndex_( aRect.top, mBottom, mRowScale, mRows );
+
+		for( int y = y0; y <= y1; ++y )
+		{
+			for( int x = x0; x <= x1; ++x )
+				aFunc( std::size_t(y) * mColumns + x );
+		}
+	};
+
+	for( auto const& rect : mRects )
+		forEachCell( rect, [&] ( std::size_t aCell ) { ++mCellStart[aCell + 1]; } );
+
+	for( std::size_t i = 1; i < mCellStart.size(); ++i )
+		mCellStart[i] += mCellStart[i-1];
+
+	mItems.resize( mCellStart.back() );
+
+	std::vector<std::uint32_t> fill( mCellStart.begin(), mCellStart.end() - 1 );
+	for( std::size_t i = mRects.size(); i-- > 0; )
+		forEachCell( mRects[i], [&] ( std::size_t aCell ) { mItems[fill[aCell]++] = std::uint32_t(i); } );
+}
+
+int UIHitGrid::HitTest( Vec2f aPoint ) const
+{
+	mLastTested = 0;
+
+	if( mRects.empty() || aPoint.x < mLeft || aPoint.x > mRight || aPoint.y < mBottom || aPoint.y > mTop )
+		return -1;
+
+	auto const x = CellIndex_( aPoint.x, mLeft, mColumnScale, mColumns );
+	auto const y = CellIndex_( aPoint.y, mBottom, mRowScale, mRows );
+	auto const cell = std::size_t(y) * mColumns + x;
+
+	for( auto i = mCellStart[cell]; i < mCellStart[cell + 1]; ++i )
+	{
+		++mLastTested;
+
+		auto const& rect = mRects[mItems[i]];
+		if( rect.left <= aPoint.x && aPoint.x <= rect.right && rect.bottom <= aPoint.y && aPoint.y <= rect.top )
+			return int(mItems[i]);
+	}
+
+	return -1;
+}
+
+int UIHitGrid::Columns() const
+{
+	return mColumns;
+}
+
+int UIHitGrid::Rows() const
+{
+	return mRows;
+}
+
+std::size_t UIHitGrid::LastTested() const
+{
+	return mLastTested;
+}
+
+int UIHitGrid::CellIndex_( float aValue, float aOrigin, float aScale, int aCount ) const
+{
+	// The far edge belongs to the last cell
+	return std::clamp( int((aValue - aOrigin) * aScale), 0, aCount - 1 );
+}
@@ -0,0 +1,66 @@
+#ifndef UI_HIT_GRID_HPP
+#define UI_HIT_GRID_HPP
+
+#include "../vmlib/vec2.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Axis aligned, in NDC like the elements
+struct UIRect
+{
+	float left, right, bottom, top;
+};
+
+
+// ===========================================================================
+//		UIHitGrid
+// ---------------------------------------------------------------------------
+//		Description
+// ---------------------------------------------------------------------------
+//	Finds the element under the mouse without testing every element. The
+//	rectangles' bounding box is cut into a uniform grid of about one cell
+//	per element, and each cell lists the rectangles overlapping it; a hit
+//	test only tests the rectangles of the one cell the point falls in.
+//
+//	Rectangles are in z-order: a later one is drawn over the earlier ones
+//	(as UIGroup draws them), so it is the one hit where they overlap. Each
+//	cell lists its rectangles topmost first, so the first that contains the
+//	point is the answer.
+// ---------------------------------------------------------------------------
+class UIHitGrid
+{
+public:
+	static constexpr int kMaxCells = 64; // Per side
+
+	// Replaces the rectangles
+	void Build( std::span<const UIRect> aRects );
+
+	// Index of the topmost rectangle containing aPoint, or -1
+	int HitTest( Vec2f aPoint ) const;
+
+	int Columns() const;
+	int Rows() const;
+
+	// Rectangles tested by the last HitTest()
+	std::size_t LastTested() const;
+
+private:
+	int CellIndex_( float aValue, float aOrigin, float aScale, int aCount ) const;
+
+private:
+	std::vector<UIRect> mRects;
+
+	// The grid: cell c lists mItems[mCellStart[c]] to mItems[mCellStart[c+1]]
+	float mLeft = 0.f, mBottom = 0.f, mRight = 0.f, mTop = 0.f;
+	float mColumnScale = 0.f, mRowScale = 0.f; // Cells per unit
+	int mColumns = 0, mRows = 0;
+	std::vector<std::uint32_t> mCellStart;
+	std::vector<std::uint32_t> mItems;
+
+	mutable std::size_t mLastTested = 0;
+};
+
+#endif
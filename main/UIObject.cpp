@@ -1,6 +1,20 @@
 #include "UIObject.hpp"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
-#include <utility>
+
+
+namespace
+{
+	uint32_t PackColour_(Vec4f aColour)
+	{
+		auto const channel = [] (float aValue) {
+			return static_cast<uint32_t>(std::clamp(aValue, 0.f, 1.f) * 255.f + 0.5f);
+		};
+
+		return channel(aColour.x) | channel(aColour.y) << 8 | channel(aColour.z) << 16 | channel(aColour.w) << 24;
+	}
+}
 
 
 UIElement::UIElement(UIElementProperties properties)
@@ -76,12 +90,20 @@ void UIElement::CalculateBounds()
 
 }
 
-void UIElement::checkUpdates(Vec2f mousePos, int mouseStatus)
+void UIElement::SetProperties(UIElementProperties properties)
+{
+	CalculateVertices(properties.uiPosition, properties.uiWidth, properties.uiHeight, properties.uiBorderWidth);
+	currentColour = properties.uiColour;
+	elementProperties = properties;
+	CalculateBounds();
+	uiDirty = true;
+}
+
+void UIElement::checkUpdates(bool mouseOver, int mouseStatus)
 {
+	const Vec4f previousColour = currentColour;
 
-	//check if within bounds of element
-	if (LB <= mousePos.x && mousePos.x <= RB &&
-		BB <= mousePos.y && mousePos.y <= UB)
+	if (mouseOver)
 	{
 		currentColour = elementProperties.uiColour / 2.f;
 
@@ -103,6 +125,41 @@ void UIElement::checkUpdates(Vec2f mousePos, int mouseStatus)
 		currentColour = elementProperties.uiColour;
 	}
 
+	if (previousColour.x != currentColour.x || previousColour.y != currentColour.y ||
+		previousColour.z != currentColour.z || previousColour.w != currentColour.w)
+	{
+		uiDirty = true;
+	}
+}
+
+
+UIRect UIElement::Bounds() const
+{
+	return UIRect{ LB, RB, BB, UB };
+}
+
+
+bool UIElement::IsDirty() const
+{
+	return uiDirty;
+}
+
+
+void UIElement::WriteVertices(std::span<UIVertex> aOut)
+{
+	assert(aOut.size() == uiVertices.size());
+
+	// Borders are opaque whatever the colour
+	const uint32_t fill = PackColour_(currentColour);
+	const uint32_t border = PackColour_(Vec4f{ currentColour.x, currentColour.y, currentColour.z, 1.f });
+
+	for (size_t i = 0; i < uiVertices.size(); i++)
+	{
+		const bool onBorder = i < uiBorderFlags.size() && uiBorderFlags[i] == 1;
+		aOut[i] = UIVertex{ uiVertices[i], onBorder ? border : fill };
+	}
+
+	uiDirty = false;
 }
 
 
@@ -169,101 +226,3 @@ PITBText* UIElement::GetButtonTextPtr()
 {
 	return uiButtonText;
 }
-
-
-//GPU version of the class for loading an element into VBO's
-UIElementGPU::UIElementGPU(const UIElement& UI)
-	: uiVboPositions(0)
-	, uiVboBorderFlags(0)
-	, uiVao(0)
-{
-	CreatePositionsVBO(UI);
-	CreateBorderFlagsVBO(UI);
-	CreateVAO();
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
-
-//destructor
-UIElementGPU::~UIElementGPU()
-{
-	ReleaseBuffers();
-}
-
-
-UIElementGPU::UIElementGPU(UIElementGPU&& other) noexcept
-	: uiVboPositions(std::exchange(other.uiVboPositions, 0))
-	, uiVboBorderFlags(std::exchange(other.uiVboBorderFlags, 0))
-	, uiVao(std::exchange(other.uiVao, 0))
-{
-}
-
-
-UIElementGPU& UIElementGPU::operator=(UIElementGPU&& other) noexcept
-{
-	if (this != &other)
-	{
-		ReleaseBuffers();
-
-		uiVboPositions = std::exchange(other.uiVboPositions, 0);
-		uiVboBorderFlags = std::exchange(other.uiVboBorderFlags, 0);
-		uiVao = std::exchange(other.uiVao, 0);
-	}
-
-	return *this;
-}
-
-
-GLuint UIElementGPU::ArrayId() const
-{
-	return uiVao;
-}
-
-void UIElementGPU::CreatePositionsVBO(const UIElement& UI)
-{
-	glGenBuffers(1, &uiVboPositions);
-	glBindBuffer(GL_ARRAY_BUFFER, uiVboPositions);
-	glBufferData(GL_ARRAY_BUFFER, UI.Vertices().size() * sizeof(Vec2f), UI.Vertices().data(), GL_STATIC_DRAW);
-}
-
-void UIElementGPU::CreateBorderFlagsVBO(const UIElement& UI)
-{
-	glGenBuffers(1, &uiVboBorderFlags);
-	glBindBuffer(GL_ARRAY_BUFFER, uiVboBorderFlags);
-	glBufferData(GL_ARRAY_BUFFER, UI.BorderFlags().size() * sizeof(uint8_t), UI.BorderFlags().data(), GL_STATIC_DRAW);
-}
-
-
-void UIElementGPU::CreateVAO()
-{
-	glGenVertexArrays(1, &uiVao);
-	glBindVertexArray(uiVao);
-	glBindBuffer(GL_ARRAY_BUFFER, uiVboPositions);
-	glVertexAttribPointer(
-		0,
-		2, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, uiVboBorderFlags);
-	glVertexAttribIPointer(
-		1,
-		1, GL_UNSIGNED_BYTE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(1);
-}
-
-void UIElementGPU::ReleaseBuffers()
-{
-	glDeleteBuffers(1, &uiVboPositions);
-	glDeleteBuffers(1, &uiVboBorderFlags);
-	glDeleteVertexArrays(1, &uiVao);
-
-	uiVboPositions = 0;
-	uiVboBorderFlags = 0;
-	uiVao = 0;
-}
\ No newline at end of file
@@ -10,9 +10,12 @@
 
 #include <vector>
 #include <functional>
+#include <span>
 #include <string>
+#include <cstdint>
 
 #include "PITBFont.hpp"
+#include "UIHitGrid.hpp"
 
 struct UIElementProperties
 {
@@ -23,12 +26,33 @@ struct UIElementProperties
 	float uiBorderWidth;
 };
 
+// One vertex of a UIGroup's batch: the element's current colour as RGBA8,
+// opaque on its border
+struct UIVertex
+{
+	Vec2f position;
+	uint32_t colour;
+};
+
 class UIElement
 {
 public:
 	explicit UIElement(UIElementProperties properties);
 
-	void checkUpdates(Vec2f mousePos, int mouseStatus);
+	// Hover and click, with the mouse over the element or not (UIGroup
+	// hit tests); the element is dirty if that changed its colour
+	void checkUpdates(bool mouseOver, int mouseStatus);
+
+	UIRect Bounds() const;
+
+	// New geometry (and base colour); makes the element dirty
+	void SetProperties(UIElementProperties properties);
+
+	// Dirty elements need their vertices written to the batch again
+	bool IsDirty() const;
+
+	// Vertices().size() vertices into aOut, and the element is clean
+	void WriteVertices(std::span<UIVertex> aOut);
 
 	const std::vector<Vec2f>& Vertices() const;
 	std::vector<Vec2f>& Vertices();
@@ -59,47 +83,9 @@ private:
 	Vec4f currentColour;
 	UIElementProperties elementProperties;
 	float LB, RB, BB, UB; //Left Bound, Right Bound, Bottom Bount, Upper Bound
-	int lastUpdateState;
+	int lastUpdateState = GLFW_RELEASE;
 	PITBText* uiButtonText = nullptr;
-
-};
-
-
-
-enum uiBufferType : size_t
-{
-	uiVboPositions_index = 0,
-	uiVboVertexColour_index,
-};
-
-class UIElementGPU
-{
-public:
-	UIElementGPU( const UIElement& UI );
-	~UIElementGPU();
-
-	UIElementGPU( const UIElementGPU& ) = delete;
-	UIElementGPU& operator=( const UIElementGPU& ) = delete;
-
-	UIElementGPU(UIElementGPU&& other) noexcept;
-	UIElementGPU& operator=(UIElementGPU&& other) noexcept;
-
-	GLuint ArrayId() const;
-
-private:
-	void CreatePositionsVBO(const UIElement& UI);
-
-	void CreateBorderFlagsVBO(const UIElement& UI);
-
-	void CreateVAO();
-
-	void ReleaseBuffers();
-
-private:
-	GLuint uiVboPositions;
-	GLuint uiVboBorderFlags;
-
-	GLuint uiVao;
+	bool uiDirty = true;
 
 };
 
@@ -1,8 +1,91 @@
 #include "fontstashbackend.hpp"
+#include <algorithm>
 #include <cstring>
 #include <print>
 #include <iostream>
 
+
+namespace
+{
+	// Blocks until the GPU is done with what was fenced, and deletes the fence
+	void internal_fsb__wait(PITBFonsContext* gl, GLsync& fence)
+	{
+		if ( fence == 0 )
+		{
+			return;
+		}
+
+		GLenum result = glClientWaitSync( fence, 0, 0 );
+		if ( result == GL_TIMEOUT_EXPIRED )
+		{
+			++gl->stats.fenceWaits;
+			do
+			{
+				result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ); // 1ms
+			} while ( result == GL_TIMEOUT_EXPIRED );
+		}
+
+		glDeleteSync( fence );
+		fence = 0;
+	}
+
+
+	// Draws the vertices appended to the current segment since the last draw
+	void internal_fsb__drawBatch(PITBFonsContext* gl)
+	{
+		if ( gl->batchCount == 0 )
+		{
+			return;
+		}
+
+		const std::size_t first = gl->segment * kFonsSegmentVertices + gl->batchFirst;
+
+		if ( gl->mapped == nullptr )
+		{
+			glBindBuffer( GL_ARRAY_BUFFER, gl->ring );
+			glBufferSubData( GL_ARRAY_BUFFER, first * sizeof(PITBFonsVertex), gl->batchCount * sizeof(PITBFonsVertex), gl->staging.data() );
+			++gl->stats.uploads;
+
+			gl->staging.clear();
+		}
+
+		// Correct shader program should already be selected by now
+		glBindVertexArray( gl->vao );
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, gl->tex );
+		glDrawArrays( GL_TRIANGLES, static_cast<GLint>(first), static_cast<GLsizei>(gl->batchCount) );
+		++gl->stats.draws;
+
+		gl->batchFirst += gl->batchCount;
+		gl->batchCount = 0;
+	}
+
+
+	// The atlas is full: double it, or start it over at the largest size
+	void internal_fsb__handleError(void* uptr, int error, int /*val*/)
+	{
+		auto* gl = static_cast<PITBFonsContext*>( uptr );
+		if ( error != FONS_ATLAS_FULL )
+		{
+			return;
+		}
+
+		if ( gl->width < gl->maxAtlasSize || gl->height < gl->maxAtlasSize )
+		{
+			const int width = std::min( gl->width * 2, gl->maxAtlasSize );
+			const int height = std::min( gl->height * 2, gl->maxAtlasSize );
+			if ( fonsExpandAtlas( gl->stash, width, height ) )
+			{
+				++gl->stats.atlasGrowths;
+			}
+		}
+		else if ( fonsResetAtlas( gl->stash, gl->width, gl->height ) )
+		{
+			++gl->stats.atlasResets;
+		}
+	}
+}
+
 int internal_fsb__renderCreate(void* uptr, int width, int height)
 {
 	auto* gl = static_cast<PITBFonsContext*>( uptr );
@@ -34,61 +117,66 @@ int internal_fsb__renderCreate(void* uptr, int width, int height)
 
 
 
-		// Make sure we've got VBOs
-		if ( gl->vboVerts == 0 )
+		// The ring outlives atlas resizes
+		if ( gl->ring == 0 )
 		{
-			glGenBuffers( 1, &gl->vboVerts );
-		}
+			const GLsizeiptr bytes = kFonsRingSegments * kFonsSegmentVertices * sizeof(PITBFonsVertex);
 
-		if ( gl->vboTexCoords == 0 )
-		{
-			glGenBuffers( 1, &gl->vboTexCoords );
-		}
+			glGenBuffers( 1, &gl->ring );
+			glBindBuffer( GL_ARRAY_BUFFER, gl->ring );
 
-		if ( gl->vboColours == 0 )
-		{
-			glGenBuffers( 1, &gl->vboColours );
-		}
+			if ( GLAD_GL_VERSION_4_4 && glBufferStorage )
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage( GL_ARRAY_BUFFER, bytes, nullptr, flags );
+				gl->mapped = static_cast<PITBFonsVertex*>( glMapBufferRange( GL_ARRAY_BUFFER, 0, bytes, flags ) );
 
+				if ( gl->mapped == nullptr )
+				{
+					// Immutable now, so start again with a fresh buffer
+					glDeleteBuffers( 1, &gl->ring );
+					glGenBuffers( 1, &gl->ring );
+					glBindBuffer( GL_ARRAY_BUFFER, gl->ring );
+				}
+			}
 
+			if ( gl->mapped == nullptr )
+			{
+				glBufferData( GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+				gl->staging.reserve( kFonsSegmentVertices );
+			}
 
-		// VAO Stuff now
-		if (gl->vao == 0)
-		{
-			glGenVertexArrays( 1, &gl->vao );
-		}
-
-		glBindVertexArray( gl->vao );
-
-
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboVerts );
-		glVertexAttribPointer(
-			0,
-			2, GL_FLOAT, GL_FALSE, // XY
-			0,
-			0
-		);
-		glEnableVertexAttribArray( 0 );
-
-
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboColours );
-		glVertexAttribPointer(
-			1,
-			4, GL_UNSIGNED_BYTE, GL_TRUE, // XY
-			sizeof(uint32_t), // Because packed rgba into an unsigned int
-			0
-		);
-		glEnableVertexAttribArray( 1 );
+			++gl->stats.bufferAllocations;
 
 
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboTexCoords );
-		glVertexAttribPointer(
-			2,
-			2, GL_FLOAT, GL_FALSE, // XY
-			0,
-			0
-		);
-		glEnableVertexAttribArray( 2 );
+			// VAO Stuff now
+			glGenVertexArrays( 1, &gl->vao );
+			glBindVertexArray( gl->vao );
+
+			glVertexAttribPointer(
+				0,
+				2, GL_FLOAT, GL_FALSE, // XY
+				sizeof(PITBFonsVertex),
+				reinterpret_cast<void*>( offsetof(PITBFonsVertex, x) )
+			);
+			glEnableVertexAttribArray( 0 );
+
+			glVertexAttribPointer(
+				1,
+				4, GL_UNSIGNED_BYTE, GL_TRUE, // Because packed rgba into an unsigned int
+				sizeof(PITBFonsVertex),
+				reinterpret_cast<void*>( offsetof(PITBFonsVertex, colour) )
+			);
+			glEnableVertexAttribArray( 1 );
+
+			glVertexAttribPointer(
+				2,
+				2, GL_FLOAT, GL_FALSE, // ST
+				sizeof(PITBFonsVertex),
+				reinterpret_cast<void*>( offsetof(PITBFonsVertex, s) )
+			);
+			glEnableVertexAttribArray( 2 );
+		}
 
 
 		glBindVertexArray( 0 );
@@ -100,6 +188,13 @@ int internal_fsb__renderCreate(void* uptr, int width, int height)
 
 int internal_fsb__renderResize(void* uptr, int width, int height)
 {
+	// What was streamed so far has texture coordinates into the old atlas
+	// (fontstash flushed it to renderDraw() just before), so draw it now
+	if ( auto* gl = static_cast<PITBFonsContext*>( uptr ) )
+	{
+		internal_fsb__drawBatch( gl );
+	}
+
 	return internal_fsb__renderCreate( uptr, width, height );
 }
 
@@ -132,6 +227,7 @@ void internal_fsb__renderUpdate(void* uptr, int* rect, const unsigned char* data
 						 GL_RED, GL_UNSIGNED_BYTE, data );
 
 		glBindTexture( GL_TEXTURE_2D, 0 );
+		++gl->stats.atlasUploads;
 
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
@@ -155,26 +251,37 @@ void internal_fsb__renderDraw(void* uptr, const float* verts, const float* tcoor
 		}
 
 
-		// Correct shader program should already be selected by now
-		glBindVertexArray( gl->vao );
-
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboVerts );
-		glBufferData( GL_ARRAY_BUFFER, sizeof(float) * 2 * nverts, verts, GL_DYNAMIC_DRAW );
+		const std::size_t count = static_cast<std::size_t>( nverts );
+		if ( gl->batchFirst + gl->batchCount + count > kFonsSegmentVertices )
+		{
+			// Out of room in this frame's segment: draw what we have, and
+			// write over it once the GPU is done with it
+			internal_fsb__drawBatch( gl );
 
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboColours );
-		glBufferData( GL_ARRAY_BUFFER, sizeof(uint32_t) * nverts, colors, GL_DYNAMIC_DRAW );
+			GLsync drawn = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+			internal_fsb__wait( gl, drawn );
+			gl->batchFirst = 0;
+		}
 
-		glBindBuffer( GL_ARRAY_BUFFER, gl->vboTexCoords );
-		glBufferData( GL_ARRAY_BUFFER, sizeof(float) * 2 * nverts, tcoords, GL_DYNAMIC_DRAW );
 
+		// Just append; FonsFlushFrame() draws
+		PITBFonsVertex* out;
+		if ( gl->mapped )
+		{
+			out = gl->mapped + gl->segment * kFonsSegmentVertices + gl->batchFirst + gl->batchCount;
+		}
+		else
+		{
+			gl->staging.resize( gl->batchCount + count );
+			out = gl->staging.data() + gl->batchCount;
+		}
 
-		glActiveTexture( GL_TEXTURE0 );
-		glBindTexture( GL_TEXTURE_2D, gl->tex );
-		glDrawArrays( GL_TRIANGLES, 0, nverts );
+		for ( std::size_t i = 0; i < count; ++i )
+		{
+			out[i] = { verts[2 * i], verts[2 * i + 1], tcoords[2 * i], tcoords[2 * i + 1], colors[i] };
+		}
 
-		// Clean up
-		glBindTexture( GL_TEXTURE_2D, 0 );
-		glBindVertexArray( 0 );
+		gl->batchCount += count;
 	}
 }
 
@@ -185,24 +292,31 @@ void internal_fsb__renderDelete(void* uptr)
 
 	if ( gl )
 	{
+		for ( GLsync& fence : gl->fences )
+		{
+			if ( fence != 0 )
+			{
+				glDeleteSync( fence );
+			}
+		}
+
+		if ( gl->mapped )
+		{
+			glBindBuffer( GL_ARRAY_BUFFER, gl->ring );
+			glUnmapBuffer( GL_ARRAY_BUFFER );
+			glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		}
+
 		glDeleteTextures(1, &gl->tex);
-		glDeleteBuffers(1, &gl->vboVerts);
-		glDeleteBuffers(1, &gl->vboColours);
-		glDeleteBuffers(1, &gl->vboTexCoords);
+		glDeleteBuffers(1, &gl->ring);
 		glDeleteVertexArrays(1, &gl->vao);
 
-		gl->tex = 0;
-		gl->vboVerts = 0;
-		gl->vboColours = 0;
-		gl->vboTexCoords = 0;
-		gl->vao = 0;
-
 		delete gl;
 	}
 }
 
 
-FONScontext* CreateFons(int width, int height, int flags)
+FONScontext* CreateFons(int width, int height, int flags, PITBFonsContext** outBackend /* = nullptr */, int maxAtlasSize /* = 2048 */)
 {
 	FONSparams params;
 	PITBFonsContext* gl = new PITBFonsContext;
@@ -222,8 +336,22 @@ FONScontext* CreateFons(int width, int height, int flags)
 
 	params.userPtr = gl;
 
+	if ( outBackend )
+	{
+		*outBackend = gl;
+	}
+
+	gl->maxAtlasSize = std::max( maxAtlasSize, std::max( width, height ) );
 
-	return fonsCreateInternal( &params );
+	// On failure, fontstash has already deleted gl (renderDelete)
+	FONScontext* stash = fonsCreateInternal( &params );
+	if ( stash )
+	{
+		gl->stash = stash;
+		fonsSetErrorCallback( stash, internal_fsb__handleError, gl );
+	}
+
+	return stash;
 }
 
 
@@ -233,6 +361,24 @@ void DeleteFons(FONScontext* ctx)
 }
 
 
+void FonsFlushFrame(PITBFonsContext* backend)
+{
+	internal_fsb__drawBatch( backend );
+
+	// Nothing streamed this frame: keep filling the same segment
+	if ( backend->batchFirst == 0 )
+	{
+		return;
+	}
+
+	backend->fences[backend->segment] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+	backend->segment = ( backend->segment + 1 ) % kFonsRingSegments;
+	backend->batchFirst = 0;
+	internal_fsb__wait( backend, backend->fences[backend->segment] );
+}
+
+
 unsigned int FonsRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
 	return (r) | (g << 8) | (b << 16) | (a << 24);
@@ -4,22 +4,89 @@
 #include "fontstash.h"
 #include <glad/glad.h>
 #include "GLFW/glfw3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 
+// One corner of a glyph quad, interleaved, with the attributes of
+// fontShader.vert. Retained text (PITBFontManager) keeps its quads as these,
+// and fonsDrawText() streams them.
+struct PITBFonsVertex
+{
+	float x, y;
+	float s, t;
+	uint32_t colour;
+};
+
+
+// What the backend did, since the context was created
+struct PITBFonsStats
+{
+	std::size_t bufferAllocations{0}; // glBufferData()/glBufferStorage()
+	std::size_t uploads{0};           // glBufferSubData() (only without persistent mapping)
+	std::size_t draws{0};
+	std::size_t fenceWaits{0};        // Segments that were still in use by the GPU
+	std::size_t atlasUploads{0};      // Newly rasterized glyphs sent to the texture
+	std::size_t atlasGrowths{0};      // The atlas filled up and was doubled
+	std::size_t atlasResets{0};       // It filled up at its largest, and was emptied
+};
+
+
+/*
+* fonsDrawText() doesn't draw: its vertices are appended to a ring buffer, and
+* FonsFlushFrame() draws everything appended since the last flush with one draw
+* call.
+*
+* The ring is split into kFonsRingSegments segments, one per frame in flight.
+* Each flush fences its segment, and the next flush to come back round to it
+* waits on that fence before writing over it. With GL 4.4 the ring is
+* persistently mapped and written directly; without, the frame's vertices are
+* staged and uploaded with a single glBufferSubData() at the flush.
+*
+* The glyph atlas starts at the size given to CreateFons(), and doubles when it
+* fills up, to at most maxAtlasSize. Full at that size, it is emptied and the
+* glyphs still in use are rasterized again: fontstash has no way to evict
+* single glyphs. Either way, what was streamed before is drawn first, with the
+* texture it was laid out for.
+*/
+constexpr std::size_t kFonsRingSegments = 3;
+constexpr std::size_t kFonsSegmentVertices = 6 * 4096;
+
 struct PITBFonsContext
 {
 	GLuint tex{0};
 	int width{0};
 	int height{0};
 
-	GLuint vboVerts{0};
-	GLuint vboTexCoords{0};
-	GLuint vboColours{0};
+	GLuint ring{0};
 	GLuint vao{0};
+
+	// The persistent mapping of ring, or null when staging
+	PITBFonsVertex* mapped{nullptr};
+	std::vector<PITBFonsVertex> staging;
+
+	std::size_t segment{0};     // The one being filled
+	std::size_t batchFirst{0};  // Vertices of it already drawn, by an early flush
+	std::size_t batchCount{0};  // Vertices of it waiting to be drawn
+	GLsync fences[kFonsRingSegments]{};
+
+	FONScontext* stash{nullptr};
+	int maxAtlasSize{0};
+
+	PITBFonsStats stats;
 };
 
-FONScontext* CreateFons(int width, int height, int flags);
+// outBackend, if given, receives the GL side of the context (owned by it).
+// The atlas grows from width x height up to maxAtlasSize (in both directions).
+FONScontext* CreateFons(int width, int height, int flags, PITBFonsContext** outBackend = nullptr, int maxAtlasSize = 2048);
 void DeleteFons(FONScontext* ctx);
+
+// Draws what fonsDrawText() streamed since the last call, with the font
+// shader bound, and moves on to the next segment of the ring. Call once per
+// frame.
+void FonsFlushFrame(PITBFonsContext* backend);
+
 unsigned int FonsRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
 
-#endif // FONT_STASH_BACKEND_HPP
\ No newline at end of file
+#endif // FONT_STASH_BACKEND_HPP
@@ -6,6 +6,7 @@
 #include <typeinfo>
 #include <stdexcept>
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 
 #include <cstdlib>
@@ -14,6 +15,7 @@
 #include "../support/program.hpp"
 #include "../support/checkpoint.hpp"
 #include "../support/debug_output.hpp"
+#include "../support/gl_state.hpp"
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
@@ -23,14 +25,21 @@
 #include "ModelObject.hpp"
 #include "ShapeObject.hpp"
 #include "LookAt.hpp"
-#include "AnimationTools.hpp"
+#include "AnimationSystem.hpp"
+#include "GpuAnimation.hpp"
+#include "Skinning.hpp"
 #include "GeometricHelpers.hpp"
 #include "Light.hpp"
 #include "UIObject.hpp"
 #include "UIGroup.hpp"
 #include "Particle.hpp"
+#include "ParticleSystem.hpp"
 
 #include "PITBFont.hpp"
+#include "RenderQueue.hpp"
+#include "GeometryBuffer.hpp"
+#include "StaticDrawBatch.hpp"
+#include "Frustum.hpp"
 
 #define BENCHMARK_MODE_1 0
 #define BENCHMARK_TASK_2 0
@@ -81,7 +90,14 @@ namespace
 		const Vec3f diffuseLight = { 0.729f, 0.808f, 0.92f }; //sky: 0.529f, 0.808f, 0.92f, warm: 0.9f, 0.9f, 0.6f, blue: 0.729f, 0.808f, 0.92f
 		Vec3f currentGlobalLight;
 
-		std::vector<KeyFramedFloat>* animatedFloatsPtr;
+		AnimationSystem* animations;
+		GpuAnimationClips* crowdAnimations;
+		bool showCrowd{ false };
+
+		// Radar on the landing pad, skinned on the CPU or the GPU (K)
+		SkinnedModel* radarModels[2];
+		SkinningBackend skinningBackend{ SkinningBackend::Gpu };
+		const Vec3f radarPosition{ -19.f, -0.9f, 14.f };
 		float dt;
 		float speedMod;
 		bool pressedKeys[KEY_COUNT_GLFW] = { false };
@@ -97,11 +113,16 @@ namespace
 
 		ObjectInstanceGroup* spaceShipInstPtr;
 		ObjectInstanceGroup* landingPadInstPtr;
-		ModelObjectGPU* terrainGPU;
 
-		GLsizei numTerrainVerts;
-		GLsizei numSpaceShipVerts;
-		GLsizei numLandingPadVerts;
+		// Static meshes, all in one GeometryBuffer, frustum culled on the CPU
+		// or the GPU (X)
+		GeometryBuffer* geometry;
+		StaticDrawBatch* staticBatch;
+		CullingBackend cullingBackend{ CullingBackend::Gpu };
+		MeshRange terrainMesh;
+		MeshRange landingPadMesh;
+		MeshRange spaceShipMesh;
+		GLuint terrainTexture{0};
 
 		const Transform spaceShipInitialTransform{
 			.mPosition{ -32.5f, 0.3f, 2.f },
@@ -113,21 +134,14 @@ namespace
 
 		bool isSplitScreen;
 
-		GLuint terrainVAO{0};
-		GLuint shipVAO{0};
-		GLuint landingPadVAO{0};
-
 		GLuint lightsUBO{0};
 
 		std::vector<Vec4f>* lightOriginalPositions;
 
 		UIGroup* UI;
-		ParticleSource* pSource;
+		ParticleSystem* particles;
+		RenderQueue* renderQueue;
 
-		//Uniform ID vectors
-		std::vector<GLuint> prog2UniformIds;
-		std::vector<GLuint> progUniformIds;
-		std::vector<GLuint> progParticleUniformIds;
 	};
 
 
@@ -138,6 +152,14 @@ namespace
 	void updateCamera(State_& state);
 
 	ModelObject create_ship();
+
+	struct SkinnedModelData_
+	{
+		ModelObject model;
+		std::vector<VertexSkin> skin;
+	};
+	SkinnedModelData_ create_radar();
+	Skeleton create_radar_skeleton();
 	UIGroup createUI( GLFWwindow* aWindow );
 	Vec2f convertCursorPos(float x, float y, float width, float height);
 
@@ -245,6 +267,9 @@ int main() try
 	setup_gl_debug_output();
 #	endif // ~ !NDEBUG
 
+	// Redundant binds and state changes are dropped from here on
+	install_gl_state_cache();
+
 	// Global GL state
 	OGL_CHECKPOINT_ALWAYS();
 
@@ -267,61 +292,67 @@ int main() try
 	// Other initialization & loading
 	OGL_CHECKPOINT_ALWAYS();
 
-	// Load shader program
-	ShaderProgram prog( {
-		{ GL_VERTEX_SHADER, "assets/cw2/default.vert" },
-		{ GL_FRAGMENT_SHADER, "assets/cw2/default.frag" }
-	} );
+	// Load shader program. Linked programs are cached as binaries, so only
+	// the first launch (or one after a shader or driver changed) compiles.
+	// The rest are compiled in the background while the models load, and
+	// finished before their first use, after ModelLoad.
+	auto const startupBegin = Clock::now();
+	ShaderProgram::setBinaryCache( "shader-cache" );
+
+	// Programs are specialized for the scene with defines: the point light
+	// count sizes their loops, and the static geometry finds its draws with
+	// gl_DrawID where the driver has it
+	constexpr std::size_t kLightCount = 3;
 
-	ShaderProgram prog2( {
-		{GL_VERTEX_SHADER, "assets/cw2/materialColour.vert"},
-		{GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag"}
-	} );
+	ShaderProgram::Define const lightCount{ "N_LIGHTS", std::to_string( kLightCount ) };
+	ShaderProgram::Define const drawParameters{ "DRAW_PARAMETERS", StaticDrawBatch::DrawParameters() ? "1" : "0" };
 
-	ShaderProgram progUI({
+	ShaderVariantCache shaders;
+
+	// Terrain, landing pads and space ship (StaticDrawBatch)
+	ShaderProgram& progStatic = shaders.get( {
+		{ GL_VERTEX_SHADER, "assets/cw2/static.vert", { drawParameters } },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/static.frag", { lightCount } }
+	}, ShaderProgram::Build::async );
+
+	ShaderProgram& progUI = shaders.get( {
 		{ GL_VERTEX_SHADER, "assets/cw2/uiShader.vert" },
 		{ GL_FRAGMENT_SHADER, "assets/cw2/uiShader.frag" }
-	});
+	}, ShaderProgram::Build::async );
 
-	ShaderProgram progParticle({
+	ShaderProgram& progParticle = shaders.get( {
 		{ GL_VERTEX_SHADER, "assets/cw2/particleShader.vert" },
 		{ GL_FRAGMENT_SHADER, "assets/cw2/particleShader.frag" }
-	});
-
-	ShaderProgram progFont({
+	}, ShaderProgram::Build::async );
+
+	// Instances animated on the GPU; the clip evaluation is linked in from
+	// animationClips.glsl
+	ShaderProgram& progCrowd = shaders.get( {
+		{ GL_VERTEX_SHADER, "assets/cw2/animatedInstance.vert" },
+		{ GL_VERTEX_SHADER, "assets/cw2/animationClips.glsl" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag", { lightCount } }
+	}, ShaderProgram::Build::async );
+
+	// Skinned models; the skinning is linked in from skinning.glsl
+	ShaderProgram& progSkinned = shaders.get( {
+		{ GL_VERTEX_SHADER, "assets/cw2/skinned.vert" },
+		{ GL_VERTEX_SHADER, "assets/cw2/skinning.glsl" },
+		{ GL_FRAGMENT_SHADER, "assets/cw2/materialColour.frag", { lightCount } }
+	}, ShaderProgram::Build::async );
+
+	ShaderProgram& progFont = shaders.get( {
 		{ GL_VERTEX_SHADER, "assets/cw2/fontShader.vert" },
 		{ GL_FRAGMENT_SHADER, "assets/cw2/fontShader.frag" }
-	});
+	}, ShaderProgram::Build::async );
+
+	auto const shadersSubmitted = Clock::now();
 
-	state.progs.push_back(&prog);
-	state.progs.push_back(&prog2);
+	state.progs.push_back(&progStatic);
 	state.progs.push_back(&progUI);
 	state.progs.push_back(&progParticle);
 	state.progs.push_back(&progFont);
-
-	//The following is a hackey method to avoid having to call glGetUniformLocation() during the render loop, we call them all now and store the values for later
-	std::vector<GLuint> progUIUniformIds;
-	progUIUniformIds.push_back(glGetUniformLocation(progUI.programId(), "inColour"));
-
-	std::vector<GLuint> progUniformIds;
-	progUniformIds.push_back(glGetUniformLocation(prog.programId(), "uCamPosition"));
-	state.progUniformIds = progUniformIds;
-
-	std::vector<GLuint> prog2UniformIds;
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uProjCameraWorld"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uModelTransform"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uNormalTransform"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uLightDir"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uLightDiffuse"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uSceneAmbient"));
-	prog2UniformIds.push_back(glGetUniformLocation(prog2.programId(), "uCamPosition"));
-	state.prog2UniformIds = prog2UniformIds;
-
-	std::vector<GLuint> progParticleUniformIds;
-	progParticleUniformIds.push_back(glGetUniformLocation(progParticle.programId(), "uProjCameraWorld"));
-	progParticleUniformIds.push_back(glGetUniformLocation(progParticle.programId(), "uColour"));
-	progParticleUniformIds.push_back(glGetUniformLocation(progParticle.programId(), "uOffset"));
-	state.progParticleUniformIds = progParticleUniformIds;
+	state.progs.push_back(&progCrowd);
+	state.progs.push_back(&progSkinned);
 
 	auto last = Clock::now();
 
@@ -342,56 +373,9 @@ int main() try
 	
 	uint32_t terrainLoadFlags = kLoadTextureCoords | kLoadVertexColour;
 	ModelObject terrain( "assets/cw2/parlahti.obj", terrainLoadFlags );
-	state.numTerrainVerts = static_cast<GLsizei>( terrain.Vertices().size() );
-
-	// Load model into VBOs
-	ModelObjectGPU terrainGPU( terrain );
-	state.terrainGPU = &terrainGPU;
-
-	// Create VAO
-	//GLuint vao = 0;
-	glGenVertexArrays( 1, &state.terrainVAO );
-	glBindVertexArray( state.terrainVAO );
-	//positions
-	glBindBuffer( GL_ARRAY_BUFFER, terrainGPU.BufferId(kVboPositions) );
-	glVertexAttribPointer(
-		0,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-
-	glEnableVertexAttribArray( 0 );
-	//colours
-	glBindBuffer( GL_ARRAY_BUFFER, terrainGPU.BufferId(kVboVertexColor) );
-	glVertexAttribPointer(
-		1,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-
-	glEnableVertexAttribArray( 1 );
-	//normals
-	glBindBuffer(GL_ARRAY_BUFFER, terrainGPU.BufferId(kVboNormals));
-	glVertexAttribPointer(
-		2,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-
-	glEnableVertexAttribArray(2);
 
-	//Texture
-	glBindBuffer(GL_ARRAY_BUFFER, terrainGPU.BufferId(kVboTextureCoords));
-	glVertexAttribPointer(
-		3,
-		2, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(3);
+	// The diffuse texture; the geometry goes in the geometry buffer below
+	state.terrainTexture = LoadTexture2D( terrain.DiffuseTexturePath().c_str() );
 
 #if BENCHMARK_TASK_2
 	GLuint terrainLoadCPUGPU2 = 0;
@@ -420,68 +404,12 @@ int main() try
 								 | kLoadVertexSpecular
 								 | kLoadVertexShininess;
 	ModelObject landingPad( "assets/cw2/landingpad.obj", landingPadLoadFlags );
-	ModelObjectGPU landingPadGPU( landingPad );
-	state.numLandingPadVerts = static_cast<GLsizei>( landingPad.Vertices().size() );
 
-	ObjectInstanceGroup landingPadInstances( landingPadGPU );
+	ObjectInstanceGroup landingPadInstances;
 	landingPadInstances.CreateInstance( Transform( { .mPosition{-19.f,  -0.97f, 10.f} } ) );
 	landingPadInstances.CreateInstance( Transform( { .mPosition{-32.5f, -0.97f, 2.f } } ) ); //og -34.7f, -0.97f, 1.f
 	state.landingPadInstPtr = &landingPadInstances;
 
-
-	//GLuint vaoLandingPad = 0;
-	glGenVertexArrays( 1, &state.landingPadVAO );
-	glBindVertexArray( state.landingPadVAO );
-	//positions
-	glBindBuffer( GL_ARRAY_BUFFER, landingPadGPU.BufferId(kVboPositions) );
-	glVertexAttribPointer(
-		0,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray( 0 );
-
-	//colours
-	glBindBuffer( GL_ARRAY_BUFFER, landingPadGPU.BufferId(kVboVertexColor) );
-	glVertexAttribPointer(
-		1,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray( 1 );
-
-	//normals
-	glBindBuffer(GL_ARRAY_BUFFER, landingPadGPU.BufferId(kVboNormals));
-	glVertexAttribPointer(
-		2,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(2);
-
-	//specular reflectance
-	glBindBuffer(GL_ARRAY_BUFFER, landingPadGPU.BufferId(kVboVertexSpecular));
-	glVertexAttribPointer(
-		3,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(3);
-
-	//shininess
-	glBindBuffer(GL_ARRAY_BUFFER, landingPadGPU.BufferId(kVboVertexShininess));
-	glVertexAttribPointer(
-		4,
-		1, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(4);
-
 #if BENCHMARK_INSTANCING
 	GLuint landingPadBM2 = 0;
 	glGenQueries( 1, &landingPadBM2 );
@@ -496,15 +424,11 @@ int main() try
 	// Combine the two model objects
 	ModelObject spaceShipModel = create_ship();
 	spaceShipModel.OriginToGeometry();
-	state.numSpaceShipVerts = spaceShipModel.Vertices().size();
-
-	// Creaete the vbos for the model object
-	ModelObjectGPU spaceShipModelGPU( spaceShipModel );
 
 	// Create an instance of the model object
 	// Makes the model object have a position that we can later modify
 
-	ObjectInstanceGroup spaceShipInstances( spaceShipModelGPU );
+	ObjectInstanceGroup spaceShipInstances;
 	state.spaceShipInstPtr = &spaceShipInstances;
 	const Transform& spaceShipInitialTransform{state.spaceShipInitialTransform};
 	spaceShipInstances.CreateInstance( spaceShipInitialTransform );
@@ -524,58 +448,49 @@ int main() try
 		shipCam.cameraUp = cross(shipCam.cameraDirection, shipCam.cameraRight);
 	} ();
 
-	//GLuint vaoSpaceShip = 0;
-	glGenVertexArrays( 1, &state.shipVAO );
-	glBindVertexArray( state.shipVAO );
-	//positions
-	glBindBuffer( GL_ARRAY_BUFFER, spaceShipModelGPU.BufferId(kVboPositions) );
-	glVertexAttribPointer(
-		0,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray( 0 );
-
-	//colours
-	glBindBuffer( GL_ARRAY_BUFFER, spaceShipModelGPU.BufferId(kVboVertexColor) );
-	glVertexAttribPointer(
-		1,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray( 1 );
-
-	//normals
-	glBindBuffer(GL_ARRAY_BUFFER, spaceShipModelGPU.BufferId(kVboNormals));
-	glVertexAttribPointer(
-		2,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(2);
-
-	//specular reflectance
-	glBindBuffer(GL_ARRAY_BUFFER, spaceShipModelGPU.BufferId(kVboVertexSpecular));
-	glVertexAttribPointer(
-		3,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(3);
-
-	//shininess
-	glBindBuffer(GL_ARRAY_BUFFER, spaceShipModelGPU.BufferId(kVboVertexShininess));
-	glVertexAttribPointer(
-		4,
-		1, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(4);
+	// All static meshes share one vertex and one index buffer, so that they
+	// are drawn together (StaticDrawBatch). Welding only ever removes
+	// vertices, so the models' own counts are room enough.
+	GLuint staticVertexCount = 0;
+	for( const ModelObject* model : { &terrain, &landingPad, &spaceShipModel } )
+		staticVertexCount += GLuint(model->Vertices().size());
+
+	GeometryBuffer geometry( staticVertexCount, staticVertexCount );
+	state.geometry = &geometry;
+	state.terrainMesh = geometry.Add( terrain );
+	state.landingPadMesh = geometry.Add( landingPad );
+	state.spaceShipMesh = geometry.Add( spaceShipModel );
+
+	StaticDrawBatch staticBatch( geometry );
+	state.staticBatch = &staticBatch;
+
+	std::print( "Static geometry: {} vertices, {} after welding; draws {}\n",
+		staticVertexCount, geometry.Vertices().Used(), StaticDrawBatch::DrawParameters() ? "by gl_DrawID" : "by base instance" );
+
+	// Startup timeline: the programs compiled while the models loaded.
+	// Finishing them waits for whatever hasn't yet.
+	auto const modelsLoaded = Clock::now();
+
+	std::size_t readyBeforeFinish = 0;
+	for( auto* program : state.progs )
+		readyBeforeFinish += program->ready() ? 1 : 0;
+
+	for( auto* program : state.progs )
+		program->finish();
+
+	auto const shadersReady = Clock::now();
+
+	{
+		using Msf = std::chrono::duration<float, std::milli>;
+		auto const& cache = ShaderProgram::cacheStats();
+
+		std::print( "Startup: shaders submitted at {:.1f} ms, models loaded at {:.1f} ms ({} of {} programs ready{}), shaders ready at {:.1f} ms\n",
+			Msf(shadersSubmitted - startupBegin).count(), Msf(modelsLoaded - startupBegin).count(),
+			readyBeforeFinish, state.progs.size(), ShaderProgram::parallelCompile() ? "" : ", no parallel compile", Msf(shadersReady - startupBegin).count() );
+		std::print( "Shader programs: {} from cache, {} compiled ({:.1f} ms blocked); cache saved {:.1f} ms\n",
+			cache.loaded, cache.compiled, cache.loadMs + cache.compileMs, cache.savedMs );
+	}
+
 
 #pragma endregion
 
@@ -586,7 +501,6 @@ int main() try
 	//LIGHTS
 	state.currentGlobalLight = state.diffuseLight;
 
-	#define N_LIGHTS 3
 	Vec4f l1InitialTransform = { -33.75f, 0.3f, 2.f, 0.f};
 	Vec4f l2InitialTransform = { -32.55f, 0.6f, 2.f, 0.f};
 	Vec4f l3InitialTransform = { -31.75f, -0.5f, 2.f, 0.f};
@@ -598,26 +512,23 @@ int main() try
 	PointLight l2 = { l2InitialTransform, { 0.988f, 0.1f, 0.1f, 1.f }, {0.1f, 0.f, 0.f} }; //rear light
 	PointLight l3 = { l3InitialTransform, { 0.1f, 0.1f, 0.9f, 1.f }, {0.2f, 0.f, 0.f} }; //bottom light 
 
-	std::vector<PointLight> lights(N_LIGHTS);
-	lights[0] = l1;
-	lights[1] = l2;
-	lights[2] = l3;
+	std::vector<PointLight> lights{ l1, l2, l3 };
+	assert( lights.size() == kLightCount );
 	state.lights = &lights;
 
 	//GLuint uboLights;
 	glGenBuffers(1, &state.lightsUBO );
 	glBindBuffer(GL_UNIFORM_BUFFER, state.lightsUBO);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(PointLight)* N_LIGHTS, nullptr, GL_DYNAMIC_DRAW);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PointLight) * kLightCount, nullptr, GL_DYNAMIC_DRAW);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-	//bind to material shader
-	GLuint blockIndex = glGetUniformBlockIndex(prog2.programId(), "LightBlock");
-	glUniformBlockBinding(prog2.programId(), blockIndex, 0);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, state.lightsUBO);
-
-	//bind to default shader
-	GLuint blockIndexdefault = glGetUniformBlockIndex(prog.programId(), "LightBlock");
-	glUniformBlockBinding(prog.programId(), blockIndexdefault, 0);
+	//bind to the static, crowd and skinned shaders (those that have
+	//lights: with N_LIGHTS 0 there is no block)
+	for( ShaderProgram* lit : { &progStatic, &progCrowd, &progSkinned } )
+	{
+		if( GLuint const blockIndex = lit->uniformBlockIndex( "LightBlock" ); GL_INVALID_INDEX != blockIndex )
+			glUniformBlockBinding( lit->programId(), blockIndex, 0 );
+	}
 	glBindBufferBase(GL_UNIFORM_BUFFER, 0, state.lightsUBO);
 
 	// Reset State
@@ -627,165 +538,130 @@ int main() try
 #pragma endregion
 
 	// Animating
-	// Space ship animation
-	std::vector<KeyFramedFloat> spaceShipAnimatedFloats =
-		[&] ()
+	// Space ship animation: lift off, wait, warp, disappear
+	AnimationSystem animations;
+	const AnimationSystem::ClipID spaceShipClip = animations.AddClip();
+
+	const Vec3f spaceShipPositionAfterLiftOff{
+		spaceShipInitialTransform.mPosition.x,
+		spaceShipInitialTransform.mPosition.y + 30.f,
+		spaceShipInitialTransform.mPosition.z
+	};
+
+	const Vec3f spaceShipRotationAfterLiftOff{
+		spaceShipInitialTransform.mRotation.x,
+		spaceShipInitialTransform.mRotation.y + 100.0_deg,
+		spaceShipInitialTransform.mRotation.z
+	};
+
+	// Warp Calculations
+	// Transform the whole ship
+	Vec3f spaceShipForward{
+		cosf(spaceShipRotationAfterLiftOff.x) * sinf(spaceShipRotationAfterLiftOff.y),
+		sinf(spaceShipRotationAfterLiftOff.x),
+		cosf(spaceShipRotationAfterLiftOff.x) * cosf(spaceShipRotationAfterLiftOff.y)
+	};
+
+	spaceShipForward = Vec4ToVec3(make_rotation_y(-90.0_deg) * Vec3ToVec4(normalize(spaceShipForward)));
+
+	const Vec3f spaceShipPositionAfterWarp = (spaceShipForward * 1000.f) + spaceShipPositionAfterLiftOff;
+	const Vec3f spaceShipPositionAfterDisappear = (spaceShipForward * 9999.f) + spaceShipPositionAfterWarp;
+
+	const Vec3TrackKeyFrame spaceShipPositionKeys[] = {
+		{ spaceShipInitialTransform.mPosition, 0.f, Shapes::None }, // First shape is unused
+		{ spaceShipPositionAfterLiftOff, 7.f, Shapes::Smoothstep },  // Go up
+		{ spaceShipPositionAfterLiftOff, 0.1f, Shapes::None },       // Wait
+		{ spaceShipPositionAfterWarp, 3.f, Shapes::Polynomial<6> },  // Warp
+		{ spaceShipPositionAfterDisappear, 1.f, Shapes::PolynomialEaseOut<6> } // Disappear
+	};
+
+	const Vec3TrackKeyFrame spaceShipRotationKeys[] = {
+		{ spaceShipInitialTransform.mRotation, 0.f, Shapes::None },
+		{ spaceShipRotationAfterLiftOff, 7.f, Shapes::PolynomialEaseOut<4> }
+	};
+
+	const AnimationSystem::TrackID spaceShipPositionTrack = animations.AddVec3Track( spaceShipClip, spaceShipPositionKeys );
+	const AnimationSystem::TrackID spaceShipRotationTrack = animations.AddVec3Track( spaceShipClip, spaceShipRotationKeys );
+
+	state.animations = &animations;
+
+	// Crowd of ships (G), animated entirely on the GPU: every instance
+	// plays a looping clip from its own start time and at its own speed, so
+	// a frame only sets the time
+	GpuAnimationClips crowdAnimations;
+
+	const Vec3TrackKeyFrame hoverPositionKeys[] = {
+		{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+		{ { 0.f, 3.f, 0.f }, 2.f, Shapes::Smoothstep },
+		{ { 0.f, 0.f, 0.f }, 2.f, Shapes::Smoothstep }
+	};
+
+	const Vec3TrackKeyFrame hoverRotationKeys[] = {
+		{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+		{ { 0.f, 360.0_deg, 0.f }, 4.f, Shapes::Linear }
+	};
+
+	const Vec3TrackKeyFrame loopPositionKeys[] = {
+		{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+		{ { 0.f, 6.f, 0.f }, 1.5f, Shapes::PolynomialEaseOut<2> },
+		{ { 0.f, 6.f, 4.f }, 1.5f, Shapes::Smoothstep },
+		{ { 0.f, 0.f, 4.f }, 1.5f, Shapes::Polynomial<2> },
+		{ { 0.f, 0.f, 0.f }, 1.5f, Shapes::Smoothstep }
+	};
+
+	const Vec3TrackKeyFrame loopRotationKeys[] = {
+		{ { 0.f, 0.f, 0.f }, 0.f, Shapes::None },
+		{ { 0.f, 0.f, 0.f }, 1.5f, Shapes::None },
+		{ { 360.0_deg, 0.f, 0.f }, 3.f, Shapes::Smoothstep }
+	};
+
+	const GpuAnimationClips::ClipID crowdClips[] = {
+		crowdAnimations.AddClip( hoverPositionKeys, hoverRotationKeys, true ),
+		crowdAnimations.AddClip( loopPositionKeys, loopRotationKeys, true )
+	};
+	crowdAnimations.Upload();
+
+	{
+		constexpr int kCrowdSide = 64;
+		constexpr float kCrowdSpacing = 4.f;
+
+		std::vector<AnimatedInstance> crowd;
+		crowd.reserve( kCrowdSide * kCrowdSide );
+		for( int i = 0; i < kCrowdSide * kCrowdSide; ++i )
 		{
-			std::vector<KeyFramedFloat> ret;
-			// Need to do this otherwise the references are invalid because
-			// vector gets resized after emplace_back();
-			ret.reserve(6);
-
-			KeyFramedFloat& spaceShipXKF = ret.emplace_back();
-			KeyFramedFloat& spaceShipYKF = ret.emplace_back();
-			KeyFramedFloat& spaceShipZKF = ret.emplace_back();
-
-			// We are keeping the X and Z rotation key frames even though we don't
-			// end up using them because we need to keep the key framed float vector
-			// to be 6 values.
-			[[maybe_unused]] KeyFramedFloat& spaceShipXRotKF = ret.emplace_back();
-			KeyFramedFloat& spaceShipYRotKF = ret.emplace_back();
-			[[maybe_unused]] KeyFramedFloat& spaceShipZRotKF = ret.emplace_back();
-
-
-			// Initial Transforms
-			spaceShipXKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.x,
-				0.f,
-				ShapingFunctions::None // First shaping function is unused
-				});
-
-			spaceShipYKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.y,
-				0.f,
-				ShapingFunctions::None // First shaping function is unused
-				});
-
-			spaceShipZKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.z,
-				0.f,
-				ShapingFunctions::None // First shaping function is unused
-				});
-
-			spaceShipYRotKF.InsertKeyframe({
-				spaceShipInitialTransform.mRotation.y,
-				0.f,
-				ShapingFunctions::None
-				});
-
-
-			// Go Up
-			spaceShipXKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.x,
-				7.f,
-				ShapingFunctions::Smoothstep
-				});
-
-			float newSpaceShipY = spaceShipInitialTransform.mPosition.y + 30.f;
-			spaceShipYKF.InsertKeyframe({
-				newSpaceShipY,
-				7.f,
-				ShapingFunctions::Smoothstep
-				});
-
-			spaceShipZKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.z,
-				7.f,
-				ShapingFunctions::Smoothstep
-				});
-
-			float newSpaceShipRotY = spaceShipInitialTransform.mRotation.y + 100.0_deg;
-			spaceShipYRotKF.InsertKeyframe({
-				newSpaceShipRotY,
-				7.f,
-				ShapingFunctions::PolynomialEaseOut<4>
-				});
-
-
-			// Wait
-			spaceShipXKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.x,
-				0.1f,
-				ShapingFunctions::None
-				});
-
-			spaceShipYKF.InsertKeyframe({
-				newSpaceShipY,
-				0.1f,
-				ShapingFunctions::None
-				});
-
-			spaceShipZKF.InsertKeyframe({
-				spaceShipInitialTransform.mPosition.z,
-				0.1f,
-				ShapingFunctions::None
-				});
-
-
-			// Warp Calculations
-			// Transform the whole ship
-			Vec3f spaceShipPositionAfterLiftOff{
-				spaceShipInitialTransform.mPosition.x,
-				newSpaceShipY,
-				spaceShipInitialTransform.mPosition.z
-			};
-
-			Vec3f spaceShipForward{
-				cosf(spaceShipInitialTransform.mRotation.x) * sinf(newSpaceShipRotY),
-				sinf(spaceShipInitialTransform.mRotation.x),
-				cosf(spaceShipInitialTransform.mRotation.x) * cosf(newSpaceShipRotY)
-			};
-
-			spaceShipForward = Vec4ToVec3(make_rotation_y(-90.0_deg) * Vec3ToVec4(normalize(spaceShipForward)));
-
-			Vec3f newSpaceShipPosition  = (spaceShipForward * 1000.f) + spaceShipPositionAfterLiftOff;
-
-
-			// Warp
-			spaceShipXKF.InsertKeyframe({
-				newSpaceShipPosition.x,
-				3.f,
-				ShapingFunctions::Polynomial<6>
-				});
-
-			spaceShipYKF.InsertKeyframe({
-				newSpaceShipPosition.y,
-				3.f,
-				ShapingFunctions::Polynomial<6>
-				});
-
-			spaceShipZKF.InsertKeyframe({
-				newSpaceShipPosition.z,
-				3.f,
-				ShapingFunctions::Polynomial<6>
-				});
-
-
-			// Disappear
-			Vec3f newSpaceShipPosition2  = (spaceShipForward * 9999.f) + newSpaceShipPosition;
-			spaceShipXKF.InsertKeyframe({
-				newSpaceShipPosition2.x,
-				1.f,
-				ShapingFunctions::PolynomialEaseOut<6>
-				});
-
-			spaceShipYKF.InsertKeyframe({
-				newSpaceShipPosition2.y,
-				1.f,
-				ShapingFunctions::PolynomialEaseOut<6>
-				});
-
-			spaceShipZKF.InsertKeyframe({
-				newSpaceShipPosition2.z,
-				1.f,
-				ShapingFunctions::PolynomialEaseOut<6>
-				});
-
-
-			return ret;
-		} ();
-
-	state.animatedFloatsPtr = &spaceShipAnimatedFloats;
+			const int row = i / kCrowdSide;
+			const int column = i % kCrowdSide;
+
+			crowd.push_back( {
+				.origin = {
+					(float(column) - kCrowdSide / 2.f) * kCrowdSpacing,
+					20.f,
+					(float(row) - kCrowdSide / 2.f) * kCrowdSpacing
+				},
+				.clip = std::uint32_t(crowdClips[(row + column) % 2]),
+				.startTime = -0.37f * float(i % 17),
+				.speed = 0.75f + 0.05f * float(i % 11),
+				.pad = { 0.f, 0.f }
+			} );
+		}
+		crowdAnimations.SetInstances( crowd );
+	}
+
+	state.crowdAnimations = &crowdAnimations;
+
+	// Radar: the mast spins and the dish nods. Both skinning backends are
+	// kept so that K can switch between them; only the one in use is
+	// updated.
+	const Skeleton radarSkeleton = create_radar_skeleton();
+	const SkinnedModelData_ radar = create_radar();
+
+	SkinnedModel radarCpu( radar.model, radar.skin, radarSkeleton.JointCount(), SkinningBackend::Cpu );
+	SkinnedModel radarGpu( radar.model, radar.skin, radarSkeleton.JointCount(), SkinningBackend::Gpu );
+	state.radarModels[0] = &radarCpu;
+	state.radarModels[1] = &radarGpu;
+
+	std::vector<Transform> radarPose( radarSkeleton.BindPose().begin(), radarSkeleton.BindPose().end() );
+	std::vector<Mat44f> radarPalette( radarSkeleton.JointCount() );
 
 	//UI initialisation
 	PITBFontManager::Get().SetShaderProgram(&progFont);
@@ -801,14 +677,33 @@ int main() try
 		.spread = 0.1f,
 		.lifeTime = 0.5f,
 		.fade = 2.f,
+		.size = 0.2f,
 		.maxParticles = 200,
-		.spawnRate = 2
+		.spawnRate = 2,
+		.backend = ParticleBackend::Gpu
 	};
 
 	//Particle effect initialisation
-	ParticleSource pSource(source1, "assets/cw2/Particle.png");
-	pSource.SetRelativePosition(pSource.GetOrigin() - state.spaceShipInitialTransform.mPosition);
-	state.pSource = &pSource;
+	ParticleSystem particles(ParticleBudget{
+		.maxParticles = 20000,
+		.fullRateDistance = 50.f,
+		.cullDistance = 500.f
+	});
+	state.particles = &particles;
+
+	// Draws of each view, and of the UI and text over them
+	RenderQueue renderQueue;
+	state.renderQueue = &renderQueue;
+
+	// Engine exhaust, one emitter per ship
+	std::vector<ParticleSystem::EmitterID> exhaustEmitters;
+	for (size_t i = 0; i < spaceShipInstances.GetInstanceCount(); i++)
+	{
+		ParticleSystem::EmitterID exhaustID = particles.AddEmitter(source1, "assets/cw2/Particle.png");
+		ParticleSource& exhaust = particles.Emitter(exhaustID);
+		exhaust.SetRelativePosition(exhaust.GetOrigin() - state.spaceShipInitialTransform.mPosition);
+		exhaustEmitters.push_back(exhaustID);
+	}
 
 	PITBFontManager& fm = PITBFontManager::Get();
 
@@ -828,6 +723,10 @@ int main() try
 		GLuint64 avgTime = 0;
 #endif // BENCHMARK_MODE_1
 
+	// GL calls through the state cache, issued and elided, over all frames
+	GLStateStats glStateTotal;
+	std::size_t frameCount = 0;
+
 	// Main loop
 	while( !glfwWindowShouldClose( window ) )
 	{
@@ -867,25 +766,44 @@ int main() try
 		last = now;
 
 		// Update space ship animation first before camera
-		Vec3f spaceShipAnimatedPosition{
-			spaceShipAnimatedFloats[0].Update(state.dt),
-			spaceShipAnimatedFloats[1].Update(state.dt),
-			spaceShipAnimatedFloats[2].Update(state.dt)
-		};
+		animations.Update(state.dt);
 
-		Vec3f spaceShipAnimatedRotation{
-			spaceShipAnimatedFloats[3].Update(state.dt),
-			spaceShipAnimatedFloats[4].Update(state.dt),
-			spaceShipAnimatedFloats[5].Update(state.dt)
-		};
+		Vec3f spaceShipAnimatedPosition = animations.Vec3Value(spaceShipPositionTrack);
 
 		// Bind animated values to space ship transform
 		Transform& spaceShipTrans = spaceShipInstances.GetTransform(0);
 		spaceShipTrans.mPosition = spaceShipAnimatedPosition;
-		spaceShipTrans.mRotation = spaceShipAnimatedRotation;
+		spaceShipTrans.mRotation = animations.Vec3Value(spaceShipRotationTrack);
 
 		updateCamera(state);
 
+		// Radar pose, shared by both skinning backends
+		{
+			const float time = float(glfwGetTime());
+			radarPose[1].mRotation.y = time;
+			radarPose[2].mRotation.z = 0.3f + 0.25f * std::sin( 2.f * time );
+			radarSkeleton.EvaluatePose( radarPose, radarPalette );
+
+			state.radarModels[SkinningBackend::Cpu == state.skinningBackend ? 0 : 1]->Update( radarPalette );
+		}
+
+		// Particles are simulated once per frame, however many views there
+		// are. The exhausts follow their ships.
+		for (size_t i = 0; i < exhaustEmitters.size(); i++)
+		{
+			const Transform& shipTransform = spaceShipInstances.GetTransform(i);
+			ParticleSource& exhaust = particles.Emitter(exhaustEmitters[i]);
+			Mat44f shipRotation = make_rotation_y(shipTransform.mRotation.y);
+			exhaust.SetPosition(Vec4ToVec3(shipRotation * Vec3ToVec4(exhaust.GetRelativePosition())) + shipTransform.mPosition);
+		}
+
+		// Cameras store their negated world position (see MakeLookAt)
+		Vec3f viewers[] = {
+			-state.camControl[state.selectedCamera_topScreen]->cameraPos,
+			-state.camControl[state.selectedCamera_bottomScreen]->cameraPos
+		};
+		particles.Update(state.dt, std::span<const Vec3f>(viewers, state.isSplitScreen ? 2 : 1));
+
 
 		// Draw scene		GLuint64 avgTime = 0;
 		OGL_CHECKPOINT_DEBUG();
@@ -913,36 +831,29 @@ int main() try
 		}
 
 
-		//Render UI
+		//Render UI and text over the whole window, in that order
 		glViewport( 0, 0, fbwidth, fbheight );
-		glDisable(GL_DEPTH_TEST);
-
-		glUseProgram(progUI.programId());
-		//give projection matrix to uniform
-
-		glEnable(GL_BLEND); //enter blending mode to use transparency
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-		UI.checkMouseInterractions(state.mousePos, state.mouseStatus);
-		//draw each UI element
-		for (int i = 0; i < UI.getElementCount(); i++)
-		{
-			glBindVertexArray(UI.getElementGPU(i).ArrayId());
-
-			Vec4f element_colour = UI.getElement(i).getColour();
-			glUniform4fv(progUIUniformIds[0], 1, &element_colour.x);
-			glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(UI.getElement(i).Vertices().size()));
-		}
+		// Update the text before the font system update
+		spaceShipHeightText.SetString("Spaceship height: {0:.2f} meters", spaceShipAnimatedPosition.y * 10.f);
 
-		glDisable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
+		renderQueue.BeginView( Vec3f{ 0.f, 0.f, 0.f }, 1.f );
 
+		//draw all UI elements, in one go (input is handled by the
+		//cursor and mouse button callbacks, as it happens)
+		renderQueue.Submit({
+			.pass = RenderPass::Overlay,
+			.program = &progUI,
+			.draw = [&] { UI.Draw(); }
+		});
 
-		// Update the text before the font system update
-		spaceShipHeightText.SetString("Spaceship height: {0:.2f} meters", spaceShipAnimatedPosition.y * 10.f);
+		// The font system binds its own program and texture
+		renderQueue.Submit({
+			.pass = RenderPass::Overlay,
+			.draw = [&] { PITBFontManager::Get().Update(fbwidth, fbheight); }
+		});
 
-		// Update the font system
-		PITBFontManager::Get().Update(fbwidth, fbheight);
+		renderQueue.Flush();
 
 #if BENCHMARK_MODE_1
 		glEndQuery(GL_TIME_ELAPSED);
@@ -958,9 +869,12 @@ int main() try
 
 #endif // BENCHMARK_MODE_1
 
-		// Cleanup
-		glBindVertexArray( 0 );
-		glUseProgram( 0 );
+		// Bindings are left as they are: the next frame rebinds only what
+		// changes
+		auto const glStateFrame = gl_state_new_frame();
+		glStateTotal.issued += glStateFrame.issued;
+		glStateTotal.elided += glStateFrame.elided;
+		++frameCount;
 
 		OGL_CHECKPOINT_DEBUG();
 
@@ -978,6 +892,13 @@ int main() try
 	std::cout << "Average time: " << uint64_t(avgTime) << "\n";
 #endif // BENCHMARK_MODE_1
 
+	if( frameCount > 0 )
+	{
+		std::print( "GL state: {:.1f} calls issued and {:.1f} elided per frame\n",
+			double(glStateTotal.issued) / double(frameCount), double(glStateTotal.elided) / double(frameCount) );
+	}
+
+	glDeleteTextures( 1, &state.terrainTexture );
 
 	return 0;
 }
@@ -1018,22 +939,26 @@ namespace
 
 			if( GLFW_KEY_F == aKey && GLFW_PRESS == aAction )
 			{
-				for ( auto& anim : *(state->animatedFloatsPtr) )
-				{
-					anim.Toggle();
-				}
-				state->pSource->ToggleActive();
+				state->animations->ToggleAll();
+				state->particles->ToggleActive();
 			}
 
 			if( GLFW_KEY_R == aKey && GLFW_PRESS == aAction )
 			{
-				for ( auto& anim : *(state->animatedFloatsPtr) )
+				state->animations->StopAll();
+				state->particles->SetActive(false);
+				state->particles->DeleteParticles();
+				
+			}
+
+			// Scrub the animation one second back/forward (held keys repeat)
+			if( (GLFW_KEY_LEFT == aKey || GLFW_KEY_RIGHT == aKey) && GLFW_RELEASE != aAction )
+			{
+				const float step = GLFW_KEY_LEFT == aKey ? -1.f : 1.f;
+				for( AnimationSystem::ClipID clip = 0; clip < state->animations->ClipCount(); ++clip )
 				{
-					anim.Stop();
+					state->animations->Seek( clip, state->animations->Time( clip ) + step );
 				}
-				state->pSource->SetActive(false);
-				state->pSource->DeleteParticles();
-				
 			}
 
 			//key actions
@@ -1065,6 +990,21 @@ namespace
 			{
 				state->isSplitScreen = !state->isSplitScreen;
 			}
+
+			if( GLFW_KEY_G == aKey && aAction == GLFW_PRESS )
+			{
+				state->showCrowd = !state->showCrowd;
+			}
+
+			if( GLFW_KEY_K == aKey && aAction == GLFW_PRESS )
+			{
+				state->skinningBackend = SkinningBackend::Cpu == state->skinningBackend ? SkinningBackend::Gpu : SkinningBackend::Cpu;
+			}
+
+			if( GLFW_KEY_X == aKey && aAction == GLFW_PRESS )
+			{
+				state->cullingBackend = CullingBackend::Cpu == state->cullingBackend ? CullingBackend::Gpu : CullingBackend::Cpu;
+			}
 		}
 	}
 
@@ -1081,6 +1021,9 @@ namespace
 			glfwGetWindowSize(aWindow, &width, &height);
 			state->mousePos = convertCursorPos(float(aX), float(aY), float(width), float(height));
 
+			if( state->UI )
+				state->UI->OnCursorMoved( state->mousePos );
+
 
 			if( state->camControl[kFreeCam]->cameraActive && freeCamSelected )
 			{
@@ -1118,6 +1061,9 @@ namespace
 		if (aButton == GLFW_MOUSE_BUTTON_LEFT)
 		{
 			state->mouseStatus = aAction;
+
+			if( state->UI )
+				state->UI->OnMouseButton( aAction );
 		}
 	}
 
@@ -1322,6 +1268,63 @@ namespace
 		return combined;
 	}
 
+	// Joints: 0 the base, 1 the mast (spins about y), 2 the dish (nods
+	// about z)
+	Skeleton create_radar_skeleton()
+	{
+		Skeleton skeleton;
+		const Skeleton::JointID base = skeleton.AddJoint( Skeleton::kNoParent, Transform{} );
+		const Skeleton::JointID mast = skeleton.AddJoint( base, Transform{} );
+		skeleton.AddJoint( mast, Transform{ .mPosition{ 0.f, 1.5f, 0.f } } );
+		return skeleton;
+	}
+
+	SkinnedModelData_ create_radar()
+	{
+		ShapeMaterial frame
+		{
+			.mVertexColor = {0.3f, 0.3f, 0.35f},
+			.mSpecular = {0.5f, 0.5f, 0.5f},
+			.mShininess = 20.f
+		};
+
+		ShapeMaterial radarDish
+		{
+			.mVertexColor = {0.722f, 0.451f, 0.20f},
+			.mSpecular = {0.946f, 0.846f, 0.846f},
+			.mShininess = 300.f
+		};
+
+		ModelObject base = MakeCube(Transform{ .mScale{0.5f, 0.1f, 0.5f} }, frame);
+
+		Transform mastTransform{
+			.mPosition{0.f, 0.f, 0.f},
+			.mRotation{0.f, 0.f, std::numbers::pi_v<float> / 2},
+			.mScale{1.5f, 0.08f, 0.08f}
+		};
+		ModelObject mast = MakeCylinder(true, 16, mastTransform, frame);
+
+		Transform dishTransform{
+			.mPosition{0.f, 1.5f, 0.f},
+			.mRotation{0.f, 0.f, 0.f},
+			.mScale{0.3f, 0.8f, 0.8f}
+		};
+		ModelObject dish = MakeCone(false, 32, dishTransform, radarDish);
+
+		std::vector<VertexSkin> skin;
+		skin.insert( skin.end(), base.Vertices().size(), RigidSkin( 0 ) );
+
+		// The top of the mast bends halfway with the dish
+		for( Vec3f const& p : mast.Vertices() )
+		{
+			skin.push_back( p.y > 1.f ? VertexSkin{ { 1, 2, 0, 0 }, { 0.5f, 0.5f, 0.f, 0.f } } : RigidSkin( 1 ) );
+		}
+
+		skin.insert( skin.end(), dish.Vertices().size(), RigidSkin( 2 ) );
+
+		return { CombineShapeModelObjects(base, mast, dish), std::move(skin) };
+	}
+
 	UIGroup createUI( GLFWwindow* aWindow )
 	{
 		auto* state = static_cast<State_*>(glfwGetWindowUserPointer(aWindow));
@@ -1340,11 +1343,8 @@ namespace
 		UIElement toggleAnimationBtn = UIElement(toggleAnimationBtn_prop);
 		toggleAnimationBtn.InsertOnClickCallback([state] ()
 			{
-				for (auto& anim : *(state->animatedFloatsPtr))
-				{
-					anim.Toggle();
-				}
-				state->pSource->ToggleActive();
+				state->animations->ToggleAll();
+				state->particles->ToggleActive();
 			});
 		elements.push_back(toggleAnimationBtn);
 
@@ -1360,12 +1360,9 @@ namespace
 		UIElement resetAnimationBtn = UIElement(resetAnimationBtn_prop2);
 		resetAnimationBtn.InsertOnClickCallback([state]()
 			{
-				for (auto& anim : *(state->animatedFloatsPtr))
-				{
-					anim.Stop();
-				}
-				state->pSource->SetActive(false);
-				state->pSource->DeleteParticles();
+				state->animations->StopAll();
+				state->particles->SetActive(false);
+				state->particles->DeleteParticles();
 			});
 		elements.push_back(resetAnimationBtn);
 
@@ -1379,13 +1376,14 @@ namespace
 
 
 		Mat44f projection;
+		const float farPlane = 200.f;
 
 		if( !state.isSplitScreen )
 		{
 			projection = make_perspective_projection(
 				60.f * std::numbers::pi_v<float> / 180.f,
 				state.fbwidth/state.fbheight,
-				0.1f, 200.0f
+				0.1f, farPlane
 			);
 		}
 		else
@@ -1393,229 +1391,159 @@ namespace
 			projection = make_perspective_projection(
 				60.f * std::numbers::pi_v<float> / 180.f,
 				state.fbwidth/(state.fbheight / 2),
-				0.1f, 200.0f
+				0.1f, farPlane
 			);
 		}
 
-#if BENCHMARK_TASK_2
-		static uint64_t averageTime = 0;
-		static int renderCount = 0;
-
-		GLuint terrainLoadCPUGPU3 = 0;
-		glGenQueries(1, &terrainLoadCPUGPU3);
-		glQueryCounter( terrainLoadCPUGPU3, GL_TIMESTAMP );
-
-		GLuint64 ts1 = 0;
-
-		glGetQueryObjectui64v(terrainLoadCPUGPU3, GL_QUERY_RESULT, &ts1);
-#endif // BENCHMARK_TASK_2
-
 		Mat44f world2Camera = MakeLookAt(aCamCtrl.cameraPos,
 										 aCamCtrl.cameraDirection,
 										 aCamCtrl.cameraUp,
 										 aCamCtrl.cameraRight);
 
-		Mat44f world2CamFlat = MakeBillboardLookAt(aCamCtrl.cameraDirection, aCamCtrl.cameraUp,
-			aCamCtrl.cameraRight);
-
-
-		auto& prog = *(state.progs[0]);
-		glUseProgram( prog.programId() );
-		GLint locCamPosTerrain = state.progUniformIds[0];
-		Mat44f terrainProjectCamWorld = projection * world2Camera * kIdentity44f;
-		glUniformMatrix4fv(0, 1, GL_TRUE, terrainProjectCamWorld.v);
-
-		Vec3f lightDir = normalize(Vec3f{ -1.f, 1.f, 0.5f }); // light direction
-		glUniform3fv(1, 1, &lightDir.x);
-		glUniform3f(2, state.currentGlobalLight[0], state.currentGlobalLight[1], state.currentGlobalLight[2] ); // light diffuse: 0.9f, 0.9f, 0.6f
-		glUniform3f(3, 0.05f, 0.05f, 0.05f); // light ambient
-
-		//camera
-		glUniform3f(locCamPosTerrain,
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[0],
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[1],
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[2]);
-
-		//lights
-		GLuint& uboLights = state.lightsUBO;
-		std::vector<PointLight>& lights = *(state.lights);
-		glBindBuffer(GL_UNIFORM_BUFFER, uboLights);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PointLight) * lights.size(), lights.data());
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-		//action
-		glBindVertexArray( state.terrainVAO );
-		glActiveTexture( GL_TEXTURE0 );
-		glBindTexture( GL_TEXTURE_2D, state.terrainGPU->BufferId(kDiffuseTexture) );
-		glDrawArraysInstanced( GL_TRIANGLES, 0, state.numTerrainVerts, 1);
-
-		glBindTexture( GL_TEXTURE_2D, 0 );
-
-
-#if BENCHMARK_TASK_2
-		GLuint terrainLoadCPUGPU4 = 0;
-		glGenQueries(1, &terrainLoadCPUGPU4);
-		glQueryCounter( terrainLoadCPUGPU4, GL_TIMESTAMP );
-
-		GLuint64 ts2 = 0;
-		glGetQueryObjectui64v(terrainLoadCPUGPU4, GL_QUERY_RESULT, &ts2);
-
-		if( renderCount == 0)
-		{
-			renderCount++;
-			averageTime += ts2-ts1;
-		}
-		else
+		// Everything is submitted to the queue, which draws it sorted by
+		// program, texture and vertex array (and depth) when flushed below.
+		// Cameras store their negated world position (see MakeLookAt).
+		RenderQueue& queue = *state.renderQueue;
+		queue.BeginView(-aCamCtrl.cameraPos, farPlane);
+
+		// Uniforms that are the same for the whole view are set on every
+		// program up front (the programs skip values they already have:
+		// most of these only change with the camera), the draws' own ones
+		// by the packets
+		const Vec3f lightDir = normalize(Vec3f{ -1.f, 1.f, 0.5f }); // light direction
+		const Vec3f sceneAmbient{ 0.05f, 0.05f, 0.05f };
+		const Vec3f camPosition = state.camControl[state.selectedCamera_topScreen]->cameraPos;
+		const Mat44f projCamera = projection * world2Camera;
+
+		auto& progStatic = *(state.progs[0]);
+		auto& progParticle = *state.progs[2];
+		auto& progCrowd = *state.progs[4];
+		auto& progSkinned = *state.progs[5];
+
+		for( ShaderProgram* lit : { &progStatic, &progCrowd, &progSkinned } )
 		{
-			averageTime = (averageTime + (ts2-ts1)) / 2;
+			lit->setUniform("uLightDir", lightDir);
+			lit->setUniform("uLightDiffuse", state.currentGlobalLight); // 0.9f, 0.9f, 0.6f
+			lit->setUniform("uSceneAmbient", sceneAmbient);
+			lit->setUniform("uCamPosition", camPosition);
 		}
-		
-		std::cout << "Average time: " << averageTime << "\n";
-#endif // BENCHMARK_TASK_2
-
-#if BENCHMARK_INSTANCING
-		static uint64_t averageTime = 0;
-		static int renderCount = 0;
 
-		GLuint landingPadBM3 = 0;
-		glGenQueries(1, &landingPadBM3);
-		glQueryCounter( landingPadBM3, GL_TIMESTAMP );
+		progStatic.setUniform("uProjCamera", projCamera);
+		progCrowd.setUniform("uProjCamera", projCamera);
+		progCrowd.setUniform("uTime", float(glfwGetTime()));
+		progSkinned.setUniform("uProjCamera", projCamera);
+		progSkinned.setUniform("uModel", make_translation( state.radarPosition ));
+		progParticle.setUniform("uProjCameraWorld", projCamera);
+		progParticle.setUniform("uCameraRight", aCamCtrl.cameraRight);
+		progParticle.setUniform("uCameraUp", aCamCtrl.cameraUp);
 
-		GLuint64 ts1 = 0;
-
-		glGetQueryObjectui64v(landingPadBM3, GL_QUERY_RESULT, &ts1);
-#endif // BENCHMARK_INSTANCING
-
-
-		// Render the landing pad
-		auto& prog2 = *state.progs[1];
-		auto& landingPadInstances = *state.landingPadInstPtr;
-		glUseProgram( prog2.programId() );
-
-		GLint locProj        = state.prog2UniformIds[0];
-		GLint locModelTrans  = state.prog2UniformIds[1];
-		GLint locNormalTrans = state.prog2UniformIds[2];
-		GLint locLightDir    = state.prog2UniformIds[3];
-		GLint locDiffuse     = state.prog2UniformIds[4];
-		GLint locAmbient     = state.prog2UniformIds[5];
-
-		GLint locCamPos = state.prog2UniformIds[6];
-		//get camera projection
-		std::vector<Mat44f> projectionList = landingPadInstances.GetProjCameraWorldArray(projection, world2Camera);
-		glUniformMatrix4fv(locProj, (GLsizei)projectionList.size(), GL_TRUE, projectionList.data()[0].v);
-		//get translations
-		std::vector<std::array<float, 3>> transformList = landingPadInstances.GetTranslationArray();
-		glUniform3fv(locModelTrans, (GLsizei) projectionList.size(), transformList.data()[0].data());
-		//get normal updates
-		std::vector<Mat33f> normalUpdates = landingPadInstances.GetNormalUpdateArray();
-		glUniformMatrix3fv(locNormalTrans, (GLsizei)normalUpdates.size(), GL_TRUE, normalUpdates.data()[0].v);
-
-		glUniform3fv(locLightDir, 1, &lightDir.x);
-		glUniform3f(locDiffuse,
-					state.currentGlobalLight[0],
-					state.currentGlobalLight[1],
-					state.currentGlobalLight[2]); // light diffuse
-		glUniform3f(locAmbient, 0.05f, 0.05f, 0.05f); // light ambient
-		glUniform3f(locCamPos,
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[0],
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[1],
-					state.camControl[state.selectedCamera_topScreen]->cameraPos[2]);
-
-		//point light uniforms
+		//point lights follow the space ship
 		Vec3f spaceShipAnimatedPosition = state.spaceShipInstPtr->GetTransform(0).mPosition;
-		Vec3f spaceShipAnimatedRotation = state.spaceShipInstPtr->GetTransform(0).mRotation;
 		Vec4f spaceShipOffset = Vec3ToVec4(spaceShipAnimatedPosition - state.spaceShipInitialTransform.mPosition);
+		std::vector<PointLight>& lights = *(state.lights);
 		for(size_t i = 0; i < lights.size(); i++)
 		{
 			lights[i].lPosition = state.lightOriginalPositions->at(i) + spaceShipOffset;
 		}
 
-		glBindBuffer(GL_UNIFORM_BUFFER, uboLights);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PointLight)* lights.size(), lights.data());
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBuffer(GL_UNIFORM_BUFFER, state.lightsUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PointLight) * lights.size(), lights.data());
 
-		glBindVertexArray( state.landingPadVAO );
-		glDrawArraysInstanced( GL_TRIANGLES, 0, state.numLandingPadVerts, landingPadInstances.GetInstanceCount());
+		// Static geometry: the terrain, the landing pads and the space ship,
+		// whose transforms are the instances of a single multi-draw. They are
+		// culled before the queue is flushed, which expects nothing bound (the
+		// GPU backend binds its compute program).
+		const Transform terrainTransform{};
+		StaticDrawBatch& staticBatch = *state.staticBatch;
+		staticBatch.Clear();
+		staticBatch.Add(state.terrainMesh, { &terrainTransform, 1 }, { .flags = kStaticTextured, .pointLightScale = 50.f });
+		staticBatch.Add(state.landingPadMesh, state.landingPadInstPtr->GetTransforms());
+		staticBatch.Add(state.spaceShipMesh, state.spaceShipInstPtr->GetTransforms());
+		staticBatch.Cull(MakeFrustum(projCamera), state.cullingBackend);
+
+		queue.Submit({
+			.program = &progStatic,
+			.vertexArray = staticBatch.VertexArray(),
+			.texture = state.terrainTexture,
+			.draw = [&] {
+#if BENCHMARK_TASK_2
+				static uint64_t averageTime = 0;
+				static int renderCount = 0;
 
+				GLuint terrainLoadCPUGPU3 = 0;
+				glGenQueries(1, &terrainLoadCPUGPU3);
+				glQueryCounter( terrainLoadCPUGPU3, GL_TIMESTAMP );
 
-#if BENCHMARK_INSTANCING
-		GLuint landingPadBM4 = 0;
-		glGenQueries(1, &landingPadBM4);
-		glQueryCounter( landingPadBM4, GL_TIMESTAMP );
+				GLuint64 ts1 = 0;
 
-		GLuint64 ts2 = 0;
-		glGetQueryObjectui64v(landingPadBM4, GL_QUERY_RESULT, &ts2);
+				glGetQueryObjectui64v(terrainLoadCPUGPU3, GL_QUERY_RESULT, &ts1);
+#endif // BENCHMARK_TASK_2
 
-		if( renderCount == 0)
-		{
-			renderCount++;
-			averageTime += ts2-ts1;
-		}
-		else
-		{
-			averageTime = (averageTime + (ts2-ts1)) / 2;
-		}
-		
-		std::cout << "Landing pad average time: " << averageTime << "\n";
-#endif // BENCHMARK_INSTANCING
+				staticBatch.Draw();
 
+#if BENCHMARK_TASK_2
+				GLuint terrainLoadCPUGPU4 = 0;
+				glGenQueries(1, &terrainLoadCPUGPU4);
+				glQueryCounter( terrainLoadCPUGPU4, GL_TIMESTAMP );
 
-		// Spaceship
-		std::vector<Mat44f> projectionList2 = state.spaceShipInstPtr->GetProjCameraWorldArray(projection, world2Camera);
-		glUniformMatrix4fv(locProj, (GLsizei) projectionList2.size(), GL_TRUE, projectionList2.data()[0].v );
-		//get ship translation
-		std::vector<std::array<float, 3>> shipTransformList = state.spaceShipInstPtr->GetTranslationArray();
-		glUniform3fv(locModelTrans, (GLsizei)projectionList2.size(), shipTransformList.data()[0].data());
-		//get normal updates
-		std::vector<Mat33f> shipNormalUpdates = state.spaceShipInstPtr->GetNormalUpdateArray();
-		glUniformMatrix3fv(locNormalTrans, (GLsizei)shipNormalUpdates.size(), GL_TRUE, shipNormalUpdates.data()[0].v);
-
-		glBindVertexArray( state.shipVAO );
-		glDrawArraysInstanced( GL_TRIANGLES, 0, state.numSpaceShipVerts, state.spaceShipInstPtr->GetInstanceCount());
-
-		//Particles
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-		glDepthMask(GL_FALSE);
-		auto& progParticle = *state.progs[3];
-		glUseProgram(progParticle.programId());
-		GLint locProjPart = state.progParticleUniformIds[0];
-		GLint locColour = state.progParticleUniformIds[1];
-		GLint locOffset = state.progParticleUniformIds[2];
-
-		//move source and update particles
-		
-
-		Mat44f spaceShipRotMat = make_rotation_y(spaceShipAnimatedRotation.y);
-		Vec3f sourcePos = Vec4ToVec3(spaceShipRotMat * Vec3ToVec4(state.pSource->GetRelativePosition())) + spaceShipAnimatedPosition;
-
-		state.pSource->SetPosition(sourcePos);
-
-		//get verticies and texture
-		glBindVertexArray(state.pSource->ParticleVAO());
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, state.pSource->GetTexture());
-
-		state.pSource->UpdateParticles(state.dt);
-		std::vector<Particle> particles = state.pSource->GetParticles();
-		for (size_t i = 0; i < particles.size(); i++) 
-		{
-			if (particles[i].life > 0) 
-			{
-				Mat44f particleProjection = projection * world2Camera * make_translation(particles[i].Position) * world2CamFlat;
-				glUniformMatrix4fv(locProjPart, 1, GL_TRUE, particleProjection.v);
-				glUniform3fv(locOffset, 1, &particles[i].Position.x);
-				glUniform4fv(locColour, 1, &particles[i].Colour.x);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
-				
+				GLuint64 ts2 = 0;
+				glGetQueryObjectui64v(terrainLoadCPUGPU4, GL_QUERY_RESULT, &ts2);
+
+				if( renderCount == 0)
+				{
+					renderCount++;
+					averageTime += ts2-ts1;
+				}
+				else
+				{
+					averageTime = (averageTime + (ts2-ts1)) / 2;
+				}
+
+				std::cout << "Average time: " << averageTime << "\n";
+#endif // BENCHMARK_TASK_2
 			}
-			
+		});
+
+		// Crowd: space ships whose instances come from the storage buffers,
+		// and animate themselves from the time. The ship's mesh is in the
+		// geometry buffer.
+		if( state.showCrowd )
+		{
+			queue.Submit({
+				.program = &progCrowd,
+				.vertexArray = state.geometry->VertexArray(),
+				.draw = [&] {
+					const MeshRange& ship = state.spaceShipMesh;
+					state.crowdAnimations->Bind();
+					glDrawElementsInstancedBaseVertex( GL_TRIANGLES, GLsizei(ship.indices.count), GL_UNSIGNED_INT,
+						reinterpret_cast<const void*>(std::size_t(ship.indices.first) * sizeof(GLuint)),
+						GLsizei(state.crowdAnimations->InstanceCount()), GLint(ship.vertices.first) );
+				}
+			});
 		}
-		glDisable(GL_BLEND);
-		glDepthMask(GL_TRUE);
 
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// Radar (binds its own vertex array)
+		queue.Submit({
+			.program = &progSkinned,
+			.position = state.radarPosition,
+			.draw = [&] {
+				state.radarModels[SkinningBackend::Cpu == state.skinningBackend ? 0 : 1]->Draw();
+			}
+		});
+
+		// Particles (simulated in the main loop). Billboarding is done in the
+		// vertex shader, so each texture is a single instanced draw.
+		queue.Submit({
+			.pass = RenderPass::Blended,
+			.program = &progParticle,
+			.blendSource = GL_SRC_ALPHA,
+			.blendDestination = GL_ONE,
+			.draw = [&] {
+				state.particles->Draw();
+			}
+		});
+
+		queue.Flush();
 	}
 
 
@@ -24,9 +24,14 @@ workspace "COMP3811-glcode"
 		-- (MSVC will not compile code with VLAs.)
 		buildoptions { "-Werror=vla" }
 
-	filter "toolset:gcc" 
+	filter "toolset:gcc"
 		links { "stdc++exp" }
 
+		-- At -O2, GCC only vectorizes loops whose trip count is known at
+		-- compile time. The SoA update loops (particles, ...) run over a
+		-- count that is only known at runtime, so let it weigh those up too.
+		buildoptions { "-fvect-cost-model=dynamic" }
+
 	filter "toolset:msc-*"
 		warnings "extra" -- this enables /W4; default is /W3
 		--buildoptions { "/W4" }
@@ -93,6 +98,7 @@ project "main"
 	files( sources )
 
 	dependson "main-shaders"
+	dependson "font-baker"
 	dependson "x-rapidobj"
 
 	links "vmlib"
@@ -110,7 +116,8 @@ project "main-shaders"
 		"assets/cw2/*.geom",
 		"assets/cw2/*.tesc",
 		"assets/cw2/*.tese",
-		"assets/cw2/*.comp"
+		"assets/cw2/*.comp",
+		"assets/cw2/*.glsl"
 	}
 
 	kind "Utility"
@@ -135,6 +142,105 @@ project "vmlib-test"
 
 	links "x-catch2"
 
+project "main-test"
+	local sources = { 
+		"main-test/**.cpp",
+		"main-test/**.hpp",
+		"main-test/**.hxx",
+		"main-test/**.inl",
+		"main-test/**.comp"
+	}
+
+	-- Code under test. Everything from main except the application itself.
+	local mainSources = {
+		"main/**.cpp",
+		"main/**.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "main-test"
+
+	files( sources )
+	files( mainSources )
+	removefiles( "main/main.cpp" )
+
+	dependson "main-shaders"
+	dependson "x-rapidobj"
+
+	links "vmlib"
+	links "support"
+
+	links "x-stb"
+	links "x-glad"
+	links "x-glfw"
+	links "x-fontstash"
+	links "x-catch2"
+
+project "bench"
+	local sources = {
+		"bench/**.cpp",
+		"bench/**.hpp",
+		"bench/**.hxx",
+		"bench/**.inl"
+	}
+
+	-- Code under test. Everything from main except the application itself.
+	local mainSources = {
+		"main/**.cpp",
+		"main/**.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "bench"
+
+	files( sources )
+	files( mainSources )
+	removefiles( "main/main.cpp" )
+
+	-- Results as JSON, so that runs can be compared across commits
+	debugargs { "--reporter", "benchjson::out=bench_output.json" }
+
+	dependson "x-rapidobj"
+
+	links "vmlib"
+	links "support"
+
+	links "x-stb"
+	links "x-glad"
+	links "x-fontstash"
+	links "x-catch2"
+
+project "font-baker"
+	local sources = {
+		"font-baker/**.cpp",
+		"font-baker/**.hpp"
+	}
+
+	-- The atlas itself, from main
+	local atlasSources = {
+		"main/SdfGlyphAtlas.cpp",
+		"main/SdfGlyphAtlas.hpp",
+		"main/FontRegistry.cpp",
+		"main/FontRegistry.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "font-baker"
+
+	files( sources )
+	files( atlasSources )
+
+	-- Bake the font main uses, next to it; PITBFontManager looks for it
+	-- there (and rasterizes the glyphs as they are used without it)
+	postbuildcommands {
+		'"%{cfg.buildtarget.abspath}" "%{wks.location}/assets/cw2/DroidSansMonoDotted.ttf" "%{wks.location}/assets/cw2/DroidSansMonoDotted.sdfatlas"'
+	}
+
+	links "support"
+
+	links "x-stb"
+	links "x-glad"
+
 project "support"
 	local sources = { 
 		"support/**.cpp",
@@ -0,0 +1,437 @@
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <utility>
+
+#include <glad/glad.h>
+
+namespace
+{
+	constexpr GLuint kUnknown_ = ~GLuint(0);
+	constexpr GLint kUnknownFlag_ = -1;
+
+	constexpr std::size_t kTextureUnits_ = 32;
+	constexpr std::size_t kIndexedBindings_ = 16;
+
+	constexpr GLenum kTextureTargets_[] = {
+		GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER
+	};
+
+	// Not GL_ELEMENT_ARRAY_BUFFER, which belongs to the vertex array
+	constexpr GLenum kBufferTargets_[] = {
+		GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER,
+		GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,
+		GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER
+	};
+	constexpr GLenum kIndexedTargets_[] = {
+		GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER
+	};
+
+	constexpr GLenum kCapabilities_[] = {
+		GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST,
+		GL_FRAMEBUFFER_SRGB, GL_PROGRAM_POINT_SIZE, GL_RASTERIZER_DISCARD
+	};
+
+	// Index of aValue in aValues; tSize if it isn't there
+	template< std::size_t tSize >
+	std::size_t index_of_( GLenum const (&aValues)[tSize], GLenum aValue ) noexcept
+	{
+		return std::size_t(std::find( std::begin(aValues), std::end(aValues), aValue ) - std::begin(aValues));
+	}
+
+	struct Cache_
+	{
+		GLuint program;
+		GLuint vertexArray;
+		GLuint activeUnit; // Index; calls for units past kTextureUnits_ aren't cached
+
+		GLuint textures[kTextureUnits_][std::size(kTextureTargets_)];
+		GLuint buffers[std::size(kBufferTargets_)];
+		GLuint indexed[std::size(kIndexedTargets_)][kIndexedBindings_];
+
+		GLint capabilities[std::size(kCapabilities_)];
+		GLenum blendSource, blendDestination;
+		GLint depthMask;
+		GLint viewport[4];
+		bool viewportKnown;
+	};
+
+	// glad's entry points, as loaded
+	struct Entry_
+	{
+		decltype(glad_glUseProgram) useProgram;
+		decltype(glad_glBindVertexArray) bindVertexArray;
+		decltype(glad_glActiveTexture) activeTexture;
+		decltype(glad_glBindTexture) bindTexture;
+		decltype(glad_glBindBuffer) bindBuffer;
+		decltype(glad_glBindBufferBase) bindBufferBase;
+		decltype(glad_glBindBufferRange) bindBufferRange;
+		decltype(glad_glEnable) enable;
+		decltype(glad_glDisable) disable;
+		decltype(glad_glBlendFunc) blendFunc;
+		decltype(glad_glBlendFuncSeparate) blendFuncSeparate;
+		decltype(glad_glDepthMask) depthMask;
+		decltype(glad_glViewport) viewport;
+
+		decltype(glad_glDeleteProgram) deleteProgram;
+		decltype(glad_glDeleteVertexArrays) deleteVertexArrays;
+		decltype(glad_glDeleteBuffers) deleteBuffers;
+		decltype(glad_glDeleteTextures) deleteTextures;
+
+		// Newer than 4.3, so possibly not loaded
+		decltype(glad_glBindTextureUnit) bindTextureUnit;
+		decltype(glad_glBindTextures) bindTextures;
+		decltype(glad_glBindBuffersBase) bindBuffersBase;
+		decltype(glad_glBindBuffersRange) bindBuffersRange;
+		decltype(glad_glEnablei) enablei;
+		decltype(glad_glDisablei) disablei;
+	};
+
+	Cache_ gCache_;
+	Entry_ gGL_;
+	GLStateStats gStats_;
+
+	// Counts the call; true if it has to be issued
+	bool issue_( bool aRedundant ) noexcept
+	{
+		if( aRedundant )
+		{
+			++gStats_.elided;
+			return false;
+		}
+
+		++gStats_.issued;
+		return true;
+	}
+
+	void forget_buffer_target_( GLenum aTarget ) noexcept
+	{
+		if( auto const i = index_of_( kBufferTargets_, aTarget ); i < std::size(kBufferTargets_) )
+			gCache_.buffers[i] = kUnknown_;
+		if( auto const i = index_of_( kIndexedTargets_, aTarget ); i < std::size(kIndexedTargets_) )
+			std::ranges::fill( gCache_.indexed[i], kUnknown_ );
+	}
+
+	void forget_capability_( GLenum aCapability ) noexcept
+	{
+		if( auto const i = index_of_( kCapabilities_, aCapability ); i < std::size(kCapabilities_) )
+			gCache_.capabilities[i] = kUnknownFlag_;
+	}
+
+	void APIENTRY use_program_( GLuint aProgram )
+	{
+		if( issue_( gCache_.program == aProgram ) )
+		{
+			gCache_.program = aProgram;
+			gGL_.useProgram( aProgram );
+		}
+	}
+
+	void APIENTRY bind_vertex_array_( GLuint aArray )
+	{
+		if( issue_( gCache_.vertexArray == aArray ) )
+		{
+			gCache_.vertexArray = aArray;
+			gGL_.bindVertexArray( aArray );
+		}
+	}
+
+	void APIENTRY active_texture_( GLenum aUnit )
+	{
+		if( issue_( gCache_.activeUnit == aUnit - GL_TEXTURE0 ) )
+		{
+			gCache_.activeUnit = aUnit - GL_TEXTURE0;
+			gGL_.activeTexture( aUnit );
+		}
+	}
+
+	void APIENTRY bind_texture_( GLenum aTarget, GLuint aTexture )
+	{
+		auto const target = index_of_( kTextureTargets_, aTarget );
+		if( target == std::size(kTextureTargets_) || gCache_.activeUnit >= kTextureUnits_ )
+		{
+			issue_( false );
+			gGL_.bindTexture( aTarget, aTexture );
+			return;
+		}
+
+		auto& bound = gCache_.textures[gCache_.activeUnit][target];
+		if( issue_( bound == aTexture ) )
+		{
+			bound = aTexture;
+			gGL_.bindTexture( aTarget, aTexture );
+		}
+	}
+
+	void APIENTRY bind_buffer_( GLenum aTarget, GLuint aBuffer )
+	{
+		auto const target = index_of_( kBufferTargets_, aTarget );
+		if( target == std::size(kBufferTargets_) )
+		{
+			issue_( false );
+			gGL_.bindBuffer( aTarget, aBuffer );
+			return;
+		}
+
+		if( issue_( gCache_.buffers[target] == aBuffer ) )
+		{
+			gCache_.buffers[target] = aBuffer;
+			gGL_.bindBuffer( aTarget, aBuffer );
+		}
+	}
+
+	// Binds the generic binding point as well
+	void APIENTRY bind_buffer_base_( GLenum aTarget, GLuint aIndex, GLuint aBuffer )
+	{
+		auto const target = index_of_( kIndexedTargets_, aTarget );
+		if( target == std::size(kIndexedTargets_) || aIndex >= kIndexedBindings_ )
+		{
+			issue_( false );
+			gGL_.bindBufferBase( aTarget, aIndex, aBuffer );
+			if( auto const generic = index_of_( kBufferTargets_, aTarget ); generic < std::size(kBufferTargets_) )
+				gCache_.buffers[generic] = aBuffer;
+			return;
+		}
+
+		auto& generic = gCache_.buffers[index_of_( kBufferTargets_, aTarget )];
+		auto& slot = gCache_.indexed[target][aIndex];
+		if( issue_( slot == aBuffer && generic == aBuffer ) )
+		{
+			slot = generic = aBuffer;
+			gGL_.bindBufferBase( aTarget, aIndex, aBuffer );
+		}
+	}
+
+	// Ranges aren't compared, only passed through
+	void APIENTRY bind_buffer_range_( GLenum aTarget, GLuint aIndex, GLuint aBuffer, GLintptr aOffset, GLsizeiptr aSize )
+	{
+		issue_( false );
+		gGL_.bindBufferRange( aTarget, aIndex, aBuffer, aOffset, aSize );
+
+		if( auto const generic = index_of_( kBufferTargets_, aTarget ); generic < std::size(kBufferTargets_) )
+			gCache_.buffers[generic] = aBuffer;
+		if( auto const target = index_of_( kIndexedTargets_, aTarget ); target < std::size(kIndexedTargets_) && aIndex < kIndexedBindings_ )
+			gCache_.indexed[target][aIndex] = kUnknown_;
+	}
+
+	void set_capability_( GLenum aCapability, GLint aEnabled, decltype(glad_glEnable) aCall )
+	{
+		auto const capability = index_of_( kCapabilities_, aCapability );
+		if( capability == std::size(kCapabilities_) )
+		{
+			issue_( false );
+			aCall( aCapability );
+			return;
+		}
+
+		if( issue_( gCache_.capabilities[capability] == aEnabled ) )
+		{
+			gCache_.capabilities[capability] = aEnabled;
+			aCall( aCapability );
+		}
+	}
+
+	void APIENTRY enable_( GLenum aCapability )
+	{
+		set_capability_( aCapability, 1, gGL_.enable );
+	}
+	void APIENTRY disable_( GLenum aCapability )
+	{
+		set_capability_( aCapability, 0, gGL_.disable );
+	}
+
+	void APIENTRY blend_func_( GLenum aSource, GLenum aDestination )
+	{
+		if( issue_( gCache_.blendSource == aSource && gCache_.blendDestination == aDestination ) )
+		{
+			gCache_.blendSource = aSource;
+			gCache_.blendDestination = aDestination;
+			gGL_.blendFunc( aSource, aDestination );
+		}
+	}
+
+	void APIENTRY blend_func_separate_( GLenum aSourceRGB, GLenum aDestinationRGB, GLenum aSourceAlpha, GLenum aDestinationAlpha )
+	{
+		issue_( false );
+		gGL_.blendFuncSeparate( aSourceRGB, aDestinationRGB, aSourceAlpha, aDestinationAlpha );
+		gCache_.blendSource = gCache_.blendDestination = kUnknown_;
+	}
+
+	void APIENTRY depth_mask_( GLboolean aFlag )
+	{
+		if( issue_( gCache_.depthMask == GLint(aFlag) ) )
+		{
+			gCache_.depthMask = GLint(aFlag);
+			gGL_.depthMask( aFlag );
+		}
+	}
+
+	void APIENTRY viewport_( GLint aX, GLint aY, GLsizei aWidth, GLsizei aHeight )
+	{
+		GLint const viewport[4] = { aX, aY, aWidth, aHeight };
+		if( issue_( gCache_.viewportKnown && std::ranges::equal( gCache_.viewport, viewport ) ) )
+		{
+			std::ranges::copy( viewport, gCache_.viewport );
+			gCache_.viewportKnown = true;
+			gGL_.viewport( aX, aY, aWidth, aHeight );
+		}
+	}
+
+	// Deleting an object unbinds it (except a program in use, which
+	// stays in use until another is)
+	void APIENTRY delete_program_( GLuint aProgram )
+	{
+		gGL_.deleteProgram( aProgram );
+		if( 0 != aProgram && gCache_.program == aProgram )
+			gCache_.program = kUnknown_;
+	}
+
+	void APIENTRY delete_vertex_arrays_( GLsizei aCount, GLuint const* aArrays )
+	{
+		gGL_.deleteVertexArrays( aCount, aArrays );
+		if( std::find( aArrays, aArrays + aCount, gCache_.vertexArray ) != aArrays + aCount )
+			gCache_.vertexArray = 0;
+	}
+
+	void APIENTRY delete_buffers_( GLsizei aCount, GLuint const* aBuffers )
+	{
+		gGL_.deleteBuffers( aCount, aBuffers );
+		for( auto const buffer : std::span( aBuffers, std::size_t(aCount) ) )
+		{
+			if( 0 == buffer )
+				continue;
+
+			std::ranges::replace( gCache_.buffers, buffer, 0u );
+			for( auto& slots : gCache_.indexed )
+				std::ranges::replace( slots, buffer, kUnknown_ );
+		}
+	}
+
+	void APIENTRY delete_textures_( GLsizei aCount, GLuint const* aTextures )
+	{
+		gGL_.deleteTextures( aCount, aTextures );
+		for( auto const texture : std::span( aTextures, std::size_t(aCount) ) )
+		{
+			if( 0 == texture )
+				continue;
+
+			for( auto& unit : gCache_.textures )
+				std::ranges::replace( unit, texture, 0u );
+		}
+	}
+
+	// Multi-bind and indexed variants: passed through, forgetting what they
+	// change
+	void APIENTRY bind_texture_unit_( GLuint aUnit, GLuint aTexture )
+	{
+		gGL_.bindTextureUnit( aUnit, aTexture );
+		if( aUnit < kTextureUnits_ )
+			std::ranges::fill( gCache_.textures[aUnit], kUnknown_ );
+	}
+
+	void APIENTRY bind_textures_( GLuint aFirst, GLsizei aCount, GLuint const* aTextures )
+	{
+		gGL_.bindTextures( aFirst, aCount, aTextures );
+		for( GLuint unit = aFirst; unit < aFirst + GLuint(aCount) && unit < kTextureUnits_; ++unit )
+			std::ranges::fill( gCache_.textures[unit], kUnknown_ );
+	}
+
+	void APIENTRY bind_buffers_base_( GLenum aTarget, GLuint aFirst, GLsizei aCount, GLuint const* aBuffers )
+	{
+		gGL_.bindBuffersBase( aTarget, aFirst, aCount, aBuffers );
+		forget_buffer_target_( aTarget );
+	}
+
+	void APIENTRY bind_buffers_range_( GLenum aTarget, GLuint aFirst, GLsizei aCount, GLuint const* aBuffers, GLintptr const* aOffsets, GLsizeiptr const* aSizes )
+	{
+		gGL_.bindBuffersRange( aTarget, aFirst, aCount, aBuffers, aOffsets, aSizes );
+		forget_buffer_target_( aTarget );
+	}
+
+	void APIENTRY enablei_( GLenum aCapability, GLuint aIndex )
+	{
+		gGL_.enablei( aCapability, aIndex );
+		forget_capability_( aCapability );
+	}
+	void APIENTRY disablei_( GLenum aCapability, GLuint aIndex )
+	{
+		gGL_.disablei( aCapability, aIndex );
+		forget_capability_( aCapability );
+	}
+
+	// Points aGlad at aHook, keeping what it pointed at in aEntry. Entry
+	// points the driver doesn't have are left alone.
+	template< typename tFn >
+	void hook_( tFn& aGlad, tFn& aEntry, tFn aHook ) noexcept
+	{
+		// Already hooked: glad wasn't loaded again since
+		if( aGlad == aHook )
+			return;
+
+		aEntry = aGlad;
+		if( aGlad )
+			aGlad = aHook;
+	}
+}
+
+void install_gl_state_cache()
+{
+	hook_( glad_glUseProgram, gGL_.useProgram, &use_program_ );
+	hook_( glad_glBindVertexArray, gGL_.bindVertexArray, &bind_vertex_array_ );
+	hook_( glad_glActiveTexture, gGL_.activeTexture, &active_texture_ );
+	hook_( glad_glBindTexture, gGL_.bindTexture, &bind_texture_ );
+	hook_( glad_glBindBuffer, gGL_.bindBuffer, &bind_buffer_ );
+	hook_( glad_glBindBufferBase, gGL_.bindBufferBase, &bind_buffer_base_ );
+	hook_( glad_glBindBufferRange, gGL_.bindBufferRange, &bind_buffer_range_ );
+	hook_( glad_glEnable, gGL_.enable, &enable_ );
+	hook_( glad_glDisable, gGL_.disable, &disable_ );
+	hook_( glad_glBlendFunc, gGL_.blendFunc, &blend_func_ );
+	hook_( glad_glBlendFuncSeparate, gGL_.blendFuncSeparate, &blend_func_separate_ );
+	hook_( glad_glDepthMask, gGL_.depthMask, &depth_mask_ );
+	hook_( glad_glViewport, gGL_.viewport, &viewport_ );
+
+	hook_( glad_glDeleteProgram, gGL_.deleteProgram, &delete_program_ );
+	hook_( glad_glDeleteVertexArrays, gGL_.deleteVertexArrays, &delete_vertex_arrays_ );
+	hook_( glad_glDeleteBuffers, gGL_.deleteBuffers, &delete_buffers_ );
+	hook_( glad_glDeleteTextures, gGL_.deleteTextures, &delete_textures_ );
+
+	hook_( glad_glBindTextureUnit, gGL_.bindTextureUnit, &bind_texture_unit_ );
+	hook_( glad_glBindTextures, gGL_.bindTextures, &bind_textures_ );
+	hook_( glad_glBindBuffersBase, gGL_.bindBuffersBase, &bind_buffers_base_ );
+	hook_( glad_glBindBuffersRange, gGL_.bindBuffersRange, &bind_buffers_range_ );
+	hook_( glad_glEnablei, gGL_.enablei, &enablei_ );
+	hook_( glad_glDisablei, gGL_.disablei, &disablei_ );
+
+	reset_gl_state_cache();
+	gStats_ = {};
+}
+
+void reset_gl_state_cache() noexcept
+{
+	gCache_.program = kUnknown_;
+	gCache_.vertexArray = kUnknown_;
+	gCache_.activeUnit = kUnknown_;
+
+	for( auto& unit : gCache_.textures )
+		std::ranges::fill( unit, kUnknown_ );
+	std::ranges::fill( gCache_.buffers, kUnknown_ );
+	for( auto& slots : gCache_.indexed )
+		std::ranges::fill( slots, kUnknown_ );
+
+	std::ranges::fill( gCache_.capabilities, kUnknownFlag_ );
+	gCache_.blendSource = gCache_.blendDestination = kUnknown_;
+	gCache_.depthMask = kUnknownFlag_;
+	gCache_.viewportKnown = false;
+}
+
+GLStateStats gl_state_stats() noexcept
+{
+	return gStats_;
+}
+
+GLStateStats gl_state_new_frame() noexcept
+{
+	return std::exchange( gStats_, {} );
+}
@@ -0,0 +1,41 @@
+#ifndef GL_STATE_HPP_3D1F6A2E_8B47_4C0B_A59E_6C2D7E41B9F8
+#define GL_STATE_HPP_3D1F6A2E_8B47_4C0B_A59E_6C2D7E41B9F8
+
+#include <cstddef>
+
+// Calls made through the cache since the last gl_state_new_frame()
+struct GLStateStats
+{
+	std::size_t issued = 0;
+	std::size_t elided = 0; // Would not have changed anything
+};
+
+// Replaces glad's entry points for the bind and state calls with versions
+// that remember what they last set, and drop calls that would set it again.
+// Everything calling glUseProgram(), glBindVertexArray(), glActiveTexture(),
+// glBindTexture(), glBindBuffer(), glBindBufferBase(), glEnable(),
+// glDisable(), glBlendFunc(), glDepthMask() or glViewport() goes through it,
+// so there is nothing to call differently.
+//
+// Call once glad has loaded the API, with the context current; calling it
+// again (e.g. after gladLoadGLLoader() for a new context) starts over. The
+// cache knows nothing at first, so the first call of each is issued.
+//
+// Only state the cache can see is cached: GL_ELEMENT_ARRAY_BUFFER is the
+// vertex array's, and unusual targets and capabilities are passed through.
+// Deleting objects and the multi-bind and indexed variants (glBindTextures(),
+// glEnablei(), ...) forget what they change. Anything else that changes
+// this state behind glad's back (another library, a debugger) should be
+// followed by reset_gl_state_cache().
+void install_gl_state_cache();
+
+// Forgets all cached state
+void reset_gl_state_cache() noexcept;
+
+// Calls so far this frame
+GLStateStats gl_state_stats() noexcept;
+
+// Returns the calls made this frame, and starts counting the next
+GLStateStats gl_state_new_frame() noexcept;
+
+#endif // GL_STATE_HPP_3D1F6A2E_8B47_4C0B_A59E_6C2D7E41B9F8
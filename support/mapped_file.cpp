@@ -0,0 +1,154 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include "error.hpp"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN 1
+#	define NOMINMAX 1
+#	include <windows.h>
+#else // !_WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif // ~ _WIN32
+
+#if defined(_WIN32)
+MappedFile::MappedFile( char const* aPath )
+	: mData( nullptr )
+	, mSize( 0 )
+	, mMapping( nullptr )
+{
+	HANDLE file = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( INVALID_HANDLE_VALUE == file )
+		throw Error( "MappedFile: unable to open '{}' (error {})", aPath, GetLastError() );
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx( file, &size ) )
+	{
+		auto const err = GetLastError();
+		CloseHandle( file );
+		throw Error( "MappedFile: unable to get the size of '{}' (error {})", aPath, err );
+	}
+
+	mSize = std::size_t(size.QuadPart);
+	if( 0 == mSize )
+	{
+		CloseHandle( file );
+		return;
+	}
+
+	// The mapping keeps the file open
+	mMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if( !mMapping )
+		throw Error( "MappedFile: unable to map '{}' (error {})", aPath, GetLastError() );
+
+	mData = static_cast<unsigned char const*>(MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 ));
+	if( !mData )
+	{
+		auto const err = GetLastError();
+		CloseHandle( mMapping );
+		throw Error( "MappedFile: unable to map '{}' (error {})", aPath, err );
+	}
+}
+
+void MappedFile::release_() noexcept
+{
+	if( mData )
+		UnmapViewOfFile( mData );
+	if( mMapping )
+		CloseHandle( mMapping );
+
+	mData = nullptr;
+	mMapping = nullptr;
+	mSize = 0;
+}
+
+MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+	, mMapping( std::exchange( aOther.mMapping, nullptr ) )
+{}
+
+MappedFile& MappedFile::operator= (MappedFile&& aOther) noexcept
+{
+	if( this != &aOther )
+	{
+		release_();
+		mData = std::exchange( aOther.mData, nullptr );
+		mSize = std::exchange( aOther.mSize, 0 );
+		mMapping = std::exchange( aOther.mMapping, nullptr );
+	}
+	return *this;
+}
+
+#else // !_WIN32
+MappedFile::MappedFile( char const* aPath )
+	: mData( nullptr )
+	, mSize( 0 )
+{
+	int const fd = open( aPath, O_RDONLY );
+	if( -1 == fd )
+		throw Error( "MappedFile: unable to open '{}'", aPath );
+
+	struct stat info;
+	if( -1 == fstat( fd, &info ) )
+	{
+		close( fd );
+		throw Error( "MappedFile: unable to stat '{}'", aPath );
+	}
+
+	mSize = std::size_t(info.st_size);
+	if( 0 == mSize )
+	{
+		close( fd );
+		return;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	void* data = mmap( nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( MAP_FAILED == data )
+		throw Error( "MappedFile: unable to map '{}'", aPath );
+
+	mData = static_cast<unsigned char const*>(data);
+}
+
+void MappedFile::release_() noexcept
+{
+	if( mData )
+		munmap( const_cast<unsigned char*>(mData), mSize );
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+{}
+
+MappedFile& MappedFile::operator= (MappedFile&& aOther) noexcept
+{
+	if( this != &aOther )
+	{
+		release_();
+		mData = std::exchange( aOther.mData, nullptr );
+		mSize = std::exchange( aOther.mSize, 0 );
+	}
+	return *this;
+}
+#endif // ~ _WIN32
+
+MappedFile::~MappedFile()
+{
+	release_();
+}
+
+std::span<unsigned char const> MappedFile::bytes() const noexcept
+{
+	return { mData, mSize };
+}
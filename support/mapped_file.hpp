@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_HPP_6725343F_83D9_48AA_BD18_F2CAE076C040
+#define MAPPED_FILE_HPP_6725343F_83D9_48AA_BD18_F2CAE076C040
+
+#include <span>
+
+#include <cstddef>
+
+// A whole file, mapped read-only into memory. The OS pages it in on demand
+// and can share the pages between processes; nothing is copied onto the
+// heap.
+//
+// Throws Error if the file can't be opened or mapped. An empty file maps to
+// an empty span.
+class MappedFile final
+{
+	public:
+		explicit MappedFile( char const* aPath );
+		~MappedFile();
+
+		MappedFile( MappedFile const& ) = delete;
+		MappedFile& operator= (MappedFile const&) = delete;
+
+		MappedFile( MappedFile&& ) noexcept;
+		MappedFile& operator= (MappedFile&&) noexcept;
+
+	public:
+		std::span<unsigned char const> bytes() const noexcept;
+
+	private:
+		void release_() noexcept;
+
+	private:
+		unsigned char const* mData;
+		std::size_t mSize;
+
+#		if defined(_WIN32)
+		void* mMapping; // HANDLE
+#		endif // ~ _WIN32
+};
+
+#endif // MAPPED_FILE_HPP_6725343F_83D9_48AA_BD18_F2CAE076C040
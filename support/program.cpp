@@ -1,10 +1,18 @@
 #include "program.hpp"
 
+#include <chrono>
+#include <format>
+#include <algorithm>
 #include <print>
+#include <string>
 #include <vector>
 #include <utility>
+#include <filesystem>
+#include <system_error>
 
+#include <cassert>
 #include <cstdio>
+#include <cstring>
 
 #include <glad/glad.h>
 
@@ -13,10 +21,57 @@
 
 namespace
 {
-	GLuint load_shader_( 
-		GLenum aShaderType, 
-		char const* aSourcePath
-	);
+	std::string read_source_( char const* aSourcePath );
+
+	// Inserts aDefines after the #version line (or at the start)
+	void inject_defines_( std::string& aSource, std::vector<ShaderProgram::Define> const& aDefines );
+
+	// Starts compiling the shader; check_shader_() waits for it, and throws
+	// Error if it failed
+	GLuint submit_shader_( GLenum aShaderType, std::string const& aSource );
+	void check_shader_( GLuint aShader, GLenum aShaderType, char const* aSourcePath );
+
+	// GL_KHR_parallel_shader_compile
+	constexpr GLenum kCompletionStatus_ = 0x91B1;
+
+	// Uniforms by type: components of 4 bytes each (0 if unsupported)
+	struct UniformFormat_
+	{
+		std::size_t components;
+	};
+
+	UniformFormat_ uniform_format_( GLenum aType ) noexcept;
+	void upload_uniform_( GLuint aProgram, GLint aLocation, GLenum aType, GLsizei aCount, void const* aData );
+
+	// Binary cache
+	struct BinaryHeader_
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t format;
+		std::uint32_t length;
+		double compileMs;
+	};
+
+	constexpr char kBinaryMagic_[4] = { 'G', 'L', 'P', 'B' };
+	constexpr std::uint32_t kBinaryVersion_ = 1;
+
+	std::string gCacheDirectory_;
+	ProgramCacheStats gCacheStats_;
+
+	std::uint64_t hash_( std::uint64_t aHash, void const* aData, std::size_t aSize );
+	std::uint64_t cache_key_( std::vector<ShaderProgram::ShaderSource> const&, std::vector<std::string> const& );
+	std::string cache_path_( std::uint64_t aKey );
+
+	// The program, linked from its cached binary, or 0
+	GLuint load_binary_( std::uint64_t aKey );
+	void store_binary_( GLuint aProgram, std::uint64_t aKey, double aCompileMs );
+
+	double elapsed_ms_( std::chrono::steady_clock::time_point aSince )
+	{
+		return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - aSince ).count();
+	}
 
 	// lightweight std::experimental::scope_exit alternative
 	// Not the most complete or convenient implementation...
@@ -37,15 +92,20 @@ namespace
 	}
 }
 
-ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources )
+ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources, Build aBuild )
 	: mProgram( 0 )
 	, mSources( std::move(aShaderSources) )
 {
-	reload();
+	submit_();
+
+	if( Build::blocking == aBuild )
+		finish();
 }
 
 ShaderProgram::~ShaderProgram()
 {
+	discard_();
+
 	if( 0 != mProgram )
 		glDeleteProgram( mProgram );
 }
@@ -53,11 +113,17 @@ ShaderProgram::~ShaderProgram()
 ShaderProgram::ShaderProgram( ShaderProgram&& aOther ) noexcept
 	: mProgram( std::exchange( aOther.mProgram, 0 ) )
 	, mSources( std::move(aOther.mSources) )
+	, mPending( std::exchange( aOther.mPending, {} ) )
+	, mReflection( std::move(aOther.mReflection) )
+	, mUniformStats( aOther.mUniformStats )
 {}
 ShaderProgram& ShaderProgram::operator= (ShaderProgram&& aOther) noexcept
 {
 	std::swap( mProgram, aOther.mProgram );
 	std::swap( mSources, aOther.mSources );
+	std::swap( mPending, aOther.mPending );
+	std::swap( mReflection, aOther.mReflection );
+	std::swap( mUniformStats, aOther.mUniformStats );
 	return *this;
 }
 
@@ -66,48 +132,89 @@ GLuint ShaderProgram::programId() const noexcept
 	return mProgram;
 }
 
+void ShaderProgram::setBinaryCache( std::string aDirectory )
+{
+	if( !aDirectory.empty() )
+	{
+		std::error_code ec;
+		std::filesystem::create_directories( aDirectory, ec );
+		if( ec )
+			throw Error( "Unable to create shader cache directory '{}': {}", aDirectory, ec.message() );
+	}
+
+	gCacheDirectory_ = std::move(aDirectory);
+}
+
+ProgramCacheStats const& ShaderProgram::cacheStats() noexcept
+{
+	return gCacheStats_;
+}
+
+bool ShaderProgram::parallelCompile()
+{
+	// Looked up once; GL_ARB_parallel_shader_compile is the same thing
+	static bool const supported = [] {
+		GLint count = 0;
+		glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+
+		for( GLint i = 0; i < count; ++i )
+		{
+			auto const* name = reinterpret_cast<char const*>(glGetStringi( GL_EXTENSIONS, GLuint(i) ));
+			if( name && (0 == std::strcmp( name, "GL_KHR_parallel_shader_compile" ) || 0 == std::strcmp( name, "GL_ARB_parallel_shader_compile" )) )
+				return true;
+		}
+
+		return false;
+	}();
+
+	return supported;
+}
+
 void ShaderProgram::reload()
 {
-	// Space to hold the shaders when we load them
-	std::vector<GLuint> shaders;
-	shaders.reserve( mSources.size() );
+	submit_();
+	finish();
+}
 
-	// Ensure that shaders are cleaned up properly, regardless of how we leave
-	// the function (e.g., either by returning or by exception)
-	auto const scopeShaders_ = scope_exit_( [&shaders] {
-		for( auto const shader : shaders )
-			glDeleteShader( shader );
-	} );
+bool ShaderProgram::ready() const
+{
+	if( 0 == mPending.program || !parallelCompile() )
+		return true;
 
-	// Load shaders
-	for( auto const& source : mSources )
-		shaders.emplace_back( load_shader_( source.type, source.sourcePath.c_str() ) );
+	GLint done = GL_FALSE;
+	glGetProgramiv( mPending.program, kCompletionStatus_, &done );
+	return GL_FALSE != done;
+}
 
-	// Create program object
-	OGL_CHECKPOINT_ALWAYS();
+bool ShaderProgram::pending() const noexcept
+{
+	return 0 != mPending.program;
+}
+
+void ShaderProgram::finish()
+{
+	if( 0 == mPending.program )
+		return;
 
-	GLuint prog = glCreateProgram();
+	auto const start = std::chrono::steady_clock::now();
 
-	// Ensure that the program is cleaned up. 
+	// Whatever happens, the pending program and its shaders are released
+	// (or, on success, the program replaces mProgram, and the old one is)
+	auto prog = std::exchange( mPending.program, 0 );
+	auto const shaders = std::exchange( mPending.shaders, {} );
 
-	/* There is a small trick here. If we successfully compile and link the new
-	 * program, we will replace the value of the "prog" variable with the old
-	 * program's ID. In this case, the following will delete the old program
-	 * (if there was any). If we do not reach the end (e.g. exception thrown),
-	 * the new program ID will still be in the "prog" variable, and we will
-	 * delete it appropriately. (However, the old program in mProgram is left
-	 * intact).
-	 */
+	auto const scopeShaders_ = scope_exit_( [&shaders] {
+		for( auto const shader : shaders )
+			glDeleteShader( shader );
+	} );
 	auto const scopeProgram_ = scope_exit_( [&prog] {
 		if( 0 != prog )
 			glDeleteProgram( prog );
 	} );
 
-	// Link individual shaders to create the final shader program
-	for( auto const shader : shaders )
-		glAttachShader( prog, shader );
-
-	glLinkProgram( prog );
+	// Compile errors first, as they explain link errors
+	for( std::size_t i = 0; i < shaders.size(); ++i )
+		check_shader_( shaders[i], mSources[i].type, mSources[i].sourcePath.c_str() );
 
 	{
 		// Get info log
@@ -134,16 +241,265 @@ void ShaderProgram::reload()
 	
 	OGL_CHECKPOINT_ALWAYS();
 
+	// Time spent waiting here, and in submit_(); with a parallel compile,
+	// less than the compile took
+	auto const ms = mPending.submitMs + elapsed_ms_( start );
+	gCacheStats_.compiled += 1;
+	gCacheStats_.compileMs += ms;
+
+	if( mPending.cached )
+		store_binary_( prog, mPending.key, ms );
+
+	auto reflection = reflect_( prog );
+
 	// Replace the old shader program (if any) with the new one
 	std::swap( mProgram, prog );
+	mReflection = std::move(reflection);
+}
+
+GLint ShaderProgram::uniformLocation( std::string_view aName ) const noexcept
+{
+	auto const it = mReflection.locations.find( aName );
+	return mReflection.locations.end() == it ? -1 : it->second;
+}
+
+GLuint ShaderProgram::uniformBlockIndex( std::string_view aName ) const noexcept
+{
+	auto const it = mReflection.uniformBlocks.find( aName );
+	return mReflection.uniformBlocks.end() == it ? GL_INVALID_INDEX : it->second;
+}
+
+GLuint ShaderProgram::storageBlockIndex( std::string_view aName ) const noexcept
+{
+	auto const it = mReflection.storageBlocks.find( aName );
+	return mReflection.storageBlocks.end() == it ? GL_INVALID_INDEX : it->second;
+}
+
+UniformStats const& ShaderProgram::uniformStats() const noexcept
+{
+	return mUniformStats;
+}
+
+void ShaderProgram::setUniform_( GLint aLocation, void const* aData, std::size_t aBytes, GLsizei aCount )
+{
+	if( aLocation < 0 || std::size_t(aLocation) >= mReflection.byLocation.size() || mReflection.byLocation[aLocation] < 0 )
+		return;
+
+	auto& uniform = mReflection.uniforms[mReflection.byLocation[aLocation]];
+
+	// Wrong types are bugs; the shadow copy must not overflow either way
+	auto const format = uniform_format_( uniform.type );
+	bool const matches = format.components > 0 && aCount <= uniform.size && aBytes == std::size_t(aCount) * format.components * 4;
+	assert( matches && "setUniform(): value doesn't match the uniform's type" );
+	if( !matches )
+		return;
+
+	auto* shadow = mReflection.shadow.data() + uniform.shadow;
+	if( uniform.set && 0 == std::memcmp( shadow, aData, aBytes ) )
+	{
+		mUniformStats.skipped += 1;
+		return;
+	}
+
+	// Only the first aCount are known now, if that's fewer than it has
+	std::memcpy( shadow, aData, aBytes );
+	uniform.set = aCount == uniform.size;
+
+	upload_uniform_( mProgram, aLocation, uniform.type, aCount, aData );
+	mUniformStats.issued += 1;
+}
+
+ShaderProgram::Reflection_ ShaderProgram::reflect_( GLuint aProgram )
+{
+	Reflection_ reflection;
+
+	auto const name = [aProgram] ( GLenum aInterface, GLuint aIndex, GLint aLength ) {
+		std::string name( std::size_t(std::max( aLength, 1 )), '\0' );
+		glGetProgramResourceName( aProgram, aInterface, aIndex, GLsizei(name.size()), nullptr, name.data() );
+		name.resize( std::strlen( name.c_str() ) );
+		return name;
+	};
+
+	// Uniforms in the default block; those in blocks have no location
+	GLint count = 0;
+	glGetProgramInterfaceiv( aProgram, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count );
+
+	GLint maxLocation = -1;
+	for( GLint i = 0; i < count; ++i )
+	{
+		GLenum const props[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION };
+		GLint values[4] = {};
+		glGetProgramResourceiv( aProgram, GL_UNIFORM, GLuint(i), 4, props, 4, nullptr, values );
+
+		if( values[3] < 0 )
+			continue;
+
+		auto const uniformName = name( GL_UNIFORM, GLuint(i), values[0] );
+		auto const type = GLenum(values[1]);
+		auto const size = std::max( values[2], 1 );
+
+		reflection.locations.emplace( uniformName, values[3] );
+		if( uniformName.ends_with( "[0]" ) )
+			reflection.locations.emplace( uniformName.substr( 0, uniformName.size() - 3 ), values[3] );
+
+		auto const bytes = std::size_t(size) * uniform_format_( type ).components * 4;
+		reflection.uniforms.push_back( { values[3], type, size, reflection.shadow.size(), false } );
+		reflection.shadow.resize( reflection.shadow.size() + bytes );
+
+		maxLocation = std::max( maxLocation, values[3] );
+	}
+
+	reflection.byLocation.assign( std::size_t(maxLocation + 1), -1 );
+	for( std::size_t i = 0; i < reflection.uniforms.size(); ++i )
+		reflection.byLocation[reflection.uniforms[i].location] = int(i);
+
+	// Blocks
+	for( auto const& [interface, blocks] : { std::pair{ GL_UNIFORM_BLOCK, &reflection.uniformBlocks }, std::pair{ GL_SHADER_STORAGE_BLOCK, &reflection.storageBlocks } } )
+	{
+		GLint blockCount = 0;
+		glGetProgramInterfaceiv( aProgram, interface, GL_ACTIVE_RESOURCES, &blockCount );
+
+		for( GLint i = 0; i < blockCount; ++i )
+		{
+			GLenum const prop = GL_NAME_LENGTH;
+			GLint length = 0;
+			glGetProgramResourceiv( aProgram, interface, GLuint(i), 1, &prop, 1, nullptr, &length );
+
+			blocks->emplace( name( interface, GLuint(i), length ), GLuint(i) );
+		}
+	}
+
+	return reflection;
+}
+
+void ShaderProgram::submit_()
+{
+	discard_();
+
+	auto const start = std::chrono::steady_clock::now();
+
+	std::vector<std::string> sources;
+	sources.reserve( mSources.size() );
+	for( auto const& source : mSources )
+	{
+		sources.emplace_back( read_source_( source.sourcePath.c_str() ) );
+		inject_defines_( sources.back(), source.defines );
+	}
+
+	// Try the cache first
+	GLint binaryFormats = 0;
+	if( !gCacheDirectory_.empty() )
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats );
+
+	bool const cached = binaryFormats > 0;
+	std::uint64_t const key = cached ? cache_key_( mSources, sources ) : 0;
+
+	if( cached )
+	{
+		if( GLuint prog = load_binary_( key ) )
+		{
+			mReflection = reflect_( prog );
+			std::swap( mProgram, prog );
+			if( 0 != prog )
+				glDeleteProgram( prog );
+
+			auto const ms = elapsed_ms_( start );
+			gCacheStats_.loaded += 1;
+			gCacheStats_.loadMs += ms;
+			gCacheStats_.savedMs -= ms;
+			return;
+		}
+	}
+
+	// Compile and link, without asking how that went: with a parallel
+	// compile, the driver does it in the background until finish() asks
+	OGL_CHECKPOINT_ALWAYS();
+
+	Pending_ pending{};
+	pending.key = key;
+	pending.cached = cached;
+	pending.program = glCreateProgram();
+
+	for( std::size_t i = 0; i < mSources.size(); ++i )
+		pending.shaders.emplace_back( submit_shader_( mSources[i].type, sources[i] ) );
+
+	// Link individual shaders to create the final shader program
+	for( auto const shader : pending.shaders )
+		glAttachShader( pending.program, shader );
+
+	if( cached )
+		glProgramParameteri( pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+
+	glLinkProgram( pending.program );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	pending.submitMs = elapsed_ms_( start );
+	mPending = std::move(pending);
+}
+
+void ShaderProgram::discard_() noexcept
+{
+	for( auto const shader : mPending.shaders )
+		glDeleteShader( shader );
+
+	if( 0 != mPending.program )
+		glDeleteProgram( mPending.program );
+
+	mPending = {};
+}
+
+ShaderProgram& ShaderVariantCache::get( std::vector<ShaderProgram::ShaderSource> const& aSources, ShaderProgram::Build aBuild )
+{
+	std::string key;
+	for( auto const& source : aSources )
+	{
+		auto defines = source.defines;
+		std::sort( defines.begin(), defines.end(), [] ( auto const& aX, auto const& aY ) {
+			return aX.name < aY.name;
+		} );
+
+		key += std::format( "{:x}:{}", source.type, source.sourcePath );
+		for( auto const& define : defines )
+			key += std::format( "|{}={}", define.name, define.value );
+		key += '\n';
+	}
+
+	auto& program = mPrograms[key];
+	if( !program )
+	{
+		// Not cached if it throws
+		try
+		{
+			program = std::make_unique<ShaderProgram>( aSources, aBuild );
+		}
+		catch( ... )
+		{
+			mPrograms.erase( key );
+			throw;
+		}
+	}
+
+	return *program;
+}
+
+std::size_t ShaderVariantCache::size() const noexcept
+{
+	return mPrograms.size();
+}
+
+void ShaderVariantCache::reloadAll()
+{
+	for( auto& [key, program] : mPrograms )
+		program->reload();
 }
 
 namespace
 {
-	GLuint load_shader_( GLenum aShaderType, char const* aSourcePath )
+	std::string read_source_( char const* aSourcePath )
 	{
 		// Load the shader source code from file
-		std::vector<GLchar> source;
+		std::string source;
 
 		if( std::FILE* fin = std::fopen( aSourcePath, "rb" ) )
 		{
@@ -163,9 +519,9 @@ namespace
 				if( 0 == ret )
 				{
 					if( auto const err = std::ferror( fin ) )
-						throw Error( "load_shader_(): error while reading from '{}': {} ({} bytes read, {} total)", aSourcePath, err, read, length );
+						throw Error( "read_source_(): error while reading from '{}': {} ({} bytes read, {} total)", aSourcePath, err, read, length );
 					if( std::feof( fin ) )
-						throw Error( "load_shader_(): unexpected EOF in '{}' ({} bytes read, {} total)", aSourcePath, read, length );
+						throw Error( "read_source_(): unexpected EOF in '{}' ({} bytes read, {} total)", aSourcePath, read, length );
 				}
 			
 				read += ret;
@@ -173,9 +529,37 @@ namespace
 		}
 		else
 		{
-			throw Error( "load_shader_(): unable to open input file '{}'", aSourcePath );
+			throw Error( "read_source_(): unable to open input file '{}'", aSourcePath );
 		}
 
+		return source;
+	}
+
+	void inject_defines_( std::string& aSource, std::vector<ShaderProgram::Define> const& aDefines )
+	{
+		if( aDefines.empty() )
+			return;
+
+		std::size_t at = 0;
+		std::size_t nextLine = 1;
+
+		if( auto const version = aSource.find( "#version" ); std::string::npos != version )
+		{
+			auto const end = aSource.find( '\n', version );
+			at = std::string::npos == end ? aSource.size() : end + 1;
+			nextLine = 1 + std::size_t(std::count( aSource.begin(), aSource.begin() + std::ptrdiff_t(at), '\n' ));
+		}
+
+		std::string defines = (at > 0 && '\n' != aSource[at-1]) ? "\n" : "";
+		for( auto const& define : aDefines )
+			defines += std::format( "#define {} {}\n", define.name, define.value );
+		defines += std::format( "#line {}\n", nextLine );
+
+		aSource.insert( at, defines );
+	}
+
+	GLuint submit_shader_( GLenum aShaderType, std::string const& aSource )
+	{
 		// Create shader object
 		OGL_CHECKPOINT_ALWAYS();
 
@@ -183,10 +567,10 @@ namespace
 
 		// Compile shader
 		GLchar const* sources[] = {
-			source.data()
+			aSource.data()
 		};
 		GLsizei lengths[] = {
-			GLsizei(source.size())
+			GLsizei(aSource.size())
 		};
 
 		glShaderSource( shader, sizeof(sources)/sizeof(sources[0]), sources, lengths );
@@ -195,19 +579,24 @@ namespace
 
 		OGL_CHECKPOINT_ALWAYS();
 
+		return shader;
+	}
+
+	void check_shader_( GLuint aShader, GLenum aShaderType, char const* aSourcePath )
+	{
 		// Get compile info log
 		/* The compile log is mainly relevant if there is an error. However, on some
 		 * systems, it can include additional information even if compilation was
 		 * successful. This might include warnings and/or usage hints.
 		 */
 		GLint logLength = 0;
-		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
+		glGetShaderiv( aShader, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetShaderInfoLog( shader, GLsizei(log.size()), nullptr, log.data() );
+			glGetShaderInfoLog( aShader, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		char const* shaderTypeName = "unknown shader";
@@ -223,19 +612,219 @@ namespace
 
 		// Check compile status
 		GLint status = 0;
-		glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+		glGetShaderiv( aShader, GL_COMPILE_STATUS, &status );
 
 		if( GL_TRUE != status )
-		{
-			glDeleteShader( shader );
 			throw Error( "{} \"{}\" compilation failed:\n{}\n", shaderTypeName, aSourcePath, log.data() );
-		}
 
 		if( !log.empty() )
 			std::print( stderr, "Note: {} \"{}\" log:\n{}\n", shaderTypeName, aSourcePath, log.data() );
 
 		OGL_CHECKPOINT_ALWAYS();
+	}
 
-		return shader;
+	std::uint64_t hash_( std::uint64_t aHash, void const* aData, std::size_t aSize )
+	{
+		// FNV-1a
+		auto const* bytes = static_cast<unsigned char const*>(aData);
+		for( std::size_t i = 0; i < aSize; ++i )
+		{
+			aHash ^= bytes[i];
+			aHash *= 0x100000001b3ull;
+		}
+		return aHash;
+	}
+
+	std::uint64_t cache_key_( std::vector<ShaderProgram::ShaderSource> const& aSources, std::vector<std::string> const& aTexts )
+	{
+		std::uint64_t key = 0xcbf29ce484222325ull;
+
+		for( auto const name : { GL_VENDOR, GL_RENDERER, GL_VERSION } )
+		{
+			auto const* str = reinterpret_cast<char const*>(glGetString( name ));
+			if( str )
+				key = hash_( key, str, std::strlen( str ) + 1 );
+		}
+
+		for( std::size_t i = 0; i < aSources.size(); ++i )
+		{
+			auto const size = std::uint64_t(aTexts[i].size());
+			key = hash_( key, &aSources[i].type, sizeof(aSources[i].type) );
+			key = hash_( key, &size, sizeof(size) );
+			key = hash_( key, aTexts[i].data(), aTexts[i].size() );
+		}
+
+		return key;
+	}
+
+	std::string cache_path_( std::uint64_t aKey )
+	{
+		return std::format( "{}/{:016x}.glprog", gCacheDirectory_, aKey );
+	}
+
+	GLuint load_binary_( std::uint64_t aKey )
+	{
+		auto const path = cache_path_( aKey );
+
+		std::FILE* fin = std::fopen( path.c_str(), "rb" );
+		if( !fin )
+			return 0;
+
+		BinaryHeader_ header{};
+		std::vector<char> binary;
+		{
+			auto const scopeFile_ = scope_exit_( [&fin] {
+				std::fclose( fin );
+			} );
+
+			if( 1 != std::fread( &header, sizeof(header), 1, fin ) )
+				header = {};
+
+			if( 0 == std::memcmp( header.magic, kBinaryMagic_, sizeof(kBinaryMagic_) ) && kBinaryVersion_ == header.version && aKey == header.key )
+			{
+				binary.resize( header.length );
+				if( header.length != std::fread( binary.data(), 1, binary.size(), fin ) )
+					binary.clear();
+			}
+		}
+
+		GLuint prog = 0;
+		if( !binary.empty() )
+		{
+			prog = glCreateProgram();
+			glProgramBinary( prog, header.format, binary.data(), GLsizei(binary.size()) );
+
+			GLint status = 0;
+			glGetProgramiv( prog, GL_LINK_STATUS, &status );
+
+			if( GL_TRUE != status )
+			{
+				glDeleteProgram( prog );
+				prog = 0;
+			}
+		}
+
+		// Malformed or rejected (say, by a driver update that kept its
+		// version string): compile from source, and replace it
+		if( 0 == prog )
+		{
+			gCacheStats_.rejected += 1;
+			std::remove( path.c_str() );
+			return 0;
+		}
+
+		gCacheStats_.savedMs += header.compileMs;
+		return prog;
+	}
+
+	void store_binary_( GLuint aProgram, std::uint64_t aKey, double aCompileMs )
+	{
+		GLint length = 0;
+		glGetProgramiv( aProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+		if( length <= 0 )
+			return;
+
+		BinaryHeader_ header{};
+		std::memcpy( header.magic, kBinaryMagic_, sizeof(kBinaryMagic_) );
+		header.version = kBinaryVersion_;
+		header.key = aKey;
+		header.compileMs = aCompileMs;
+
+		std::vector<char> binary( static_cast<std::size_t>(length) );
+		GLsizei written = 0;
+		GLenum format = 0;
+		glGetProgramBinary( aProgram, length, &written, &format, binary.data() );
+		if( written <= 0 )
+			return;
+
+		header.format = format;
+		header.length = std::uint32_t(written);
+
+		// Written aside and renamed, so that another instance never reads
+		// half a binary
+		auto const path = cache_path_( aKey );
+		auto const temp = path + ".tmp";
+
+		bool ok = false;
+		if( std::FILE* fout = std::fopen( temp.c_str(), "wb" ) )
+		{
+			ok = 1 == std::fwrite( &header, sizeof(header), 1, fout )
+				&& header.length == std::fwrite( binary.data(), 1, header.length, fout );
+			ok = (0 == std::fclose( fout )) && ok;
+		}
+
+		std::error_code ec;
+		if( ok )
+			std::filesystem::rename( temp, path, ec );
+
+		if( !ok || ec )
+		{
+			std::filesystem::remove( temp, ec );
+			std::print( stderr, "Note: unable to cache shader program binary '{}'\n", path );
+			return;
+		}
+
+		gCacheStats_.stored += 1;
+	}
+
+	UniformFormat_ uniform_format_( GLenum aType ) noexcept
+	{
+		switch( aType )
+		{
+			case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL:
+				return { 1 };
+			case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+				return { 2 };
+			case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+				return { 3 };
+			case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+			case GL_FLOAT_MAT2:
+				return { 4 };
+			case GL_FLOAT_MAT3:
+				return { 9 };
+			case GL_FLOAT_MAT4:
+				return { 16 };
+
+			// Samplers and images are set with their unit
+			case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER:
+			case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+			case GL_IMAGE_2D: case GL_IMAGE_BUFFER:
+				return { 1 };
+		}
+
+		return { 0 };
+	}
+
+	void upload_uniform_( GLuint aProgram, GLint aLocation, GLenum aType, GLsizei aCount, void const* aData )
+	{
+		auto const* f = static_cast<GLfloat const*>(aData);
+		auto const* i = static_cast<GLint const*>(aData);
+		auto const* u = static_cast<GLuint const*>(aData);
+
+		switch( aType )
+		{
+			case GL_FLOAT: glProgramUniform1fv( aProgram, aLocation, aCount, f ); break;
+			case GL_FLOAT_VEC2: glProgramUniform2fv( aProgram, aLocation, aCount, f ); break;
+			case GL_FLOAT_VEC3: glProgramUniform3fv( aProgram, aLocation, aCount, f ); break;
+			case GL_FLOAT_VEC4: glProgramUniform4fv( aProgram, aLocation, aCount, f ); break;
+
+			case GL_UNSIGNED_INT: glProgramUniform1uiv( aProgram, aLocation, aCount, u ); break;
+			case GL_UNSIGNED_INT_VEC2: glProgramUniform2uiv( aProgram, aLocation, aCount, u ); break;
+			case GL_UNSIGNED_INT_VEC3: glProgramUniform3uiv( aProgram, aLocation, aCount, u ); break;
+			case GL_UNSIGNED_INT_VEC4: glProgramUniform4uiv( aProgram, aLocation, aCount, u ); break;
+
+			case GL_INT_VEC2: case GL_BOOL_VEC2: glProgramUniform2iv( aProgram, aLocation, aCount, i ); break;
+			case GL_INT_VEC3: case GL_BOOL_VEC3: glProgramUniform3iv( aProgram, aLocation, aCount, i ); break;
+			case GL_INT_VEC4: case GL_BOOL_VEC4: glProgramUniform4iv( aProgram, aLocation, aCount, i ); break;
+
+			// Row-major, as vmlib's
+			case GL_FLOAT_MAT2: glProgramUniformMatrix2fv( aProgram, aLocation, aCount, GL_TRUE, f ); break;
+			case GL_FLOAT_MAT3: glProgramUniformMatrix3fv( aProgram, aLocation, aCount, GL_TRUE, f ); break;
+			case GL_FLOAT_MAT4: glProgramUniformMatrix4fv( aProgram, aLocation, aCount, GL_TRUE, f ); break;
+
+			// GL_INT, GL_BOOL, samplers and images
+			default: glProgramUniform1iv( aProgram, aLocation, aCount, i ); break;
+		}
 	}
 }
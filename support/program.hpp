@@ -3,24 +3,96 @@
 
 #include <glad/glad.h>
 
+#include <memory>
 #include <string>
 #include <vector>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 
+// Uploads done and skipped by ShaderProgram::setUniform(), so far
+struct UniformStats
+{
+	std::size_t issued = 0;
+	std::size_t skipped = 0; // Same value as last time
+};
+
+// What ShaderProgram's binary cache has done so far
+struct ProgramCacheStats
+{
+	std::size_t loaded = 0;   // Linked from a cached binary
+	std::size_t compiled = 0; // Compiled and linked from source
+	std::size_t rejected = 0; // Cached binaries the driver refused
+	std::size_t stored = 0;
+
+	// Spent blocked loading or compiling; compiles in the background
+	// (ShaderProgram::Build::async) only count the waiting
+	double loadMs = 0.;
+	double compileMs = 0.;
+
+	// What the loaded programs took to compile when they were cached, less
+	// what loading them took
+	double savedMs = 0.;
+};
+
+// Each shader source can be specialized with defines, which are inserted
+// right after its #version line (followed by a #line, so that errors still
+// point at the file's own lines). Shaders give their constants defaults
+// with #ifndef, and programs override them.
+//
+// Linked programs can be cached (setBinaryCache()): reload() then links
+// from the binary glGetProgramBinary() returned last time, and only
+// compiles from source if there is none or the driver rejects it. The key
+// is a hash of the sources (as compiled, so anything injected into them
+// counts) and of the driver's vendor, renderer and version strings, so a
+// driver update or an edited shader just misses.
+//
+// Once linked, the program's active uniforms, uniform blocks and storage
+// blocks are looked up by name from a table filled at link time, rather
+// than by asking GL. setUniform() keeps a copy of every value it sets, and
+// skips the upload if the value hasn't changed; it sets the program's
+// uniforms directly (glProgramUniform*), so the program needn't be in use.
+// Values set with glUniform*() behind its back aren't seen, so a program
+// should be set one way or the other. Arrays are set whole, from their
+// first element.
+//
+// Programs can also be built in the background (Build::async): the
+// constructor only submits the compile and link, ready() says whether it is
+// done, and finish() waits for it and throws Error if it failed. Submitting
+// every program up front lets the driver compile them while the caller
+// loads everything else. Only drivers with GL_KHR_parallel_shader_compile
+// can say whether a program is ready; elsewhere ready() is always true, and
+// finish() compiles then, as the blocking build does.
 class ShaderProgram final
 {
 	public:
+		struct Define
+		{
+			std::string name;
+			std::string value;
+		};
+
 		struct ShaderSource
 		{
 			GLenum type;
 			std::string sourcePath;
+			std::vector<Define> defines = {};
+		};
+
+		enum class Build
+		{
+			blocking,
+			async
 		};
 
 	public:
 		explicit ShaderProgram( 
-			std::vector<ShaderSource> = {}
+			std::vector<ShaderSource> = {},
+			Build = Build::blocking
 		);
 
 		~ShaderProgram();
@@ -34,11 +106,160 @@ class ShaderProgram final
 	public:
 		GLuint programId() const noexcept;
 
+		// Blocking, like the constructor's default
 		void reload();
 
+		// Whether an async build is done (or finish() won't have to wait)
+		bool ready() const;
+		bool pending() const noexcept;
+
+		// Waits for an async build, and replaces the program with it; throws
+		// Error (keeping the old program) if it failed
+		void finish();
+
+	public:
+		// Active uniforms ("name" or, for arrays, "name[0]" too), -1 if
+		// there is no such uniform, or it was optimized out
+		GLint uniformLocation( std::string_view ) const noexcept;
+
+		// GL_INVALID_INDEX if there is no such block
+		GLuint uniformBlockIndex( std::string_view ) const noexcept;
+		GLuint storageBlockIndex( std::string_view ) const noexcept;
+
+		// Sets aCount values of the uniform at aLocation (or named aName),
+		// unless it has those already. T is laid out like the uniform's GLSL
+		// type: float, GLint (also for bool and samplers), GLuint, or floats
+		// like vecN and matN. Matrices are row-major, as vmlib's are. Does
+		// nothing for uniforms that aren't active.
+		template< typename tValue >
+		void setUniform( GLint aLocation, tValue const* aValues, GLsizei aCount );
+		template< typename tValue >
+		void setUniform( GLint aLocation, tValue const& aValue );
+		template< typename tValue >
+		void setUniform( std::string_view aName, tValue const& aValue );
+		template< typename tValue >
+		void setUniform( std::string_view aName, tValue const* aValues, GLsizei aCount );
+
+		UniformStats const& uniformStats() const noexcept;
+
+	public:
+		// Directory for cached program binaries, created if needed; empty
+		// (the default) disables the cache
+		static void setBinaryCache( std::string aDirectory );
+
+		static ProgramCacheStats const& cacheStats() noexcept;
+
+		// GL_KHR_parallel_shader_compile (or the ARB one)
+		static bool parallelCompile();
+
+	private:
+		void submit_();
+		void discard_() noexcept;
+
+		void setUniform_( GLint aLocation, void const* aData, std::size_t aBytes, GLsizei aCount );
+
+	private:
+		struct Pending_
+		{
+			GLuint program = 0;
+			std::vector<GLuint> shaders;
+			std::uint64_t key = 0;
+			bool cached = false;
+			double submitMs = 0.;
+		};
+
+		struct NameHash_
+		{
+			using is_transparent = void;
+
+			std::size_t operator() ( std::string_view aName ) const noexcept
+			{
+				return std::hash<std::string_view>{}( aName );
+			}
+		};
+
+		template< typename tValue >
+		using NameMap_ = std::unordered_map<std::string, tValue, NameHash_, std::equal_to<>>;
+
+		// Reflected at link time
+		struct Uniform_
+		{
+			GLint location;
+			GLenum type;
+			GLint size;           // Array elements
+			std::size_t shadow;   // Offset of its values in shadow
+			bool set;
+		};
+
+		struct Reflection_
+		{
+			NameMap_<GLint> locations;
+			NameMap_<GLuint> uniformBlocks;
+			NameMap_<GLuint> storageBlocks;
+
+			std::vector<Uniform_> uniforms;
+			std::vector<int> byLocation; // Index into uniforms, or -1
+			std::vector<unsigned char> shadow;
+		};
+
+		static Reflection_ reflect_( GLuint aProgram );
+
 	private:
 		GLuint mProgram;
 		std::vector<ShaderSource> mSources;
+		Pending_ mPending;
+
+		Reflection_ mReflection;
+		UniformStats mUniformStats;
+};
+
+template< typename tValue > inline
+void ShaderProgram::setUniform( GLint aLocation, tValue const* aValues, GLsizei aCount )
+{
+	setUniform_( aLocation, aValues, sizeof(tValue) * std::size_t(aCount), aCount );
+}
+template< typename tValue > inline
+void ShaderProgram::setUniform( GLint aLocation, tValue const& aValue )
+{
+	setUniform_( aLocation, &aValue, sizeof(tValue), 1 );
+}
+template< typename tValue > inline
+void ShaderProgram::setUniform( std::string_view aName, tValue const& aValue )
+{
+	setUniform_( uniformLocation( aName ), &aValue, sizeof(tValue), 1 );
+}
+template< typename tValue > inline
+void ShaderProgram::setUniform( std::string_view aName, tValue const* aValues, GLsizei aCount )
+{
+	setUniform_( uniformLocation( aName ), aValues, sizeof(tValue) * std::size_t(aCount), aCount );
+}
+
+// Programs by their sources and defines, each built the first time it is
+// asked for, so that specialized variants (a light count, an instance
+// count, ...) are built once, on demand, and shared. The programs stay put
+// while the cache lives.
+class ShaderVariantCache final
+{
+	public:
+		ShaderVariantCache() = default;
+
+		ShaderVariantCache( ShaderVariantCache const& ) = delete;
+		ShaderVariantCache& operator= (ShaderVariantCache const&) = delete;
+
+	public:
+		// The build mode only matters the first time; defines match in any
+		// order
+		ShaderProgram& get(
+			std::vector<ShaderProgram::ShaderSource> const&,
+			ShaderProgram::Build = ShaderProgram::Build::blocking
+		);
+
+		std::size_t size() const noexcept;
+
+		void reloadAll();
+
+	private:
+		std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> mPrograms;
 };
 
 #endif // PROGRAM_HPP_EEC27A62_D86E_4D88_A66C_7A8E7142515A
@@ -0,0 +1,2 @@
+#define STB_TRUETYPE_IMPLEMENTATION 1
+#include <stb_truetype.h>